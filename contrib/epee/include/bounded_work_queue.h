@@ -0,0 +1,147 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "misc_log_ex.h"
+
+// Fixed set of worker threads fed through a queue of limited length.
+// Meant for taking long jobs off network I/O threads: try_post() never blocks,
+// when the queue is full caller gets false and decides itself (usually runs the job in place).
+namespace epee
+{
+  class bounded_work_queue
+  {
+  public:
+    typedef std::function<void()> job_t;
+
+    bounded_work_queue(): m_max_pending(0), m_busy(0), m_run(false)
+    {}
+    ~bounded_work_queue()
+    {
+      stop();
+    }
+
+    bool start(size_t threads_count, size_t max_pending)
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      if (m_run)
+        return false;
+      m_max_pending = max_pending;
+      m_run = true;
+      for (size_t i = 0; i != threads_count; i++)
+        m_threads.push_back(std::thread([this](){ worker(); }));
+      return true;
+    }
+
+    // waits for jobs in progress, pending jobs are discarded
+    void stop()
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_lock);
+        if (!m_run)
+          return;
+        m_run = false;
+        m_jobs.clear();
+      }
+      m_have_jobs.notify_all();
+      for (auto& th : m_threads)
+        th.join();
+      m_threads.clear();
+    }
+
+    bool try_post(const job_t& job)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_lock);
+        if (!m_run || m_jobs.size() >= m_max_pending)
+          return false;
+        m_jobs.push_back(job);
+      }
+      m_have_jobs.notify_one();
+      return true;
+    }
+
+    bool is_running()
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      return m_run;
+    }
+
+    // queued and running jobs
+    size_t get_jobs_count()
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      return m_jobs.size() + m_busy;
+    }
+
+  private:
+    void worker()
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      while (true)
+      {
+        m_have_jobs.wait(lock, [this](){ return !m_run || !m_jobs.empty(); });
+        if (!m_run)
+          return;
+        job_t job = m_jobs.front();
+        m_jobs.pop_front();
+        ++m_busy;
+        lock.unlock();
+        //jobs are expected to handle their errors, whatever escapes is logged and the thread goes on
+        try
+        {
+          job();
+        }
+        catch (const std::exception& e)
+        {
+          LOG_ERROR("bounded_work_queue: job threw exception: " << e.what());
+        }
+        catch (...)
+        {
+          LOG_ERROR("bounded_work_queue: job threw unknown exception");
+        }
+        lock.lock();
+        --m_busy;
+      }
+    }
+
+    std::mutex m_lock;
+    std::condition_variable m_have_jobs;
+    std::deque<job_t> m_jobs;
+    std::vector<std::thread> m_threads;
+    size_t m_max_pending;
+    size_t m_busy;
+    bool m_run;
+  };
+}
@@ -30,7 +30,7 @@
 #ifndef _GZIP_ENCODING_H_
 #define _GZIP_ENCODING_H_
 #include "net/http_client_base.h"
-#include "zlib/zlib.h"
+#include <zlib.h>
 //#include "http.h"
 
 
@@ -96,14 +96,15 @@ namespace net_utils
 
 			std::string decode_summary_buff;
 
-			size_t	ungzip_size = m_pre_decode.size() * 0x30;
+			size_t	ungzip_size = std::max<size_t>(m_pre_decode.size() * 0x30, 0x10000);
 			std::string current_decode_buff(ungzip_size, 'X');
 
 			//Here the cycle is introduced where we unpack the buffer, the cycle is required
-			//because of the case where if after unpacking the data will exceed the awaited size, we will not halt with error
-			bool continue_unpacking = true;
+			//because of the case where if after unpacking the data will exceed the awaited size, we will not halt with error.
+			//It goes on while output buffer is filled up completely: inflate could keep decoded data
+			//inside even if all the input is already consumed
 			bool first_step = true;
-			while(m_pre_decode.size() && continue_unpacking)
+			while(!m_is_stream_ended)
 			{
 
 				//fill buffers
@@ -114,7 +115,6 @@ namespace net_utils
 
 				int flag = Z_SYNC_FLUSH;
 				int ret = inflate(&m_zstream_in, flag);
-				CHECK_AND_ASSERT_MES(ret>=0 || m_zstream_in.avail_out ||m_is_deflate_mode, false, "content_encoding_gzip::update_in() Failed to inflate. err = " << ret);
 
 				if(Z_STREAM_END == ret)
 					m_is_stream_ended = true;
@@ -142,20 +142,24 @@ namespace net_utils
 					m_zstream_in.avail_in = (uInt)m_pre_decode.size();
 
 					ret = inflate(&m_zstream_in, Z_NO_FLUSH);
-					if (ret != Z_OK)
+					if (ret != Z_OK && ret != Z_STREAM_END)
 					{
 						LOCAL_ASSERT(0);
 						m_pre_decode.swap(piece_of_transfer);
 						return false;
 					}
+					if(Z_STREAM_END == ret)
+						m_is_stream_ended = true;
+				}
+				else
+				{
+					//Z_BUF_ERROR only means that there was nothing to do
+					CHECK_AND_ASSERT_MES(ret == Z_OK || ret == Z_BUF_ERROR, false, "content_encoding_gzip::update_in() Failed to inflate. err = " << ret);
 				}
-
 
 				//leave only unpacked part in the output buffer to start with it the next time
 				m_pre_decode.erase(0, m_pre_decode.size()-m_zstream_in.avail_in);
-				//if decoder gave nothing to return, then everything is ahead, now simply break
-				if(ungzip_size == m_zstream_in.avail_out)
-					break;
+				bool is_output_full = !m_zstream_in.avail_out;
 
 				//decode_buff currently stores data parts that were unpacked, fix this size
 				current_decode_buff.resize(ungzip_size - m_zstream_in.avail_out);
@@ -166,6 +170,8 @@ namespace net_utils
 
 				current_decode_buff.resize(ungzip_size);
 				first_step = false;
+				if(!is_output_full)
+					break;
 			}
 
 			//Process these data if required
@@ -219,6 +225,30 @@ namespace net_utils
 		*/
 		bool		m_is_first_update_in;
 	};
+
+	/*! \brief
+	*  Function gzip_compress : packs whole buffer into gzip stream (HTTP "Content-Encoding: gzip")
+	*
+	*/
+	inline
+	bool gzip_compress(const std::string& source, std::string& target, int level = Z_DEFAULT_COMPRESSION)
+	{
+		z_stream zstream;
+		memset(&zstream, 0, sizeof(zstream));
+		int ret = deflateInit2(&zstream, level, Z_DEFLATED, 0x1F, 8, Z_DEFAULT_STRATEGY);
+		CHECK_AND_ASSERT_MES(ret == Z_OK, false, "gzip_compress() Failed to init deflate. err = " << ret);
+
+		target.resize(deflateBound(&zstream, (uLong)source.size()));
+		zstream.next_in = (Bytef*)source.data();
+		zstream.avail_in = (uInt)source.size();
+		zstream.next_out = (Bytef*)&target[0];
+		zstream.avail_out = (uInt)target.size();
+		ret = deflate(&zstream, Z_FINISH);
+		deflateEnd(&zstream);
+		CHECK_AND_ASSERT_MES(ret == Z_STREAM_END, false, "gzip_compress() Failed to deflate. err = " << ret);
+		target.resize(target.size() - zstream.avail_out);
+		return true;
+	}
 }
 }
 
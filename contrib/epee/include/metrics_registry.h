@@ -0,0 +1,273 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+// Process-wide registry of counters, gauges and fixed-bucket histograms.
+// Metrics are created once (under the registry mutex) and cached in function-static references
+// by the macros below, so updating them is a few relaxed atomic operations without any lock.
+// render_text() produces Prometheus text exposition format.
+
+#define METRICS_COUNTER_ADD(name, labels, value) \
+  do { static epee::metrics::counter& metric_ = epee::metrics::registry::instance().get_counter(name, labels); metric_.add(value); } while(0)
+
+#define METRICS_COUNTER_INC(name, labels) METRICS_COUNTER_ADD(name, labels, 1)
+
+#define METRICS_GAUGE_SET(name, labels, value) \
+  do { static epee::metrics::gauge& metric_ = epee::metrics::registry::instance().get_gauge(name, labels); metric_.set(static_cast<int64_t>(value)); } while(0)
+
+#define METRICS_HISTOGRAM_OBSERVE(name, labels, value) \
+  do { static epee::metrics::histogram& metric_ = epee::metrics::registry::instance().get_histogram(name, labels); metric_.observe(static_cast<uint64_t>(value)); } while(0)
+
+// observes microseconds spent in the current scope
+#define METRICS_SCOPED_TIMER(var_name, name, labels) \
+  static epee::metrics::histogram& var_name##_histogram = epee::metrics::registry::instance().get_histogram(name, labels); \
+  epee::metrics::scoped_timer var_name(var_name##_histogram);
+
+namespace epee
+{
+namespace metrics
+{
+  class counter
+  {
+  public:
+    counter() : m_value(0)
+    {}
+
+    void add(uint64_t v) { m_value.fetch_add(v, std::memory_order_relaxed); }
+    uint64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> m_value;
+  };
+
+  class gauge
+  {
+  public:
+    gauge() : m_value(0)
+    {}
+
+    void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+    void add(int64_t v) { m_value.fetch_add(v, std::memory_order_relaxed); }
+    int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int64_t> m_value;
+  };
+
+  // values are expected in microseconds, buckets go from 10us to 10s
+  class histogram
+  {
+  public:
+    enum { buckets_count = 13 };
+
+    static const uint64_t* bucket_bounds()
+    {
+      static const uint64_t bounds[buckets_count] = { 10, 50, 100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000, 10000000 };
+      return bounds;
+    }
+
+    histogram() : m_sum(0), m_count(0)
+    {
+      for (size_t i = 0; i != buckets_count + 1; i++)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    void observe(uint64_t v)
+    {
+      const uint64_t* bounds = bucket_bounds();
+      size_t i = 0;
+      while (i != buckets_count && v > bounds[i])
+        ++i;
+      m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+      m_sum.fetch_add(v, std::memory_order_relaxed);
+      m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // not cumulative, the last one is +Inf bucket
+    uint64_t get_bucket(size_t i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+    uint64_t get_sum() const { return m_sum.load(std::memory_order_relaxed); }
+    uint64_t get_count() const { return m_count.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> m_buckets[buckets_count + 1];
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_count;
+  };
+
+  class scoped_timer
+  {
+  public:
+    explicit scoped_timer(histogram& h) : m_histogram(h), m_start(std::chrono::high_resolution_clock::now())
+    {}
+
+    ~scoped_timer()
+    {
+      m_histogram.observe(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - m_start).count());
+    }
+
+  private:
+    histogram& m_histogram;
+    std::chrono::high_resolution_clock::time_point m_start;
+  };
+
+  class registry
+  {
+  public:
+    static registry& instance()
+    {
+      static registry r;
+      return r;
+    }
+
+    // labels are given in exposition format without braces: key1="v1",key2="v2"
+    counter& get_counter(const std::string& name, const std::string& labels)
+    {
+      return get_metric(name, labels, type_counter, m_counters);
+    }
+
+    gauge& get_gauge(const std::string& name, const std::string& labels)
+    {
+      return get_metric(name, labels, type_gauge, m_gauges);
+    }
+
+    histogram& get_histogram(const std::string& name, const std::string& labels)
+    {
+      return get_metric(name, labels, type_histogram, m_histograms);
+    }
+
+    // one line description rendered as # HELP, may be set before or after the metric is created
+    void set_help(const std::string& name, const std::string& help)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_help[name] = help;
+    }
+
+    std::string render_text()
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      std::stringstream ss;
+      for (auto& f : m_families)
+      {
+        auto hit = m_help.find(f.first);
+        if (hit != m_help.end())
+          ss << "# HELP " << f.first << " " << hit->second << "\n";
+        ss << "# TYPE " << f.first << " " << get_type_name(f.second) << "\n";
+        switch (f.second)
+        {
+        case type_counter:
+          for (auto& m : m_counters[f.first])
+            ss << f.first << wrap_labels(m.first) << " " << m.second->get() << "\n";
+          break;
+        case type_gauge:
+          for (auto& m : m_gauges[f.first])
+            ss << f.first << wrap_labels(m.first) << " " << m.second->get() << "\n";
+          break;
+        case type_histogram:
+          for (auto& m : m_histograms[f.first])
+            render_histogram(ss, f.first, m.first, *m.second);
+          break;
+        }
+      }
+      return ss.str();
+    }
+
+  private:
+    enum metric_type { type_counter, type_gauge, type_histogram };
+
+    template<class t_metric>
+    using metrics_by_labels = std::map<std::string, std::unique_ptr<t_metric> >;
+
+    registry()
+    {}
+
+    template<class t_metric>
+    t_metric& get_metric(const std::string& name, const std::string& labels, metric_type type, std::map<std::string, metrics_by_labels<t_metric> >& container)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      //first registration defines the family type, metric of the same name with another type goes to a separate family
+      std::string family_name = name;
+      auto fit = m_families.insert(std::make_pair(family_name, type)).first;
+      if (fit->second != type)
+      {
+        family_name = name + "_" + get_type_name(type);
+        m_families.insert(std::make_pair(family_name, type));
+      }
+      std::unique_ptr<t_metric>& m = container[family_name][labels];
+      if (!m)
+        m.reset(new t_metric());
+      return *m;
+    }
+
+    static const char* get_type_name(metric_type t)
+    {
+      switch (t)
+      {
+      case type_counter:   return "counter";
+      case type_gauge:     return "gauge";
+      case type_histogram: return "histogram";
+      }
+      return "untyped";
+    }
+
+    static std::string wrap_labels(const std::string& labels)
+    {
+      return labels.empty() ? std::string() : "{" + labels + "}";
+    }
+
+    static void render_histogram(std::stringstream& ss, const std::string& name, const std::string& labels, const histogram& h)
+    {
+      std::string labels_prefix = labels.empty() ? std::string() : labels + ",";
+      const uint64_t* bounds = histogram::bucket_bounds();
+      uint64_t cumulative = 0;
+      for (size_t i = 0; i != histogram::buckets_count; i++)
+      {
+        cumulative += h.get_bucket(i);
+        ss << name << "_bucket{" << labels_prefix << "le=\"" << bounds[i] << "\"} " << cumulative << "\n";
+      }
+      cumulative += h.get_bucket(histogram::buckets_count);
+      ss << name << "_bucket{" << labels_prefix << "le=\"+Inf\"} " << cumulative << "\n";
+      ss << name << "_sum" << wrap_labels(labels) << " " << h.get_sum() << "\n";
+      ss << name << "_count" << wrap_labels(labels) << " " << h.get_count() << "\n";
+    }
+
+    std::mutex m_lock;
+    std::map<std::string, metric_type> m_families;
+    std::map<std::string, std::string> m_help;
+    std::map<std::string, metrics_by_labels<counter> > m_counters;
+    std::map<std::string, metrics_by_labels<gauge> > m_gauges;
+    std::map<std::string, metrics_by_labels<histogram> > m_histograms;
+  };
+}
+}
@@ -38,6 +38,8 @@
 #include <algorithm>
 #include <list>
 #include <map>
+#include <memory>
+#include <thread>
 #include <time.h>
 #ifndef Q_MOC_RUN
 #include <boost/cstdint.hpp>
@@ -747,12 +749,126 @@ namespace log_space
 
 
 
+  /************************************************************************/
+  /* Bounded lock-free queue with many producers and a single consumer,   */
+  /* used by asynchronous logging. Cells carry sequence numbers as in     */
+  /* D. Vyukov's bounded MPMC queue: producers claim a position with CAS, */
+  /* consumer owns the read position.                                     */
+  /************************************************************************/
+  template<class t_entry>
+  class mpsc_bounded_queue
+  {
+  public:
+    mpsc_bounded_queue(size_t size): m_mask(0), m_enqueue_pos(0), m_dequeue_pos(0)
+    {
+      size_t sz = get_capacity_for(size);
+      m_cells.reset(new cell[sz]);
+      m_mask = sz - 1;
+      for(size_t i = 0; i != sz; i++)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    //entry is moved into the queue on success
+    bool try_push(t_entry& e)
+    {
+      cell* pc = NULL;
+      size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      for(;;)
+      {
+        pc = &m_cells[pos & m_mask];
+        size_t seq = pc->sequence.load(std::memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if(dif == 0)
+        {
+          if(m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            break;
+        }
+        else if(dif < 0)
+          return false;//full
+        else
+          pos = m_enqueue_pos.load(std::memory_order_relaxed);
+      }
+      pc->data = std::move(e);
+      pc->sequence.store(pos + 1, std::memory_order_release);
+      return true;
+    }
+
+    //consumer side only
+    bool try_pop(t_entry& e)
+    {
+      cell& c = m_cells[m_dequeue_pos & m_mask];
+      if(c.sequence.load(std::memory_order_acquire) != m_dequeue_pos + 1)
+        return false;
+      e = std::move(c.data);
+      c.sequence.store(m_dequeue_pos + m_mask + 1, std::memory_order_release);
+      ++m_dequeue_pos;
+      return true;
+    }
+
+    //consumer side only
+    bool empty() const
+    {
+      return m_cells[m_dequeue_pos & m_mask].sequence.load(std::memory_order_acquire) != m_dequeue_pos + 1;
+    }
+
+    //number of positions claimed by producers so far
+    uint64_t get_pushed_count() const
+    {
+      return m_enqueue_pos.load(std::memory_order_acquire);
+    }
+
+    size_t get_capacity() const
+    {
+      return m_mask + 1;
+    }
+
+    //requested size is rounded up to power of two
+    static size_t get_capacity_for(size_t size)
+    {
+      size_t sz = 2;
+      while(sz < size)
+        sz <<= 1;
+      return sz;
+    }
+
+  private:
+    struct cell
+    {
+      std::atomic<size_t> sequence;
+      t_entry data;
+    };
+
+    std::unique_ptr<cell[]> m_cells;
+    size_t m_mask;
+    char m_pad0[64];
+    std::atomic<size_t> m_enqueue_pos;
+    char m_pad1[64];
+    size_t m_dequeue_pos;
+  };
+
+  struct async_log_entry
+  {
+    async_log_entry(): have_log_name(false), log_level(LOG_LEVEL_0), color(console_color_default), add_to_journal(false)
+    {}
+
+    std::string message;
+    std::string log_name;
+    bool have_log_name;
+    int log_level;
+    int color;
+    bool add_to_journal;
+  };
+
+#define ASYNC_LOG_MAX_BATCH              1024
+#define ASYNC_LOG_WRITER_IDLE_MS         100
+#define ASYNC_LOG_FLUSH_TIMEOUT_MS       2000
+
     class logger
   {
   public:
     friend class log_singletone;
 
-    logger()
+    logger(): m_async(false), m_async_producers(0), m_writer_run(false), m_writer_sleeping(false), m_flush_waiters(0), m_written_count(0), m_dropped_count(0), m_reported_dropped_count(0), m_writer_thread_id(std::thread::id())
     {
       CRITICAL_REGION_BEGIN(m_critical_sec);
       init();
@@ -760,6 +876,7 @@ namespace log_space
     }
     ~logger()
     {
+      set_async_mode(false);
     }
 
     bool set_max_logfile_size(uint64_t max_size)
@@ -780,6 +897,7 @@ namespace log_space
 
     bool take_away_journal(std::list<std::string>& journal)
     {
+      flush();
       CRITICAL_REGION_BEGIN(m_critical_sec);
       m_journal.swap(journal);
       CRITICAL_REGION_END();
@@ -788,6 +906,47 @@ namespace log_space
 
     bool do_log_message(const std::string& rlog_mes, int log_level, int color, bool add_to_journal = false, const char* plog_name = NULL)
     {
+      if(m_async)
+      {
+        //set_async_mode(false) waits for producers to leave before the last drain of the queue,
+        //m_async is checked again after registering so nothing is pushed after that drain
+        bool pushed = false;
+        bool queue_full = false;
+        ++m_async_producers;
+        if(m_async)
+        {
+          async_log_entry e;
+          e.message = rlog_mes;
+          e.have_log_name = plog_name != NULL;
+          if(plog_name)
+            e.log_name = plog_name;
+          e.log_level = log_level;
+          e.color = color;
+          e.add_to_journal = add_to_journal;
+          pushed = m_async_queue->try_push(e);
+          queue_full = !pushed;
+          if(pushed)
+          {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_writer_sleeping)
+              m_writer_wakeup.notify_one();
+          }
+        }
+        --m_async_producers;
+        if(pushed)
+        {
+          //errors go to journal, make sure they reach the streams before caller goes on (and maybe crashes)
+          if(add_to_journal)
+            flush();
+          return true;
+        }
+        if(queue_full && log_level > LOG_LEVEL_0)
+        {
+          ++m_dropped_count;
+          return false;
+        }
+        //queue is full or async mode was just switched off, level 0 messages are never dropped and written in place
+      }
       CRITICAL_REGION_BEGIN(m_critical_sec);
       m_log_target.do_log_message(rlog_mes, log_level, color, plog_name);
       if(add_to_journal)
@@ -831,6 +990,93 @@ namespace log_space
       return m_thr_prefix_strings[misc_utils::get_thread_string_id()];
     }
 
+    //in asynchronous mode do_log_message() only puts messages to a bounded lock-free queue,
+    //a dedicated thread writes them to the streams in batches. When queue is full, messages
+    //above LOG_LEVEL_0 are dropped and counted. Zero queue_size on re-enable keeps the queue
+    //of previous async period, other size replaces it; queue of running async mode can't be resized.
+    bool set_async_mode(bool enable, size_t queue_size = 0)
+    {
+      boost::lock_guard<boost::mutex> mode_lock(m_async_mode_lock);
+      if(enable == m_async)
+      {
+        //not logged: error message would go through this logger while mode lock is held
+        if(enable && queue_size && m_async_queue->get_capacity() != mpsc_bounded_queue<async_log_entry>::get_capacity_for(queue_size))
+          return false;
+        return true;
+      }
+      if(enable)
+      {
+        //queue was drained when async mode was switched off, nothing is lost by replacing it
+        if(!m_async_queue || (queue_size && m_async_queue->get_capacity() != mpsc_bounded_queue<async_log_entry>::get_capacity_for(queue_size)))
+        {
+          m_async_queue.reset(new mpsc_bounded_queue<async_log_entry>(queue_size));
+          //written messages are counted against positions of the queue, see flush()
+          m_written_count = 0;
+        }
+        m_writer_run = true;
+        m_writer_thread = boost::thread(&logger::writer_thread, this);
+        m_async = true;
+      }
+      else
+      {
+        m_async = false;
+        //producers that saw m_async set finish their push, later ones write synchronously
+        while(m_async_producers)
+          boost::this_thread::yield();
+        m_writer_run = false;
+        m_writer_wakeup.notify_one();
+        m_writer_thread.join();
+        //messages of threads that were inside do_log_message() while switching
+        while(write_async_batch());
+      }
+      return true;
+    }
+
+    bool is_async_mode()
+    {
+      return m_async;
+    }
+
+    //0 when async mode has never been on
+    size_t get_async_queue_size()
+    {
+      boost::lock_guard<boost::mutex> mode_lock(m_async_mode_lock);
+      return m_async_queue ? m_async_queue->get_capacity() : 0;
+    }
+
+    //waits until everything queued before the call is written, bounded by ASYNC_LOG_FLUSH_TIMEOUT_MS
+    bool flush()
+    {
+      if(!m_async || std::this_thread::get_id() == m_writer_thread_id.load())
+        return true;
+      uint64_t target = 0;
+      {
+        //queue may be replaced by set_async_mode() once async mode is off
+        boost::lock_guard<boost::mutex> mode_lock(m_async_mode_lock);
+        if(!m_async)
+          return true;
+        target = m_async_queue->get_pushed_count();
+      }
+      boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(ASYNC_LOG_FLUSH_TIMEOUT_MS);
+      ++m_flush_waiters;
+      m_writer_wakeup.notify_one();
+      {
+        boost::unique_lock<boost::mutex> lock(m_writer_lock);
+        while(m_written_count < target && m_async)
+        {
+          if(!m_flushed.timed_wait(lock, deadline) && boost::posix_time::microsec_clock::universal_time() >= deadline)
+            break;
+        }
+      }
+      --m_flush_waiters;
+      return m_written_count >= target;
+    }
+
+    uint64_t get_dropped_messages_count()
+    {
+      return m_dropped_count;
+    }
+
     std::string get_default_log_file()
     {
       return m_default_log_file;
@@ -848,6 +1094,78 @@ namespace log_space
 
   protected:
   private:
+    void writer_thread()
+    {
+      m_writer_thread_id = std::this_thread::get_id();
+      while(m_writer_run)
+      {
+        if(write_async_batch())
+          continue;
+        boost::unique_lock<boost::mutex> lock(m_writer_lock);
+        m_writer_sleeping = true;
+        //producers look at m_writer_sleeping after publishing, recheck queue to not miss them;
+        //wait is timed anyway so lost wakeup only delays output
+        if(m_writer_run && m_async_queue->empty())
+          m_writer_wakeup.timed_wait(lock, boost::posix_time::milliseconds(ASYNC_LOG_WRITER_IDLE_MS));
+        m_writer_sleeping = false;
+      }
+      while(write_async_batch());
+      m_writer_thread_id = std::thread::id();
+    }
+
+    //writes up to ASYNC_LOG_MAX_BATCH queued messages, consecutive messages with the same
+    //level, color and target are merged and go to streams with one call
+    bool write_async_batch()
+    {
+      async_log_entry e;
+      if(!m_async_queue || !m_async_queue->try_pop(e))
+        return false;
+
+      uint64_t count = 0;
+      CRITICAL_REGION_BEGIN(m_critical_sec);
+      std::string& merged = m_async_merge_buffer;
+      merged.clear();
+      int level = e.log_level;
+      int color = e.color;
+      bool have_log_name = e.have_log_name;
+      std::string log_name = e.log_name;
+      do
+      {
+        ++count;
+        if(merged.size() && (e.log_level != level || e.color != color || e.have_log_name != have_log_name || e.log_name != log_name))
+        {
+          m_log_target.do_log_message(merged, level, color, have_log_name ? log_name.c_str() : NULL);
+          merged.clear();
+          level = e.log_level;
+          color = e.color;
+          have_log_name = e.have_log_name;
+          log_name = e.log_name;
+        }
+        merged += e.message;
+        if(e.add_to_journal)
+          m_journal.push_back(e.message);
+      } while(count < ASYNC_LOG_MAX_BATCH && m_async_queue->try_pop(e));
+      m_log_target.do_log_message(merged, level, color, have_log_name ? log_name.c_str() : NULL);
+
+      uint64_t dropped = m_dropped_count;
+      if(dropped != m_reported_dropped_count)
+      {
+        std::stringstream ss;
+        ss << get_time_string() << " " << dropped - m_reported_dropped_count << " log messages dropped, asynchronous log queue is full" << std::endl;
+        m_log_target.do_log_message(ss.str(), LOG_LEVEL_0, console_color_red);
+        m_reported_dropped_count = dropped;
+      }
+      CRITICAL_REGION_END();
+
+      m_written_count += count;
+      if(m_flush_waiters)
+      {
+        boost::lock_guard<boost::mutex> lock(m_writer_lock);
+        m_flushed.notify_all();
+      }
+      return true;
+    }
+
     bool init()
     {
       //
@@ -893,6 +1211,24 @@ namespace log_space
     std::map<std::string, std::string> m_thr_prefix_strings;
     std::list<std::string> m_journal;
     critical_section m_critical_sec;
+
+    //asynchronous mode
+    std::unique_ptr<mpsc_bounded_queue<async_log_entry> > m_async_queue;
+    std::atomic<bool> m_async;
+    std::atomic<int> m_async_producers;
+    std::atomic<bool> m_writer_run;
+    std::atomic<bool> m_writer_sleeping;
+    std::atomic<int> m_flush_waiters;
+    std::atomic<uint64_t> m_written_count;
+    std::atomic<uint64_t> m_dropped_count;
+    uint64_t m_reported_dropped_count;
+    std::string m_async_merge_buffer;
+    boost::thread m_writer_thread;
+    std::atomic<std::thread::id> m_writer_thread_id;   //read by flush() without m_async_mode_lock
+    boost::mutex m_writer_lock;
+    boost::condition_variable m_writer_wakeup;
+    boost::condition_variable m_flushed;
+    boost::mutex m_async_mode_lock;
   };
   /************************************************************************/
   /*                                                                      */
@@ -931,6 +1267,27 @@ namespace log_space
       return res;
     }
 
+    static bool set_async_mode(bool enable, size_t queue_size = 0)
+    {
+      logger* plogger = get_or_create_instance();
+      if(!plogger) return false;
+      return plogger->set_async_mode(enable, queue_size);
+    }
+
+    static bool flush()
+    {
+      logger* plogger = get_or_create_instance();
+      if(!plogger) return false;
+      return plogger->flush();
+    }
+
+    static uint64_t get_dropped_messages_count()
+    {
+      logger* plogger = get_or_create_instance();
+      if(!plogger) return 0;
+      return plogger->get_dropped_messages_count();
+    }
+
     static bool take_away_journal(std::list<std::string>& journal)
     {
       logger* plogger = get_or_create_instance();
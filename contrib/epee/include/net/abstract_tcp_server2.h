@@ -49,6 +49,8 @@
 
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 2000
+#define ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE 8192
+#define ABSTRACT_SERVER_RECV_BUFFER_MAX_SIZE (256 * 1024)
 
 namespace epee
 {
@@ -109,14 +111,16 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    void adjust_recv_buffer(size_t bytes_transferred);
+
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
 
     /// Socket for the connection.
     boost::asio::ip::tcp::socket socket_;
 
-    /// Buffer for incoming data.
-    boost::array<char, 8192> buffer_;
+    /// Buffer for incoming data, grows while reads fill it up and shrinks back when traffic calms down.
+    std::vector<char> buffer_;
 
     t_connection_context context;
     volatile uint32_t m_want_close_connection;
@@ -154,7 +158,13 @@ namespace net_utils
     bool init_server(uint32_t port, const std::string address = "0.0.0.0");
     bool init_server(const std::string port,  const std::string& address = "0.0.0.0");
 
-    /// Run the server's io_service loop.
+    /// Spread connections over this many io_services (shards), each connection stays on its shard.
+    /// Should be called before init_server(), 0 or 1 - all connections share one io_service.
+    bool set_io_shards_count(size_t count);
+    size_t get_io_shards_count(){return m_io_shards.size() + 1;}
+
+    /// Run the server's io_service loop. In sharded mode threads are assigned to shards in turn,
+    /// each shard gets at least one thread.
     bool run_server(size_t threads_count, bool wait = true);
 
     /// wait for service workers stop
@@ -251,21 +261,30 @@ namespace net_utils
 
   private:
     /// Run the server's io_service loop.
-    bool worker_thread();
+    bool worker_thread(size_t shard);
     /// Handle completion of an asynchronous accept operation.
     void handle_accept(const boost::system::error_code& e);
 
     bool is_thread_worker();
 
+    boost::asio::io_service& get_shard_io_service(size_t shard);
+    /// io_service for the next new connection, shards are taken in turn
+    boost::asio::io_service& get_next_io_service();
+
     /// The io_service used to perform asynchronous operations.
     std::unique_ptr<boost::asio::io_service> m_io_service_local_instance;
     boost::asio::io_service& io_service_;    
+    /// Extra io_services of sharded mode, io_service_ is the first shard (it also runs acceptor and timers),
+    /// declared before connections so they outlive them
+    std::vector<std::unique_ptr<boost::asio::io_service> > m_io_shards;
+    std::vector<std::unique_ptr<boost::asio::io_service::work> > m_io_shards_work;
 
     /// Acceptor used to listen for incoming connections.
     boost::asio::ip::tcp::acceptor acceptor_;
 
     /// The next connection to be accepted.
     connection_ptr new_connection_;
+    std::atomic<size_t> m_next_shard;
     //std::mutex connections_mutex;
     //std::deque<connection_ptr> connections_;
     std::atomic<bool> m_stop_signal_sent;
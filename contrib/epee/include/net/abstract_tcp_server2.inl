@@ -52,6 +52,7 @@ DISABLE_VS_WARNINGS(4355)
     typename t_protocol_handler::config_type& config, volatile uint32_t& sock_count, i_connection_filter* &pfilter)
                           : strand_(io_service),
                             socket_(io_service),
+                            buffer_(ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE),
                             m_protocol_handler(this, config, context), 
                             m_want_close_connection(0), 
                             m_was_shutdown(0), 
@@ -217,6 +218,21 @@ DISABLE_VS_WARNINGS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void connection<t_protocol_handler>::adjust_recv_buffer(size_t bytes_transferred)
+  {
+    //full read means more data is waiting in socket (big frames while syncing), take it in bigger chunks
+    if(bytes_transferred == buffer_.size() && buffer_.size() < ABSTRACT_SERVER_RECV_BUFFER_MAX_SIZE)
+    {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    else if(bytes_transferred < buffer_.size() / 4 && buffer_.size() > ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE)
+    {
+      buffer_.resize(buffer_.size() / 2);
+      buffer_.shrink_to_fit();
+    }
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   void connection<t_protocol_handler>::handle_read(const boost::system::error_code& e,
     std::size_t bytes_transferred)
   {
@@ -244,6 +260,7 @@ DISABLE_VS_WARNINGS(4355)
           shutdown();
       }else
       {
+        adjust_recv_buffer(bytes_transferred);
         socket_.async_read_some(boost::asio::buffer(buffer_),
           strand_.wrap(
             boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
@@ -437,7 +454,7 @@ DISABLE_VS_WARNINGS(4355)
     io_service_(*m_io_service_local_instance.get()),
     acceptor_(io_service_),
     new_connection_(new connection<t_protocol_handler>(io_service_, m_config, m_sockets_count, m_pfilter)), 
-    m_stop_signal_sent(false), m_port(0), m_sockets_count(0), m_threads_count(0), m_pfilter(NULL), m_thread_index(0)
+    m_next_shard(0), m_stop_signal_sent(false), m_port(0), m_sockets_count(0), m_threads_count(0), m_pfilter(NULL), m_thread_index(0)
   {
     m_thread_name_prefix = "NET";
   }
@@ -447,12 +464,47 @@ DISABLE_VS_WARNINGS(4355)
     io_service_(extarnal_io_service),
     acceptor_(io_service_),
     new_connection_(new connection<t_protocol_handler>(io_service_, m_config, m_sockets_count, m_pfilter)), 
-    m_stop_signal_sent(false), m_port(0), m_sockets_count(0), m_threads_count(0), m_pfilter(NULL), m_thread_index(0)
+    m_next_shard(0), m_stop_signal_sent(false), m_port(0), m_sockets_count(0), m_threads_count(0), m_pfilter(NULL), m_thread_index(0)
   {
     m_thread_name_prefix = "NET";
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool boosted_tcp_server<t_protocol_handler>::set_io_shards_count(size_t count)
+  {
+    TRY_ENTRY();
+    CHECK_AND_ASSERT_MES(!acceptor_.is_open() && m_threads.empty(), false, "io shards count can't be changed on running server");
+    m_io_shards_work.clear();
+    m_io_shards.clear();
+    for (size_t i = 1; i < count; i++)
+    {
+      m_io_shards.push_back(std::unique_ptr<boost::asio::io_service>(new boost::asio::io_service()));
+      //shard io_service has no acceptor to keep it busy
+      m_io_shards_work.push_back(std::unique_ptr<boost::asio::io_service::work>(new boost::asio::io_service::work(*m_io_shards.back())));
+    }
+    m_next_shard = 0;
+    new_connection_.reset(new connection<t_protocol_handler>(get_next_io_service(), m_config, m_sockets_count, m_pfilter));
+    return true;
+    CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::set_io_shards_count", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::get_shard_io_service(size_t shard)
+  {
+    if (!shard)
+      return io_service_;
+    return *m_io_shards[shard - 1];
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::get_next_io_service()
+  {
+    if (m_io_shards.empty())
+      return io_service_;
+    return get_shard_io_service(m_next_shard++ % (m_io_shards.size() + 1));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   boosted_tcp_server<t_protocol_handler>::~boosted_tcp_server()
   {
     this->send_stop_signal();
@@ -500,18 +552,22 @@ DISABLE_GCC_WARNING(maybe-uninitialized)
 POP_WARNINGS
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool boosted_tcp_server<t_protocol_handler>::worker_thread()
+  bool boosted_tcp_server<t_protocol_handler>::worker_thread(size_t shard)
   {
     TRY_ENTRY();
     uint32_t local_thr_index = boost::interprocess::ipcdetail::atomic_inc32(&m_thread_index); 
     std::string thread_name = std::string("[") + m_thread_name_prefix;
-    thread_name += boost::to_string(local_thr_index) + "]";
+    thread_name += boost::to_string(local_thr_index);
+    if (m_io_shards.size())
+      thread_name += std::string("/") + boost::to_string(shard);
+    thread_name += "]";
     log_space::log_singletone::set_thread_log_prefix(thread_name);
+    boost::asio::io_service& ios = get_shard_io_service(shard);
     while(!m_stop_signal_sent)
     {
       try
       {
-        io_service_.run();
+        ios.run();
       }
       catch(const std::exception& ex)
       {
@@ -543,6 +599,8 @@ POP_WARNINGS
   bool boosted_tcp_server<t_protocol_handler>::run_server(size_t threads_count, bool wait)
   {
     TRY_ENTRY();
+    size_t shards_count = m_io_shards.size() + 1;
+    threads_count = std::max(threads_count, shards_count);
     m_threads_count = threads_count;
     m_main_thread_id = boost::this_thread::get_id();
     log_space::log_singletone::set_thread_log_prefix("[SRV_MAIN]");
@@ -554,7 +612,7 @@ POP_WARNINGS
       for (std::size_t i = 0; i < threads_count; ++i)
       {
         boost::shared_ptr<boost::thread> thread(new boost::thread(
-          boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this)));
+          boost::bind(&boosted_tcp_server<t_protocol_handler>::worker_thread, this, i % shards_count)));
         m_threads.push_back(thread);
       }
       CRITICAL_REGION_END();
@@ -634,6 +692,8 @@ POP_WARNINGS
 //     }
 //     connections_mutex.unlock();
     io_service_.stop();
+    for (auto& ios : m_io_shards)
+      ios->stop();
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::send_stop_signal()", void());
   }
   //---------------------------------------------------------------------------------
@@ -651,7 +711,7 @@ POP_WARNINGS
     {
       connection_ptr conn(std::move(new_connection_));
 
-      new_connection_.reset(new connection<t_protocol_handler>(io_service_, m_config, m_sockets_count, m_pfilter));
+      new_connection_.reset(new connection<t_protocol_handler>(get_next_io_service(), m_config, m_sockets_count, m_pfilter));
       acceptor_.async_accept(new_connection_->socket(),
         boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept, this,
         boost::asio::placeholders::error));
@@ -669,7 +729,7 @@ POP_WARNINGS
   {
     TRY_ENTRY();
 
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_config, m_sockets_count, m_pfilter) );
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(get_next_io_service(), m_config, m_sockets_count, m_pfilter) );
 //     connections_mutex.lock();
 //     connections_.push_back(new_connection_l);
 //     LOG_PRINT_L2("connections_ size now " << connections_.size());
@@ -769,7 +829,8 @@ POP_WARNINGS
   bool boosted_tcp_server<t_protocol_handler>::connect_async(const std::string& adr, const std::string& port, uint32_t conn_timeout, t_callback cb, const std::string& bind_ip)
   {
     TRY_ENTRY();    
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_config, m_sockets_count, m_pfilter) );
+    boost::asio::io_service& conn_io_service = get_next_io_service();
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(conn_io_service, m_config, m_sockets_count, m_pfilter) );
     boost::asio::ip::tcp::socket&  sock_ = new_connection_l->socket();
 //     connections_mutex.lock();
 //     connections_.push_back(new_connection_l);
@@ -795,7 +856,8 @@ POP_WARNINGS
       sock_.bind(local_endpoint);
     }
     
-    boost::shared_ptr<boost::asio::deadline_timer> sh_deadline(new boost::asio::deadline_timer(io_service_));
+    //deadline runs on connection's shard, so it doesn't race with connect handler from another thread
+    boost::shared_ptr<boost::asio::deadline_timer> sh_deadline(new boost::asio::deadline_timer(conn_io_service));
     //start deadline
     sh_deadline->expires_from_now(boost::posix_time::milliseconds(conn_timeout));
     sh_deadline->async_wait([=](const boost::system::error_code& error)
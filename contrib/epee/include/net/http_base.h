@@ -96,6 +96,7 @@ namespace net_utils
 			std::string m_content_type;     //"Content-Type:"
 			std::string m_transfer_encoding;//"Transfer-Encoding:"
 			std::string m_content_encoding; //"Content-Encoding:"
+			std::string m_accept_encoding;  //"Accept-Encoding:"
 			std::string m_host;             //"Host:"
 			std::string m_cookie;			//"Cookie:"
 			fields_list m_etc_fields;
@@ -108,6 +109,7 @@ namespace net_utils
 				m_content_type.clear();
 				m_transfer_encoding.clear();
 				m_content_encoding.clear();
+				m_accept_encoding.clear();
 				m_host.clear();
 				m_cookie.clear();
 				m_etc_fields.clear();
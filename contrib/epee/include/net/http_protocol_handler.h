@@ -35,6 +35,9 @@
 #include "to_nonconst_iterator.h"
 #include "http_base.h"
 
+#define HTTP_GZIP_DEFAULT_MIN_SIZE	 4096
+#define HTTP_GZIP_DEFAULT_LEVEL		 6
+
 namespace epee
 {
 namespace net_utils
@@ -48,9 +51,14 @@ namespace net_utils
 		/************************************************************************/
 		struct http_server_config
 		{
+			http_server_config():m_gzip_min_size(HTTP_GZIP_DEFAULT_MIN_SIZE), m_gzip_level(HTTP_GZIP_DEFAULT_LEVEL)
+			{}
       void on_send_stop_signal(){}
 			std::string m_folder;
 			critical_section m_lock;
+			//responses of at least m_gzip_min_size bytes are gzipped for clients accepting it, level 0 turns it off
+			size_t m_gzip_min_size;
+			int m_gzip_level;
 		};
 
 		/************************************************************************/
@@ -109,16 +117,26 @@ namespace net_utils
 				http_body_transfer_undefined
 			};
 
-			bool handle_buff_in(std::string& buf);
+			enum chunk_state{
+				http_chunk_state_size,
+				http_chunk_state_data,
+				http_chunk_state_data_end,
+				http_chunk_state_trailer
+			};
+
+			//parses [data, data+size) in place, "consumed" is advanced by every byte that is done with
+			bool handle_buff_in(const char* data, size_t size, size_t& consumed);
 
-			bool analize_cached_request_header_and_invoke_state(size_t pos);
+			bool analize_cached_request_header_and_invoke_state();
 
-			bool handle_invoke_query_line();
-			bool parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos);
-			std::string::size_type match_end_of_header(const std::string& buf);
+			bool handle_invoke_query_line(const char* begin, const char* end);
+			bool parse_header_line(const char* begin, const char* end);
 			bool get_len_from_content_lenght(const std::string& str, size_t& len);
-			bool handle_retriving_query_body();
-			bool handle_query_measure();
+			bool handle_retriving_query_body(const char* data, size_t size, size_t& consumed);
+			bool handle_query_measure(const char* data, size_t size, size_t& consumed);
+			bool handle_query_chunked(const char* data, size_t size, size_t& consumed);
+			bool finish_request();
+			bool is_connection_close_requested();
 			bool set_ready_state();
 			bool slash_to_back_slash(std::string& str);
 			std::string get_file_mime_tipe(const std::string& path);
@@ -134,6 +152,8 @@ namespace net_utils
 			std::string m_cache;
 			machine_state m_state;
 			body_transfer_type m_body_transfer_type;
+			chunk_state m_chunk_state;
+			std::string* m_plast_header_value;
 			bool m_is_stop_handling;
 			http::http_request_info m_query_info;
 			size_t m_len_summary, m_len_remain;
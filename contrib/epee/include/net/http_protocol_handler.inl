@@ -27,14 +27,24 @@
 
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
 #include "http_protocol_handler.h"
 #include "reg_exp_definer.h"
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "net_parse_helpers.h"
+#ifdef HTTP_ENABLE_GZIP
+#include "gzip_encoding.h"
+#endif
 
 #define HTTP_MAX_URI_LEN		 9000 
 #define HTTP_MAX_HEADER_LEN		 100000
+#define HTTP_MAX_CHUNK_LINE_LEN	 1024
+#define HTTP_MAX_BODY_PREALLOC	 1048576
+#define HTTP_MAX_BODY_LEN		 (100 * 1024 * 1024)
 
 namespace epee
 {
@@ -190,11 +200,173 @@ namespace net_utils
 
 
 
+		//--------------------------------------------------------------------------------------------
+		// Request line and header fields are parsed in place from the receive buffer, so the common
+		// case of whole requests arriving in one packet (and pipelined requests after them) is handled
+		// without copying anything except the tail of an incomplete request.
+		//--------------------------------------------------------------------------------------------
+		inline bool is_http_space(char c)
+		{
+			return c == ' ' || c == '\t';
+		}
+		//--------------------------------------------------------------------------------------------
+		inline bool is_equal_no_case(const char* begin, const char* end, const char* token, size_t token_len)
+		{
+			if(static_cast<size_t>(end - begin) != token_len)
+				return false;
+			for(; begin != end; ++begin, ++token)
+			{
+				if(std::tolower(static_cast<unsigned char>(*begin)) != std::tolower(static_cast<unsigned char>(*token)))
+					return false;
+			}
+			return true;
+		}
+		//--------------------------------------------------------------------------------------------
+		inline void trim_http_spaces(const char*& begin, const char*& end)
+		{
+			while(begin != end && (is_http_space(*begin) || *begin == '\r'))
+				++begin;
+			while(begin != end && (is_http_space(*(end - 1)) || *(end - 1) == '\r'))
+				--end;
+		}
+		//--------------------------------------------------------------------------------------------
+		inline const char* find_line_end(const char* begin, size_t size)
+		{
+			return static_cast<const char*>(std::memchr(begin, '\n', size));
+		}
+		//--------------------------------------------------------------------------------------------
+		inline bool is_empty_line(const char* begin, const char* line_end)
+		{
+			return begin == line_end || (begin + 1 == line_end && *begin == '\r');
+		}
+		//--------------------------------------------------------------------------------------------
+		inline bool parse_http_method(const char* begin, const char* end, http::http_method& method)
+		{
+#define HTTP_MATCH_METHOD(name, val) if(is_equal_no_case(begin, end, name, sizeof(name) - 1)) { method = val; return true; }
+			HTTP_MATCH_METHOD("GET", http::http_method_get);
+			HTTP_MATCH_METHOD("POST", http::http_method_post);
+			HTTP_MATCH_METHOD("HEAD", http::http_method_head);
+			HTTP_MATCH_METHOD("PUT", http::http_method_put);
+			HTTP_MATCH_METHOD("OPTIONS", http::http_method_etc);
+			HTTP_MATCH_METHOD("DELETE", http::http_method_etc);
+			HTTP_MATCH_METHOD("TRACE", http::http_method_etc);
+#undef HTTP_MATCH_METHOD
+			return false;
+		}
+		//--------------------------------------------------------------------------------------------
+		inline bool parse_http_decimal(const char*& it, const char* end, int& val)
+		{
+			const char* start = it;
+			val = 0;
+			for(; it != end && std::isdigit(static_cast<unsigned char>(*it)) && it - start < 4; ++it)
+				val = val * 10 + (*it - '0');
+			return it != start;
+		}
+		//--------------------------------------------------------------------------------------------
+		//"HTTP/<major>.<minor>"
+		inline bool parse_http_version(const char* begin, const char* end, int& ver_hi, int& ver_lo)
+		{
+			static const char prefix[] = "HTTP/";
+			if(static_cast<size_t>(end - begin) < sizeof(prefix) - 1 || !is_equal_no_case(begin, begin + sizeof(prefix) - 1, prefix, sizeof(prefix) - 1))
+				return false;
+			const char* it = begin + sizeof(prefix) - 1;
+			if(!parse_http_decimal(it, end, ver_hi) || it == end || *it != '.')
+				return false;
+			++it;
+			return parse_http_decimal(it, end, ver_lo) && it == end;
+		}
+		//--------------------------------------------------------------------------------------------
+		inline bool parse_http_chunk_size(const char* begin, const char* end, size_t& size)
+		{
+			trim_http_spaces(begin, end);
+			size = 0;
+			const char* it = begin;
+			for(; it != end; ++it)
+			{
+				char c = *it;
+				size_t digit = 0;
+				if(c >= '0' && c <= '9')
+					digit = c - '0';
+				else if(c >= 'a' && c <= 'f')
+					digit = c - 'a' + 10;
+				else if(c >= 'A' && c <= 'F')
+					digit = c - 'A' + 10;
+				else
+					break;
+				if(size > (std::numeric_limits<size_t>::max() >> 4))
+					return false;
+				size = (size << 4) | digit;
+			}
+			//chunk extensions are allowed after ';' and ignored
+			return it != begin && (it == end || *it == ';' || is_http_space(*it));
+		}
+		//--------------------------------------------------------------------------------------------
+		inline bool is_chunked_transfer_encoding(const std::string& transfer_encoding)
+		{
+			//"chunked" have to be the last applied coding
+			const char* begin = transfer_encoding.data();
+			const char* end = begin + transfer_encoding.size();
+			trim_http_spaces(begin, end);
+			static const char chunked[] = "chunked";
+			return static_cast<size_t>(end - begin) >= sizeof(chunked) - 1 && is_equal_no_case(end - (sizeof(chunked) - 1), end, chunked, sizeof(chunked) - 1);
+		}
+		//--------------------------------------------------------------------------------------------
+		//"gzip" is listed in Accept-Encoding and not refused with "q=0"
+		//"q=0", "q=0.0", "q=0.000" mean "not acceptable", missing q means q=1
+		inline bool is_zero_qvalue(const char* params, const char* params_end)
+		{
+			const char* it = params;
+			while(it != params_end)
+			{
+				const char* param_end = std::find(it + 1, params_end, ';');
+				const char* param_begin = *it == ';' ? it + 1 : it;
+				const char* value_end = param_end;
+				trim_http_spaces(param_begin, value_end);
+				if(value_end - param_begin >= 2 && std::tolower(static_cast<unsigned char>(param_begin[0])) == 'q' && param_begin[1] == '=')
+				{
+					const char* q = param_begin + 2;
+					if(q == value_end)
+						return false;
+					for(; q != value_end; ++q)
+					{
+						if(*q != '0' && *q != '.')
+							return false;
+					}
+					return true;
+				}
+				it = param_end;
+			}
+			return false;
+		}
+		//--------------------------------------------------------------------------------------------
+		//explicit gzip entry takes precedence over "*", whatever order they come in
+		inline bool is_gzip_accepted(const std::string& accept_encoding)
+		{
+			const char* it = accept_encoding.data();
+			const char* end = it + accept_encoding.size();
+			bool any_accepted = false;
+			while(it != end)
+			{
+				const char* item_end = std::find(it, end, ',');
+				const char* params = std::find(it, item_end, ';');
+				const char* coding_begin = it;
+				const char* coding_end = params;
+				trim_http_spaces(coding_begin, coding_end);
+				if(is_equal_no_case(coding_begin, coding_end, "gzip", 4))
+					return !is_zero_qvalue(params, item_end);
+				if(is_equal_no_case(coding_begin, coding_end, "*", 1))
+					any_accepted = !is_zero_qvalue(params, item_end);
+				it = item_end == end ? end : item_end + 1;
+			}
+			return any_accepted;
+		}
 		//--------------------------------------------------------------------------------------------
 		template<class t_connection_context>
 		simple_http_connection_handler<t_connection_context>::simple_http_connection_handler(i_service_endpoint* psnd_hndlr, config_type& config):
 		m_state(http_state_retriving_comand_line),
 		m_body_transfer_type(http_body_transfer_undefined),
+		m_chunk_state(http_chunk_state_size),
+		m_plast_header_value(NULL),
         m_is_stop_handling(false),
 		m_len_summary(0),
 		m_len_remain(0),
@@ -211,87 +383,119 @@ namespace net_utils
 		m_is_stop_handling = false;
 		m_state = http_state_retriving_comand_line;
 		m_body_transfer_type = http_body_transfer_undefined;
+		m_chunk_state = http_chunk_state_size;
+		m_plast_header_value = NULL;
 		m_query_info.clear();
 		m_len_summary = 0;
+		m_len_remain = 0;
 		return true;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_recv(const void* ptr, size_t cb)
 	{
-		std::string buf((const char*)ptr, cb);
-		//LOG_PRINT_L0("HTTP_RECV: " << ptr << "\r\n" << buf);
-		//file_io_utils::save_string_to_file(string_tools::get_current_module_folder() + "/" + boost::lexical_cast<std::string>(ptr), std::string((const char*)ptr, cb));
+		//LOG_PRINT_L0("HTTP_RECV: " << ptr << "\r\n" << std::string((const char*)ptr, cb));
+		size_t consumed = 0;
+		bool res = false;
+		if(m_cache.empty())
+		{
+			//nothing left from previous packets: parse straight from the receive buffer and keep only the unparsed tail
+			res = handle_buff_in(static_cast<const char*>(ptr), cb, consumed);
+			if(res && consumed < cb)
+				m_cache.assign(static_cast<const char*>(ptr) + consumed, cb - consumed);
+		}
+		else
+		{
+			m_cache.append(static_cast<const char*>(ptr), cb);
+			res = handle_buff_in(m_cache.data(), m_cache.size(), consumed);
+			if(res)
+				m_cache.erase(0, consumed);
+		}
 
-		bool res = handle_buff_in(buf);
 		if(m_want_close/*m_state == http_state_connection_close || m_state == http_state_error*/)
 			return false;
 		return res;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::handle_buff_in(std::string& buf)
+	bool simple_http_connection_handler<t_connection_context>::handle_buff_in(const char* data, size_t size, size_t& consumed)
 	{
-
-		if(m_cache.size())
-			m_cache += buf;
-		else
-			m_cache.swap(buf);
-
 		m_is_stop_handling = false;
-		while(!m_is_stop_handling)
+		while(!m_is_stop_handling && consumed < size)
 		{
+			const char* p = data + consumed;
+			size_t left = size - consumed;
 			switch(m_state)
 			{
 			case http_state_retriving_comand_line:
-				//The HTTP protocol does not place any a priori limit on the length of a URI.  (c)RFC2616
-				//but we forebly restirct it len to HTTP_MAX_URI_LEN to make it more safely
-				if(!m_cache.size())
-					break;
-
-				//check_and_handle_fake_response();
-				if((m_cache[0] == '\r' || m_cache[0] == '\n'))
 				{
-          //some times it could be that before query line cold be few line breaks
-          //so we have to be calm without panic with assers
-					m_cache.erase(0, 1);
+					//some times it could be that before query line cold be few line breaks
+					//so we have to be calm without panic with assers
+					if(*p == '\r' || *p == '\n')
+					{
+						++consumed;
+						break;
+					}
+					const char* line_end = find_line_end(p, left);
+					if(!line_end)
+					{
+						//The HTTP protocol does not place any a priori limit on the length of a URI.  (c)RFC2616
+						//but we forebly restirct it len to HTTP_MAX_URI_LEN to make it more safely
+						m_is_stop_handling = true;
+						if(left > HTTP_MAX_URI_LEN)
+						{
+							LOG_ERROR("simple_http_connection_handler::handle_buff_in: Too long URI line");
+							m_state = http_state_error;
+							return false;
+						}
+						break;
+					}
+					if(!handle_invoke_query_line(p, line_end))
+						return false;
+					consumed += line_end + 1 - p;
 					break;
 				}
-
-				if(std::string::npos != m_cache.find('\n', 0))
-					handle_invoke_query_line();
-				else
+			case http_state_retriving_header:
 				{
-					m_is_stop_handling = true;
-					if(m_cache.size() > HTTP_MAX_URI_LEN)
+					const char* line_end = find_line_end(p, left);
+					size_t line_len = line_end ? line_end + 1 - p : left;
+					if(m_query_info.m_full_request_buf_size + line_len > HTTP_MAX_HEADER_LEN)
 					{
-						LOG_ERROR("simple_http_connection_handler::handle_buff_out: Too long URI line");
+						LOG_ERROR("simple_http_connection_handler::handle_buff_in: Too long header area");
 						m_state = http_state_error;
 						return false;
 					}
-				}
-				break;
-			case http_state_retriving_header:
-				{
-					std::string::size_type pos = match_end_of_header(m_cache);
-					if(std::string::npos == pos)
+					if(!line_end)
 					{
 						m_is_stop_handling = true;
-						if(m_cache.size() > HTTP_MAX_HEADER_LEN)
-						{
-							LOG_ERROR("simple_http_connection_handler::handle_buff_in: Too long header area");
-							m_state = http_state_error;
-							return false;
-						}	
 						break;
 					}
-					analize_cached_request_header_and_invoke_state(pos);
+					m_query_info.m_full_request_buf_size += line_len;
+					if(log_space::get_set_log_detalisation_level() >= LOG_LEVEL_4)
+						m_query_info.m_request_head.append(p, line_len);
+					consumed += line_len;
+					if(is_empty_line(p, line_end))
+					{
+						if(!analize_cached_request_header_and_invoke_state())
+							return false;
+					}
+					else if(!parse_header_line(p, line_end))
+					{
+						LOG_ERROR("simple_http_connection_handler::handle_buff_in: failed to parse header line: " << std::string(p, line_end));
+						m_state = http_state_error;
+						return false;
+					}
 					break;
 				}
 			case http_state_retriving_body:
-				return handle_retriving_query_body();
+				if(!handle_retriving_query_body(p, left, consumed))
+					return false;
+				break;
 			case http_state_connection_close:
-				return false;
+				//everything pipelined after "Connection: close" request is dropped
+				consumed = size;
+				m_is_stop_handling = true;
+				break;
 			default:
 				LOG_ERROR("simple_http_connection_handler::handle_char_out: Wrong state: " << m_state);
 				return false;
@@ -299,136 +503,167 @@ namespace net_utils
 				LOG_ERROR("simple_http_connection_handler::handle_char_out: Error state!!!");
 				return false;
 			}
-
-			if(!m_cache.size())
-				m_is_stop_handling = true;
 		}
 
-		return true;
+		return m_state != http_state_error;
 	}
-	//--------------------------------------------------------------------------------------------
-	inline bool analize_http_method(const boost::smatch& result, http::http_method& method, int& http_ver_major, int& http_ver_minor)
-	{
-		CHECK_AND_ASSERT_MES(result[0].matched, false, "simple_http_connection_handler::analize_http_method() assert failed...");
-		http_ver_major = boost::lexical_cast<int>(result[11]);
-		http_ver_minor = boost::lexical_cast<int>(result[12]);
-		if(result[4].matched)
-			method = http::http_method_get;
-		else if(result[5].matched)
-			method = http::http_method_head;
-		else if(result[6].matched)
-			method = http::http_method_post;
-		else if(result[7].matched)
-			method = http::http_method_put;
-		else 
-			method = http::http_method_etc;
-
-		return true;
-	}
-
   //--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line()
+	bool simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(const char* begin, const char* end)
 	{ 
 		LOG_FRAME("simple_http_connection_handler<t_connection_context>::handle_recognize_protocol_out(*)", LOG_LEVEL_3);
 
-		STATIC_REGEXP_EXPR_1(rexp_match_command_line, "^(((OPTIONS)|(GET)|(HEAD)|(POST)|(PUT)|(DELETE)|(TRACE)) (\\S+) HTTP/(\\d+).(\\d+))\r?\n", boost::regex::icase | boost::regex::normal);
-		//											    123         4     5      6      7     8        9        10          11     12    
-		//size_t match_len = 0;
-		boost::smatch result;	
-		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
-		{
-			analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi);
-			m_query_info.m_URI = result[10];
-      parse_uri(m_query_info.m_URI, m_query_info.m_uri_content);
-			m_query_info.m_http_method_str = result[2];
-			m_query_info.m_full_request_str = result[0];
-
-			m_cache.erase(m_cache.begin(),  to_nonsonst_iterator(m_cache, result[0].second));
-
-			m_state = http_state_retriving_header;
-
-			return true;
-		}else
+		//<method> SP <uri> SP HTTP/<major>.<minor> [CR] LF
+		const char* line_end = end;
+		if(line_end != begin && *(line_end - 1) == '\r')
+			--line_end;
+		const char* method_end = std::find(begin, line_end, ' ');
+		const char* uri_begin = method_end == line_end ? line_end : method_end + 1;
+		const char* uri_end = std::find(uri_begin, line_end, ' ');
+		const char* version_begin = uri_end == line_end ? line_end : uri_end + 1;
+
+		if(uri_begin == uri_end
+			|| !parse_http_method(begin, method_end, m_query_info.m_http_method)
+			|| !parse_http_version(version_begin, line_end, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_lo))
 		{
 			m_state = http_state_error;
-			LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << m_cache);
+			LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_invoke_query_line(): Failed to match first line: " << std::string(begin, end));
 			return false;
 		}
 
-		return false;
+		m_query_info.m_URI.assign(uri_begin, uri_end);
+		parse_uri(m_query_info.m_URI, m_query_info.m_uri_content);
+		m_query_info.m_http_method_str.assign(begin, method_end);
+		m_query_info.m_full_request_str.assign(begin, end + 1);
+		m_query_info.m_full_request_buf_size = 0;
+
+		m_state = http_state_retriving_header;
+		return true;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	std::string::size_type simple_http_connection_handler<t_connection_context>::match_end_of_header(const std::string& buf)
+	bool simple_http_connection_handler<t_connection_context>::parse_header_line(const char* begin, const char* end)
 	{
+		//obsolete line folding: continuation of the previous field value
+		if(is_http_space(*begin))
+		{
+			CHECK_AND_ASSERT_MES(m_plast_header_value, false, "header continuation line without field");
+			trim_http_spaces(begin, end);
+			if(begin != end)
+			{
+				m_plast_header_value->push_back(' ');
+				m_plast_header_value->append(begin, end);
+			}
+			return true;
+		}
 
-    //Here we returning head size, including terminating sequence (\r\n\r\n or \n\n)
-		std::string::size_type res = buf.find("\r\n\r\n");
-		if(std::string::npos != res)
-			return res+4;
-		res = buf.find("\n\n");
-		if(std::string::npos != res)
-			return res+2;
-		return res;
+		const char* colon = std::find(begin, end, ':');
+		CHECK_AND_ASSERT_MES(colon != end, false, "header field without ':'");
+		const char* name_begin = begin;
+		const char* name_end = colon;
+		trim_http_spaces(name_begin, name_end);
+		CHECK_AND_ASSERT_MES(name_begin != name_end, false, "header field with empty name");
+		const char* value_begin = colon + 1;
+		const char* value_end = end;
+		trim_http_spaces(value_begin, value_end);
+
+		struct known_field
+		{
+			const char* name;
+			size_t name_len;
+			std::string http_header_info::* pfield;
+		};
+#define HTTP_KNOWN_FIELD(name, field) {name, sizeof(name) - 1, &http_header_info::field}
+		static const known_field known_fields[] = {
+			HTTP_KNOWN_FIELD("Connection", m_connection),
+			HTTP_KNOWN_FIELD("Referer", m_referer),
+			HTTP_KNOWN_FIELD("Content-Length", m_content_length),
+			HTTP_KNOWN_FIELD("Content-Type", m_content_type),
+			HTTP_KNOWN_FIELD("Transfer-Encoding", m_transfer_encoding),
+			HTTP_KNOWN_FIELD("Content-Encoding", m_content_encoding),
+			HTTP_KNOWN_FIELD("Accept-Encoding", m_accept_encoding),
+			HTTP_KNOWN_FIELD("Host", m_host),
+			HTTP_KNOWN_FIELD("Cookie", m_cookie)
+		};
+#undef HTTP_KNOWN_FIELD
+
+		http_header_info& header_info = m_query_info.m_header_info;
+		for(size_t i = 0; i != sizeof(known_fields) / sizeof(known_fields[0]); i++)
+		{
+			if(is_equal_no_case(name_begin, name_end, known_fields[i].name, known_fields[i].name_len))
+			{
+				m_plast_header_value = &(header_info.*known_fields[i].pfield);
+				m_plast_header_value->assign(value_begin, value_end);
+				return true;
+			}
+		}
+
+		header_info.m_etc_fields.push_back(std::pair<std::string, std::string>(std::string(name_begin, name_end), std::string(value_begin, value_end)));
+		m_plast_header_value = &header_info.m_etc_fields.back().second;
+		return true;
 	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(size_t pos)
+	bool simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state()
 	{ 
-		//LOG_PRINT_L4("HTTP HEAD:\r\n" << m_cache.substr(0, pos));
-
 		LOG_FRAME("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(*)", LOG_LEVEL_3);
 
-		m_query_info.m_full_request_buf_size = pos;
-    m_query_info.m_request_head.assign(m_cache.begin(), m_cache.begin()+pos); 
-
-		if(!parse_cached_header(m_query_info.m_header_info, m_cache, pos))
+		m_plast_header_value = NULL;
+		const http_header_info& header_info = m_query_info.m_header_info;
+		if(header_info.m_transfer_encoding.size())
 		{
-			LOG_ERROR("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): failed to anilize request header: " << m_cache);
-			m_state = http_state_error;
+			if(!is_chunked_transfer_encoding(header_info.m_transfer_encoding))
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): unsupported Transfer-Encoding: " << header_info.m_transfer_encoding);
+				m_state = http_state_error;
+				return false;
+			}
+			//Content-Length is ignored when chunked coding is applied (RFC 7230, 3.3.3)
+			m_state = http_state_retriving_body;
+			m_body_transfer_type = http_body_transfer_chunked;
+			m_chunk_state = http_chunk_state_size;
+			return true;
 		}
 
-		m_cache.erase(0, pos);
-
-		std::string req_command_str = m_query_info.m_full_request_str;
     //if we have POST or PUT command, it is very possible tha we will get body
     //but now, we suppose than we have body only in case of we have "ContentLength" 
-		if(m_query_info.m_header_info.m_content_length.size())
+		if(header_info.m_content_length.size())
 		{
-			m_state = http_state_retriving_body;
-			m_body_transfer_type = http_body_transfer_measure;
-			if(!get_len_from_content_lenght(m_query_info.m_header_info.m_content_length, m_len_summary))
+			if(!get_len_from_content_lenght(header_info.m_content_length, m_len_summary))
 			{
-				LOG_ERROR("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): Failed to get_len_from_content_lenght();, m_query_info.m_content_length="<<m_query_info.m_header_info.m_content_length);
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): Failed to get_len_from_content_lenght();, m_query_info.m_content_length="<<header_info.m_content_length);
 				m_state = http_state_error;
 				return false;
 			}
-			if(0 == m_len_summary)
-			{	//current query finished, next will be next query
-				if(handle_request_and_send_response(m_query_info))
-					set_ready_state();
-				else
-					m_state = http_state_error;
+			if(m_len_summary > HTTP_MAX_BODY_LEN)
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): Too big body: " << m_len_summary << ", max " << HTTP_MAX_BODY_LEN);
+				m_state = http_state_error;
+				return false;
+			}
+			if(m_len_summary)
+			{
+				m_state = http_state_retriving_body;
+				m_body_transfer_type = http_body_transfer_measure;
+				m_len_remain = m_len_summary;
+				m_query_info.m_body.reserve(std::min<size_t>(m_len_summary, HTTP_MAX_BODY_PREALLOC));
+				return true;
 			}
-			m_len_remain = m_len_summary;
-		}else
-		{//current query finished, next will be next query
-			handle_request_and_send_response(m_query_info);
-			set_ready_state();
 		}
 
-		return true;
+		//current query finished, next will be next query
+		return finish_request();
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::handle_retriving_query_body()
+	bool simple_http_connection_handler<t_connection_context>::handle_retriving_query_body(const char* data, size_t size, size_t& consumed)
 	{
 		switch(m_body_transfer_type)
 		{
 		case http_body_transfer_measure:
-			return handle_query_measure();
+			return handle_query_measure(data, size, consumed);
 		case http_body_transfer_chunked:
+			return handle_query_chunked(data, size, consumed);
 		case http_body_transfer_connection_close:
 		case http_body_transfer_multipart:
 		case http_body_transfer_undefined:
@@ -442,103 +677,158 @@ namespace net_utils
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::handle_query_measure()
+	bool simple_http_connection_handler<t_connection_context>::handle_query_measure(const char* data, size_t size, size_t& consumed)
 	{
+		size_t len = std::min(m_len_remain, size);
+		m_query_info.m_body.append(data, len);
+		m_len_remain -= len;
+		consumed += len;
 
-		if(m_len_remain >= m_cache.size())
+		if(!m_len_remain)
+			return finish_request();
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::handle_query_chunked(const char* data, size_t size, size_t& consumed)
+	{
+		if(m_chunk_state == http_chunk_state_data)
 		{
-			m_len_remain -= m_cache.size();
-			m_query_info.m_body += m_cache;
-			m_cache.clear();
-		}else
+			size_t len = std::min(m_len_remain, size);
+			m_query_info.m_body.append(data, len);
+			m_len_remain -= len;
+			consumed += len;
+			if(!m_len_remain)
+				m_chunk_state = http_chunk_state_data_end;
+			return true;
+		}
+
+		//all other chunk states are line based
+		const char* line_end = find_line_end(data, size);
+		if(!line_end)
 		{
-			m_query_info.m_body.append(m_cache.begin(), m_cache.begin() + m_len_remain);
-			m_cache.erase(0, m_len_remain);
-			m_len_remain = 0;
+			m_is_stop_handling = true;
+			if(size > HTTP_MAX_CHUNK_LINE_LEN)
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_query_chunked(): Too long chunk line");
+				m_state = http_state_error;
+				return false;
+			}
+			return true;
 		}
+		consumed += line_end + 1 - data;
 
-		if(!m_len_remain)
+		switch(m_chunk_state)
 		{
-			if(handle_request_and_send_response(m_query_info))
-				set_ready_state();
-			else
+		case http_chunk_state_size:
+			if(!parse_http_chunk_size(data, line_end, m_len_remain))
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_query_chunked(): Failed to parse chunk size: " << std::string(data, line_end));
+				m_state = http_state_error;
+				return false;
+			}
+			//decoded body is bounded as Content-Length one is
+			if(m_len_remain > HTTP_MAX_BODY_LEN - m_len_summary)
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_query_chunked(): Too big chunked body, max " << HTTP_MAX_BODY_LEN);
+				m_state = http_state_error;
+				return false;
+			}
+			m_len_summary += m_len_remain;
+			m_chunk_state = m_len_remain ? http_chunk_state_data : http_chunk_state_trailer;
+			return true;
+		case http_chunk_state_data_end:
+			if(!is_empty_line(data, line_end))
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_query_chunked(): Chunk data is not terminated by CRLF");
 				m_state = http_state_error;
+				return false;
+			}
+			m_chunk_state = http_chunk_state_size;
+			return true;
+		case http_chunk_state_trailer:
+			//trailer fields are skipped, empty line completes the request
+			if(is_empty_line(data, line_end))
+				return finish_request();
+			return true;
+		default:
+			LOG_ERROR("simple_http_connection_handler<t_connection_context>::handle_query_chunked(): Wrong chunk state: " << m_chunk_state);
+			m_state = http_state_error;
+			return false;
 		}
-		return true;
 	}
-	//--------------------------------------------------------------------------------------------
+	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
-	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
-	{ 
-		LOG_FRAME("http_stream_filter::parse_cached_header(*)", LOG_LEVEL_3);
-
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, 
-			"\n?((Connection)|(Referer)|(Content-Length)|(Content-Type)|(Transfer-Encoding)|(Content-Encoding)|(Host)|(Cookie)"
-			//  12            3         4                5              6                   7                  8      9    
-			"|([\\w-]+?)) ?: ?((.*?)(\r?\n))[^\t ]",	
-			//10             1112   13 
-			boost::regex::icase | boost::regex::normal);
-
-		boost::smatch		result;
-		std::string::const_iterator it_current_bound = m_cache_to_process.begin();
-		std::string::const_iterator it_end_bound = m_cache_to_process.begin()+pos;
-
-		body_info.clear();
-
-		//lookup all fields and fill well-known fields
-		while( boost::regex_search( it_current_bound, it_end_bound, result, rexp_mach_field, boost::match_default) && result[0].matched) 
-		{
-			const size_t field_val = 12;
-			const size_t field_etc_name = 10;
-
-			int i = 2; //start position = 2
-			if(result[i++].matched)//"Connection"
-				body_info.m_connection = result[field_val];
-			else if(result[i++].matched)//"Referer"
-				body_info.m_referer = result[field_val];
-			else if(result[i++].matched)//"Content-Length"
-				body_info.m_content_length = result[field_val];
-			else if(result[i++].matched)//"Content-Type"
-				body_info.m_content_type = result[field_val];
-			else if(result[i++].matched)//"Transfer-Encoding"
-				body_info.m_transfer_encoding = result[field_val];
-			else if(result[i++].matched)//"Content-Encoding"
-				body_info.m_content_encoding = result[field_val];
-			else if(result[i++].matched)//"Host"
-				body_info.m_host = result[field_val];
-			else if(result[i++].matched)//"Cookie"
-				body_info.m_cookie = result[field_val];
-			else if(result[i++].matched)//e.t.c (HAVE TO BE MATCHED!)
-				body_info.m_etc_fields.push_back(std::pair<std::string, std::string>(result[field_etc_name], result[field_val]));
-			else
-			{
-				LOG_ERROR("simple_http_connection_handler<t_connection_context>::parse_cached_header() not matched last entry in:"<<m_cache_to_process);
-			}
-
-			it_current_bound = result[(int)result.size()-1]. first;
+	bool simple_http_connection_handler<t_connection_context>::finish_request()
+	{
+		bool res = handle_request_and_send_response(m_query_info);
+		if(m_want_close)
+		{
+			m_state = http_state_connection_close;
+			m_is_stop_handling = true;
+			return true;
+		}
+		if(!res)
+		{
+			m_state = http_state_error;
+			return false;
 		}
-		return  true;
+		return set_ready_state();
 	}
 	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::get_len_from_content_lenght(const std::string& str, size_t& OUT len)
 	{
-		STATIC_REGEXP_EXPR_1(rexp_mach_field, "\\d+", boost::regex::normal);
-		std::string res;
-		boost::smatch result;
-		if(!(boost::regex_search( str, result, rexp_mach_field, boost::match_default) && result[0].matched))
+		const char* begin = str.data();
+		const char* end = begin + str.size();
+		trim_http_spaces(begin, end);
+		if(begin == end)
 			return false;
-
-		len = boost::lexical_cast<size_t>(result[0]);
+		len = 0;
+		for(; begin != end; ++begin)
+		{
+			if(!std::isdigit(static_cast<unsigned char>(*begin)))
+				return false;
+			size_t digit = *begin - '0';
+			if(len > (std::numeric_limits<size_t>::max() - digit) / 10)
+				return false;
+			len = len * 10 + digit;
+		}
 		return true;
 	}
 	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::is_connection_close_requested()
+	{
+		const std::string& connection = m_query_info.m_header_info.m_connection;
+		if(!string_tools::compare_no_case("close", connection))
+			return true;
+		//HTTP/1.0 connections are persistent only on explicit request
+		bool is_http_1_0 = m_query_info.m_http_ver_hi < 1 || (m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0);
+		return is_http_1_0 && string_tools::compare_no_case("keep-alive", connection);
+	}
+	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_request_and_send_response(const http::http_request_info& query_info)
 	{
 		http_response_info response;
 		bool res = handle_request(query_info, response);
 		//CHECK_AND_ASSERT_MES(res, res, "handle_request(query_info, response) returned false" );
+#ifdef HTTP_ENABLE_GZIP
+		if(m_config.m_gzip_level > 0 && response.m_body.size() >= m_config.m_gzip_min_size && response.m_header_info.m_content_encoding.empty())
+		{
+			//body depends on Accept-Encoding whether this one is gzipped or not, caches must not mix them
+			response.m_additional_fields.push_back(std::make_pair("Vary", "Accept-Encoding"));
+			std::string packed_body;
+			if(is_gzip_accepted(query_info.m_header_info.m_accept_encoding)
+				&& gzip_compress(response.m_body, packed_body, m_config.m_gzip_level) && packed_body.size() < response.m_body.size())
+			{
+				LOG_PRINT_L3("HTTP_RESPONSE_BODY gzipped: " << response.m_body.size() << " -> " << packed_body.size());
+				response.m_body.swap(packed_body);
+				response.m_header_info.m_content_encoding = "gzip";
+			}
+		}
+#endif
 
 		std::string response_data = get_response_header(response);
 		
@@ -592,6 +882,8 @@ namespace net_utils
 		buf += boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
 		buf += "Content-Type: ";
 		buf += response.m_mime_tipe + "\r\n";
+		if(response.m_header_info.m_content_encoding.size())
+			buf += "Content-Encoding: " + response.m_header_info.m_content_encoding + "\r\n";
 
 		buf += "Last-Modified: ";
 		time_t tm;
@@ -600,20 +892,19 @@ namespace net_utils
 		buf += "Accept-Ranges: bytes\r\n";
 		//Wed, 01 Dec 2010 03:27:41 GMT"
 
-		string_tools::trim(m_query_info.m_header_info.m_connection);
-		if(m_query_info.m_header_info.m_connection.size())
+		if(is_connection_close_requested())
 		{
-			if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection))
-			{
-        //closing connection after sending
-				buf += "Connection: close\r\n";
-				m_state = http_state_connection_close;
-				m_want_close = true;
-			}
+			//closing connection after sending
+			buf += "Connection: close\r\n";
+			m_want_close = true;
+		}
+		else if(m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0)
+		{
+			buf += "Connection: keep-alive\r\n";
 		}
 		//add additional fields, if it is
 		for(fields_list::const_iterator it = response.m_additional_fields.begin(); it!=response.m_additional_fields.end(); it++)
-			buf += it->first + ":" + it->second + "\r\n";
+			buf += it->first + ": " + it->second + "\r\n";
 
 		buf+="\r\n";
 
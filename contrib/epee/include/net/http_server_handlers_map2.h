@@ -26,8 +26,12 @@
 
 
 #pragma once 
+#include <vector>
+#include "misc_language.h"
+#include "metrics_registry.h"
 #include "serialization/keyvalue_serialization.h"
 #include "storages/portable_storage_template_helper.h"
+#include "storages/json_stream.h"
 #include "http_base.h"
 
 
@@ -60,9 +64,10 @@
     else if((query_info.m_URI == s_pattern) && (cond)) \
     { \
       handled = true; \
+      METRICS_SCOPED_TIMER(uri_call_timer, "rpc_request_duration_us", "uri=\"" s_pattern "\""); \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
-      bool parse_res = epee::serialization::load_t_from_json(static_cast<command_type::request&>(req), query_info.m_body); \
+      bool parse_res = epee::serialization::load_t_from_json_stream(static_cast<command_type::request&>(req), query_info.m_body); \
       CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse json: \r\n" << query_info.m_body); \
       uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::response> resp;\
@@ -74,7 +79,7 @@
         return true; \
       } \
       uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
-      epee::serialization::store_t_to_json(static_cast<command_type::response&>(resp), response_info.m_body); \
+      epee::serialization::store_t_to_json_stream(static_cast<command_type::response&>(resp), response_info.m_body); \
       uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
       response_info.m_mime_tipe = "application/json"; \
       response_info.m_header_info.m_content_type = " application/json"; \
@@ -83,10 +88,11 @@
 
 #define MAP_URI_AUTO_JON2(s_pattern, callback_f, command_type) MAP_URI_AUTO_JON2_IF(s_pattern, callback_f, command_type, true)
 
-#define MAP_URI_AUTO_BIN2(s_pattern, callback_f, command_type) \
-    else if(query_info.m_URI == s_pattern) \
+#define MAP_URI_AUTO_BIN2_IF(s_pattern, callback_f, command_type, cond) \
+    else if((query_info.m_URI == s_pattern) && (cond)) \
     { \
       handled = true; \
+      METRICS_SCOPED_TIMER(uri_call_timer, "rpc_request_duration_us", "uri=\"" s_pattern "\""); \
       uint64_t ticks = misc_utils::get_tick_count(); \
       boost::value_initialized<command_type::request> req; \
       bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), query_info.m_body); \
@@ -108,6 +114,8 @@
       LOG_PRINT( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms", LOG_LEVEL_2); \
     }
 
+#define MAP_URI_AUTO_BIN2(s_pattern, callback_f, command_type) MAP_URI_AUTO_BIN2_IF(s_pattern, callback_f, command_type, true)
+
 #define CHAIN_URI_MAP2(callback) else {callback(query_info, response_info, m_conn_context);handled = true;}
 
 #define END_URI_MAP2() return handled;}
@@ -199,54 +207,185 @@ namespace epee
     };
 
     typedef response<dummy_result, error> error_response;
+
+    //FNV-1a, usable in case labels of JSON RPC method dispatch
+    constexpr uint64_t method_hash(const char* name, uint64_t h = 14695981039346656037ULL)
+    {
+      return *name ? method_hash(name + 1, (h ^ static_cast<uint8_t>(*name)) * 1099511628211ULL) : h;
+    }
+
+    inline uint64_t method_hash(const std::string& name)
+    {
+      uint64_t h = 14695981039346656037ULL;
+      for(std::string::const_iterator it = name.begin(); it != name.end(); ++it)
+        h = (h ^ static_cast<uint8_t>(*it)) * 1099511628211ULL;
+      return h;
+    }
+
+    template<class t_storage>
+    bool get_request_method(t_storage& ps, std::string& method, epee::serialization::storage_entry& id, typename t_storage::hsection hcall = nullptr)
+    {
+      try
+      {
+        id = epee::serialization::storage_entry(std::string());
+        ps.get_value("id", id, hcall);
+        return ps.get_value("method", method, hcall);
+      }
+      catch(const std::exception& e)
+      {
+        LOG_PRINT_L1("json_rpc: malformed request header: " << e.what());
+        return false;
+      }
+    }
+
+    inline void make_error_response(const epee::serialization::storage_entry& id, int64_t code, const std::string& message, std::string& body)
+    {
+      error_response rsp = AUTO_VAL_INIT(rsp);
+      rsp.jsonrpc = "2.0";
+      rsp.id = id;
+      rsp.error.code = code;
+      rsp.error.message = message;
+      epee::serialization::store_t_to_json_stream(rsp, body);
+    }
+
+    //root object is a single call, root array is a batch of calls (JSON RPC 2.0)
+    inline bool get_request_calls(const epee::serialization::json_stream_reader& ps, std::vector<epee::serialization::json_stream_reader::hsection>& calls)
+    {
+      const epee::serialization::json_stream_reader::token* root = ps.get_root();
+      calls.clear();
+      if(root && root->type == epee::serialization::json_stream_reader::token_array)
+      {
+        calls = ps.get_array_elements(*root);
+        return true;
+      }
+      calls.push_back(root);
+      return false;
+    }
+
+    //default admission: every request is served
+    template<class t_context>
+    bool admit_all(const std::vector<std::string>& /*methods*/, t_context& /*context*/, epee::misc_utils::auto_scope_leave_caller& /*ticket*/)
+    {
+      return true;
+    }
+
+    //default batch guard: calls of a batch are executed one by one without any common lock
+    inline epee::misc_utils::auto_scope_leave_caller no_batch_guard(const std::vector<std::string>& /*methods*/)
+    {
+      return epee::misc_utils::auto_scope_leave_caller();
+    }
+
+    //collects responses of the calls: single call response goes as is, batch responses are joined into JSON array
+    class calls_response
+    {
+    public:
+      calls_response(bool is_batch) : m_is_batch(is_batch), m_count(0)
+      {}
+
+      void push(std::string& call_body)
+      {
+        if(!m_is_batch)
+        {
+          m_body.swap(call_body);
+          call_body.clear();
+          return;
+        }
+        m_body.push_back(m_count++ ? ',' : '[');
+        m_body.append(call_body);
+        call_body.clear();
+      }
+
+      void finalize(std::string& body)
+      {
+        if(m_is_batch)
+          m_body.push_back(']');
+        body.swap(m_body);
+      }
+
+    private:
+      bool m_is_batch;
+      size_t m_count;
+      std::string m_body;
+    };
   }
 }
 
 
 
 
-#define BEGIN_JSON_RPC_MAP(uri)    else if(query_info.m_URI == uri) \
+// JSON RPC body is bound to request structures straight from json_stream_reader tokens,
+// methods are dispatched by switch over FNV-1a hash of the method name.
+// Root array is handled as JSON RPC 2.0 batch: calls are executed in order, each one gets its own
+// response (or error) object, batch_guard_f(methods) is held while the whole batch is executed.
+// admission_f(methods, context, ticket) is asked before any call is executed, the ticket is held till
+// the request is done; refused request gets "Server is busy" error
+#ifndef JSON_RPC_DEFAULT_MAX_BATCH_SIZE
+  #define JSON_RPC_DEFAULT_MAX_BATCH_SIZE 100
+#endif
+
+#define BEGIN_JSON_RPC_MAP_ADMISSION(uri, max_batch_size, batch_guard_f, admission_f)    else if(query_info.m_URI == uri) \
     { \
+    handled = true; \
     uint64_t ticks = epee::misc_utils::get_tick_count(); \
-    epee::serialization::portable_storage ps; \
+    epee::serialization::json_stream_reader ps; \
+    response_info.m_mime_tipe = "application/json"; \
+    response_info.m_header_info.m_content_type = " application/json"; \
     if(!ps.load_from_json(query_info.m_body)) \
     { \
-       boost::value_initialized<epee::json_rpc::error_response> rsp; \
-       static_cast<epee::json_rpc::error_response&>(rsp).error.code = -32700; \
-       static_cast<epee::json_rpc::error_response&>(rsp).error.message = "Parse error"; \
-       epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+       epee::json_rpc::make_error_response(epee::serialization::storage_entry(std::string()), -32700, "Parse error", response_info.m_body); \
        return true; \
     } \
-    epee::serialization::storage_entry id_; \
-    id_ = epee::serialization::storage_entry(std::string()); \
-    ps.get_value("id", id_, nullptr); \
-    std::string callback_name; \
-    if(!ps.get_value("method", callback_name, nullptr)) \
+    std::vector<epee::serialization::json_stream_reader::hsection> rpc_calls; \
+    bool rpc_is_batch = epee::json_rpc::get_request_calls(ps, rpc_calls); \
+    if(rpc_is_batch && (rpc_calls.empty() || rpc_calls.size() > static_cast<size_t>(max_batch_size))) \
     { \
-      epee::json_rpc::error_response rsp; \
-      rsp.jsonrpc = "2.0"; \
-      rsp.error.code = -32600; \
-      rsp.error.message = "Invalid Request"; \
-      epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+      LOG_PRINT_L1("json_rpc: rejected batch of " << rpc_calls.size() << " calls, max batch size is " << (max_batch_size)); \
+      epee::json_rpc::make_error_response(epee::serialization::storage_entry(std::string()), -32600, rpc_calls.empty() ? "Invalid Request" : "Invalid Request: batch is too large", response_info.m_body); \
       return true; \
     } \
-    LOG_PRINT_L1("json_rpc: ") \
-    if(false) return true; //just a stub to have "else if"
+    std::vector<std::string> rpc_methods(rpc_calls.size()); \
+    std::vector<epee::serialization::storage_entry> rpc_ids(rpc_calls.size()); \
+    std::vector<char> rpc_headers_valid(rpc_calls.size()); \
+    for(size_t i = 0; i != rpc_calls.size(); i++) \
+      rpc_headers_valid[i] = epee::json_rpc::get_request_method(ps, rpc_methods[i], rpc_ids[i], rpc_calls[i]); \
+    epee::misc_utils::auto_scope_leave_caller rpc_admission_ticket; \
+    if(!admission_f(rpc_methods, m_conn_context, rpc_admission_ticket)) \
+    { \
+      epee::json_rpc::make_error_response(rpc_is_batch ? epee::serialization::storage_entry(std::string()) : rpc_ids[0], -32000, "Server is busy", response_info.m_body); \
+      return true; \
+    } \
+    epee::misc_utils::auto_scope_leave_caller rpc_batch_guard; \
+    if(rpc_is_batch) \
+      rpc_batch_guard = batch_guard_f(rpc_methods); \
+    epee::json_rpc::calls_response rpc_response(rpc_is_batch); \
+    std::string rpc_call_body; \
+    for(size_t rpc_call_index = 0; rpc_call_index != rpc_calls.size(); rpc_response.push(rpc_call_body), ++rpc_call_index) \
+    { \
+    epee::serialization::json_stream_reader::hsection rpc_call = rpc_calls[rpc_call_index]; \
+    const std::string& callback_name = rpc_methods[rpc_call_index]; \
+    const epee::serialization::storage_entry& id_ = rpc_ids[rpc_call_index]; \
+    if(!rpc_headers_valid[rpc_call_index]) \
+    { \
+      epee::json_rpc::make_error_response(id_, -32600, "Invalid Request", rpc_call_body); \
+      continue; \
+    } \
+    LOG_PRINT_L1("json_rpc: " << callback_name) \
+    switch(epee::json_rpc::method_hash(callback_name)) \
+    {
+
+#define BEGIN_JSON_RPC_MAP_BATCH(uri, max_batch_size, batch_guard_f) BEGIN_JSON_RPC_MAP_ADMISSION(uri, max_batch_size, batch_guard_f, epee::json_rpc::admit_all)
+
+#define BEGIN_JSON_RPC_MAP(uri) BEGIN_JSON_RPC_MAP_BATCH(uri, JSON_RPC_DEFAULT_MAX_BATCH_SIZE, epee::json_rpc::no_batch_guard)
 
 
-#define PREPARE_OBJECTS_FROM_JSON(command_type) \
-  handled = true; \
+#define PREPARE_OBJECTS_FROM_JSON(method_name, command_type) \
+  METRICS_SCOPED_TIMER(rpc_call_timer, "rpc_request_duration_us", std::string("method=\"") + method_name + "\""); \
   boost::value_initialized<epee::json_rpc::request<command_type::request> > req_; \
   epee::json_rpc::request<command_type::request>& req = static_cast<epee::json_rpc::request<command_type::request>&>(req_);\
-  if(!req.load(ps)) \
+  if(!req.load(ps, rpc_call)) \
   { \
-    epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
-    fail_resp.jsonrpc = "2.0"; \
-    fail_resp.id = req.id; \
-    fail_resp.error.code = -32602; \
-    fail_resp.error.message = "Invalid params"; \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
-    return true; \
+    epee::json_rpc::make_error_response(req.id, -32602, "Invalid params", rpc_call_body); \
+    continue; \
   } \
   uint64_t ticks1 = epee::misc_utils::get_tick_count(); \
   boost::value_initialized<epee::json_rpc::response<command_type::response, epee::json_rpc::dummy_error> > resp_; \
@@ -256,76 +395,73 @@ namespace epee
 
 #define FINALIZE_OBJECTS_TO_JSON(method_name) \
   uint64_t ticks2 = epee::misc_utils::get_tick_count(); \
-  epee::serialization::store_t_to_json(resp, response_info.m_body); \
+  epee::serialization::store_t_to_json_stream(resp, rpc_call_body); \
   uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
-  response_info.m_mime_tipe = "application/json"; \
-  response_info.m_header_info.m_content_type = " application/json"; \
   LOG_PRINT( query_info.m_URI << "[" << method_name << "] processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms", LOG_LEVEL_2);
 
 #define MAP_JON_RPC_WE_IF(method_name, callback_f, command_type, cond) \
-    else if((callback_name == method_name) && (cond)) \
+    case epee::json_rpc::method_hash(method_name): \
+    if((callback_name == method_name) && (cond)) \
 { \
-  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  PREPARE_OBJECTS_FROM_JSON(method_name, command_type) \
   epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
   fail_resp.jsonrpc = "2.0"; \
   fail_resp.id = req.id; \
   if(!callback_f(req.params, resp.result, fail_resp.error, m_conn_context)) \
   { \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
-    return true; \
+    epee::serialization::store_t_to_json_stream(static_cast<epee::json_rpc::error_response&>(fail_resp), rpc_call_body); \
+    continue; \
   } \
   FINALIZE_OBJECTS_TO_JSON(method_name) \
-  return true;\
-}
+  continue;\
+} \
+    break;
 
 #define MAP_JON_RPC_WE(method_name, callback_f, command_type) MAP_JON_RPC_WE_IF(method_name, callback_f, command_type, true)
 
 #define MAP_JON_RPC_WERI(method_name, callback_f, command_type) \
-    else if(callback_name == method_name) \
+    case epee::json_rpc::method_hash(method_name): \
+    if(callback_name == method_name) \
 { \
-  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  PREPARE_OBJECTS_FROM_JSON(method_name, command_type) \
   epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
   fail_resp.jsonrpc = "2.0"; \
   fail_resp.id = req.id; \
   if(!callback_f(req.params, resp.result, fail_resp.error, m_conn_context, response_info)) \
   { \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
-    return true; \
+    epee::serialization::store_t_to_json_stream(static_cast<epee::json_rpc::error_response&>(fail_resp), rpc_call_body); \
+    continue; \
   } \
   FINALIZE_OBJECTS_TO_JSON(method_name) \
-  return true;\
-}
+  continue;\
+} \
+    break;
 
 #define MAP_JON_RPC_IF(method_name, callback_f, command_type, cond) \
-    else if((callback_name == method_name) && (cond)) \
+    case epee::json_rpc::method_hash(method_name): \
+    if((callback_name == method_name) && (cond)) \
 { \
-  PREPARE_OBJECTS_FROM_JSON(command_type) \
+  PREPARE_OBJECTS_FROM_JSON(method_name, command_type) \
   if(!callback_f(req.params, resp.result, m_conn_context)) \
   { \
-    epee::json_rpc::error_response fail_resp = AUTO_VAL_INIT(fail_resp); \
-    fail_resp.jsonrpc = "2.0"; \
-    fail_resp.id = req.id; \
-    fail_resp.error.code = -32603; \
-    fail_resp.error.message = "Internal error"; \
-    epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(fail_resp), response_info.m_body); \
-    return true; \
+    epee::json_rpc::make_error_response(req.id, -32603, "Internal error", rpc_call_body); \
+    continue; \
   } \
   FINALIZE_OBJECTS_TO_JSON(method_name) \
-  return true;\
-}
+  continue;\
+} \
+    break;
 
 #define MAP_JON_RPC(method_name, callback_f, command_type) MAP_JON_RPC_IF(method_name, callback_f, command_type, true)
 
 #define MAP_JON_RPC_N(callback_f, command_type) MAP_JON_RPC(command_type::methodname(), callback_f, command_type)
 
 #define END_JSON_RPC_MAP() \
-  epee::json_rpc::error_response rsp; \
-  rsp.id = id_; \
-  rsp.jsonrpc = "2.0"; \
-  rsp.error.code = -32601; \
-  rsp.error.message = "Method not found"; \
-  epee::serialization::store_t_to_json(static_cast<epee::json_rpc::error_response&>(rsp), response_info.m_body); \
+    } \
+    epee::json_rpc::make_error_response(id_, -32601, "Method not found", rpc_call_body); \
+    } \
+  rpc_response.finalize(response_info.m_body); \
+  if(rpc_is_batch) \
+    LOG_PRINT_L2(query_info.m_URI << " batch of " << rpc_calls.size() << " calls processed with " << epee::misc_utils::get_tick_count() - ticks << "ms"); \
   return true; \
   }
-
-
@@ -71,6 +71,13 @@ namespace epee
       return true;
     }
 
+    //should be called before run()
+    void set_gzip_options(size_t min_size, int level)
+    {
+      m_net_server.get_config_object().m_gzip_min_size = min_size;
+      m_net_server.get_config_object().m_gzip_level = level;
+    }
+
     bool run(size_t threads_count, bool wait = true)
     {
       //go to loop
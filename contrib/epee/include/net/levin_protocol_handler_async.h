@@ -36,6 +36,8 @@
 #include "misc_language.h"
 #include "profile_tools.h"
 
+#define LEVIN_MAX_BODY_PREALLOC 65536 //body buffer reserved on head, then reservation follows received bytes
+
 
 namespace epee
 {
@@ -129,6 +131,10 @@ public:
   config_type& m_config;
   t_connection_context& m_connection_context;
 
+  //head is collected in place, body goes straight into the buffer handed over to handlers; the buffer is
+  //reserved at least twice of received bytes, so a big body takes log2(size/LEVIN_MAX_BODY_PREALLOC) reallocations
+  bucket_head2 m_head_in;
+  size_t m_head_in_size;
   std::string m_cache_in_buffer;
   stream_state m_state;
 
@@ -226,6 +232,8 @@ public:
             m_pservice_endpoint(psnd_hndlr), 
             m_config(config), 
             m_connection_context(conn_context), 
+            m_head_in(bucket_head2()),
+            m_head_in_size(0),
             m_state(stream_state_head)
   {
     m_close_called = 0;
@@ -338,36 +346,34 @@ public:
       return false;
     }
 
-    if(m_cache_in_buffer.size() +  cb > m_config.m_max_packet_size)
-    {
-      LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
-                          << ", packet received " << m_cache_in_buffer.size() +  cb 
-                          << ", connection will be closed.");
-      return false;
-    }
-
-    m_cache_in_buffer.append((const char*)ptr, cb);
-
+    const char* pdata = (const char*)ptr;
     bool is_continue = true;
     while(is_continue)
     {
       switch(m_state)
       {
       case stream_state_body:
+        {
+          size_t body_part = std::min<size_t>(static_cast<size_t>(m_current_head.m_cb) - m_cache_in_buffer.size(), cb);
+          size_t body_received = m_cache_in_buffer.size() + body_part;
+          if(body_received > m_cache_in_buffer.capacity())
+          {
+            //peer that sent this much likely sends the rest, still never reserve more than twice of what came
+            m_cache_in_buffer.reserve(std::min<size_t>(static_cast<size_t>(m_current_head.m_cb), std::max<size_t>(LEVIN_MAX_BODY_PREALLOC, 2 * body_received)));
+          }
+          m_cache_in_buffer.append(pdata, body_part);
+          pdata += body_part;
+          cb -= body_part;
+        }
         if(m_cache_in_buffer.size() < m_current_head.m_cb)
         {
           is_continue = false;
           break;
         }
         {
+          //body is handed over to handlers as is, buffer for the next one is allocated when its head comes
           std::string buff_to_invoke;
-          if(m_cache_in_buffer.size()  == m_current_head.m_cb)
-            buff_to_invoke.swap(m_cache_in_buffer);
-          else
-          {
-            buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
-            m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
-          }
+          buff_to_invoke.swap(m_cache_in_buffer);
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
@@ -465,9 +471,14 @@ public:
         break;
       case stream_state_head:
         {
-          if(m_cache_in_buffer.size() < sizeof(bucket_head2))
+          size_t head_part = std::min(sizeof(bucket_head2) - m_head_in_size, cb);
+          memcpy((char*)&m_head_in + m_head_in_size, pdata, head_part);
+          m_head_in_size += head_part;
+          pdata += head_part;
+          cb -= head_part;
+          if(m_head_in_size < sizeof(bucket_head2))
           {
-            if(m_cache_in_buffer.size() >= sizeof(uint64_t) && *((uint64_t*)m_cache_in_buffer.data()) != LEVIN_SIGNATURE)
+            if(m_head_in_size >= sizeof(uint64_t) && m_head_in.m_signature != LEVIN_SIGNATURE)
             {
               LOG_PRINT_CC_L0(m_connection_context, "Signature mismatch, connection will be closed");
               return false;
@@ -476,15 +487,14 @@ public:
             break;
           }
 
-          bucket_head2* phead = (bucket_head2*)m_cache_in_buffer.data();
-          if(LEVIN_SIGNATURE != phead->m_signature)
+          m_head_in_size = 0;
+          if(LEVIN_SIGNATURE != m_head_in.m_signature)
           {
             LOG_PRINT_CC_L0(m_connection_context, "Signature mismatch, connection will be closed");
             return false;
           }
-          m_current_head = *phead;
+          m_current_head = m_head_in;
 
-          m_cache_in_buffer.erase(0, sizeof(bucket_head2));
           m_state = stream_state_body;
           m_oponent_protocol_ver = m_current_head.m_protocol_version;
           if(m_current_head.m_cb > m_config.m_max_packet_size)
@@ -494,6 +504,8 @@ public:
               << ", connection will be closed.");
             return false;
           }
+          //announced size is not trusted for allocation, a peer could announce big bodies and never send them
+          m_cache_in_buffer.reserve(std::min<size_t>(static_cast<size_t>(m_current_head.m_cb), LEVIN_MAX_BODY_PREALLOC));
         }
         break;
       default:
@@ -28,5 +28,5 @@
 #pragma once 
 
 
-#define RPC_METHOD_NAME(name) static inline const char* methodname(){return name;}
+#define RPC_METHOD_NAME(name) static constexpr const char* methodname(){return name;}
 
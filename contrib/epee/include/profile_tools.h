@@ -29,13 +29,17 @@
 #define _PROFILE_TOOLS_H_
 
 #include <chrono>
+#include "metrics_registry.h"
 
 // 0 - no profiling, 1 - basic, 2 - full, 3 - ultimate
 #define PROFILING_LEVEL 2
 
+// finished profiling timers also go to "prof_timer_us" histogram of the metrics registry, labeled by function and timer name
+#define PROF_TIMER_TO_METRICS(timer_var) METRICS_HISTOGRAM_OBSERVE("prof_timer_us", std::string("func=\"") + __FUNCTION__ + "\",timer=\"" #timer_var "\"", timer_var)
+
 #if PROFILING_LEVEL >= 1
 #  define PROF_L1_START(timer_var) TIME_MEASURE_START(timer_var)
-#  define PROF_L1_FINISH(timer_var) TIME_MEASURE_FINISH(timer_var)
+#  define PROF_L1_FINISH(timer_var) do { TIME_MEASURE_FINISH(timer_var) PROF_TIMER_TO_METRICS(timer_var); } while(0)
 #  define PROF_L1_STR_MS(str, timer_var) str << epee::print_mcsec_as_ms(timer_var, 8)
 #  define PROF_L1_STR_MS_STR(str, timer_var, text2) str << epee::print_mcsec_as_ms(timer_var, 8) << text2
 #  define PROF_L1_STR(str) str
@@ -53,7 +57,7 @@
 
 #if PROFILING_LEVEL >= 2
 #  define PROF_L2_START(timer_var) TIME_MEASURE_START(timer_var)
-#  define PROF_L2_FINISH(timer_var) TIME_MEASURE_FINISH(timer_var)
+#  define PROF_L2_FINISH(timer_var) do { TIME_MEASURE_FINISH(timer_var) PROF_TIMER_TO_METRICS(timer_var); } while(0)
 #  define PROF_L2_STR_MS(str, timer_var) str << epee::print_mcsec_as_ms(timer_var, 8)
 #  define PROF_L2_STR_MS_STR(str, timer_var, text2) str << epee::print_mcsec_as_ms(timer_var, 8) << text2
 #  define PROF_L2_STR(str) str
@@ -71,7 +75,7 @@
 
 #if PROFILING_LEVEL >= 3
 #  define PROF_L3_START(timer_var) TIME_MEASURE_START(timer_var)
-#  define PROF_L3_FINISH(timer_var) TIME_MEASURE_FINISH(timer_var)
+#  define PROF_L3_FINISH(timer_var) do { TIME_MEASURE_FINISH(timer_var) PROF_TIMER_TO_METRICS(timer_var); } while(0)
 #  define PROF_L3_STR_MS(str, timer_var) str << epee::print_mcsec_as_ms(timer_var, 8)
 #  define PROF_L3_STR_MS_STR(str, timer_var, text2) str << epee::print_mcsec_as_ms(timer_var, 8) << text2
 #  define PROF_L3_STR(str) str
@@ -0,0 +1,863 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <sstream>
+#include <typeinfo>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_json.h"
+#include "portable_storage_val_converters.h"
+
+#define JSON_STREAM_MAX_DEPTH  100
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Storage-like JSON writer: KV_SERIALIZE maps are printed straight     */
+    /* into the output buffer in declaration order, without building a     */
+    /* portable_storage tree. Scopes are closed lazily, when the next value */
+    /* goes to one of their parents, or in finalize().                      */
+    /************************************************************************/
+    class json_stream_writer
+    {
+    public:
+      struct scope
+      {
+        bool is_array;
+        bool has_entries;
+      };
+
+      typedef scope* hsection;
+      typedef scope* harray;
+      typedef storage_entry meta_entry;
+
+      json_stream_writer(std::string& buff) : m_buff(buff)
+      {
+        m_buff.clear();
+        m_buff.push_back('{');
+        push_scope(false);
+      }
+
+      void finalize()
+      {
+        close_scopes(nullptr);
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool /*create_if_notexist*/ = false)
+      {
+        begin_entry(section_name, hparent_section);
+        m_buff.push_back('{');
+        return push_scope(false);
+      }
+
+      template<class t_value>
+      bool set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+      {
+        begin_entry(value_name, hparent_section);
+        write_value(v);
+        return true;
+      }
+
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+      {
+        begin_entry(value_name, hparent_section);
+        m_buff.push_back('[');
+        write_value(v);
+        harray harr = push_scope(true);
+        harr->has_entries = true;
+        return harr;
+      }
+
+      template<class t_value>
+      bool insert_next_value(harray hval_array, const t_value& v)
+      {
+        unwind_to(hval_array);
+        m_buff.push_back(',');
+        write_value(v);
+        return true;
+      }
+
+      harray insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section)
+      {
+        begin_entry(section_name, hparent_section);
+        m_buff += "[{";
+        harray harr = push_scope(true);
+        harr->has_entries = true;
+        hinserted_childsection = push_scope(false);
+        return harr;
+      }
+
+      bool insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+      {
+        unwind_to(hsec_array);
+        m_buff += ",{";
+        hinserted_childsection = push_scope(false);
+        return true;
+      }
+
+    private:
+      hsection push_scope(bool is_array)
+      {
+        scope s = {is_array, false};
+        m_scopes.push_back(s);
+        return &m_scopes.back();
+      }
+
+      void close_scopes(hsection target)
+      {
+        while(!m_scopes.empty() && &m_scopes.back() != target)
+        {
+          m_buff.push_back(m_scopes.back().is_array ? ']' : '}');
+          m_scopes.pop_back();
+        }
+      }
+
+      //closes every scope nested into target, nullptr stands for the root section
+      hsection unwind_to(hsection target)
+      {
+        if(!target)
+          target = &m_scopes.front();
+        close_scopes(target);
+        CHECK_AND_ASSERT_THROW_MES(!m_scopes.empty(), "json_stream_writer: write to already closed scope");
+        return target;
+      }
+
+      void begin_entry(const std::string& name, hsection hparent_section)
+      {
+        hsection s = unwind_to(hparent_section);
+        if(s->has_entries)
+          m_buff.push_back(',');
+        s->has_entries = true;
+        write_value(name);
+        m_buff.push_back(':');
+      }
+
+      void write_value(const std::string& v)
+      {
+        //same escaping as misc_utils::parse::transform_to_escape_sequence(), without temporary string
+        m_buff.push_back('"');
+        const char* run = v.data();
+        const char* end = run + v.size();
+        for(const char* it = run; it != end; ++it)
+        {
+          const char* esc = nullptr;
+          switch(*it)
+          {
+          case '\b': esc = "\\b"; break;
+          case '\f': esc = "\\f"; break;
+          case '\n': esc = "\\n"; break;
+          case '\r': esc = "\\r"; break;
+          case '\t': esc = "\\t"; break;
+          case '\v': esc = "\\v"; break;
+          case '"':  esc = "\\\""; break;
+          case '\\': esc = "\\\\"; break;
+          case '/':  esc = "\\/"; break;
+          default:   continue;
+          }
+          m_buff.append(run, it);
+          m_buff += esc;
+          run = it + 1;
+        }
+        m_buff.append(run, end);
+        m_buff.push_back('"');
+      }
+
+      void write_value(bool v)
+      {
+        m_buff += v ? "true" : "false";
+      }
+
+      void write_value(double v)
+      {
+        //matches default std::ostream formatting used by dump_as_json()
+        char buff[32];
+        int len = std::snprintf(buff, sizeof(buff), "%g", v);
+        m_buff.append(buff, len);
+      }
+
+      void write_value(uint64_t v)
+      {
+        char buff[24];
+        char* p = buff + sizeof(buff);
+        do
+        {
+          *--p = static_cast<char>('0' + v % 10);
+          v /= 10;
+        } while(v);
+        m_buff.append(p, buff + sizeof(buff) - p);
+      }
+
+      void write_value(int64_t v)
+      {
+        if(v < 0)
+        {
+          m_buff.push_back('-');
+          write_value(static_cast<uint64_t>(0) - static_cast<uint64_t>(v));
+        }
+        else
+          write_value(static_cast<uint64_t>(v));
+      }
+
+      void write_value(uint32_t v) { write_value(static_cast<uint64_t>(v)); }
+      void write_value(uint16_t v) { write_value(static_cast<uint64_t>(v)); }
+      void write_value(uint8_t v)  { write_value(static_cast<uint64_t>(v)); }
+      void write_value(int32_t v)  { write_value(static_cast<int64_t>(v)); }
+      void write_value(int16_t v)  { write_value(static_cast<int64_t>(v)); }
+      void write_value(int8_t v)   { write_value(static_cast<int64_t>(v)); }
+
+      struct storage_entry_writer: public boost::static_visitor<void>
+      {
+        json_stream_writer& m_writer;
+        storage_entry_writer(json_stream_writer& writer) : m_writer(writer) {}
+        void operator()(const section& v)
+        {
+          std::stringstream ss;
+          dump_as_json(ss, v, 0);
+          m_writer.m_buff += ss.str();
+        }
+        void operator()(const array_entry& v)
+        {
+          std::stringstream ss;
+          dump_as_json(ss, v, 0);
+          m_writer.m_buff += ss.str();
+        }
+        template<class t_value>
+        void operator()(const t_value& v)
+        {
+          m_writer.write_value(v);
+        }
+      };
+
+      void write_value(const storage_entry& v)
+      {
+        storage_entry_writer sew(*this);
+        boost::apply_visitor(sew, v);
+      }
+
+      std::string& m_buff;
+      std::deque<scope> m_scopes; //deque keeps handles valid on push_back
+    };
+
+    /************************************************************************/
+    /* Storage-like JSON reader: the buffer is split once into a flat token */
+    /* array (one entry per value, key or container), and KV_SERIALIZE maps */
+    /* are loaded straight from it. Values are converted from the source    */
+    /* text on request, conversion rules follow portable_storage.           */
+    /* The JSON buffer has to outlive the reader.                           */
+    /************************************************************************/
+    class json_stream_reader
+    {
+    public:
+      enum token_type
+      {
+        token_object,
+        token_array,
+        token_string,
+        token_number,
+        token_true,
+        token_false,
+        token_null
+      };
+
+      struct token
+      {
+        token_type type;
+        bool is_escaped;     //string with escape sequences
+        bool is_float;       //number with fraction or exponent
+        bool is_negative;
+        const char* begin;   //string contents without quotes, or number text
+        const char* end;
+        size_t next;         //index of the token following this value (with all nested ones)
+      };
+
+      struct array_cursor
+      {
+        size_t current;
+        size_t end;
+      };
+
+      typedef const token* hsection;
+      typedef array_cursor* harray;
+      typedef storage_entry meta_entry;
+
+      bool load_from_json(const std::string& buff_json)
+      {
+        m_tokens.clear();
+        m_cursors.clear();
+        m_tokens.reserve(buff_json.size() / 8 + 4);
+        const char* it = buff_json.data();
+        const char* end = it + buff_json.size();
+        skip_spaces(it, end);
+        bool r = parse_value(it, end, 0);
+        if(r)
+        {
+          //nothing but whitespace is allowed after root value
+          skip_spaces(it, end);
+          r = it == end;
+        }
+        if(!r)
+        {
+          LOG_PRINT_L1("Failed to parse json near: " << std::string(it, std::min<size_t>(end - it, 64)));
+          m_tokens.clear();
+          return false;
+        }
+        return true;
+      }
+
+      //root value, could be object or array
+      const token* get_root() const
+      {
+        return m_tokens.empty() ? nullptr : &m_tokens.front();
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool /*create_if_notexist*/ = false)
+      {
+        const token* t = find_entry(section_name, hparent_section);
+        if(!t || t->type != token_object)
+          return nullptr;
+        return t;
+      }
+
+      template<class t_value>
+      bool get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+      {
+        const token* t = find_entry(value_name, hparent_section);
+        if(!t || t->type == token_null)
+          return false;
+        convert(*t, val);
+        return true;
+      }
+
+      bool get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+      {
+        const token* t = find_entry(value_name, hparent_section);
+        if(!t || t->type == token_null)
+          return false;
+        val = to_storage_entry(*t);
+        return true;
+      }
+
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+      {
+        harray harr = open_array(value_name, hparent_section);
+        if(!harr || !get_next_value(harr, target))
+          return nullptr;
+        return harr;
+      }
+
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target)
+      {
+        CHECK_AND_ASSERT(hval_array, false);
+        if(hval_array->current == hval_array->end)
+          return false;
+        const token& t = m_tokens[hval_array->current];
+        convert(t, target);
+        hval_array->current = t.next;
+        return true;
+      }
+
+      harray get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section)
+      {
+        harray harr = open_array(section_name, hparent_section);
+        if(!harr || !get_next_section(harr, h_child_section))
+          return nullptr;
+        return harr;
+      }
+
+      bool get_next_section(harray hsec_array, hsection& h_child_section)
+      {
+        CHECK_AND_ASSERT(hsec_array, false);
+        if(hsec_array->current == hsec_array->end)
+          return false;
+        const token& t = m_tokens[hsec_array->current];
+        if(t.type != token_object)
+          return false;
+        h_child_section = &t;
+        hsec_array->current = t.next;
+        return true;
+      }
+
+      //elements of array token, for callers working with the token array directly
+      std::vector<const token*> get_array_elements(const token& arr) const
+      {
+        std::vector<const token*> res;
+        if(arr.type != token_array)
+          return res;
+        for(size_t i = index_of(arr) + 1; i != arr.next; i = m_tokens[i].next)
+          res.push_back(&m_tokens[i]);
+        return res;
+      }
+
+    private:
+      size_t index_of(const token& t) const
+      {
+        return &t - &m_tokens.front();
+      }
+
+      static void skip_spaces(const char*& it, const char* end)
+      {
+        while(it != end && (*it == ' ' || *it == '\t' || *it == '\r' || *it == '\n'))
+          ++it;
+      }
+
+      size_t add_token(token_type type, const char* begin, const char* end)
+      {
+        token t = {type, false, false, false, begin, end, 0};
+        m_tokens.push_back(t);
+        return m_tokens.size() - 1;
+      }
+
+      bool parse_string(const char*& it, const char* end)
+      {
+        //it points to opening quote
+        const char* begin = ++it;
+        bool is_escaped = false;
+        for(; it != end; ++it)
+        {
+          if(*it == '\\')
+          {
+            is_escaped = true;
+            if(++it == end)
+              return false;
+          }
+          else if(*it == '"')
+          {
+            size_t i = add_token(token_string, begin, it);
+            m_tokens[i].is_escaped = is_escaped;
+            m_tokens[i].next = i + 1;
+            ++it;
+            return true;
+          }
+        }
+        return false;
+      }
+
+      bool parse_number(const char*& it, const char* end)
+      {
+        const char* begin = it;
+        bool is_negative = false;
+        bool is_float = false;
+        if(*it == '-')
+        {
+          is_negative = true;
+          ++it;
+        }
+        const char* digits = it;
+        while(it != end && std::isdigit(static_cast<unsigned char>(*it)))
+          ++it;
+        if(it == digits)
+          return false;
+        if(it != end && *it == '.')
+        {
+          is_float = true;
+          const char* fraction = ++it;
+          while(it != end && std::isdigit(static_cast<unsigned char>(*it)))
+            ++it;
+          if(it == fraction)
+            return false;
+        }
+        if(it != end && (*it == 'e' || *it == 'E'))
+        {
+          is_float = true;
+          ++it;
+          if(it != end && (*it == '+' || *it == '-'))
+            ++it;
+          const char* exponent = it;
+          while(it != end && std::isdigit(static_cast<unsigned char>(*it)))
+            ++it;
+          if(it == exponent)
+            return false;
+        }
+        size_t i = add_token(token_number, begin, it);
+        m_tokens[i].is_float = is_float;
+        m_tokens[i].is_negative = is_negative;
+        m_tokens[i].next = i + 1;
+        return true;
+      }
+
+      static bool is_keyword(const char* begin, size_t len, const char* keyword)
+      {
+        if(len != std::strlen(keyword))
+          return false;
+        for(size_t i = 0; i != len; i++)
+        {
+          if(std::tolower(static_cast<unsigned char>(begin[i])) != keyword[i])
+            return false;
+        }
+        return true;
+      }
+
+      bool parse_word(const char*& it, const char* end)
+      {
+        const char* begin = it;
+        while(it != end && std::isalpha(static_cast<unsigned char>(*it)))
+          ++it;
+        size_t len = it - begin;
+        token_type type;
+        //keywords are case insensitive, as in portable_storage json loader
+        if(is_keyword(begin, len, "true"))
+          type = token_true;
+        else if(is_keyword(begin, len, "false"))
+          type = token_false;
+        else if(is_keyword(begin, len, "null"))
+          type = token_null;
+        else
+          return false;
+        size_t i = add_token(type, begin, it);
+        m_tokens[i].next = i + 1;
+        return true;
+      }
+
+      bool parse_value(const char*& it, const char* end, size_t depth)
+      {
+        if(it == end)
+          return false;
+        switch(*it)
+        {
+        case '{':
+          return parse_container(it, end, depth, token_object, '}');
+        case '[':
+          return parse_container(it, end, depth, token_array, ']');
+        case '"':
+          return parse_string(it, end);
+        default:
+          if(*it == '-' || std::isdigit(static_cast<unsigned char>(*it)))
+            return parse_number(it, end);
+          return parse_word(it, end);
+        }
+      }
+
+      bool parse_container(const char*& it, const char* end, size_t depth, token_type type, char closing)
+      {
+        if(depth >= JSON_STREAM_MAX_DEPTH)
+          return false;
+        size_t i = add_token(type, it, end);
+        ++it;
+        skip_spaces(it, end);
+        bool first = true;
+        while(it != end && *it != closing)
+        {
+          if(!first)
+          {
+            if(*it != ',')
+              return false;
+            ++it;
+            skip_spaces(it, end);
+          }
+          first = false;
+          if(type == token_object)
+          {
+            if(it == end || *it != '"' || !parse_string(it, end))
+              return false;
+            skip_spaces(it, end);
+            if(it == end || *it != ':')
+              return false;
+            ++it;
+            skip_spaces(it, end);
+          }
+          if(!parse_value(it, end, depth + 1))
+            return false;
+          skip_spaces(it, end);
+        }
+        if(it == end)
+          return false;
+        ++it;
+        m_tokens[i].end = it;
+        m_tokens[i].next = m_tokens.size();
+        return true;
+      }
+
+      static void unescape(const token& t, std::string& val)
+      {
+        //same escape sequences as misc_utils::parse::match_string2()
+        val.clear();
+        val.reserve(t.end - t.begin);
+        for(const char* it = t.begin; it != t.end; ++it)
+        {
+          if(*it != '\\')
+          {
+            val.push_back(*it);
+            continue;
+          }
+          ++it;
+          switch(*it)
+          {
+          case 'b':  val.push_back(0x08); break;
+          case 'f':  val.push_back(0x0C); break;
+          case 'n':  val.push_back('\n'); break;
+          case 'r':  val.push_back('\r'); break;
+          case 't':  val.push_back('\t'); break;
+          case 'v':  val.push_back('\v'); break;
+          case '\'': val.push_back('\''); break;
+          case '"':  val.push_back('"'); break;
+          case '\\': val.push_back('\\'); break;
+          case '/':  val.push_back('/'); break;
+          default:
+            val.push_back(*it);
+            LOG_PRINT_L0("Unknown escape sequence :\"\\" << *it << "\"");
+          }
+        }
+      }
+
+      bool is_key_equal(const token& key, const std::string& name) const
+      {
+        if(!key.is_escaped)
+          return static_cast<size_t>(key.end - key.begin) == name.size() && !std::memcmp(key.begin, name.data(), name.size());
+        std::string unescaped;
+        unescape(key, unescaped);
+        return unescaped == name;
+      }
+
+      const token* find_entry(const std::string& name, hsection hparent_section) const
+      {
+        if(!hparent_section)
+          hparent_section = get_root();
+        if(!hparent_section || hparent_section->type != token_object)
+          return nullptr;
+        //members are laid out as key token followed by value token(s)
+        for(size_t i = index_of(*hparent_section) + 1; i != hparent_section->next; i = m_tokens[i + 1].next)
+        {
+          if(is_key_equal(m_tokens[i], name))
+            return &m_tokens[i + 1];
+        }
+        return nullptr;
+      }
+
+      harray open_array(const std::string& name, hsection hparent_section)
+      {
+        const token* t = find_entry(name, hparent_section);
+        if(!t || t->type != token_array)
+          return nullptr;
+        array_cursor c = {index_of(*t) + 1, t->next};
+        m_cursors.push_back(c);
+        return &m_cursors.back();
+      }
+
+      static void parse_integer(const token& t, uint64_t& magnitude)
+      {
+        magnitude = 0;
+        for(const char* it = t.is_negative ? t.begin + 1 : t.begin; it != t.end; ++it)
+        {
+          uint64_t digit = *it - '0';
+          CHECK_AND_ASSERT_THROW_MES(magnitude <= (std::numeric_limits<uint64_t>::max() - digit) / 10, "json number is too big: " << std::string(t.begin, t.end));
+          magnitude = magnitude * 10 + digit;
+        }
+      }
+
+      //integer fields take only integer json numbers, "1.0" or "1e3" are rejected as the
+      //double->integer conversion of portable_storage_from_json rejected them
+      template<class t_value>
+      static void convert_integral(const token& t, t_value& val)
+      {
+        CHECK_AND_ASSERT_THROW_MES(t.type == token_number && !t.is_float, "WRONG DATA CONVERSION: json value is not integer, to type " << typeid(t_value).name());
+        uint64_t magnitude = 0;
+        parse_integer(t, magnitude);
+        if(t.is_negative)
+        {
+          CHECK_AND_ASSERT_THROW_MES(magnitude <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + 1, "json number is too small: " << std::string(t.begin, t.end));
+          int64_t v = static_cast<int64_t>(static_cast<uint64_t>(0) - magnitude);
+          convert_t(v, val);
+        }
+        else
+          convert_t(magnitude, val);
+      }
+
+      static void convert(const token& t, uint64_t& val) { convert_integral(t, val); }
+      static void convert(const token& t, uint32_t& val) { convert_integral(t, val); }
+      static void convert(const token& t, uint16_t& val) { convert_integral(t, val); }
+      static void convert(const token& t, uint8_t& val)  { convert_integral(t, val); }
+      static void convert(const token& t, int64_t& val)  { convert_integral(t, val); }
+      static void convert(const token& t, int32_t& val)  { convert_integral(t, val); }
+      static void convert(const token& t, int16_t& val)  { convert_integral(t, val); }
+      static void convert(const token& t, int8_t& val)   { convert_integral(t, val); }
+
+      static void convert(const token& t, double& val)
+      {
+        CHECK_AND_ASSERT_THROW_MES(t.type == token_number, "WRONG DATA CONVERSION: json value is not number, to type double");
+        val = boost::lexical_cast<double>(std::string(t.begin, t.end));
+      }
+
+      static void convert(const token& t, bool& val)
+      {
+        CHECK_AND_ASSERT_THROW_MES(t.type == token_true || t.type == token_false, "WRONG DATA CONVERSION: json value is not boolean");
+        val = t.type == token_true;
+      }
+
+      static void convert(const token& t, std::string& val)
+      {
+        CHECK_AND_ASSERT_THROW_MES(t.type == token_string, "WRONG DATA CONVERSION: json value is not string");
+        if(t.is_escaped)
+          unescape(t, val);
+        else
+          val.assign(t.begin, t.end);
+      }
+
+      static void convert(const token& t, storage_entry& val)
+      {
+        //arrays of storage entries aren't serializable, but keep overload set complete
+        CHECK_AND_ASSERT_THROW_MES(false, "WRONG DATA CONVERSION: arrays of storage_entry not supported");
+      }
+
+      //same typing as portable_storage json loader: signed/unsigned 64-bit integers and doubles
+      storage_entry to_storage_entry(const token& t) const
+      {
+        switch(t.type)
+        {
+        case token_string:
+          {
+            std::string v;
+            convert(t, v);
+            return storage_entry(v);
+          }
+        case token_number:
+          if(t.is_float)
+          {
+            double v = 0;
+            convert(t, v);
+            return storage_entry(v);
+          }
+          else if(t.is_negative)
+          {
+            int64_t v = 0;
+            convert(t, v);
+            return storage_entry(v);
+          }
+          else
+          {
+            uint64_t v = 0;
+            convert(t, v);
+            return storage_entry(v);
+          }
+        case token_true:
+          return storage_entry(true);
+        case token_false:
+          return storage_entry(false);
+        case token_object:
+          {
+            section s;
+            for(size_t i = index_of(t) + 1; i != t.next; i = m_tokens[i + 1].next)
+            {
+              if(m_tokens[i + 1].type == token_null)
+                continue;
+              std::string name;
+              convert(m_tokens[i], name);
+              s.m_entries[name] = to_storage_entry(m_tokens[i + 1]);
+            }
+            return storage_entry(s);
+          }
+        case token_array:
+          return storage_entry(to_array_entry(t));
+        case token_null:
+        default:
+          ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: unexpected json token type " << t.type);
+        }
+      }
+
+      template<class t_value>
+      array_entry to_typed_array_entry(const token& t) const
+      {
+        array_entry_t<t_value> arr;
+        for(size_t i = index_of(t) + 1; i != t.next; i = m_tokens[i].next)
+        {
+          t_value v = t_value();
+          convert(m_tokens[i], v);
+          arr.insert_next_value(v);
+        }
+        return array_entry(arr);
+      }
+
+      array_entry to_array_entry(const token& t) const
+      {
+        //element type is taken from the first element, as portable_storage json loader does
+        size_t first = index_of(t) + 1;
+        if(first == t.next)
+          return array_entry(array_entry_t<section>());
+        const token& f = m_tokens[first];
+        switch(f.type)
+        {
+        case token_object:
+          {
+            array_entry_t<section> arr;
+            for(size_t i = first; i != t.next; i = m_tokens[i].next)
+            {
+              CHECK_AND_ASSERT_THROW_MES(m_tokens[i].type == token_object, "mixed json array is not supported");
+              arr.insert_next_value(boost::get<section>(to_storage_entry(m_tokens[i])));
+            }
+            return array_entry(arr);
+          }
+        case token_string:
+          return to_typed_array_entry<std::string>(t);
+        case token_true:
+        case token_false:
+          return to_typed_array_entry<bool>(t);
+        case token_number:
+          return f.is_float ? to_typed_array_entry<double>(t) : to_typed_array_entry<int64_t>(t);
+        default:
+          ASSERT_MES_AND_THROW("json array of given type is not supported");
+        }
+      }
+
+      std::vector<token> m_tokens;
+      std::deque<array_cursor> m_cursors; //deque keeps handles valid on push_back
+    };
+
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool load_t_from_json_stream(t_struct& out, const std::string& json_buff)
+    {
+      json_stream_reader reader;
+      if(!reader.load_from_json(json_buff))
+        return false;
+      return out.load(reader);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool store_t_to_json_stream(const t_struct& str_in, std::string& json_buff)
+    {
+      json_stream_writer writer(json_buff);
+      if(!str_in.store(writer))
+        return false;
+      writer.finalize();
+      return true;
+    }
+  }
+}
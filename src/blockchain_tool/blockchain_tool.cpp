@@ -0,0 +1,367 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Offline main chain export/import: fast bootstrap and repeatable sync benchmark without network;
+// database compaction: returns pages freed by ring signatures pruning to the filesystem
+
+#include "include_base_utils.h"
+#include "version.h"
+
+using namespace epee;
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+#if defined(WIN32)
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include "common/command_line.h"
+#include "common/util.h"
+#include "currency_core/checkpoints_create.h"
+#include "currency_core/currency_core.h"
+#include "profile_tools.h"
+
+namespace po = boost::program_options;
+
+#define BLOCKCHAIN_FILE_SIGNATURE             0x4e49414843524242ULL // "BBRCHAIN"
+#define BLOCKCHAIN_FILE_FORMAT_VERSION        1
+#define BLOCKCHAIN_FILE_MAX_BLOB_SIZE         CURRENCY_MAX_BLOCK_SIZE
+#define BLOCKCHAIN_TOOL_PROGRESS_INTERVAL     1000
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_export_file            = {"export-file", "Export main chain of --data-dir to given file", "", true};
+  const command_line::arg_descriptor<std::string> arg_import_file            = {"import-file", "Import blocks from given file into --data-dir", "", true};
+  const command_line::arg_descriptor<uint64_t>    arg_stop_height            = {"stop-height", "Export/import blocks up to given height only", 0};
+  const command_line::arg_descriptor<bool>        arg_import_no_checkpoints  = {"import-without-checkpoints", "Fully verify imported blocks, including ring signatures below checkpoints"};
+  const command_line::arg_descriptor<std::string> arg_compact_to             = {"compact-to", "Finish ring signatures pruning and write compacted copy of --data-dir database to given folder", "", true};
+
+  std::atomic<bool> stop_requested(false);
+
+  uint64_t get_peak_rss()
+  {
+#if defined(WIN32)
+    PROCESS_MEMORY_COUNTERS pmc = AUTO_VAL_INIT(pmc);
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+      return 0;
+    return pmc.PeakWorkingSetSize;
+#else
+    struct rusage ru = AUTO_VAL_INIT(ru);
+    if (0 != getrusage(RUSAGE_SELF, &ru))
+      return 0;
+#  if defined(__APPLE__)
+    return ru.ru_maxrss;
+#  else
+    return static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+#  endif
+#endif
+  }
+
+  std::string print_blocks_per_second(uint64_t blocks, uint64_t microseconds)
+  {
+    if (!microseconds)
+      return "-";
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << blocks * 1000000.0 / microseconds;
+    return ss.str();
+  }
+
+  //------------------------------------------------------------------
+  // file layout: [u64 signature][u32 format version] followed by entries
+  // [u32 block blob size][block blob][u32 txs count]{[u32 tx blob size][tx blob]}
+  //------------------------------------------------------------------
+  bool write_blob(std::ofstream& out, const currency::blobdata& blob)
+  {
+    uint32_t sz = static_cast<uint32_t>(blob.size());
+    out.write(reinterpret_cast<const char*>(&sz), sizeof(sz));
+    out.write(blob.data(), blob.size());
+    return out.good();
+  }
+
+  bool read_blob(std::ifstream& in, currency::blobdata& blob)
+  {
+    uint32_t sz = 0;
+    in.read(reinterpret_cast<char*>(&sz), sizeof(sz));
+    if (!in.good())
+      return false;
+    CHECK_AND_ASSERT_MES(sz <= BLOCKCHAIN_FILE_MAX_BLOB_SIZE, false, "wrong blob size in blockchain file: " << sz);
+    blob.resize(sz);
+    if (sz)
+      in.read(&blob[0], sz);
+    return in.good();
+  }
+
+  //------------------------------------------------------------------
+  bool export_blockchain(currency::core& ccore, const std::string& path, uint64_t stop_height)
+  {
+    std::ofstream out(path, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    CHECK_AND_ASSERT_MES(out.is_open(), false, "failed to open " << path);
+
+    uint64_t signature = BLOCKCHAIN_FILE_SIGNATURE;
+    uint32_t version = BLOCKCHAIN_FILE_FORMAT_VERSION;
+    out.write(reinterpret_cast<const char*>(&signature), sizeof(signature));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+
+    uint64_t height = ccore.get_current_blockchain_height();
+    if (stop_height && stop_height < height)
+      height = stop_height;
+
+    LOG_PRINT_L0("Exporting " << height - 1 << " blocks to " << path << "...");
+    uint64_t txs_count = 0;
+    TIME_MEASURE_START(export_time);
+    // genesis is not exported, every node generates it by itself
+    for (uint64_t h = 1; h < height && !stop_requested; h++)
+    {
+      currency::block b = AUTO_VAL_INIT(b);
+      bool r = ccore.get_blockchain_storage().get_block_by_height(h, b);
+      CHECK_AND_ASSERT_MES(r, false, "failed to get block at height " << h);
+      std::list<currency::transaction> txs;
+      std::list<crypto::hash> missed_txs;
+      ccore.get_transactions(b.tx_hashes, txs, missed_txs);
+      CHECK_AND_ASSERT_MES(missed_txs.empty() && txs.size() == b.tx_hashes.size(), false, "block at height " << h << " has " << missed_txs.size() << " missed transactions");
+
+      write_blob(out, currency::block_to_blob(b));
+      uint32_t txs_in_block = static_cast<uint32_t>(txs.size());
+      out.write(reinterpret_cast<const char*>(&txs_in_block), sizeof(txs_in_block));
+      for (const auto& tx : txs)
+        write_blob(out, currency::tx_to_blob(tx));
+      CHECK_AND_ASSERT_MES(out.good(), false, "failed to write to " << path);
+      txs_count += txs.size();
+
+      if (!(h % BLOCKCHAIN_TOOL_PROGRESS_INTERVAL))
+        LOG_PRINT_L0("Exported " << h << "/" << height - 1 << " blocks");
+    }
+    out.flush();
+    CHECK_AND_ASSERT_MES(out.good(), false, "failed to write to " << path);
+    TIME_MEASURE_FINISH(export_time);
+
+    LOG_PRINT_GREEN("Exported " << height - 1 << " blocks, " << txs_count << " transactions in " << print_mcsec_as_ms(export_time) << " ms"
+      << (stop_requested ? " (interrupted)" : ""), LOG_LEVEL_0);
+    return true;
+  }
+
+  //------------------------------------------------------------------
+  bool import_blockchain(currency::core& ccore, const std::string& path, uint64_t stop_height)
+  {
+    std::ifstream in(path, std::ios_base::binary | std::ios_base::in);
+    CHECK_AND_ASSERT_MES(in.is_open(), false, "failed to open " << path);
+
+    uint64_t signature = 0;
+    uint32_t version = 0;
+    in.read(reinterpret_cast<char*>(&signature), sizeof(signature));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    CHECK_AND_ASSERT_MES(in.good() && signature == BLOCKCHAIN_FILE_SIGNATURE, false, path << " is not a blockchain file");
+    CHECK_AND_ASSERT_MES(version == BLOCKCHAIN_FILE_FORMAT_VERSION, false, "unsupported blockchain file version " << version);
+
+    uint64_t start_height = ccore.get_current_blockchain_height();
+    LOG_PRINT_L0("Importing blocks from " << path << ", current height " << start_height << "...");
+    ccore.get_blockchain_storage().reset_performance_data();
+
+    uint64_t read_time = 0;
+    uint64_t handle_txs_time = 0;
+    uint64_t handle_block_time = 0;
+    uint64_t imported_blocks = 0;
+    uint64_t imported_txs = 0;
+    uint64_t height = 1;
+    currency::blobdata block_blob;
+    std::vector<currency::blobdata> tx_blobs;
+    TIME_MEASURE_START(import_time);
+    for (; !stop_requested && (!stop_height || height < stop_height); height++)
+    {
+      PROF_L1_START(read_entry_time);
+      if (!read_blob(in, block_blob))
+        break;
+      uint32_t txs_in_block = 0;
+      in.read(reinterpret_cast<char*>(&txs_in_block), sizeof(txs_in_block));
+      CHECK_AND_ASSERT_MES(in.good(), false, "unexpected end of file at block " << height);
+      tx_blobs.resize(txs_in_block);
+      for (auto& tx_blob : tx_blobs)
+      {
+        bool r = read_blob(in, tx_blob);
+        CHECK_AND_ASSERT_MES(r, false, "unexpected end of file at block " << height);
+      }
+      PROF_L1_FINISH(read_entry_time);
+      PROF_L1_DO(read_time += read_entry_time);
+
+      // already imported during previous run
+      if (height < start_height)
+        continue;
+
+      // same order as currency_protocol_handler: transactions go to the pool first
+      PROF_L1_START(txs_time);
+      for (const auto& tx_blob : tx_blobs)
+      {
+        currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        ccore.handle_incoming_tx(tx_blob, tvc, true);
+        CHECK_AND_ASSERT_MES(!tvc.m_verifivation_failed, false, "transaction verification failed in block " << height);
+      }
+      PROF_L1_FINISH(txs_time);
+      PROF_L1_DO(handle_txs_time += txs_time);
+
+      PROF_L1_START(block_time);
+      currency::block_verification_context bvc = AUTO_VAL_INIT(bvc);
+      ccore.handle_incoming_block(block_blob, bvc, false);
+      PROF_L1_FINISH(block_time);
+      PROF_L1_DO(handle_block_time += block_time);
+      CHECK_AND_ASSERT_MES(!bvc.m_verifivation_failed && bvc.m_added_to_main_chain, false, "block verification failed at height " << height);
+
+      ++imported_blocks;
+      imported_txs += tx_blobs.size();
+      if (!(imported_blocks % BLOCKCHAIN_TOOL_PROGRESS_INTERVAL))
+      {
+        TIME_MEASURE_FINISH(import_time);
+        LOG_PRINT_L0("Imported up to height " << height << ", " << print_blocks_per_second(imported_blocks, import_time) << " blocks/sec, peak RSS " << get_peak_rss() / (1024 * 1024) << " MB");
+      }
+    }
+    TIME_MEASURE_FINISH(import_time);
+
+    currency::blockchain_storage::performance_data pd = ccore.get_blockchain_storage().get_performance_data();
+    LOG_PRINT_GREEN("Imported " << imported_blocks << " blocks, " << imported_txs << " transactions in " << print_mcsec_as_ms(import_time) << " ms"
+      << (stop_requested ? " (interrupted)" : "") << ", height " << ccore.get_current_blockchain_height()
+      << ENDL << "  blocks/sec:                 " << print_blocks_per_second(imported_blocks, import_time)
+      << ENDL << "  peak RSS:                   " << get_peak_rss() / (1024 * 1024) << " MB"
+      << PROF_L1_STR(ENDL << "  Timings (ms):")
+      << PROF_L1_STR_MS(ENDL << "  file read:                  ", read_time)
+      << PROF_L1_STR_MS(ENDL << "  handle_incoming_tx:         ", handle_txs_time)
+      << PROF_L1_STR_MS(ENDL << "  handle_incoming_block:      ", handle_block_time)
+      << PROF_L1_STR_MS(ENDL << "    block processing:         ", pd.block_processing_time)
+      << PROF_L1_STR_MS(ENDL << "    difficulty:               ", pd.target_calculating_time)
+      << PROF_L1_STR_MS(ENDL << "    PoW:                      ", pd.longhash_calculating_time)
+      << PROF_L2_STR_MS(ENDL << "    inputs/ring signatures:   ", pd.tx_check_inputs_time)
+      << PROF_L2_STR_MS(ENDL << "    DB commit:                ", pd.db_commit_time), LOG_LEVEL_0);
+    return true;
+  }
+
+  //------------------------------------------------------------------
+  uint64_t get_folder_size(const std::string& path)
+  {
+    uint64_t sz = 0;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec))
+    {
+      if (boost::filesystem::is_regular_file(it->status()))
+        sz += boost::filesystem::file_size(it->path(), ec);
+    }
+    return sz;
+  }
+
+  bool compact_blockchain(currency::core& ccore, const std::string& data_dir, const std::string& path)
+  {
+    currency::blockchain_storage& bcs = ccore.get_blockchain_storage();
+    uint64_t pruned_height = 0, target_height = 0;
+    bcs.get_ring_signatures_pruning_progress(pruned_height, target_height);
+    if (target_height > pruned_height)
+    {
+      LOG_PRINT_L0("Pruning ring signatures in blocks " << pruned_height + 1 << "-" << target_height << "...");
+      TIME_MEASURE_START(prune_time);
+      while (target_height > pruned_height && !stop_requested)
+      {
+        bool r = bcs.prune_ring_signatures_if_need();
+        CHECK_AND_ASSERT_MES(r, false, "failed to prune ring signatures at height " << pruned_height);
+        uint64_t prev_pruned_height = pruned_height;
+        bcs.get_ring_signatures_pruning_progress(pruned_height, target_height);
+        CHECK_AND_ASSERT_MES(pruned_height > prev_pruned_height, false, "ring signatures pruning is disabled, check --prune-rs-blocks-per-step");
+      }
+      TIME_MEASURE_FINISH(prune_time);
+      LOG_PRINT_L0("Pruned up to height " << pruned_height << " in " << print_mcsec_as_ms(prune_time) << " ms");
+      CHECK_AND_ASSERT_MES(!stop_requested, false, "interrupted");
+    }
+
+    const std::string src_folder = data_dir + "/" CURRENCY_BLOCKCHAINDATA_FOLDERNAME;
+    const std::string dst_folder = path + "/" CURRENCY_BLOCKCHAINDATA_FOLDERNAME;
+    boost::system::error_code ec;
+    CHECK_AND_ASSERT_MES(!boost::filesystem::exists(dst_folder, ec) || boost::filesystem::is_empty(dst_folder, ec), false, dst_folder << " is not empty");
+
+    TIME_MEASURE_START(copy_time);
+    bool r = bcs.copy_compact(dst_folder);
+    CHECK_AND_ASSERT_MES(r, false, "failed to copy database to " << dst_folder);
+    TIME_MEASURE_FINISH(copy_time);
+
+    LOG_PRINT_GREEN("Database compacted in " << print_mcsec_as_ms(copy_time) << " ms: " << get_folder_size(src_folder) / (1024 * 1024) << " MB -> "
+      << get_folder_size(dst_folder) / (1024 * 1024) << " MB, replace " << src_folder << " with " << dst_folder << " while daemon is stopped", LOG_LEVEL_0);
+    return true;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  string_tools::set_module_name_and_folder(argv[0]);
+  log_space::get_set_log_detalisation_level(true, LOG_LEVEL_0);
+  log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL);
+
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, command_line::arg_data_dir, tools::get_default_data_dir());
+  command_line::add_arg(desc_options, command_line::arg_log_level);
+  command_line::add_arg(desc_options, arg_export_file);
+  command_line::add_arg(desc_options, arg_import_file);
+  command_line::add_arg(desc_options, arg_stop_height);
+  command_line::add_arg(desc_options, arg_import_no_checkpoints);
+  command_line::add_arg(desc_options, arg_compact_to);
+  currency::core::init_options(desc_options);
+  currency::miner::init_options(desc_options);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  bool do_export = command_line::has_arg(vm, arg_export_file);
+  bool do_import = command_line::has_arg(vm, arg_import_file);
+  bool do_compact = command_line::has_arg(vm, arg_compact_to);
+  if (command_line::get_arg(vm, command_line::arg_help) || int(do_export) + int(do_import) + int(do_compact) != 1)
+  {
+    std::cout << CURRENCY_NAME << " v" << PROJECT_VERSION_LONG << ENDL << ENDL;
+    std::cout << "One of --" << arg_export_file.name << ", --" << arg_import_file.name << " or --" << arg_compact_to.name << " should be specified." << ENDL << ENDL;
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  int log_level = command_line::get_arg(vm, command_line::arg_log_level);
+  if (log_level >= LOG_LEVEL_MIN && log_level <= LOG_LEVEL_MAX)
+    log_space::get_set_log_detalisation_level(true, log_level);
+
+  currency::core ccore(NULL);
+  LOG_PRINT_L0("Initializing core...");
+  r = ccore.init(vm);
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize core");
+
+  // without checkpoints ring signatures of every imported transaction are verified
+  if (!do_import || !command_line::get_arg(vm, arg_import_no_checkpoints))
+  {
+    currency::checkpoints checkpoints;
+    r = currency::create_checkpoints(checkpoints);
+    CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize checkpoints");
+    ccore.set_checkpoints(std::move(checkpoints));
+  }
+
+  tools::signal_handler::install([] {
+    stop_requested = true;
+  });
+
+  uint64_t stop_height = command_line::get_arg(vm, arg_stop_height);
+  if (do_export)
+    r = export_blockchain(ccore, command_line::get_arg(vm, arg_export_file), stop_height);
+  else if (do_import)
+    r = import_blockchain(ccore, command_line::get_arg(vm, arg_import_file), stop_height);
+  else
+    r = compact_blockchain(ccore, command_line::get_arg(vm, command_line::arg_data_dir), command_line::get_arg(vm, arg_compact_to));
+
+  LOG_PRINT_L0("Deinitializing core...");
+  ccore.deinit();
+  return r ? 0 : 1;
+  CATCH_ENTRY_L0("main", 1);
+}
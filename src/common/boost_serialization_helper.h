@@ -6,6 +6,9 @@
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
 
 
 #define CHECK_PROJECT_NAME()    std::string project_name = CURRENCY_NAME; ar & project_name;  if(project_name != CURRENCY_NAME) {throw std::runtime_error(std::string("wrong storage file: project name in file: ") + project_name + ", expected: " + CURRENCY_NAME );}
@@ -44,4 +47,20 @@ namespace tools
     return !data_file.fail();
     CATCH_ENTRY_L0("unserialize_obj_from_file", false);
   }
+
+  template<class t_object>
+  bool unserialize_obj_from_mapped_file(t_object& obj, const std::string& file_path)
+  {
+    TRY_ENTRY();
+    // reads straight from the page cache instead of copying the file through ifstream buffers
+    boost::interprocess::file_mapping mapping(file_path.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(mapping, boost::interprocess::read_only);
+    region.advise(boost::interprocess::mapped_region::advice_sequential);
+    boost::interprocess::ibufferstream data_stream(static_cast<const char*>(region.get_address()), region.get_size());
+    boost::archive::binary_iarchive a(static_cast<std::istream&>(data_stream));
+
+    a >> obj;
+    return !data_stream.fail();
+    CATCH_ENTRY_L0("unserialize_obj_from_mapped_file", false);
+  }
 }
@@ -15,6 +15,7 @@ namespace command_line
   const arg_descriptor<bool>        arg_os_version =   { "os-version", "" };
   const arg_descriptor<std::string> arg_log_file =     { "log-file", "", "" };
   const arg_descriptor<int>         arg_log_level =    { "log-level", "", LOG_LEVEL_0 };
+  const arg_descriptor<uint32_t>    arg_log_async_queue_size = { "log-async-queue-size", "Write log from a separate thread through a lock-free queue of this many messages, 0 - write synchronously", 0 };
   const arg_descriptor<bool>        arg_console =      { "no-console", "Disable daemon console commands" };
   const arg_descriptor<bool>        arg_show_details = { "currency-details", "Display currency details" };
 
@@ -178,6 +178,7 @@ namespace command_line
   extern const arg_descriptor<bool>        arg_os_version;
   extern const arg_descriptor<std::string> arg_log_file;
   extern const arg_descriptor<int>         arg_log_level;
+  extern const arg_descriptor<uint32_t>    arg_log_async_queue_size;
   extern const arg_descriptor<bool>        arg_console;
   extern const arg_descriptor<bool>        arg_show_details;
 }
@@ -51,6 +51,8 @@ namespace db
     virtual bool erase(const table_id tid, const char* key_data, size_t key_size) = 0;
 
     virtual bool visit_table(const table_id tid, i_db_visitor* visitor) = 0;
+    // visits items in key order starting from the first key not less than the given one, in read-only transaction
+    virtual bool visit_table_from(const table_id tid, const char* key_data, size_t key_size, i_db_visitor* visitor) = 0;
     
     virtual ~i_db_adapter()
     {};
@@ -441,6 +443,16 @@ namespace db
       m_dbb.get_adapter()->visit_table(m_tid, &visitor);
     }
 
+    // same as enumerate_items(), but starts from the first key not less than start_key (in db keys order)
+    template<class callback_t>
+    void enumerate_items_from(const key_t& start_key, callback_t callback) const 
+    {
+      size_t key_size = 0;
+      const char* key_data = tkey_to_pointer(start_key, key_size);
+      table_keys_and_values_visitor<callback_t, key_t, value_t, value_type_is_serializable> visitor(callback);
+      m_dbb.get_adapter()->visit_table_from(m_tid, key_data, key_size, &visitor);
+    }
+
     void set(const key_t& key, const value_t& value)
     {
       m_cached_size_is_valid = false;
@@ -10,6 +10,7 @@
 #include "boost/thread/recursive_mutex.hpp"
 #include "epee/include/misc_language.h"
 #include "epee/include/string_coding.h"
+#include "epee/include/metrics_registry.h"
 #include "command_line.h"
 
 // TODO: estimate correct size
@@ -25,9 +26,10 @@ namespace db
 
   struct stack_entry_t
   {
-    explicit stack_entry_t(MDB_txn* txn, bool ro_access) : txn(txn), ro_access(ro_access) {}
+    explicit stack_entry_t(MDB_txn* txn, bool ro_access) : txn(txn), ro_access(ro_access), started(std::chrono::steady_clock::now()) {}
     MDB_txn* txn;         // lmdb transaction handle
     bool     ro_access;   // if true: this db transaction is declared by user as Read-Only
+    std::chrono::steady_clock::time_point started; // for db_transaction_duration_us metrics
   };
 
   struct lmdb_adapter_impl
@@ -243,16 +245,31 @@ namespace db
 
     MDB_txn* txn = tx_stack.back().txn;
     read_only_access = tx_stack.back().ro_access; // set actual value for unlocker
+    std::chrono::steady_clock::time_point started = tx_stack.back().started;
 
     tx_stack.pop_back();
-    if (tx_stack.empty())
+    bool top_level = tx_stack.empty();
+    if (top_level)
       m_p_impl->m_transaction_stack.erase(it);
     // tx_stack could be invalid after this point 
           
     int r = 0;
+    std::chrono::steady_clock::time_point commit_started = std::chrono::steady_clock::now();
     r = mdb_txn_commit(txn);
     CHECK_DB_CALL_RESULT(r, false, "mdb_txn_commit failed");
 
+    // only top-level transactions are accounted, nested ones are parts of them
+    if (top_level && read_only_access)
+    {
+      METRICS_HISTOGRAM_OBSERVE("db_transaction_duration_us", "access=\"ro\"", std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count());
+    }
+    else if (top_level)
+    {
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      METRICS_HISTOGRAM_OBSERVE("db_transaction_duration_us", "access=\"rw\"", std::chrono::duration_cast<std::chrono::microseconds>(now - started).count());
+      METRICS_HISTOGRAM_OBSERVE("db_commit_duration_us", "", std::chrono::duration_cast<std::chrono::microseconds>(now - commit_started).count());
+    }
+
     return true;
   }
 
@@ -281,6 +298,7 @@ namespace db
     // tx_stack could be invalid after this point 
           
     mdb_txn_abort(txn);
+    METRICS_COUNTER_INC("db_transactions_aborted_total", "");
   }
   
   bool lmdb_adapter::get(const table_id tid, const char* key_data, size_t key_size, std::string& out_buffer)
@@ -373,6 +391,64 @@ namespace db
     return true;
   }
 
+  bool lmdb_adapter::visit_table_from(const table_id tid, const char* key_data, size_t key_size, i_db_visitor* visitor)
+  {
+    CHECK_AND_ASSERT_MES(visitor != nullptr, false, "visitor is null");
+    MDB_val key = AUTO_VAL_INIT(key);
+    MDB_val data = AUTO_VAL_INIT(data);
+    key.mv_data = const_cast<char*>(key_data);
+    key.mv_size = key_size;
+
+    // read-only snapshot does not block writers
+    bool local_transaction = false;
+    if (!m_p_impl->has_active_transaction())
+    {
+      local_transaction = true;
+      begin_transaction(true);
+    }
+    MDB_cursor* p_cursor = nullptr;
+    int r = mdb_cursor_open(m_p_impl->get_current_transaction(), static_cast<MDB_dbi>(tid), &p_cursor);
+    if (r != MDB_SUCCESS && local_transaction)
+      commit_transaction();
+    CHECK_DB_CALL_RESULT(r, false, "mdb_cursor_open failed");
+    CHECK_AND_ASSERT_MES(p_cursor != nullptr, false, "p_cursor == nullptr");
+
+    size_t count = 0;
+    // LMDB does not accept zero-length keys for MDB_SET_RANGE
+    for(MDB_cursor_op op = key_size ? MDB_SET_RANGE : MDB_FIRST; ; op = MDB_NEXT)
+    {
+      int res = mdb_cursor_get(p_cursor, &key, &data, op);
+      if (res == MDB_NOTFOUND)
+        break;
+      if (res != MDB_SUCCESS)
+      {
+        LOG_ERROR("mdb_cursor_get failed with error " << res);
+        break;
+      }
+      if (!visitor->on_visit_db_item(count, key.mv_data, key.mv_size, data.mv_data, data.mv_size))
+        break;
+      ++count;
+    }
+
+    mdb_cursor_close(p_cursor);
+    if (local_transaction)
+      commit_transaction();
+    return true;
+  }
+
+  bool lmdb_adapter::copy_compact(const std::string& path)
+  {
+    CHECK_AND_ASSERT_MES(m_p_impl->p_mdb_env != nullptr, false, "db env is null");
+    std::string path_utf8;
+    bool br = epee::string_encoding::convert_to_utf8(path, path_utf8);
+    CHECK_AND_ASSERT_MES(br, false, "convert_to_utf8 failed");
+
+    LOG_PRINT_L0("Copying lmdb database from " << m_db_folder << " to " << path << " with compaction...");
+    int r = mdb_env_copy2(m_p_impl->p_mdb_env, path_utf8.c_str(), MDB_CP_COMPACT);
+    CHECK_DB_CALL_RESULT(r, false, "mdb_env_copy2 failed, path = " << path);
+    return true;
+  }
+
 
 
 } // namespace db
@@ -31,6 +31,10 @@ namespace db
     virtual bool set(const table_id tid, const char* key_data, size_t key_size, const char* value_data, size_t value_size) override;
     virtual bool erase(const table_id tid, const char* key_data, size_t key_size) override;
     virtual bool visit_table(const table_id tid, i_db_visitor* visitor) override;
+    virtual bool visit_table_from(const table_id tid, const char* key_data, size_t key_size, i_db_visitor* visitor) override;
+
+    // consistent copy of the whole environment into given existing folder, free pages are omitted
+    bool copy_compact(const std::string& path);
 
   private:
     lmdb_adapter_impl* m_p_impl;
@@ -0,0 +1,221 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/filesystem.hpp>
+#if defined(WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "include_base_utils.h"
+using namespace epee;
+
+#include "journal_file.h"
+#include "crypto/hash.h"
+
+namespace tools
+{
+  namespace
+  {
+    const size_t journal_header_size = sizeof(uint64_t) * 2;
+    const size_t record_header_size = sizeof(uint32_t) * 2 + sizeof(uint8_t);
+
+    uint32_t get_record_checksum(uint8_t type, const char* payload, size_t payload_size)
+    {
+      std::string buff;
+      buff.reserve(payload_size + 1);
+      buff.push_back(static_cast<char>(type));
+      buff.append(payload, payload_size);
+      crypto::hash h = crypto::cn_fast_hash(buff.data(), buff.size());
+      uint32_t checksum = 0;
+      memcpy(&checksum, &h, sizeof(checksum));
+      return checksum;
+    }
+
+    void make_record(uint8_t type, const std::string& payload, std::string& buff)
+    {
+      uint32_t payload_size = static_cast<uint32_t>(payload.size());
+      uint32_t checksum = get_record_checksum(type, payload.data(), payload.size());
+      buff.append(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+      buff.append(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+      buff.append(reinterpret_cast<const char*>(&type), sizeof(type));
+      buff.append(payload);
+    }
+
+    bool flush_to_disk(FILE* f)
+    {
+      if (0 != fflush(f))
+        return false;
+#if defined(WIN32)
+      return 0 == _commit(_fileno(f));
+#else
+      return 0 == fsync(fileno(f));
+#endif
+    }
+  }
+  //----------------------------------------------------------------------------------------------------
+  journal_file::journal_file(uint64_t signature, uint32_t max_record_size, const std::string& name) :
+    m_signature(signature), m_max_record_size(max_record_size), m_name(name), m_file(nullptr), m_file_size(0), m_records_count(0)
+  {}
+  //----------------------------------------------------------------------------------------------------
+  journal_file::~journal_file()
+  {
+    close();
+  }
+  //----------------------------------------------------------------------------------------------------
+  void journal_file::close()
+  {
+    if (m_file)
+      fclose(m_file);
+    m_file = nullptr;
+    m_file_size = 0;
+    m_records_count = 0;
+    m_pending.clear();
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool journal_file::open_file(const std::string& path, const char* mode)
+  {
+    close();
+    m_path = path;
+    m_file = fopen(path.c_str(), mode);
+    CHECK_AND_ASSERT_MES(m_file, false, "failed to open " << m_name << " " << path);
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool journal_file::replay_and_open(const std::string& path, uint64_t tag, record_handler_t handler, uint64_t& records_replayed)
+  {
+    close();
+    records_replayed = 0;
+
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+      return rewrite(path, tag, std::vector<record>());
+
+    uint64_t header[2] = {};
+    if (1 != fread(header, sizeof(header), 1, f) || header[0] != m_signature || header[1] != tag)
+    {
+      //journal left by other snapshot or format version, or damaged one
+      LOG_PRINT_L0("Journal " << path << " has wrong signature or does not match " << tag << ", ignored");
+      fclose(f);
+      return rewrite(path, tag, std::vector<record>());
+    }
+
+    uint64_t valid_size = journal_header_size;
+    std::string payload;
+    while (true)
+    {
+      char rh[record_header_size];
+      if (1 != fread(rh, sizeof(rh), 1, f))
+        break;
+      uint32_t payload_size = 0;
+      uint32_t checksum = 0;
+      uint8_t type = 0;
+      memcpy(&payload_size, rh, sizeof(payload_size));
+      memcpy(&checksum, rh + sizeof(payload_size), sizeof(checksum));
+      memcpy(&type, rh + sizeof(payload_size) + sizeof(checksum), sizeof(type));
+      if (payload_size > m_max_record_size)
+        break;
+      payload.resize(payload_size);
+      if (payload_size && 1 != fread(&payload[0], payload_size, 1, f))
+        break;
+      if (checksum != get_record_checksum(type, payload.data(), payload.size()))
+        break;
+      if (!handler(type, payload))
+      {
+        LOG_ERROR(m_name << " record #" << records_replayed << " (type " << static_cast<uint32_t>(type) << ") failed to apply, the rest of journal is discarded");
+        break;
+      }
+      valid_size += record_header_size + payload_size;
+      ++records_replayed;
+    }
+    fclose(f);
+
+    boost::system::error_code ec;
+    uint64_t actual_size = boost::filesystem::file_size(path, ec);
+    if (!ec && actual_size != valid_size)
+    {
+      LOG_PRINT_L0("Journal " << path << " has " << actual_size - valid_size << " bytes of torn tail, truncated");
+      boost::filesystem::resize_file(path, valid_size, ec);
+      CHECK_AND_ASSERT_MES(!ec, false, "failed to truncate " << m_name << " " << path << ": " << ec.message());
+    }
+
+    if (!open_file(path, "r+b"))
+      return false;
+    fseek(m_file, 0, SEEK_END);
+    m_file_size = valid_size;
+    m_records_count = records_replayed;
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool journal_file::rewrite(const std::string& path, uint64_t tag, const std::vector<record>& records)
+  {
+    std::string buff;
+    uint64_t header[2] = { m_signature, tag };
+    buff.append(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const auto& r : records)
+      make_record(r.first, r.second, buff);
+
+    //new journal is complete on disk before it replaces the old one
+    std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    CHECK_AND_ASSERT_MES(f, false, "failed to create " << m_name << " " << tmp_path);
+    bool r = 1 == fwrite(buff.data(), buff.size(), 1, f) && flush_to_disk(f);
+    fclose(f);
+    CHECK_AND_ASSERT_MES(r, false, "failed to write " << buff.size() << " bytes to " << m_name << " " << tmp_path);
+
+    close();
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmp_path, path, ec);
+    CHECK_AND_ASSERT_MES(!ec, false, "failed to rename " << tmp_path << " to " << path << ": " << ec.message());
+
+    if (!open_file(path, "r+b"))
+      return false;
+    fseek(m_file, 0, SEEK_END);
+    m_file_size = buff.size();
+    m_records_count = records.size();
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  void journal_file::add_record(uint8_t type, const std::string& payload)
+  {
+    make_record(type, payload, m_pending);
+    ++m_records_count;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool journal_file::commit(bool sync)
+  {
+    CHECK_AND_ASSERT_MES(is_open(), false, m_name << " is not open");
+    if (m_pending.empty())
+      return true;
+
+    bool r = 1 == fwrite(m_pending.data(), m_pending.size(), 1, m_file) && (sync ? flush_to_disk(m_file) : 0 == fflush(m_file));
+    if (!r)
+    {
+      //the file may end with a partially written record now, stop appending to it
+      LOG_ERROR("failed to append " << m_pending.size() << " bytes to " << m_name << " " << m_path);
+      close();
+      return false;
+    }
+    m_file_size += m_pending.size();
+    m_pending.clear();
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool journal_file::sync()
+  {
+    if (!is_open())
+      return false;
+    return flush_to_disk(m_file);
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool journal_file::sync_file(const std::string& path)
+  {
+    FILE* f = fopen(path.c_str(), "r+b");
+    CHECK_AND_ASSERT_MES(f, false, "failed to open " << path << " for syncing");
+    bool r = flush_to_disk(f);
+    fclose(f);
+    return r;
+  }
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+
+namespace tools
+{
+  /************************************************************************/
+  /* Append-only file of typed records, base of wallet and pool journals. */
+  /*                                                                      */
+  /* File layout: [u64 signature][u64 tag] followed by records            */
+  /* [u32 payload size][u32 checksum][u8 type][payload], payload being a  */
+  /* headerless boost binary archive. The tag is owner defined (snapshot  */
+  /* generation, format version), file with other signature or tag is     */
+  /* started over. Records are buffered in memory until commit(), a torn  */
+  /* tail left by a crash is detected and cut off on replay. rewrite()    */
+  /* replaces the file atomically with the given set of records.          */
+  /************************************************************************/
+  class journal_file
+  {
+  public:
+    typedef std::function<bool(uint8_t type, const std::string& payload)> record_handler_t;
+    typedef std::pair<uint8_t, std::string> record;
+
+    //name is used in log messages only
+    journal_file(uint64_t signature, uint32_t max_record_size, const std::string& name);
+    ~journal_file();
+
+    //replays records of existing journal (missing or alien file is started over) and keeps it open for appending
+    bool replay_and_open(const std::string& path, uint64_t tag, record_handler_t handler, uint64_t& records_replayed);
+    bool rewrite(const std::string& path, uint64_t tag, const std::vector<record>& records);
+    void add_record(uint8_t type, const std::string& payload);
+    //writes pending records, with sync they survive a power loss, without - only a crash of the process
+    bool commit(bool sync);
+    bool sync();
+    void close();
+
+    bool is_open() const { return m_file != nullptr; }
+    uint64_t size() const { return m_file_size + m_pending.size(); }
+    const std::string& get_path() const { return m_path; }
+    //records added since journal was opened or rewritten
+    uint64_t get_records_count() const { return m_records_count; }
+
+    template<class... t_args>
+    static std::string pack(const t_args&... args)
+    {
+      std::ostringstream ss;
+      {
+        boost::archive::binary_oarchive a(ss, boost::archive::no_header);
+        pack_args(a, args...);
+      }
+      return ss.str();
+    }
+
+    template<class... t_args>
+    static void unpack(const std::string& payload, t_args&... args)
+    {
+      std::istringstream ss(payload);
+      boost::archive::binary_iarchive a(ss, boost::archive::no_header);
+      unpack_args(a, args...);
+    }
+
+    static bool sync_file(const std::string& path);
+
+  private:
+    journal_file(const journal_file&) = delete;
+    journal_file& operator=(const journal_file&) = delete;
+
+    bool open_file(const std::string& path, const char* mode);
+
+    template<class t_archive>
+    static void pack_args(t_archive& a) {}
+    template<class t_archive, class t_arg, class... t_args>
+    static void pack_args(t_archive& a, const t_arg& arg, const t_args&... args)
+    {
+      a << arg;
+      pack_args(a, args...);
+    }
+
+    template<class t_archive>
+    static void unpack_args(t_archive& a) {}
+    template<class t_archive, class t_arg, class... t_args>
+    static void unpack_args(t_archive& a, t_arg& arg, t_args&... args)
+    {
+      a >> arg;
+      unpack_args(a, args...);
+    }
+
+    const uint64_t m_signature;
+    const uint32_t m_max_record_size;
+    const std::string m_name;
+    std::string m_path;
+    FILE* m_file;
+    uint64_t m_file_size;
+    uint64_t m_records_count;
+    std::string m_pending;
+  };
+}
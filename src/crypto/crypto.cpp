@@ -202,6 +202,28 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::derive_public_keys(const key_derivation &derivation, size_t first_output_index,
+    const public_key &base, public_key *derived_keys, size_t count) {
+    ec_scalar scalar;
+    ge_p3 point1;
+    ge_p3 point2;
+    ge_cached point3;
+    ge_p1p1 point4;
+    ge_p2 point5;
+    if (ge_frombytes_vartime(&point1, &base) != 0) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      derivation_to_scalar(derivation, first_output_index + i, scalar);
+      ge_scalarmult_base(&point2, &scalar);
+      ge_p3_to_cached(&point3, &point2);
+      ge_add(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&point5, &point4);
+      ge_tobytes(&derived_keys[i], &point5);
+    }
+    return true;
+  }
+
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     ec_scalar scalar;
@@ -81,6 +81,8 @@ namespace crypto {
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool derive_public_keys(const key_derivation &, std::size_t, const public_key &, public_key *, std::size_t);
+    friend bool derive_public_keys(const key_derivation &, std::size_t, const public_key &, public_key *, std::size_t);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
@@ -161,6 +163,12 @@ namespace crypto {
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Same as derive_public_key for outputs [first_output_index, first_output_index + count), base key is unpacked once.
+   */
+  inline bool derive_public_keys(const key_derivation &derivation, std::size_t first_output_index,
+    const public_key &base, public_key *derived_keys, std::size_t count) {
+    return crypto_ops::derive_public_keys(derivation, first_output_index, base, derived_keys, count);
+  }
   inline void derive_secret_key(const key_derivation &derivation, std::size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     crypto_ops::derive_secret_key(derivation, output_index, base, derived_key);
@@ -79,11 +79,16 @@
 #endif
 
 #define COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT           1000
+#define COMMAND_RPC_GET_ALIASES_MAX_COUNT               1000
+#define COMMAND_RPC_GET_ALIAS_CHANGES_MAX_BLOCKS        1000
+#define COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_MAX_COUNT   1000
+#define COMMAND_RPC_SCANNER_GET_OUTPUTS_MAX_COUNT       1000
 
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                  1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                   5000
 
 #define P2P_DEFAULT_CONNECTIONS_COUNT                   8
+#define P2P_DEFAULT_THREADS_COUNT                       10
 #define P2P_DEFAULT_HANDSHAKE_INTERVAL                  60           //secondes
 #define P2P_DEFAULT_PACKET_MAX_SIZE                     50000000     //50000000 bytes maximum packet size
 #define P2P_DEFAULT_PEERS_IN_HANDSHAKE                  250
@@ -132,10 +137,12 @@
 #endif
 
 #define CURRENCY_POOLDATA_FILENAME                      "poolstate.bin"
+#define CURRENCY_POOLJOURNAL_FILENAME                   "poolstate.journal"
 //#define CURRENCY_BLOCKCHAINDATA_FILENAME                "blockchain.bin"
 //#define CURRENCY_BLOCKCHAINDATA_TEMP_FILENAME           "blockchain.bin.tmp"
 #define CURRENCY_BLOCKCHAINDATA_FOLDERNAME              "blockchain"
-#define CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE        "scratchpad.cache"
+#define CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE        "scratchpad.cache" //not used anymore, removed on start
+#define CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_MAP          "scratchpad.map"
 #define P2P_NET_DATA_FILENAME                           "p2pstate.bin"
 #define MINER_CONFIG_FILENAME                           "miner_conf.json"
 #define GUI_CONFIG_FILENAME                             "gui_conf.json"
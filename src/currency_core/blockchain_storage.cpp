@@ -42,6 +42,8 @@ using namespace currency;
 #define BLOCKCHAIN_CONTAINER_ADDR_TO_ALIAS    "addr_to_alias"
 #define BLOCKCHAIN_CONTAINER_SCRATCHPAD       "scratchpad"
 #define BLOCKCHAIN_CONTAINER_BLOCKS_INDEX     "blocks_index"
+#define BLOCKCHAIN_CONTAINER_BLOCK_HEADERS    "block_headers"
+#define BLOCKCHAIN_CONTAINER_BLOCK_UNDO       "block_undo"
 
 #define BLOCKCHAIN_OPTIONS_ID_CURRENT_BLOCK_CUMUL_SZ_LIMIT          0
 #define BLOCKCHAIN_OPTIONS_ID_CURRENT_PRUNED_RS_HEIGHT              1
@@ -50,12 +52,26 @@ using namespace currency;
 
 #define BLOCKCHAIN_STORAGE_MAJOR_COMPABILITY_VERSION                1
 
+#define BLOCKCHAIN_PRUNE_RS_DEFAULT_BLOCKS_PER_STEP                 100
+#define BLOCKCHAIN_VERIFIED_INPUTS_CACHE_DEFAULT_SIZE               200000
+#define BLOCKCHAIN_HEADERS_INDEX_REBUILD_BLOCKS_PER_TX              1000
+#define BLOCKCHAIN_UNDO_RECORDS_DEPTH                               CURRENCY_ALT_BLOCK_LIVETIME_COUNT //deeper switch is not expected, older blocks are popped the old way
+
+#define CHAIN_STATS_HASHRATE_SHORT_WINDOW                           50
+#define CHAIN_STATS_HASHRATE_LONG_WINDOW                            350
+#define CHAIN_STATS_WINDOW_SIZE                                     (DIFFICULTY_BLOCKS_COUNT > CURRENCY_BLOCK_PER_DAY ? DIFFICULTY_BLOCKS_COUNT : CURRENCY_BLOCK_PER_DAY)
+static_assert(CHAIN_STATS_WINDOW_SIZE >= CHAIN_STATS_HASHRATE_LONG_WINDOW, "chain stats window is too small for hashrate calculation");
+
 
 DISABLE_VS_WARNINGS(4267)
 
   namespace
   {
     const command_line::arg_descriptor<std::string>   arg_macos_debuger_dummy_option =     {"-NSDocumentRevisionsDebugMode", "XCode weird paramter", "", true};
+    const command_line::arg_descriptor<uint64_t>      arg_prune_rs_blocks_per_step =       {"prune-rs-blocks-per-step", "Blocks pruned from ring signatures per idle cycle in background, 0 - disable pruning", BLOCKCHAIN_PRUNE_RS_DEFAULT_BLOCKS_PER_STEP};
+    const command_line::arg_descriptor<uint64_t>      arg_verified_inputs_cache_size =     {"verified-inputs-cache-size", "Number of inputs with checked ring signatures remembered to skip checking them again, 0 - disable", BLOCKCHAIN_VERIFIED_INPUTS_CACHE_DEFAULT_SIZE};
+    const command_line::arg_descriptor<std::string>   arg_scratchpad_file =                {"scratchpad-file", "Memory-mapped scratchpad file, place it on hugetlbfs or tmpfs mount to get huge pages (default is " CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_MAP " in data folder)", ""};
+    const command_line::arg_descriptor<bool>          arg_scratchpad_huge_pages =          {"scratchpad-huge-pages", "Ask OS to back memory-mapped scratchpad with transparent huge pages"};
   }
   
 
@@ -65,12 +81,14 @@ blockchain_storage::blockchain_storage(tx_memory_pool& tx_pool) : m_lmdb_adapter
                                                                  m_db(m_lmdb_adapter),
                                                                  m_db_blocks(m_db),
                                                                  m_db_blocks_index(m_db),
+                                                                 m_db_block_headers(m_db),
                                                                  m_db_transactions(m_db),
                                                                  m_db_spent_keys(m_db),
                                                                  m_db_outputs(m_db),
                                                                  m_db_solo_options(m_db),
                                                                  m_db_aliases(m_db),
                                                                  m_db_addr_to_alias(m_db), 
+                                                                 m_db_block_undo(m_db),
                                                                  m_db_scratchpad_internal(m_db),
                                                                  m_scratchpad_wr(m_db_scratchpad_internal),
                                                                  m_db_current_block_cumul_sz_limit(BLOCKCHAIN_OPTIONS_ID_CURRENT_BLOCK_CUMUL_SZ_LIMIT, m_db_solo_options),
@@ -82,12 +100,28 @@ blockchain_storage::blockchain_storage(tx_memory_pool& tx_pool) : m_lmdb_adapter
                                                                  m_donations_account(AUTO_VAL_INIT(m_donations_account)), 
                                                                  m_royalty_account(AUTO_VAL_INIT(m_royalty_account)),
                                                                  m_is_blockchain_storing(false), 
+                                                                 m_performance_data(AUTO_VAL_INIT(m_performance_data)),
+                                                                 m_prune_rs_blocks_per_step(BLOCKCHAIN_PRUNE_RS_DEFAULT_BLOCKS_PER_STEP),
+                                                                 m_verified_inputs_cache(BLOCKCHAIN_VERIFIED_INPUTS_CACHE_DEFAULT_SIZE),
+                                                                 m_chain_stats(AUTO_VAL_INIT(m_chain_stats)),
                                                                  m_locker_file(0)
 {
   bool r = get_donation_accounts(m_donations_account, m_royalty_account);
   CHECK_AND_ASSERT_THROW_MES(r, "failed to load donation accounts");
 }
 //------------------------------------------------------------------
+blockchain_storage::performance_data blockchain_storage::get_performance_data() const
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_performance_data;
+}
+//------------------------------------------------------------------
+void blockchain_storage::reset_performance_data()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_performance_data = AUTO_VAL_INIT(m_performance_data);
+}
+//------------------------------------------------------------------
 bool blockchain_storage::have_tx(const crypto::hash &id)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -132,6 +166,10 @@ uint64_t blockchain_storage::get_current_blockchain_height()
 void blockchain_storage::init_options(boost::program_options::options_description& desc)
 {
   command_line::add_arg(desc, arg_macos_debuger_dummy_option); 
+  command_line::add_arg(desc, arg_prune_rs_blocks_per_step);
+  command_line::add_arg(desc, arg_verified_inputs_cache_size);
+  command_line::add_arg(desc, arg_scratchpad_file);
+  command_line::add_arg(desc, arg_scratchpad_huge_pages);
   db::lmdb_adapter::init_options(desc);
 
 }
@@ -143,6 +181,8 @@ bool blockchain_storage::init(const boost::program_options::variables_map& vm, c
 
   bool res = m_lmdb_adapter->init(vm);
   CHECK_AND_ASSERT_MES(res, false, "Unable to init lmdb adapter");
+  m_prune_rs_blocks_per_step = command_line::get_arg(vm, arg_prune_rs_blocks_per_step);
+  m_verified_inputs_cache.set_max_size(command_line::get_arg(vm, arg_verified_inputs_cache_size));
 
   m_config_folder = config_folder;
   if (!check_instance(m_config_folder))
@@ -158,6 +198,8 @@ bool blockchain_storage::init(const boost::program_options::variables_map& vm, c
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_blocks_index.init(BLOCKCHAIN_CONTAINER_BLOCKS_INDEX);
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
+  res = m_db_block_headers.init(BLOCKCHAIN_CONTAINER_BLOCK_HEADERS);
+  CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_transactions.init(BLOCKCHAIN_CONTAINER_TRANSACTIONS);
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_spent_keys.init(BLOCKCHAIN_CONTAINER_SPENT_KEYS);
@@ -172,8 +214,13 @@ bool blockchain_storage::init(const boost::program_options::variables_map& vm, c
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_scratchpad_internal.init(BLOCKCHAIN_CONTAINER_SCRATCHPAD);
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
+  res = m_db_block_undo.init(BLOCKCHAIN_CONTAINER_BLOCK_UNDO);
+  CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
 
-  res = m_scratchpad_wr.init(config_folder);
+  std::string scratchpad_file = command_line::get_arg(vm, arg_scratchpad_file);
+  if (scratchpad_file.empty())
+    scratchpad_file = config_folder + "/" + CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_MAP;
+  res = m_scratchpad_wr.init(config_folder, scratchpad_file, command_line::get_arg(vm, arg_scratchpad_huge_pages));
   CHECK_AND_ASSERT_MES(res, false, "Unable to init scratchpad wrapper");
 
   bool need_reinit = false;
@@ -192,7 +239,14 @@ bool blockchain_storage::init(const boost::program_options::variables_map& vm, c
     CHECK_AND_ASSERT_MES(!bvc.m_verifivation_failed, false, "Failed to add genesis block to blockchain");
     LOG_PRINT_MAGENTA("Storage initialized with genesis", LOG_LEVEL_0);
   }
+  else if (m_db_block_headers.size() != m_db_blocks.size())
+  {
+    //storage created by previous version, or headers index got out of sync
+    res = rebuild_block_headers_index();
+    CHECK_AND_ASSERT_MES(res, false, "Failed to rebuild block headers index");
+  }
   initialize_db_solo_options_values();
+  update_chain_stats();
 
   //print information message
   uint64_t timestamp_diff = time(nullptr) - m_db_blocks.back()->bl.timestamp;
@@ -231,53 +285,59 @@ bool blockchain_storage::pop_block_from_blockchain()
   auto vptr = m_db_blocks[h];
   CHECK_AND_ASSERT_MES(vptr.get(), false, "pop_block_from_blockchain: can't pop from blockchain");
   block_extended_info bei = *vptr;
-  
-  bool r = m_scratchpad_wr.pop_block_scratchpad_data(bei.bl);
-  CHECK_AND_ASSERT_MES(r, false, "Failed to pop_block_scratchpad_data for block " << get_block_hash(bei.bl) << " on height " << h);
+  crypto::hash id = get_block_hash(bei.bl);
+
+  bool r = false;
+  std::map<uint64_t, crypto::hash> scratchpad_patch;
+  if (m_main_line_patches.size())
+  {
+    r = get_main_block_scratchpad_patch(h, scratchpad_patch);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to get_main_block_scratchpad_patch for block " << id << " on height " << h);
+  }
+
+  //record is missing for blocks connected by previous versions or deeper than BLOCKCHAIN_UNDO_RECORDS_DEPTH
+  auto undo_ptr = m_db_block_undo.get(h);
+  if (undo_ptr && undo_ptr->id == id)
+  {
+    r = undo_block_from_blockchain(bei.bl, *undo_ptr);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to undo_block_from_blockchain for block " << id << " on height " << h);
+  }
+  else
+  {
+    r = m_scratchpad_wr.pop_block_scratchpad_data(bei.bl);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to pop_block_scratchpad_data for block " << id << " on height " << h);
 
-  r = purge_block_data_from_blockchain(bei.bl, bei.bl.tx_hashes.size());
-  CHECK_AND_ASSERT_MES(r, false, "Failed to purge_block_data_from_blockchain for block " << get_block_hash(bei.bl) << " on height " << h);
+    r = purge_block_data_from_blockchain(bei.bl, bei.bl.tx_hashes.size());
+    CHECK_AND_ASSERT_MES(r, false, "Failed to purge_block_data_from_blockchain for block " << id << " on height " << h);
+  }
+  if (undo_ptr)
+    m_db_block_undo.erase(h);
 
   //remove from index
-  r = m_db_blocks_index.erase_validate(get_block_hash(bei.bl));
+  r = m_db_blocks_index.erase_validate(id);
   CHECK_AND_ASSERT_MES(r, false, "pop_block_from_blockchain: block id not found in m_blocks_index while trying to delete it");
 
   //pop block from core
+  m_db_block_headers.pop_back();
   m_db_blocks.pop_back();
+  on_main_line_block_patch(h, scratchpad_patch, false);
   m_tx_pool.on_blockchain_dec(m_db_blocks.size() - 1, get_top_block_id());
   return true;
 }
 //------------------------------------------------------------------
 bool blockchain_storage::set_checkpoints(checkpoints&& chk_pts) 
 {
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
   m_checkpoints = chk_pts;
-  try
-  {
-    m_db.begin_transaction();
-    prune_ring_signatures_if_need();
-    m_db.commit_transaction();
-    if (!m_checkpoints.is_in_checkpoint_zone(get_current_blockchain_height()))
-    {
-      m_is_in_checkpoint_zone = false;
-    }
-    else
-    {
-      m_is_in_checkpoint_zone = true;
-    }
-    return true;
-  }
-  catch (const std::exception& ex)
-  {
-    m_db.abort_transaction();
-    LOG_ERROR("UNKNOWN EXCEPTION WHILE ADDINIG NEW BLOCK: " << ex.what());
-    return false;
-  }
-  catch (...)
-  {
-    m_db.abort_transaction();
-    LOG_ERROR("UNKNOWN EXCEPTION WHILE ADDINIG NEW BLOCK.");
-    return false;
-  }
+  m_is_in_checkpoint_zone = m_checkpoints.is_in_checkpoint_zone(get_current_blockchain_height());
+  update_chain_stats();
+
+  // pruning itself is done in background by prune_ring_signatures_if_need(), see core::on_idle()
+  uint64_t pruned_height = 0, target_height = 0;
+  get_ring_signatures_pruning_progress(pruned_height, target_height);
+  if (target_height > pruned_height)
+    LOG_PRINT_CYAN("Ring signatures pruning scheduled: " << target_height - pruned_height << " blocks up to height " << target_height << (m_prune_rs_blocks_per_step ? "" : " (disabled by --prune-rs-blocks-per-step=0)"), LOG_LEVEL_0);
+  return true;
 }
 //------------------------------------------------------------------
 bool blockchain_storage::prune_ring_signatures(uint64_t height, uint64_t& transactions_pruned, uint64_t& signatures_pruned)
@@ -323,26 +383,73 @@ bool blockchain_storage::check_instance(const std::string& path)
   }
 }
 
+//------------------------------------------------------------------
+void blockchain_storage::get_ring_signatures_pruning_progress(uint64_t& pruned_height, uint64_t& target_height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  pruned_height = m_db_current_pruned_rs_height;
+  target_height = m_checkpoints.get_top_checkpoint_height();
+  // blocks above current top are stripped on arrival while in checkpoint zone, see handle_block_to_main_chain()
+  if (m_db_blocks.size() && target_height > m_db_blocks.size() - 1)
+    target_height = m_db_blocks.size() - 1;
+  if (target_height < pruned_height)
+    target_height = pruned_height;
+}
 //------------------------------------------------------------------
 bool blockchain_storage::prune_ring_signatures_if_need()
 {
+  if (!m_prune_rs_blocks_per_step)
+    return true;
+
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  uint64_t pruned_height = 0, target_height = 0;
+  get_ring_signatures_pruning_progress(pruned_height, target_height);
+  if (target_height <= pruned_height)
+    return true;
 
-  if (m_db_blocks.size() && m_checkpoints.get_top_checkpoint_height() && m_checkpoints.get_top_checkpoint_height() > m_db_current_pruned_rs_height)
+  // small write transaction per call, so block handling never waits for the whole range
+  uint64_t last_height = std::min(target_height, pruned_height + m_prune_rs_blocks_per_step);
+  uint64_t tx_count = 0, sig_count = 0;
+  TIME_MEASURE_START(prune_time);
+  try
   {
-    LOG_PRINT_CYAN("Starting pruning ring signatues and attachments...", LOG_LEVEL_0);
-    uint64_t tx_count = 0, sig_count = 0, attach_count = 0;
-    for (uint64_t height = m_db_current_pruned_rs_height; height < m_db_blocks.size() && height <= m_checkpoints.get_top_checkpoint_height(); height++)
+    m_db.begin_transaction();
+    for (uint64_t height = pruned_height + 1; height <= last_height; height++)
     {
-      bool res = prune_ring_signatures(height, tx_count, sig_count);
-      CHECK_AND_ASSERT_MES(res, false, "failed to prune_ring_signatures_and_attachments for height = " << height);
+      if (!prune_ring_signatures(height, tx_count, sig_count))
+      {
+        m_db.abort_transaction();
+        LOG_ERROR("failed to prune_ring_signatures for height = " << height);
+        return false;
+      }
     }
-    m_db_current_pruned_rs_height = m_checkpoints.get_top_checkpoint_height();
-    LOG_PRINT_CYAN("Transaction pruning finished: " << sig_count << " signatures and " << attach_count << " attachments released in " << tx_count << " transactions.", LOG_LEVEL_0);
+    m_db_current_pruned_rs_height = last_height;
+    m_db.commit_transaction();
+    CRITICAL_REGION_LOCAL1(m_chain_stats_lock);
+    m_chain_stats.pruned_rs_height = last_height;
+  }
+  catch (const std::exception& ex)
+  {
+    m_db.abort_transaction();
+    LOG_ERROR("EXCEPTION WHILE PRUNING RING SIGNATURES: " << ex.what());
+    return false;
   }
+  TIME_MEASURE_FINISH(prune_time);
+
+  LOG_PRINT_L1("Pruned " << sig_count << " ring signatures in " << tx_count << " transactions, blocks " << pruned_height + 1 << "-" << last_height
+    << " in " << print_mcsec_as_ms(prune_time) << " ms");
+  if (last_height == target_height)
+    LOG_PRINT_CYAN("Ring signatures pruning finished at height " << last_height, LOG_LEVEL_0);
   return true;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::copy_compact(const std::string& path)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  tools::create_directories_if_necessary(path);
+  return m_lmdb_adapter->copy_compact(path);
+}
+//------------------------------------------------------------------
 bool blockchain_storage::clear()
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -350,14 +457,19 @@ bool blockchain_storage::clear()
 
   m_db_blocks.clear();
   m_db_blocks_index.clear();
+  m_db_block_headers.clear();
   m_db_transactions.clear();
   m_db_spent_keys.clear();
   m_db_solo_options.clear();
   initialize_db_solo_options_values();
   m_db_outputs.clear();
   m_invalid_blocks.clear(); 
+  m_alt_scratchpad_states.clear();
+  m_main_line_patches.clear();
+  m_verified_inputs_cache.clear();
   m_db_aliases.clear();
   m_db_addr_to_alias.clear();
+  m_db_block_undo.clear();
   m_scratchpad_wr.clear();
   m_db.commit_transaction();
   return true;
@@ -380,10 +492,19 @@ bool blockchain_storage::reset_and_set_genesis_block(const block& b)
 bool blockchain_storage::copy_scratchpad(std::vector<crypto::hash>& scr)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  scr = m_scratchpad_wr.get_scratchpad();
+  scr.assign(m_scratchpad_wr.get_scratchpad().begin(), m_scratchpad_wr.get_scratchpad().end());
   return true;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::attach_scratchpad(mapped_scratchpad& scr)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  const mapped_scratchpad& own_scr = m_scratchpad_wr.get_scratchpad();
+  if (scr.is_open() && scr.get_path() == own_scr.get_path())
+    return scr.refresh();
+  return scr.open(own_scr.get_path(), true, own_scr.is_huge_pages());
+}
+//------------------------------------------------------------------
 // bool blockchain_storage::set_scratchpad(const std::vector<crypto::hash>& scr)
 // {
 //   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -499,6 +620,58 @@ bool blockchain_storage::purge_block_data_from_blockchain(const block& bl, size_
   return res;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::undo_block_from_blockchain(const block& b, const block_undo_entry& undo)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  std::map<uint64_t, crypto::hash> patch;
+  BOOST_FOREACH(const auto& p, undo.scratchpad_patch)
+    patch[p.first] = p.second;
+  bool r = m_scratchpad_wr.pop_block_scratchpad_data(patch, undo.scratchpad_addendum_size);
+  CHECK_AND_ASSERT_MES(r, false, "Failed to pop scratchpad data");
+
+  //flags have to be reset while spent transactions are still in place, they could be in this block
+  BOOST_FOREACH(const auto& so, undo.spent_outs)
+  {
+    r = update_spent_tx_flags_for_input(so.first, so.second, false);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to update_spent_tx_flags_for_input, amount " << so.first << ", global index " << so.second);
+  }
+  BOOST_FOREACH(const auto& ki, undo.key_images)
+  {
+    r = m_db_spent_keys.erase_validate(ki);
+    CHECK_AND_ASSERT_MES(r, false, "key image " << ki << " not found in spent keys");
+  }
+  BOOST_REVERSE_FOREACH(const auto& o, undo.outputs)
+  {
+    CHECK_AND_ASSERT_MES(m_db_outputs.get_item_size(o.first) >= o.second, false, "transactions outs global index: not enough outputs for amount: " << o.first);
+    for (uint64_t i = 0; i != o.second; i++)
+      m_db_outputs.pop_back_item(o.first);
+  }
+  if (undo.alias.size())
+  {
+    alias_info ai = AUTO_VAL_INIT(ai);
+    ai.m_alias = undo.alias;
+    r = pop_alias_info(ai);
+    CHECK_AND_ASSERT_MES(r, false, "failed to pop_alias_info");
+  }
+
+  r = m_db_transactions.erase_validate(get_transaction_hash(b.miner_tx));
+  CHECK_AND_ASSERT_MES(r, false, "coinbase of block " << undo.id << " not found in transactions");
+  BOOST_REVERSE_FOREACH(const crypto::hash& tx_id, b.tx_hashes)
+  {
+    auto tx_ptr = m_db_transactions.find(tx_id);
+    CHECK_AND_ASSERT_MES(tx_ptr, false, "transaction " << tx_id << " of block " << undo.id << " not found in transactions");
+    currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+    r = m_tx_pool.add_tx(tx_ptr->tx, tx_id, tvc, true);
+    CHECK_AND_ASSERT_MES(r, false, "failed to add transaction " << tx_id << " to transaction pool");
+    m_db_transactions.erase(tx_id);
+  }
+
+  LOG_PRINT_L1("Block " << undo.id << " data removed from blockchain by undo record: " << b.tx_hashes.size() + 1 << " transactions, "
+    << undo.key_images.size() << " key images, " << undo.outputs.size() << " outputs ranges");
+  return true;
+}
+//------------------------------------------------------------------
 crypto::hash blockchain_storage::get_top_block_id(uint64_t& height)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -658,7 +831,7 @@ bool blockchain_storage::rollback_blockchain_switching(std::list<block>& origina
   BOOST_FOREACH(auto& bl, original_chain)
   {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
-    bool r = handle_block_to_main_chain(bl, bvc);
+    bool r = handle_block_to_main_chain(bl, get_block_hash(bl), bvc, true);
     CHECK_AND_ASSERT_MES(r && bvc.m_added_to_main_chain, false, "PANIC!!! failed to add (again) block while chain switching during the rollback!");
   }
 
@@ -675,6 +848,9 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
   size_t split_height = alt_chain.front()->second.height;
   CHECK_AND_ASSERT_MES(m_db_blocks.size() > split_height, false, "switch_to_alternative_blockchain: blockchain size is lower than split height");
 
+  //alternative chains may get other connection points, their scratchpad states are rebuilt on demand
+  m_alt_scratchpad_states.clear();
+
   //disconnecting old chain
   std::list<block> disconnected_chain;
   for (size_t i = m_db_blocks.size() - 1; i >= split_height; i--)
@@ -738,6 +914,20 @@ wide_difficulty_type blockchain_storage::get_difficulty_for_next_block()
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   std::vector<uint64_t> timestamps;
   std::vector<wide_difficulty_type> commulative_difficulties;
+  // chain stats window covers whole difficulty window and is valid as long as its top is current top block
+  if (m_chain_stats_window.size() && m_chain_stats_window.back().height + 1 == m_db_blocks.size() && m_chain_stats_window.back().id == get_top_block_id() &&
+    m_chain_stats_window.front().height <= std::max<uint64_t>(1, m_db_blocks.size() - std::min<uint64_t>(m_db_blocks.size(), DIFFICULTY_BLOCKS_COUNT)))
+  {
+    for (const auto& e : m_chain_stats_window)
+    {
+      if (e.height + DIFFICULTY_BLOCKS_COUNT < m_db_blocks.size())
+        continue;
+      timestamps.push_back(e.timestamp);
+      commulative_difficulties.push_back(e.cumulative_difficulty);
+    }
+    return next_difficulty(timestamps, commulative_difficulties);
+  }
+
   size_t offset = m_db_blocks.size() - std::min(m_db_blocks.size(), static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
   if (!offset)
     ++offset;//skip genesis block
@@ -1180,8 +1370,6 @@ bool blockchain_storage::handle_alternative_block(const block& b, const crypto::
     //build alternative subchain, front -> mainchain, back -> alternative head
     blocks_ext_by_hash::iterator alt_it = it_prev; //m_alternative_chains.find()
     std::list<blocks_ext_by_hash::iterator> alt_chain;
-    std::vector<crypto::hash> alt_scratchppad;
-    std::map<uint64_t, crypto::hash> alt_scratchppad_patch;
     std::vector<uint64_t> timestamps;
     while (alt_it != m_alternative_chains.end())
     {
@@ -1198,17 +1386,6 @@ bool blockchain_storage::handle_alternative_block(const block& b, const crypto::
       get_block_hash(m_db_blocks[alt_chain.front()->second.height - 1]->bl, h);
       CHECK_AND_ASSERT_MES(h == alt_chain.front()->second.bl.prev_id, false, "alternative chain have wrong connection to main chain");
       complete_timestamps_vector(alt_chain.front()->second.height - 1, timestamps);
-      //build alternative scratchpad
-      for (auto& ach : alt_chain)
-      {
-        if (!push_block_scratchpad_data(ach->second.scratch_offset, ach->second.bl, alt_scratchppad, alt_scratchppad_patch))
-        {
-          LOG_PRINT_RED_L0("Block with id: " << id
-            << ENDL << " for alternative chain, have invalid data");
-          bvc.m_verifivation_failed = true;
-          return false;
-        }
-      }
     }
     else
     {
@@ -1228,65 +1405,17 @@ bool blockchain_storage::handle_alternative_block(const block& b, const crypto::
     block_extended_info bei = boost::value_initialized<block_extended_info>();
     bei.bl = b;
     bei.height = alt_chain.size() ? it_prev->second.height + 1 : *it_main_prev + 1;
-    uint64_t connection_height = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
-    CHECK_AND_ASSERT_MES(connection_height, false, "INTERNAL ERROR: Wrong connection_height==0 in handle_alternative_block");
-    bei.scratch_offset = m_db_blocks[connection_height]->scratch_offset + alt_scratchppad.size();
-    CHECK_AND_ASSERT_MES(bei.scratch_offset, false, "INTERNAL ERROR: Wrong bei.scratch_offset==0 in handle_alternative_block");
-
-    //lets collect patchs from main line
-    std::map<uint64_t, crypto::hash> main_line_patches;
-    for (uint64_t i = connection_height; i != m_db_blocks.size(); i++)
-    {
-      std::vector<crypto::hash> block_addendum;
-      bool res = get_block_scratchpad_addendum(m_db_blocks[i]->bl, block_addendum);
-      CHECK_AND_ASSERT_MES(res, false, "Failed to get_block_scratchpad_addendum for alt block");
-      get_scratchpad_patch(m_db_blocks[i]->scratch_offset, 
-        0, 
-        block_addendum.size(),
-        block_addendum,
-        main_line_patches);
-    }
-    //apply only that patches that lay under alternative scratchpad offset
-    for (auto ml : main_line_patches)
-    {
-      if (ml.first < m_db_blocks[connection_height]->scratch_offset)
-        alt_scratchppad_patch[ml.first] = crypto::xor_pod(alt_scratchppad_patch[ml.first], ml.second);
-    }
-
     wide_difficulty_type current_diff = get_next_difficulty_for_alternative_chain(alt_chain, bei);
     CHECK_AND_ASSERT_MES(current_diff, false, "!!!!!!! DIFFICULTY OVERHEAD !!!!!!!");
-    crypto::hash proof_of_work = null_hash;
     // POW
-#ifdef ENABLE_HASHING_DEBUG
-    size_t call_no = 0;
-    std::stringstream ss;      
-#endif
-    get_block_longhash(bei.bl, proof_of_work, bei.height, [&](uint64_t index) -> crypto::hash
+    crypto::hash proof_of_work = null_hash;
+    if (!get_alt_block_longhash(alt_chain, bei, proof_of_work))
     {
-      uint64_t offset = index%bei.scratch_offset;
-      crypto::hash res;
-      if(offset >= m_db_blocks[connection_height]->scratch_offset)
-      {
-        res = alt_scratchppad[offset - m_db_blocks[connection_height]->scratch_offset];
-      }
-      else
-      {
-        res = m_scratchpad_wr.get_scratchpad()[offset];
-      }
-      auto it = alt_scratchppad_patch.find(offset);
-      if (it != alt_scratchppad_patch.end())
-      {//apply patch
-        res = crypto::xor_pod(res, it->second);
-      }
-#ifdef ENABLE_HASHING_DEBUG
-      ss << "[" << call_no << "][" << index << "%" << bei.scratch_offset << "(" << index%bei.scratch_offset << ")]" << res << ENDL;
-      ++call_no;
-#endif
-      return res;
-    });
-#ifdef ENABLE_HASHING_DEBUG
-    LOG_PRINT_L3("ID: " << get_block_hash(bei.bl) << "[" << bei.height << "]" << ENDL << "POW:" << proof_of_work << ENDL << ss.str());
-#endif
+      LOG_PRINT_RED_L0("Block with id: " << id
+        << ENDL << " for alternative chain, have invalid data");
+      bvc.m_verifivation_failed = true;
+      return false;
+    }
     if (!check_hash(proof_of_work, current_diff))
     {
       LOG_PRINT_RED_L0("Block with id: " << id
@@ -1331,6 +1460,8 @@ bool blockchain_storage::handle_alternative_block(const block& b, const crypto::
     auto i_res = m_alternative_chains.insert(blocks_ext_by_hash::value_type(id, bei));
     CHECK_AND_ASSERT_MES(i_res.second, false, "insertion of new alternative block returned as it already exist");
     alt_chain.push_back(i_res.first);
+    if (!add_alt_scratchpad_state(i_res.first, alt_chain.front()->second.height))
+      LOG_ERROR("Failed to cache scratchpad state for alternative block " << id << ", it will be rebuilt on demand");
     //check if difficulty bigger then in main chain
     if (m_db_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty)
     {
@@ -1462,12 +1593,114 @@ uint64_t blockchain_storage::get_current_hashrate(size_t aprox_count)
   return w_hr.convert_to<uint64_t>();
 }
 //------------------------------------------------------------------
+blockchain_storage::chain_stats blockchain_storage::get_chain_stats() const
+{
+  CRITICAL_REGION_LOCAL(m_chain_stats_lock);
+  return m_chain_stats;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::fill_chain_stats_entry(uint64_t height, chain_stats_entry& e)
+{
+  auto ptr = m_db_blocks[height];
+  CHECK_AND_ASSERT_MES(ptr, false, "failed to get block on height " << height);
+  e.height = height;
+  e.id = get_block_hash(ptr->bl);
+  e.timestamp = ptr->bl.timestamp;
+  e.cumulative_difficulty = ptr->cumulative_difficulty;
+  e.tx_count = ptr->bl.tx_hashes.size();
+  e.tx_volume = 0;
+  for (const auto& h : ptr->bl.tx_hashes)
+  {
+    auto tx_ptr = m_db_transactions.find(h);
+    CHECK_AND_ASSERT_MES(tx_ptr, false, "Wrong transaction hash " << h << " in block on height " << height);
+    uint64_t am = 0;
+    bool r = get_inputs_money_amount(tx_ptr->tx, am);
+    CHECK_AND_ASSERT_MES(r, false, "failed to get_inputs_money_amount");
+    e.tx_volume += am;
+  }
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::update_chain_stats()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  try
+  {
+    const uint64_t sz = m_db_blocks.size();
+    CHECK_AND_ASSERT_MES(sz, false, "update_chain_stats called for empty blockchain");
+
+    // forget blocks popped by reorganize or rollback
+    while (m_chain_stats_window.size() && (m_chain_stats_window.back().height >= sz || m_chain_stats_window.back().id != get_block_id_by_height(m_chain_stats_window.back().height)))
+      m_chain_stats_window.pop_back();
+
+    // genesis is skipped, as in get_difficulty_for_next_block()
+    const uint64_t window_start = sz > CHAIN_STATS_WINDOW_SIZE ? sz - CHAIN_STATS_WINDOW_SIZE : 1;
+    if (m_chain_stats_window.size() && m_chain_stats_window.back().height + 1 < window_start)
+      m_chain_stats_window.clear();
+    while (m_chain_stats_window.size() && m_chain_stats_window.front().height < window_start)
+      m_chain_stats_window.pop_front();
+    while (m_chain_stats_window.size() && m_chain_stats_window.front().height > window_start)
+    {
+      chain_stats_entry e = AUTO_VAL_INIT(e);
+      CHECK_AND_ASSERT_MES(fill_chain_stats_entry(m_chain_stats_window.front().height - 1, e), false, "failed to fill chain stats");
+      m_chain_stats_window.push_front(e);
+    }
+    for (uint64_t h = m_chain_stats_window.size() ? m_chain_stats_window.back().height + 1 : window_start; h < sz; h++)
+    {
+      chain_stats_entry e = AUTO_VAL_INIT(e);
+      CHECK_AND_ASSERT_MES(fill_chain_stats_entry(h, e), false, "failed to fill chain stats");
+      m_chain_stats_window.push_back(e);
+    }
+
+    chain_stats cs = AUTO_VAL_INIT(cs);
+    cs.height = sz;
+    cs.next_difficulty = get_difficulty_for_next_block();
+    cs.total_transactions = m_db_transactions.size();
+    cs.current_blocks_median = get_current_comulative_blocksize_limit() / 2;
+    cs.scratchpad_size = m_scratchpad_wr.get_scratchpad().size() * 32;
+    cs.aliases_count = m_db_aliases.size();
+    cs.alt_blocks_count = m_alternative_chains.size();
+    get_ring_signatures_pruning_progress(cs.pruned_rs_height, cs.pruning_target_height);
+    for (const auto& e : m_chain_stats_window)
+    {
+      if (e.height + CURRENCY_BLOCK_PER_DAY < sz)
+        continue;
+      cs.transactions_cnt_per_day += e.tx_count;
+      cs.transactions_volume_per_day += e.tx_volume;
+    }
+    // same as get_current_hashrate()
+    auto get_hashrate = [&](uint64_t aprox_count) -> uint64_t
+    {
+      if (sz <= aprox_count || m_chain_stats_window.empty())
+        return 0;
+      const chain_stats_entry& from = m_chain_stats_window[sz - aprox_count - m_chain_stats_window.front().height];
+      const chain_stats_entry& to = m_chain_stats_window.back();
+      if (to.timestamp == from.timestamp)
+        return 0;
+      wide_difficulty_type w_hr = (to.cumulative_difficulty - from.cumulative_difficulty) / (to.timestamp - from.timestamp);
+      return w_hr.convert_to<uint64_t>();
+    };
+    cs.hashrate_50 = get_hashrate(CHAIN_STATS_HASHRATE_SHORT_WINDOW);
+    cs.hashrate_350 = get_hashrate(CHAIN_STATS_HASHRATE_LONG_WINDOW);
+
+    CRITICAL_REGION_LOCAL1(m_chain_stats_lock);
+    m_chain_stats = cs;
+    return true;
+  }
+  catch (const std::exception& ex)
+  {
+    LOG_ERROR("EXCEPTION WHILE UPDATING CHAIN STATS: " << ex.what());
+    m_chain_stats_window.clear();
+    return false;
+  }
+}
+//------------------------------------------------------------------
 bool blockchain_storage::extport_scratchpad_to_file(const std::string& path)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   export_scratchpad_file_header fh;
   memset(&fh, 0, sizeof(fh));
-  const std::vector<crypto::hash>& scr_vector = m_scratchpad_wr.get_scratchpad();
+  const mapped_scratchpad& scr_vector = m_scratchpad_wr.get_scratchpad();
 
   fh.current_hi.prevhash = currency::get_block_hash(m_db_blocks.back()->bl);
   fh.current_hi.height = m_db_blocks.size() - 1;
@@ -1737,6 +1970,87 @@ wide_difficulty_type blockchain_storage::block_difficulty(size_t i)
   return m_db_blocks[i]->cumulative_difficulty - m_db_blocks[i - 1]->cumulative_difficulty;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::get_block_headers_range(uint64_t start_height, uint64_t count, std::list<block_header_index_entry>& headers, uint64_t& height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  height = m_db_block_headers.size();
+  CHECK_AND_ASSERT_MES(start_height < height, false, "wrong start height " << start_height << " for headers range, blockchain height = " << height);
+  uint64_t end_height = start_height + std::min(count, height - start_height);
+
+  //whole range read within one db transaction, ended on any exit
+  m_db.begin_transaction(true);
+  auto tx_finalizer = misc_utils::create_scope_leave_handler([this](){ m_db.commit_transaction(); });
+  for (uint64_t h = start_height; h < end_height; h++)
+    headers.push_back(*m_db_block_headers[h]);
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_block_miner_reward(const block& bl, uint64_t& reward)
+{
+  reward = get_outs_money_amount(bl.miner_tx);
+  uint64_t h = get_block_height(bl);
+  if (h && !(h % CURRENCY_DONATIONS_INTERVAL))
+  {
+    uint64_t donation = 0;
+    uint64_t royalty = 0;
+    bool r = lookfor_donation(bl.miner_tx, donation, royalty);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to lookfor_donation");
+    reward -= donation + royalty;
+  }
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::make_block_header_index_entry(const block_extended_info& bei, const wide_difficulty_type& difficulty, block_header_index_entry& bhie)
+{
+  bhie = block_header_index_entry();
+  bhie.id = get_block_hash(bei.bl);
+  bhie.timestamp = bei.bl.timestamp;
+  bhie.block_cumulative_size = bei.block_cumulative_size;
+  bhie.header_blob_size = get_object_blobsize(bei.bl) - get_object_blobsize(bei.bl.miner_tx);
+  bhie.difficulty = difficulty;
+  bhie.cumulative_difficulty = bei.cumulative_difficulty;
+  bhie.tx_count = bei.bl.tx_hashes.size() + 1;
+  bool r = get_block_miner_reward(bei.bl, bhie.reward);
+  CHECK_AND_ASSERT_MES(r, false, "Failed to get miner reward for block " << bhie.id);
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::rebuild_block_headers_index()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  uint64_t height = m_db_blocks.size();
+  LOG_PRINT_L0("Building block headers index for " << height << " blocks...");
+
+  m_db.begin_transaction();
+  m_db_block_headers.clear();
+  m_db.commit_transaction();
+
+  wide_difficulty_type prev_cumulative_difficulty = 0;
+  for (uint64_t h = 0; h < height; h += BLOCKCHAIN_HEADERS_INDEX_REBUILD_BLOCKS_PER_TX)
+  {
+    m_db.begin_transaction();
+    for (uint64_t i = h; i < std::min<uint64_t>(height, h + BLOCKCHAIN_HEADERS_INDEX_REBUILD_BLOCKS_PER_TX); i++)
+    {
+      auto bei_ptr = m_db_blocks[i];
+      block_header_index_entry bhie = AUTO_VAL_INIT(bhie);
+      if (!make_block_header_index_entry(*bei_ptr, bei_ptr->cumulative_difficulty - prev_cumulative_difficulty, bhie))
+      {
+        //index stays shorter than blocks, next init() starts rebuilding over
+        m_db.abort_transaction();
+        LOG_ERROR("Failed to build block headers index entry at height " << i);
+        return false;
+      }
+      m_db_block_headers.push_back(bhie);
+      prev_cumulative_difficulty = bei_ptr->cumulative_difficulty;
+    }
+    m_db.commit_transaction();
+    LOG_PRINT_L1("Block headers index: " << std::min<uint64_t>(height, h + BLOCKCHAIN_HEADERS_INDEX_REBUILD_BLOCKS_PER_TX) << "/" << height);
+  }
+
+  LOG_PRINT_L0("Block headers index built");
+  return true;
+}
+//------------------------------------------------------------------
 void blockchain_storage::print_blockchain(uint64_t start_index, uint64_t end_index)
 {
   std::stringstream ss;
@@ -1871,7 +2185,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, block_verif
   return handle_block_to_main_chain(bl, id, bvc);
 }
 //------------------------------------------------------------------
-bool blockchain_storage::push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes)
+bool blockchain_storage::push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes, block_undo_entry& undo)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   size_t i = 0;
@@ -1881,6 +2195,10 @@ bool blockchain_storage::push_transaction_to_global_outs_index(const transaction
     {
       m_db_outputs.push_back_item(ot.amount, std::pair<crypto::hash, size_t>(tx_id, i));
       global_indexes.push_back(m_db_outputs.get_item_size(ot.amount) - 1);
+      if (undo.outputs.size() && undo.outputs.back().first == ot.amount)
+        ++undo.outputs.back().second;
+      else
+        undo.outputs.push_back(make_serializable_pair<uint64_t, uint64_t>(ot.amount, 1));
     }
     ++i;
   }
@@ -1983,8 +2301,9 @@ uint64_t blockchain_storage::get_scratchpad_size()
 //------------------------------------------------------------------
 bool blockchain_storage::get_all_aliases(std::list<alias_info>& aliases)
 {
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-
+  //read-only db snapshot, doesn't hold m_blockchain_lock for the whole table walk
+  m_db.begin_transaction(true);
+  auto tx_finalizer = misc_utils::create_scope_leave_handler([this](){ m_db.commit_transaction(); });
   m_db_aliases.enumerate_items([&](uint64_t i, const std::string& alias, const std::list<alias_info_base>& elias_entries)
   {
     if (elias_entries.size())
@@ -1999,6 +2318,68 @@ bool blockchain_storage::get_all_aliases(std::list<alias_info>& aliases)
   return true;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::get_aliases(const std::string& start_alias, const std::string& prefix, size_t count, std::list<alias_info>& aliases, std::string& next_alias, uint64_t& height)
+{
+  CHECK_AND_ASSERT_MES(count, false, "get_aliases: zero count requested");
+  next_alias.clear();
+
+  //aliases table is ordered by name bytes, so prefix matches form contiguous range starting from the prefix itself
+  const std::string& first_key = start_alias < prefix ? prefix : start_alias;
+
+  //read-only db snapshot: page is consistent with returned height and doesn't block blocks processing
+  m_db.begin_transaction(true);
+  auto tx_finalizer = misc_utils::create_scope_leave_handler([this](){ m_db.commit_transaction(); });
+  height = m_db_blocks.size_no_cache();
+  m_db_aliases.enumerate_items_from(first_key, [&](uint64_t i, const std::string& alias, const std::list<alias_info_base>& elias_entries)
+  {
+    if (alias.compare(0, prefix.size(), prefix) != 0)
+      return false;
+    if (aliases.size() >= count)
+    {
+      next_alias = alias;
+      return false;
+    }
+    if (elias_entries.size())
+    {
+      aliases.push_back(alias_info());
+      aliases.back().m_alias = alias;
+      static_cast<alias_info_base&>(aliases.back()) = elias_entries.back();
+    }
+    return true;
+  });
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_aliases_changes(uint64_t from_height, uint64_t max_blocks, std::list<alias_info>& aliases, uint64_t& next_height, uint64_t& height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  height = m_db_blocks.size();
+  next_height = std::min(height, from_height + std::min<uint64_t>(max_blocks, COMMAND_RPC_GET_ALIAS_CHANGES_MAX_BLOCKS));
+
+  //aliases are registered/updated only by coinbase transactions, so the feed is built from miner_tx of the blocks in range
+  std::set<std::string> changed;
+  for (uint64_t h = from_height; h < next_height; h++)
+  {
+    tx_extra_info ei = AUTO_VAL_INIT(ei);
+    bool r = parse_and_validate_tx_extra(m_db_blocks[h]->bl.miner_tx, ei);
+    CHECK_AND_ASSERT_MES(r, false, "failed to validate coinbase extra at height " << h);
+    if (ei.m_alias.m_alias.size())
+      changed.insert(ei.m_alias.m_alias);
+  }
+
+  //return actual state of every touched alias
+  for (const auto& name : changed)
+  {
+    auto alias_ptr = m_db_aliases.find(name);
+    if (!alias_ptr || !alias_ptr->size())
+      continue;
+    aliases.push_back(alias_info());
+    aliases.back().m_alias = name;
+    static_cast<alias_info_base&>(aliases.back()) = alias_ptr->back();
+  }
+  return true;
+}
+//------------------------------------------------------------------
 std::string blockchain_storage::get_alias_by_address(const account_public_address& addr)
 {
   auto alias_ptr = m_db_addr_to_alias.find(addr);
@@ -2145,7 +2526,7 @@ bool blockchain_storage::put_alias_info(const alias_info& ai)
   return true;
 }
 //------------------------------------------------------------------
-bool blockchain_storage::process_blockchain_tx_extra(const transaction& tx)
+bool blockchain_storage::process_blockchain_tx_extra(const transaction& tx, block_undo_entry& undo)
 {
   //check transaction extra
   tx_extra_info ei = AUTO_VAL_INIT(ei);
@@ -2155,15 +2536,16 @@ bool blockchain_storage::process_blockchain_tx_extra(const transaction& tx)
   {
     r = put_alias_info(ei.m_alias);
     CHECK_AND_ASSERT_MES(r, false, "failed to put_alias_info");
+    undo.alias = ei.m_alias.m_alias;
   }
   return true;
 }
 //------------------------------------------------------------------
-bool blockchain_storage::add_transaction_from_block(const transaction& tx, const crypto::hash& tx_id, const crypto::hash& bl_id, uint64_t bl_height)
+bool blockchain_storage::add_transaction_from_block(const transaction& tx, const crypto::hash& tx_id, const crypto::hash& bl_id, uint64_t bl_height, block_undo_entry& undo)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   PROF_L2_START(process_tx_extra_time);
-  bool r = process_blockchain_tx_extra(tx);
+  bool r = process_blockchain_tx_extra(tx, undo);
   CHECK_AND_ASSERT_MES(r, false, "failed to process_blockchain_tx_extra");
   PROF_L2_FINISH(process_tx_extra_time);
   struct add_transaction_input_visitor : public boost::static_visitor<bool>
@@ -2172,11 +2554,13 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
     key_images_container& m_db_spent_keys;
     const crypto::hash& m_tx_id;
     const crypto::hash& m_bl_id;
-    add_transaction_input_visitor(blockchain_storage& bcs, key_images_container& spent_keys, const crypto::hash& tx_id, const crypto::hash& bl_id) :
+    block_undo_entry& m_undo;
+    add_transaction_input_visitor(blockchain_storage& bcs, key_images_container& spent_keys, const crypto::hash& tx_id, const crypto::hash& bl_id, block_undo_entry& undo) :
       m_bcs(bcs),
       m_db_spent_keys(spent_keys),
       m_tx_id(tx_id),
-      m_bl_id(bl_id)
+      m_bl_id(bl_id),
+      m_undo(undo)
     {}
     bool operator()(const txin_to_key& in) const
     {
@@ -2190,6 +2574,7 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
         return false;
       }
       m_db_spent_keys.set(ki, true);
+      m_undo.key_images.push_back(ki);
 
       if (in.key_offsets.size() == 1)
       {
@@ -2200,6 +2585,7 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
           LOG_PRINT_RED_L0("Failed to  update_spent_tx_flags_for_input");
           return false;
         }
+        m_undo.spent_outs.push_back(make_serializable_pair<uint64_t, uint64_t>(in.amount, in.key_offsets[0]));
       }
 
       return true;
@@ -2213,7 +2599,7 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
   PROF_L2_START(process_tx_inputs_time);
   BOOST_FOREACH(const txin_v& in, tx.vin)
   {
-    if (!boost::apply_visitor(add_transaction_input_visitor(*this, m_db_spent_keys, tx_id, bl_id), in))
+    if (!boost::apply_visitor(add_transaction_input_visitor(*this, m_db_spent_keys, tx_id, bl_id, undo), in))
     {
       LOG_ERROR("critical internal error: add_transaction_input_visitor failed. but key_images should be already checked");
       purge_transaction_keyimages_from_blockchain(tx, false);
@@ -2242,7 +2628,7 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
     return false;
   }
 
-  r = push_transaction_to_global_outs_index(tx, tx_id, ch_e.m_global_output_indexes);
+  r = push_transaction_to_global_outs_index(tx, tx_id, ch_e.m_global_output_indexes, undo);
   CHECK_AND_ASSERT_MES(r, false, "failed to return push_transaction_to_global_outs_index tx id " << tx_id);
   PROF_L2_FINISH(push_tx_to_global_index_time_2);
 
@@ -2420,7 +2806,14 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
     return true;
 
   CHECK_AND_ASSERT_MES(sig.size() == output_keys.size(), false, "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size());
-  return crypto::check_ring_signature(tx_prefix_hash, txin.k_image, output_keys, sig.data());
+  //checks above depend on chain state and are done every time, only signature verification result is remembered
+  crypto::hash cache_key = verified_inputs_cache::make_key(tx_prefix_hash, txin, output_keys, sig);
+  if (m_verified_inputs_cache.has(cache_key))
+    return true;
+  if (!crypto::check_ring_signature(tx_prefix_hash, txin.k_image, output_keys, sig.data()))
+    return false;
+  m_verified_inputs_cache.add(cache_key);
+  return true;
 }
 //------------------------------------------------------------------
 uint64_t blockchain_storage::get_adjusted_time()
@@ -2461,6 +2854,163 @@ bool blockchain_storage::check_block_timestamp(std::vector<uint64_t> timestamps,
   return true;
 }
 
+//------------------------------------------------------------------
+const blockchain_storage::alt_scratchpad_state* blockchain_storage::get_alt_scratchpad_state(const std::list<blocks_ext_by_hash::iterator>& alt_chain)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  CHECK_AND_ASSERT_MES(alt_chain.size(), nullptr, "empty alt chain passed to get_alt_scratchpad_state");
+  const crypto::hash& tip_id = alt_chain.back()->first;
+  uint64_t connection_height = alt_chain.front()->second.height;
+  auto it = m_alt_scratchpad_states.find(tip_id);
+  if (it != m_alt_scratchpad_states.end() && it->second.connection_height == connection_height)
+    return &it->second;
+
+  //not cached: tip already has a child, or states were reset by chain switching
+  alt_scratchpad_state& st = m_alt_scratchpad_states[tip_id];
+  st.connection_height = connection_height;
+  st.scratchpad.clear();
+  st.patch.clear();
+  for (auto& ach : alt_chain)
+  {
+    if (!push_block_scratchpad_data(ach->second.scratch_offset, ach->second.bl, st.scratchpad, st.patch))
+    {
+      m_alt_scratchpad_states.erase(tip_id);
+      return nullptr;
+    }
+  }
+  return &st;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_alt_block_longhash(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei, crypto::hash& proof_of_work)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //alternative scratchpad, usually cached for chain tip
+  alt_scratchpad_state empty_alt_state = AUTO_VAL_INIT(empty_alt_state);
+  const alt_scratchpad_state* palt_state = &empty_alt_state;
+  if (alt_chain.size())
+  {
+    palt_state = get_alt_scratchpad_state(alt_chain);
+    CHECK_AND_ASSERT_MES(palt_state, false, "Failed to get scratchpad state of alternative chain for block on height " << bei.height);
+  }
+  uint64_t connection_height = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
+  CHECK_AND_ASSERT_MES(connection_height, false, "INTERNAL ERROR: Wrong connection_height==0 in get_alt_block_longhash");
+  //patches from main line that lay under alternative scratchpad offset, kept up to date as main chain grows
+  const main_line_patch_entry* pmain_line = get_main_line_patches(connection_height);
+  CHECK_AND_ASSERT_MES(pmain_line, false, "Failed to get main line patches for connection height " << connection_height);
+  bei.scratch_offset = pmain_line->scratch_offset + palt_state->scratchpad.size();
+  CHECK_AND_ASSERT_MES(bei.scratch_offset, false, "INTERNAL ERROR: Wrong bei.scratch_offset==0 in get_alt_block_longhash");
+
+#ifdef ENABLE_HASHING_DEBUG
+  size_t call_no = 0;
+  std::stringstream ss;
+#endif
+  get_block_longhash(bei.bl, proof_of_work, bei.height, [&](uint64_t index) -> crypto::hash
+  {
+    crypto::hash res = get_alt_scratchpad_entry(index%bei.scratch_offset, *palt_state, *pmain_line);
+#ifdef ENABLE_HASHING_DEBUG
+    ss << "[" << call_no << "][" << index << "%" << bei.scratch_offset << "(" << index%bei.scratch_offset << ")]" << res << ENDL;
+    ++call_no;
+#endif
+    return res;
+  });
+#ifdef ENABLE_HASHING_DEBUG
+  LOG_PRINT_L3("ID: " << get_block_hash(bei.bl) << "[" << bei.height << "]" << ENDL << "POW:" << proof_of_work << ENDL << ss.str());
+#endif
+  return true;
+}
+//------------------------------------------------------------------
+crypto::hash blockchain_storage::get_alt_scratchpad_entry(uint64_t offset, const alt_scratchpad_state& alt_state, const main_line_patch_entry& main_line)
+{
+  crypto::hash res = null_hash;
+  if (offset >= main_line.scratch_offset)
+  {
+    res = alt_state.scratchpad[offset - main_line.scratch_offset];
+  }
+  else
+  {
+    res = m_scratchpad_wr.get_scratchpad()[offset];
+    auto it = main_line.patch.find(offset);
+    if (it != main_line.patch.end())
+    {//revert main line patch
+      res = crypto::xor_pod(res, it->second);
+    }
+  }
+  auto it = alt_state.patch.find(offset);
+  if (it != alt_state.patch.end())
+  {//apply patch
+    res = crypto::xor_pod(res, it->second);
+  }
+  return res;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::add_alt_scratchpad_state(const blocks_ext_by_hash::iterator& alt_it, uint64_t connection_height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  alt_scratchpad_state st = AUTO_VAL_INIT(st);
+  st.connection_height = connection_height;
+  if (alt_it->second.height != connection_height)
+  {
+    //state moves on to the new tip, another block on top of the same previous one will rebuild it
+    auto prev_it = m_alt_scratchpad_states.find(alt_it->second.bl.prev_id);
+    CHECK_AND_ASSERT_MES(prev_it != m_alt_scratchpad_states.end(), false, "no scratchpad state for previous alt block " << alt_it->second.bl.prev_id);
+    st = std::move(prev_it->second);
+    m_alt_scratchpad_states.erase(prev_it);
+  }
+  bool r = push_block_scratchpad_data(alt_it->second.scratch_offset, alt_it->second.bl, st.scratchpad, st.patch);
+  CHECK_AND_ASSERT_MES(r, false, "Failed to push_block_scratchpad_data for alt block " << alt_it->first);
+  m_alt_scratchpad_states[alt_it->first] = std::move(st);
+  return true;
+}
+//------------------------------------------------------------------
+const blockchain_storage::main_line_patch_entry* blockchain_storage::get_main_line_patches(uint64_t connection_height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  auto it = m_main_line_patches.find(connection_height);
+  if (it != m_main_line_patches.end())
+    return &it->second;
+
+  CHECK_AND_ASSERT_MES(connection_height < m_db_blocks.size(), nullptr, "connection height " << connection_height << " is above main chain size " << m_db_blocks.size());
+  main_line_patch_entry mlp = AUTO_VAL_INIT(mlp);
+  mlp.scratch_offset = m_db_blocks[connection_height]->scratch_offset;
+  for (uint64_t i = connection_height; i != m_db_blocks.size(); i++)
+  {
+    std::map<uint64_t, crypto::hash> block_patch;
+    bool r = get_main_block_scratchpad_patch(i, block_patch);
+    CHECK_AND_ASSERT_MES(r, nullptr, "Failed to get scratchpad patch of main chain block on height " << i);
+    merge_scratchpad_patch(mlp.patch, block_patch, mlp.scratch_offset);
+  }
+  return &(m_main_line_patches[connection_height] = std::move(mlp));
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_main_block_scratchpad_patch(uint64_t height, std::map<uint64_t, crypto::hash>& patch)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  CHECK_AND_ASSERT_MES(height < m_db_blocks.size(), false, "height " << height << " is above main chain size " << m_db_blocks.size());
+  auto undo_ptr = m_db_block_undo.get(height);
+  if (undo_ptr && undo_ptr->id == m_db_block_headers[height]->id)
+  {
+    BOOST_FOREACH(const auto& p, undo_ptr->scratchpad_patch)
+      patch[p.first] = crypto::xor_pod(patch[p.first], p.second);
+    return true;
+  }
+
+  auto bei_ptr = m_db_blocks[height];
+  std::vector<crypto::hash> block_addendum;
+  bool r = get_block_scratchpad_addendum(bei_ptr->bl, block_addendum);
+  CHECK_AND_ASSERT_MES(r, false, "Failed to get_block_scratchpad_addendum for block on height " << height);
+  return get_scratchpad_patch(bei_ptr->scratch_offset, 0, block_addendum.size(), block_addendum, patch);
+}
+//------------------------------------------------------------------
+void blockchain_storage::on_main_line_block_patch(uint64_t height, const std::map<uint64_t, crypto::hash>& patch, bool added)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //popped block could be connection point itself
+  if (!added)
+    m_main_line_patches.erase(m_main_line_patches.lower_bound(height), m_main_line_patches.end());
+  //xor patch undoes itself on pop
+  for (auto& mlp : m_main_line_patches)
+    merge_scratchpad_patch(mlp.second.patch, patch, mlp.second.scratch_offset);
+}
 //------------------------------------------------------------------
 bool blockchain_storage::get_block_for_scratchpad_alt(uint64_t connection_height, uint64_t block_index, std::list<blockchain_storage::blocks_ext_by_hash::iterator>& alt_chain, block & b)
 {
@@ -2494,15 +3044,22 @@ bool blockchain_storage::prune_aged_alt_blocks()
   for (auto it = m_alternative_chains.begin(); it != m_alternative_chains.end();)
   {
     if (current_height > it->second.height && current_height - it->second.height > CURRENCY_ALT_BLOCK_LIVETIME_COUNT)
+    {
+      m_alt_scratchpad_states.erase(it->first);
       m_alternative_chains.erase(it++);
+    }
     else
       ++it;
   }
+  if (current_height > CURRENCY_ALT_BLOCK_LIVETIME_COUNT)
+    m_main_line_patches.erase(m_main_line_patches.begin(), m_main_line_patches.lower_bound(current_height - CURRENCY_ALT_BLOCK_LIVETIME_COUNT));
 
+  CRITICAL_REGION_LOCAL1(m_chain_stats_lock);
+  m_chain_stats.alt_blocks_count = m_alternative_chains.size();
   return true;
 }
 //------------------------------------------------------------------
-bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc)
+bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc, bool reconnect)
 {
   PROF_L1_START(block_processing_time);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -2534,12 +3091,15 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   PROF_L1_START(longhash_calculating_time);
   crypto::hash proof_of_work = null_hash;
 
-  proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+  if (!reconnect)
   {
-    return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
-  });
+    proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+    {
+      return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
+    });
+  }
 
-  if (!check_hash(proof_of_work, current_diffic))
+  if (!reconnect && !check_hash(proof_of_work, current_diffic))
   {
     LOG_PRINT_L0("Block with id: " << id << ENDL
       << "have not enough proof of work: " << proof_of_work << ENDL
@@ -2575,8 +3135,10 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   PROF_L2_START(add_miner_tx_time);
   size_t coinbase_blob_size = get_object_blobsize(bl.miner_tx);
   size_t cumulative_block_size = coinbase_blob_size;
+  block_undo_entry undo = AUTO_VAL_INIT(undo);
+  undo.id = id;
   //process transactions
-  if (!add_transaction_from_block(bl.miner_tx, get_transaction_hash(bl.miner_tx), id, get_current_blockchain_height()))
+  if (!add_transaction_from_block(bl.miner_tx, get_transaction_hash(bl.miner_tx), id, get_current_blockchain_height(), undo))
   {
     LOG_PRINT_L0("Block with id: " << id << " failed to add transaction to blockchain storage");
     bvc.m_verifivation_failed = true;
@@ -2608,7 +3170,11 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
       tx.signatures.clear();
     }
 
-    if (!check_tx_inputs(tx))
+    PROF_L2_START(tx_check_inputs_time);
+    bool check_inputs_res = reconnect || check_tx_inputs(tx);
+    PROF_L2_FINISH(tx_check_inputs_time);
+    PROF_L2_DO(m_performance_data.tx_check_inputs_time += tx_check_inputs_time);
+    if (!check_inputs_res)
     {
       LOG_PRINT_L0("Block with id: " << id << "have at least one transaction (id: " << tx_id << ") with wrong inputs.");
       currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -2621,7 +3187,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
       return false;
     }
 
-    if (!add_transaction_from_block(tx, tx_id, id, get_current_blockchain_height()))
+    if (!add_transaction_from_block(tx, tx_id, id, get_current_blockchain_height(), undo))
     {
       LOG_PRINT_L0("Block with id: " << id << " failed to add transaction to blockchain storage");
       currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -2667,6 +3233,15 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
 
   bei.height = m_db_blocks.size();
 
+  block_header_index_entry bhie = AUTO_VAL_INIT(bhie);
+  if (!make_block_header_index_entry(bei, current_diffic, bhie))
+  {
+    LOG_ERROR("Failed to make block headers index entry for block id: " << id);
+    purge_block_data_from_blockchain(bl, tx_processed_count);
+    bvc.m_verifivation_failed = true;
+    return false;
+  }
+
   auto blocks_index_ptr = m_db_blocks_index.get(id);
   if (blocks_index_ptr)
   {
@@ -2679,7 +3254,8 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   PROF_L2_FINISH(update_blocks_table_time1);
 
   PROF_L2_START(update_scratchpad_time);
-  if (!m_scratchpad_wr.push_block_scratchpad_data(bl))
+  std::map<uint64_t, crypto::hash> scratchpad_patch;
+  if (!m_scratchpad_wr.push_block_scratchpad_data(bl, scratchpad_patch, undo.scratchpad_addendum_size))
   {
     LOG_ERROR("Internal error for block id: " << id << ": failed to put_block_scratchpad_data");
     purge_block_data_from_blockchain(bl, tx_processed_count);
@@ -2688,16 +3264,28 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   }
 
 #ifdef ENABLE_HASHING_DEBUG  
-  LOG_PRINT_L3("SCRATCHPAD_SHOT FOR H=" << bei.height + 1 << ENDL << dump_scratchpad(m_scratchpad_wr.get_scratchpad()));
+  LOG_PRINT_L3("SCRATCHPAD_SHOT FOR H=" << bei.height + 1 << ENDL << dump_scratchpad(std::vector<crypto::hash>(m_scratchpad_wr.get_scratchpad().begin(), m_scratchpad_wr.get_scratchpad().end())));
 #endif
   PROF_L2_FINISH(update_scratchpad_time);
 
   PROF_L2_START(update_blocks_table_time2);
   m_db_blocks.push_back(bei);
+  m_db_block_headers.push_back(bhie);
+  for (const auto& p : scratchpad_patch)
+    undo.scratchpad_patch.push_back(make_serializable_pair(p.first, p.second));
+  m_db_block_undo.set(bei.height, undo);
+  if (bei.height >= BLOCKCHAIN_UNDO_RECORDS_DEPTH)
+    m_db_block_undo.erase_validate(bei.height - BLOCKCHAIN_UNDO_RECORDS_DEPTH);
+  on_main_line_block_patch(bei.height, scratchpad_patch, true);
   update_next_comulative_size_limit();
   PROF_L2_FINISH(update_blocks_table_time2);
 
   PROF_L1_FINISH(block_processing_time);
+  ++m_performance_data.blocks_count;
+  m_performance_data.transactions_count += tx_processed_count;
+  PROF_L1_DO(m_performance_data.block_processing_time += block_processing_time;
+             m_performance_data.target_calculating_time += target_calculating_time;
+             m_performance_data.longhash_calculating_time += longhash_calculating_time);
   LOG_PRINT_L1("+++++ BLOCK SUCCESSFULLY ADDED" << ENDL << "id:\t" << id
     << ENDL << "PoW:\t" << proof_of_work
     << ENDL << "HEIGHT " << bei.height << ", difficulty:\t" << current_diffic
@@ -2768,6 +3356,7 @@ bool blockchain_storage::add_new_block(const block& bl_, block_verification_cont
       m_db.begin_transaction();
       bool r = handle_alternative_block(bl, id, bvc);
       m_db.commit_transaction();
+      update_chain_stats();
       return r;
       //never relay alternative blocks
     }
@@ -2784,6 +3373,8 @@ bool blockchain_storage::add_new_block(const block& bl_, block_verification_cont
     m_db.commit_transaction();
     PROF_L2_FINISH(time_handle_main_3);
     PROF_L2_FINISH(time_handle_main);
+    PROF_L2_DO(m_performance_data.db_commit_time += time_handle_main_3);
+    update_chain_stats();
 
 #if PROFILING_LEVEL >= 2
     LOG_PRINT_L2("bcs::add_new_block timings (ms) have block: " << print_mcsec_as_ms(time_have_block_check) << ", handle alt: " << print_mcsec_as_ms(time_handle_alt) <<
@@ -10,6 +10,7 @@
 
 #include <boost/foreach.hpp>
 #include <atomic>
+#include <deque>
 
 
 #include "serialization/serialization.h"
@@ -30,6 +31,7 @@
 #include "crypto/hash.h"
 #include "checkpoints.h"
 #include "scratchpad_helpers.h"
+#include "verified_inputs_cache.h"
 #include "file_io_utils.h"
 #include "common/db_lmdb_adapter.h"
 
@@ -93,6 +95,64 @@ namespace currency
       END_SERIALIZE()
     };
 
+    // compact per-height record kept in sync with blocks table, lets explorer-like range queries avoid full blocks loading
+    struct block_header_index_entry
+    {
+      crypto::hash id;
+      uint64_t timestamp;
+      uint64_t block_cumulative_size;
+      uint64_t header_blob_size;  //block blob size without coinbase
+      wide_difficulty_type difficulty;
+      wide_difficulty_type cumulative_difficulty;
+      uint64_t tx_count;          //including coinbase
+      uint64_t reward;            //miner's part of coinbase, without donation and royalty
+
+      uint32_t version;
+
+      DEFINE_SERIALIZATION_VERSION(1)
+      BEGIN_SERIALIZE_OBJECT()
+        VERSION_ENTRY(version)
+        FIELD(id)
+        FIELD(timestamp)
+        FIELD(block_cumulative_size)
+        FIELD(header_blob_size)
+        FIELD(difficulty)
+        FIELD(cumulative_difficulty)
+        FIELD(tx_count)
+        FIELD(reward)
+      END_SERIALIZE()
+    };
+
+    // cumulative timings (microseconds) of blocks added to main chain, filled according to PROFILING_LEVEL
+    struct performance_data
+    {
+      uint64_t blocks_count;
+      uint64_t transactions_count;
+      uint64_t block_processing_time;
+      uint64_t target_calculating_time;
+      uint64_t longhash_calculating_time;
+      uint64_t tx_check_inputs_time;
+      uint64_t db_commit_time;
+    };
+
+    // chain figures for RPC, refreshed incrementally after each change of main chain, see update_chain_stats()
+    struct chain_stats
+    {
+      uint64_t height;
+      wide_difficulty_type next_difficulty;
+      uint64_t total_transactions;
+      uint64_t current_blocks_median;
+      uint64_t hashrate_50;
+      uint64_t hashrate_350;
+      uint64_t scratchpad_size;
+      uint64_t aliases_count;
+      uint64_t transactions_cnt_per_day;
+      uint64_t transactions_volume_per_day;
+      uint64_t alt_blocks_count;
+      uint64_t pruned_rs_height;
+      uint64_t pruning_target_height;
+    };
+
     typedef db::key_to_array_accessor_base<uint64_t, std::pair<crypto::hash, uint64_t>, false>  outputs_container;
 
     blockchain_storage(tx_memory_pool& tx_pool);
@@ -149,6 +209,8 @@ namespace currency
     bool get_alias_info(const std::string& alias, alias_info_base& info);
     std::string get_alias_by_address(const account_public_address& addr);
     bool get_all_aliases(std::list<alias_info>& aliases);
+    bool get_aliases(const std::string& start_alias, const std::string& prefix, size_t count, std::list<alias_info>& aliases, std::string& next_alias, uint64_t& height);
+    bool get_aliases_changes(uint64_t from_height, uint64_t max_blocks, std::list<alias_info>& aliases, uint64_t& next_height, uint64_t& height);
     uint64_t get_aliases_count();
     uint64_t get_scratchpad_size();
     //bool store_blockchain();
@@ -168,7 +230,11 @@ namespace currency
     bool clear();
     bool is_storing_blockchain(){ return m_is_blockchain_storing; }
     wide_difficulty_type block_difficulty(size_t i);
+    bool get_block_headers_range(uint64_t start_height, uint64_t count, std::list<block_header_index_entry>& headers, uint64_t& height);
+    bool get_block_miner_reward(const block& bl, uint64_t& reward);
     bool copy_scratchpad(std::vector<crypto::hash>& dst);//TODO: not the best way, add later update method instead of full copy    
+    //opens scratchpad file read-only or refreshes already attached one, local miners use it instead of a copy
+    bool attach_scratchpad(mapped_scratchpad& dst);
     bool copy_scratchpad_as_blob(std::string& dst);
     bool prune_aged_alt_blocks();
     bool get_transactions_daily_stat(uint64_t& daily_cnt, uint64_t& daily_volume);
@@ -177,6 +243,14 @@ namespace currency
     bool get_block_extended_info_by_hash(const crypto::hash &h, block_extended_info &blk) const;
     bool get_block_extended_info_by_height(uint64_t h, block_extended_info &blk) const;
     bool lookfor_donation(const transaction& tx, uint64_t& donation, uint64_t& royalty);
+    performance_data get_performance_data() const;
+    void reset_performance_data();
+    bool prune_ring_signatures_if_need();
+    void get_ring_signatures_pruning_progress(uint64_t& pruned_height, uint64_t& target_height);
+    bool copy_compact(const std::string& path);
+    chain_stats get_chain_stats() const;
+    //held by callers that need several queries to see the same chain state
+    critical_section& get_blockchain_lock() const { return m_blockchain_lock; }
 
     template<class t_ids_container, class t_blocks_container, class t_missed_container>
     bool get_blocks(const t_ids_container& block_ids, t_blocks_container& blocks, t_missed_container& missed_bs)
@@ -225,12 +299,16 @@ namespace currency
     void print_blockchain_outs(const std::string& file);
 
   private:
+    //core tests reach internals through it, see tests/core_tests
+    friend struct blockchain_storage_test_accessor;
+
     //-------------- DB containers --------------
     typedef db::key_value_accessor_base<crypto::hash, uint64_t, false> blocks_by_id_index; //typedef std::unordered_map<crypto::hash, size_t> blocks_by_id_index;
     typedef db::key_value_accessor_base<crypto::hash, transaction_chain_entry, true> transactions_container; //typedef std::unordered_map<crypto::hash, transaction_chain_entry> transactions_container;
 
     typedef db::key_value_accessor_base<crypto::key_image, bool, false> key_images_container; //typedef std::unordered_set<crypto::key_image> key_images_container;
     typedef db::array_accessor<block_extended_info, true> blocks_container;
+    typedef db::array_accessor<block_header_index_entry, true> block_headers_container;
 
 
     typedef db::key_value_accessor_base<std::string, std::list<alias_info_base>, true> aliases_container; //typedef std::map<std::string, std::list<extra_alias_entry_base>> aliases_container; //alias can be address address address + view key
@@ -238,6 +316,33 @@ namespace currency
     typedef db::key_value_accessor_base<crypto::hash, std::pair<crypto::hash, uint64_t>, false> multisig_outs_container;//  typedef std::unordered_map<crypto::hash, std::pair<crypto::hash, size_t>> multisig_outs_container;// hash key - multisig output id, pair<tx_id, n> - reference to tx id + output in transaction
     typedef db::key_value_accessor_base<uint64_t, uint64_t, false> solo_options_container;
 
+    // everything a main chain block changed in containers, written when block is connected so it could be disconnected by replay
+    struct block_undo_entry
+    {
+      crypto::hash id;
+      std::vector<crypto::key_image> key_images;
+      std::vector<serializable_pair<uint64_t, uint64_t> > spent_outs;  //amount, global index of direct spends
+      std::vector<serializable_pair<uint64_t, uint64_t> > outputs;     //amount, count of outputs pushed to global index, in order of pushing
+      std::string alias;                                               //alias registered or updated by coinbase
+      std::vector<serializable_pair<uint64_t, crypto::hash> > scratchpad_patch;
+      uint64_t scratchpad_addendum_size;
+
+      uint32_t version;
+
+      DEFINE_SERIALIZATION_VERSION(1)
+      BEGIN_SERIALIZE_OBJECT()
+        VERSION_ENTRY(version)
+        FIELD(id)
+        FIELD(key_images)
+        FIELD(spent_outs)
+        FIELD(outputs)
+        FIELD(alias)
+        FIELD(scratchpad_patch)
+        FIELD(scratchpad_addendum_size)
+      END_SERIALIZE()
+    };
+    typedef db::key_value_accessor_base<uint64_t, block_undo_entry, true> block_undo_container;
+
 
     //------
     typedef std::unordered_map<crypto::hash, block_extended_info> blocks_ext_by_hash;
@@ -250,6 +355,7 @@ namespace currency
     //containers
     blocks_container m_db_blocks;
     blocks_by_id_index m_db_blocks_index;
+    block_headers_container m_db_block_headers;
     transactions_container m_db_transactions;
     key_images_container m_db_spent_keys;
     solo_options_container m_db_solo_options;
@@ -260,6 +366,7 @@ namespace currency
     outputs_container m_db_outputs;
     aliases_container m_db_aliases;
     address_to_aliases_container m_db_addr_to_alias;
+    block_undo_container m_db_block_undo;   //by height, only for last BLOCKCHAIN_UNDO_RECORDS_DEPTH blocks
     
     scratchpad_wrapper::scratchpad_container m_db_scratchpad_internal;
     scratchpad_wrapper m_scratchpad_wr;
@@ -271,8 +378,41 @@ namespace currency
     blocks_ext_by_hash m_invalid_blocks;     // crypto::hash -> block_extended_info
     blocks_ext_by_hash m_alternative_chains; // crypto::hash -> block_extended_info
 
+    // scratchpad of alternative chain as seen by its next block: entries appended by alt blocks and patch they made to earlier entries
+    struct alt_scratchpad_state
+    {
+      uint64_t connection_height;
+      std::vector<crypto::hash> scratchpad;         //starts at scratch offset of connection height
+      std::map<uint64_t, crypto::hash> patch;
+    };
+    // xor of patches main chain blocks from connection height to the top made to entries under connection scratch offset
+    struct main_line_patch_entry
+    {
+      uint64_t scratch_offset;
+      std::map<uint64_t, crypto::hash> patch;
+    };
+    std::unordered_map<crypto::hash, alt_scratchpad_state> m_alt_scratchpad_states; // alt chain tip id -> state including tip
+    std::map<uint64_t, main_line_patch_entry> m_main_line_patches;                  // connection height -> patches, updated as main chain moves
+
     std::atomic<bool> m_is_in_checkpoint_zone;
     std::atomic<bool> m_is_blockchain_storing;
+    performance_data m_performance_data;
+    uint64_t m_prune_rs_blocks_per_step;
+    verified_inputs_cache m_verified_inputs_cache;
+
+    // per-block data of the last CHAIN_STATS_WINDOW_SIZE main chain blocks, guarded by m_blockchain_lock
+    struct chain_stats_entry
+    {
+      uint64_t height;
+      crypto::hash id;
+      uint64_t timestamp;
+      wide_difficulty_type cumulative_difficulty;
+      uint64_t tx_count;
+      uint64_t tx_volume;
+    };
+    std::deque<chain_stats_entry> m_chain_stats_window;
+    chain_stats m_chain_stats;
+    mutable critical_section m_chain_stats_lock;
 
     std::string m_config_folder;
     account_keys m_donations_account;
@@ -290,17 +430,19 @@ namespace currency
     bool purge_block_data_from_blockchain(const block& b, size_t processed_tx_count);
     bool purge_transaction_from_blockchain(const crypto::hash& tx_id);
     bool purge_transaction_keyimages_from_blockchain(const transaction& tx, bool strict_check);
+    bool undo_block_from_blockchain(const block& b, const block_undo_entry& undo);
 
     bool handle_block_to_main_chain(const block& bl, block_verification_context& bvc);
-    bool handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc);
+    //reconnect - block was in main chain on top of the same state, proof of work and inputs signatures are not checked again
+    bool handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc, bool reconnect = false);
     bool handle_alternative_block(const block& b, const crypto::hash& id, block_verification_context& bvc);
     wide_difficulty_type get_next_difficulty_for_alternative_chain(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei);
     bool prevalidate_miner_transaction(const block& b, uint64_t height);
     bool validate_miner_transaction(const block& b, size_t cumulative_block_size, uint64_t fee, uint64_t& base_reward, uint64_t already_generated_coins, uint64_t already_donated_coins, uint64_t& donation_total);
     bool validate_transaction(const block& b, uint64_t height, const transaction& tx);
     bool rollback_blockchain_switching(std::list<block>& original_chain, size_t rollback_height);
-    bool add_transaction_from_block(const transaction& tx, const crypto::hash& tx_id, const crypto::hash& bl_id, uint64_t bl_height);
-    bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes);
+    bool add_transaction_from_block(const transaction& tx, const crypto::hash& tx_id, const crypto::hash& bl_id, uint64_t bl_height, block_undo_entry& undo);
+    bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes, block_undo_entry& undo);
     bool pop_transaction_from_global_index(const transaction& tx, const crypto::hash& tx_id);
     bool get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count);
     bool add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i, uint64_t mix_count, bool use_only_forced_to_mix = false);
@@ -313,8 +455,18 @@ namespace currency
     uint64_t get_adjusted_time();
     bool complete_timestamps_vector(uint64_t start_height, std::vector<uint64_t>& timestamps);
     bool update_next_comulative_size_limit();
+    bool make_block_header_index_entry(const block_extended_info& bei, const wide_difficulty_type& difficulty, block_header_index_entry& bhie);
+    bool rebuild_block_headers_index();
+    const alt_scratchpad_state* get_alt_scratchpad_state(const std::list<blocks_ext_by_hash::iterator>& alt_chain);
+    bool add_alt_scratchpad_state(const blocks_ext_by_hash::iterator& alt_it, uint64_t connection_height);
+    //alt_chain - alternative blocks under bei, empty if bei is connected to main chain, sets bei.scratch_offset
+    bool get_alt_block_longhash(const std::list<blocks_ext_by_hash::iterator>& alt_chain, block_extended_info& bei, crypto::hash& proof_of_work);
+    crypto::hash get_alt_scratchpad_entry(uint64_t offset, const alt_scratchpad_state& alt_state, const main_line_patch_entry& main_line);
+    const main_line_patch_entry* get_main_line_patches(uint64_t connection_height);
+    bool get_main_block_scratchpad_patch(uint64_t height, std::map<uint64_t, crypto::hash>& patch);
+    void on_main_line_block_patch(uint64_t height, const std::map<uint64_t, crypto::hash>& patch, bool added);
     bool get_block_for_scratchpad_alt(uint64_t connection_height, uint64_t block_index, std::list<blockchain_storage::blocks_ext_by_hash::iterator>& alt_chain, block & b);
-    bool process_blockchain_tx_extra(const transaction& tx);
+    bool process_blockchain_tx_extra(const transaction& tx, block_undo_entry& undo);
     bool unprocess_blockchain_tx_extra(const transaction& tx);
     bool pop_alias_info(const alias_info& ai);
     bool put_alias_info(const alias_info& ai);
@@ -323,9 +475,10 @@ namespace currency
     bool get_required_donations_value_for_next_block(uint64_t& don_am); //applicable only for each CURRENCY_DONATIONS_INTERVAL-th block
     //void fill_addr_to_alias_dict();
     //bool resync_spent_tx_flags();
-    bool prune_ring_signatures_if_need();
     bool prune_ring_signatures(uint64_t height, uint64_t& transactions_pruned, uint64_t& signatures_pruned);
     bool check_instance(const std::string& data_dir);
+    bool update_chain_stats();
+    bool fill_chain_stats_entry(uint64_t height, chain_stats_entry& e);
   };
 
   /************************************************************************/
@@ -5,6 +5,7 @@
 #pragma once
 #include <unordered_set>
 #include <atomic>
+#include <memory>
 #include "net/net_utils_base.h"
 #include "copyable_atomic.h"
 
@@ -22,12 +23,20 @@ namespace currency
       state_normal
     };
 
+    enum import_status
+    {
+      import_in_progress = 0,
+      import_succeeded,
+      import_failed
+    };
+
     state m_state;
     std::list<crypto::hash> m_needed_objects;
     std::unordered_set<crypto::hash> m_requested_objects;
     uint64_t m_remote_blockchain_height;
     uint64_t m_last_response_height;
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
+    std::shared_ptr<std::atomic<int> > m_pending_import; //set while received blocks are imported off the network thread
     //size_t m_score;  TODO: add score calculations
   };
 
@@ -0,0 +1,78 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chrono>
+#include "include_base_utils.h"
+#include "misc_language.h"
+#include "crypto/crypto.h"
+using namespace epee;
+
+#include "core_events.h"
+
+namespace currency
+{
+  //---------------------------------------------------------------------------
+  uint32_t core_event_notifier::events_state::get_events_since(uint64_t since_token) const
+  {
+    if ((since_token >> 32) != (token >> 32))
+      return event_all;
+    uint32_t events = 0;
+    if (tip_token > since_token)
+      events |= event_tip_changed;
+    if (template_token > since_token)
+      events |= event_template_changed;
+    if (pool_token > since_token)
+      events |= event_pool_changed;
+    return events;
+  }
+  //---------------------------------------------------------------------------
+  core_event_notifier::core_event_notifier() : core_event_notifier(crypto::rand<uint32_t>() | 1)
+  {
+  }
+  //---------------------------------------------------------------------------
+  core_event_notifier::core_event_notifier(uint32_t epoch) : m_state(AUTO_VAL_INIT(m_state)), m_interrupted(false)
+  {
+    m_state.token = m_state.tip_token = m_state.template_token = m_state.pool_token = static_cast<uint64_t>(epoch) << 32;
+  }
+  //---------------------------------------------------------------------------
+  void core_event_notifier::notify(uint32_t events)
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      ++m_state.token;
+      if (events & event_tip_changed)
+        m_state.tip_token = m_state.token;
+      if (events & event_template_changed)
+        m_state.template_token = m_state.token;
+      if (events & event_pool_changed)
+        m_state.pool_token = m_state.token;
+    }
+    m_cond.notify_all();
+  }
+  //---------------------------------------------------------------------------
+  core_event_notifier::events_state core_event_notifier::get_state() const
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    return m_state;
+  }
+  //---------------------------------------------------------------------------
+  core_event_notifier::events_state core_event_notifier::wait_for_events(uint64_t since_token, uint32_t events_mask, uint64_t timeout_ms)
+  {
+    std::unique_lock<std::mutex> lk(m_lock);
+    m_cond.wait_for(lk, std::chrono::milliseconds(timeout_ms), [&]()
+    {
+      return m_interrupted || (m_state.get_events_since(since_token) & events_mask) != 0;
+    });
+    return m_state;
+  }
+  //---------------------------------------------------------------------------
+  void core_event_notifier::interrupt()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_interrupted = true;
+    }
+    m_cond.notify_all();
+  }
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <condition_variable>
+#include <mutex>
+
+namespace currency
+{
+  /************************************************************************/
+  /* Change notifications for long-poll subscribers (RPC)                 */
+  /* every event bumps a sequence number, subscribers pass the last seen  */
+  /* one back as a token and get woken up on anything newer               */
+  /* high 32 bits of token are epoch picked on start, so token issued     */
+  /* before daemon restart never looks like recent one                    */
+  /************************************************************************/
+  class core_event_notifier
+  {
+  public:
+    enum event_type
+    {
+      event_tip_changed      = 0x01,
+      event_template_changed = 0x02,
+      event_pool_changed     = 0x04,
+      event_all              = event_tip_changed | event_template_changed | event_pool_changed
+    };
+
+    struct events_state
+    {
+      uint64_t token;          // sequence number of the last event of any type
+      uint64_t tip_token;      // sequence number of the last event of each type
+      uint64_t template_token;
+      uint64_t pool_token;
+
+      // token of other epoch (or 0) reports all events
+      uint32_t get_events_since(uint64_t since_token) const;
+    };
+
+    core_event_notifier();
+    // epoch is given by tests only, must not be 0
+    explicit core_event_notifier(uint32_t epoch);
+    void notify(uint32_t events);
+    events_state get_state() const;
+    // blocks until one of events_mask happened after since_token, timeout or interrupt()
+    events_state wait_for_events(uint64_t since_token, uint32_t events_mask, uint64_t timeout_ms);
+    // wakes up all waiters and makes further waits return immediately, used on shutdown
+    void interrupt();
+
+  private:
+    mutable std::mutex m_lock;
+    std::condition_variable m_cond;
+    events_state m_state;
+    bool m_interrupted;
+  };
+}
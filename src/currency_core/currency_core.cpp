@@ -28,10 +28,12 @@ namespace currency
               m_mempool(m_blockchain_storage),
               m_blockchain_storage(m_mempool),
               m_miner(this, m_blockchain_storage),
+              m_view_key_scanner(m_blockchain_storage),
               m_miner_address(boost::value_initialized<account_public_address>()), 
               m_starter_message_showed(false)
   {
     set_currency_protocol(pprotocol);
+    m_mempool.set_event_notifier(&m_events);
   }
   void core::set_currency_protocol(i_currency_protocol* pprotocol)
   {
@@ -49,6 +51,7 @@ namespace currency
   void core::init_options(boost::program_options::options_description& desc)
   {
     blockchain_storage::init_options(desc);
+    view_key_scanner::init_options(desc);
   }
   //-----------------------------------------------------------------------------------------------
   std::string core::get_config_folder()
@@ -135,6 +138,9 @@ namespace currency
     r = m_miner.init(vm);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
+    r = m_view_key_scanner.init(vm, m_config_folder);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to initialize view key scanner");
+
     return load_state_data();
   }
   //-----------------------------------------------------------------------------------------------
@@ -151,8 +157,10 @@ namespace currency
   //-----------------------------------------------------------------------------------------------
     bool core::deinit()
   {
+    m_events.interrupt();
     m_miner.stop();
     m_miner.deinit();
+    m_view_key_scanner.deinit();
     m_mempool.deinit();
     m_blockchain_storage.deinit();
     return true;
@@ -388,7 +396,7 @@ namespace currency
   {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
     m_miner.pause();
-    m_blockchain_storage.add_new_block(b, bvc);
+    add_new_block(b, bvc);
     //anyway - update miner template
     update_miner_block_template();
     m_miner.resume();
@@ -433,7 +441,13 @@ namespace currency
   //-----------------------------------------------------------------------------------------------
   bool core::add_new_block(const block& b, block_verification_context& bvc)
   {
-    return m_blockchain_storage.add_new_block(b, bvc);
+    bool r = m_blockchain_storage.add_new_block(b, bvc);
+    if (bvc.m_added_to_main_chain)
+    {
+      m_events.notify(core_event_notifier::event_tip_changed);
+      m_view_key_scanner.on_new_block();
+    }
+    return r;
   }
   //-----------------------------------------------------------------------------------------------
   bool core::handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate)
@@ -521,6 +535,7 @@ namespace currency
   bool core::update_miner_block_template()
   {
     m_miner.on_block_chain_update();
+    m_events.notify(core_event_notifier::event_template_changed);
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -542,6 +557,7 @@ namespace currency
 
     //m_store_blockchain_interval.do_call([this](){return m_blockchain_storage.store_blockchain();});
     m_prune_alt_blocks_interval.do_call([this](){return m_blockchain_storage.prune_aged_alt_blocks();});
+    m_blockchain_storage.prune_ring_signatures_if_need();
     m_miner.on_idle();
     m_mempool.on_idle();
     return true;
@@ -14,6 +14,8 @@
 #include "tx_pool.h"
 #include "blockchain_storage.h"
 #include "miner.h"
+#include "core_events.h"
+#include "view_key_scanner.h"
 #include "connection_context.h"
 #include "currency_core/currency_stat_info.h"
 #include "warnings.h"
@@ -37,6 +39,8 @@ namespace currency
      bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate = true);
      i_currency_protocol* get_protocol(){return m_pprotocol;}
      tx_memory_pool& get_tx_pool(){ return m_mempool; };
+     core_event_notifier& get_event_notifier(){ return m_events; }
+     view_key_scanner& get_view_key_scanner(){ return m_view_key_scanner; }
 
      //-------------------- i_miner_handler -----------------------
      virtual bool handle_block_found( block& b);
@@ -117,12 +121,14 @@ namespace currency
      bool check_tx_inputs_keyimages_diff(const transaction& tx);
 
 
+     core_event_notifier m_events;
      tx_memory_pool m_mempool;
      blockchain_storage m_blockchain_storage;
      i_currency_protocol* m_pprotocol;
      critical_section m_incoming_tx_lock;
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner;
+     view_key_scanner m_view_key_scanner;
      account_public_address m_miner_address;
      std::string m_config_folder;
      currency_protocol_stub m_protocol_stub;
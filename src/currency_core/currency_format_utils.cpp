@@ -187,8 +187,12 @@ namespace currency
     crypto::key_derivation recv_derivation = AUTO_VAL_INIT(recv_derivation);
     bool r = crypto::generate_key_derivation(tx_public_key, ack.m_view_secret_key, recv_derivation);
     CHECK_AND_ASSERT_MES(r, false, "key image helper: failed to generate_key_derivation(" << tx_public_key << ", " << ack.m_view_secret_key << ")");
-
-    r = crypto::derive_public_key(recv_derivation, real_output_index, ack.m_account_address.m_spend_public_key, in_ephemeral.pub);
+    return generate_key_image_helper(ack, recv_derivation, real_output_index, in_ephemeral, ki);
+  }
+  //---------------------------------------------------------------
+  bool generate_key_image_helper(const account_keys& ack, const crypto::key_derivation& recv_derivation, size_t real_output_index, keypair& in_ephemeral, crypto::key_image& ki)
+  {
+    bool r = crypto::derive_public_key(recv_derivation, real_output_index, ack.m_account_address.m_spend_public_key, in_ephemeral.pub);
     CHECK_AND_ASSERT_MES(r, false, "key image helper: failed to derive_public_key(" << recv_derivation << ", " << real_output_index <<  ", " << ack.m_account_address.m_spend_public_key << ")");
 
     crypto::derive_secret_key(recv_derivation, real_output_index, ack.m_spend_secret_key, in_ephemeral.sec);
@@ -738,16 +742,35 @@ namespace currency
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     money_transfered = 0;
-    size_t i = 0;
-    BOOST_FOREACH(const tx_out& o,  tx.vout)
+    crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+    if (!generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation))
     {
-      CHECK_AND_ASSERT_MES(o.target.type() ==  typeid(txout_to_key), false, "wrong type id in transaction out" );
-      if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), tx_pub_key, i))
+      //malformed tx public key, none of outputs could be addressed to anyone
+      BOOST_FOREACH(const tx_out& o, tx.vout)
+        CHECK_AND_ASSERT_MES(o.target.type() == typeid(txout_to_key), false, "wrong type id in transaction out");
+      return true;
+    }
+    return lookup_acc_outs(derivation, acc.m_account_address.m_spend_public_key, tx, outs, money_transfered);
+  }
+  //---------------------------------------------------------------
+  bool lookup_acc_outs(const crypto::key_derivation& derivation, const crypto::public_key& spend_public_key, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered)
+  {
+    money_transfered = 0;
+    if (tx.vout.empty())
+      return true;
+    BOOST_FOREACH(const tx_out& o, tx.vout)
+      CHECK_AND_ASSERT_MES(o.target.type() == typeid(txout_to_key), false, "wrong type id in transaction out");
+
+    std::vector<crypto::public_key> keys(tx.vout.size());
+    bool r = crypto::derive_public_keys(derivation, 0, spend_public_key, &keys[0], keys.size());
+    CHECK_AND_ASSERT_MES(r, false, "failed to derive_public_keys(" << derivation << ", " << spend_public_key << ")");
+    for (size_t i = 0; i != tx.vout.size(); i++)
+    {
+      if (keys[i] == boost::get<txout_to_key>(tx.vout[i].target).key)
       {
         outs.push_back(i);
-        money_transfered += o.amount;
+        money_transfered += tx.vout[i].amount;
       }
-      i++;
     }
     return true;
   }
@@ -851,10 +874,15 @@ namespace currency
   //---------------------------------------------------------------
   crypto::hash get_blob_longhash_opt(const std::string& blob, const std::vector<crypto::hash>& scratchpad)
   {
-    if(!scratchpad.size())
-      return get_blob_longhash(blob, 0, scratchpad);
+    return get_blob_longhash_opt(blob, scratchpad.data(), scratchpad.size());
+  }
+  //------------------------------------------------------------------
+  crypto::hash get_blob_longhash_opt(const std::string& blob, const crypto::hash* scratchpad, size_t scratchpad_size)
+  {
+    if(!scratchpad_size)
+      return get_blob_longhash(blob, 0, std::vector<crypto::hash>());
     crypto::hash h2 = null_hash;
-    crypto::wild_keccak_dbl_opt(reinterpret_cast<const uint8_t*>(&blob[0]), blob.size(), reinterpret_cast<uint8_t*>(&h2), sizeof(h2), (const UINT64*)&scratchpad[0], scratchpad.size()*4);
+    crypto::wild_keccak_dbl_opt(reinterpret_cast<const uint8_t*>(&blob[0]), blob.size(), reinterpret_cast<uint8_t*>(&h2), sizeof(h2), (const UINT64*)scratchpad, scratchpad_size*4);
     return h2;
   }
 
@@ -0,0 +1,218 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fstream>
+#include <boost/filesystem.hpp>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "include_base_utils.h"
+using namespace epee;
+
+#include "currency_basic.h"
+#include "mapped_scratchpad.h"
+
+namespace currency
+{
+  namespace bip = boost::interprocess;
+  static_assert(sizeof(crypto::hash) == 32 && MAPPED_SCRATCHPAD_HEADER_SIZE % sizeof(crypto::hash) == 0, "entries have to be aligned");
+  //----------------------------------------------------------------------------------------------------
+  mapped_scratchpad::mapped_scratchpad() : m_read_only(true),
+                                           m_huge_pages(false),
+                                           m_header(nullptr),
+                                           m_data(nullptr),
+                                           m_size(0),
+                                           m_capacity(0)
+  {}
+  //----------------------------------------------------------------------------------------------------
+  mapped_scratchpad::~mapped_scratchpad()
+  {
+    close();
+  }
+  //----------------------------------------------------------------------------------------------------
+  void mapped_scratchpad::close()
+  {
+    bip::mapped_region().swap(m_region);
+    bip::file_mapping().swap(m_file);
+    m_header = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::open(const std::string& path, bool read_only, bool huge_pages)
+  {
+    close();
+    m_path = path;
+    m_read_only = read_only;
+    m_huge_pages = huge_pages;
+
+    boost::system::error_code ec;
+    if (!read_only && !boost::filesystem::exists(path, ec))
+    {
+      std::ofstream f(path, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+      CHECK_AND_ASSERT_MES(f.good(), false, "failed to create scratchpad file " << path);
+      f.close();
+      boost::filesystem::resize_file(path, MAPPED_SCRATCHPAD_GROW_STEP, ec);
+      CHECK_AND_ASSERT_MES(!ec, false, "failed to resize scratchpad file " << path << ": " << ec.message());
+    }
+
+    try
+    {
+      bip::file_mapping(path.c_str(), read_only ? bip::read_only : bip::read_write).swap(m_file);
+    }
+    catch (const bip::interprocess_exception& e)
+    {
+      LOG_ERROR("failed to open scratchpad file " << path << ": " << e.what());
+      return false;
+    }
+    if (!map_file())
+    {
+      close();
+      return false;
+    }
+
+    if (m_header->signature != MAPPED_SCRATCHPAD_SIGNATURE || m_header->version != MAPPED_SCRATCHPAD_VERSION || m_header->size > m_capacity)
+    {
+      if (read_only)
+      {
+        LOG_ERROR("scratchpad file " << path << " has wrong signature or version");
+        close();
+        return false;
+      }
+      //new or alien file, start over, it's not clean so owner fills it up from scratch
+      m_header->signature = MAPPED_SCRATCHPAD_SIGNATURE;
+      m_header->version = MAPPED_SCRATCHPAD_VERSION;
+      m_header->size = 0;
+      m_header->update_seq = 0;
+      m_header->clean = 0;
+    }
+    m_size = static_cast<size_t>(m_header->size.load());
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::map_file()
+  {
+    boost::system::error_code ec;
+    uint64_t file_size = boost::filesystem::file_size(m_path, ec);
+    CHECK_AND_ASSERT_MES(!ec && file_size >= MAPPED_SCRATCHPAD_HEADER_SIZE, false, "wrong scratchpad file " << m_path << " size " << file_size);
+    try
+    {
+      bip::mapped_region(m_file, m_read_only ? bip::read_only : bip::read_write, 0, static_cast<size_t>(file_size)).swap(m_region);
+    }
+    catch (const bip::interprocess_exception& e)
+    {
+      LOG_ERROR("failed to map scratchpad file " << m_path << ": " << e.what());
+      return false;
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    //effective on hugetlbfs/tmpfs mounts, files there are backed by huge pages anyway
+    if (m_huge_pages && madvise(m_region.get_address(), m_region.get_size(), MADV_HUGEPAGE))
+      LOG_PRINT_L1("madvise(MADV_HUGEPAGE) failed for scratchpad file " << m_path << ", errno " << errno);
+#endif
+    m_header = static_cast<header*>(m_region.get_address());
+    m_data = reinterpret_cast<crypto::hash*>(static_cast<char*>(m_region.get_address()) + MAPPED_SCRATCHPAD_HEADER_SIZE);
+    m_capacity = static_cast<size_t>((file_size - MAPPED_SCRATCHPAD_HEADER_SIZE) / sizeof(crypto::hash));
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::reserve(size_t count)
+  {
+    CHECK_AND_ASSERT_MES(is_open() && !m_read_only, false, "scratchpad file is not open for writing");
+    if (count <= m_capacity)
+      return true;
+
+    uint64_t file_size = MAPPED_SCRATCHPAD_HEADER_SIZE + static_cast<uint64_t>(count) * sizeof(crypto::hash);
+    file_size = (file_size + MAPPED_SCRATCHPAD_GROW_STEP - 1) / MAPPED_SCRATCHPAD_GROW_STEP * MAPPED_SCRATCHPAD_GROW_STEP;
+    bip::mapped_region().swap(m_region);
+    m_header = nullptr;
+    boost::system::error_code ec;
+    boost::filesystem::resize_file(m_path, file_size, ec);
+    if (ec)
+      LOG_ERROR("failed to grow scratchpad file " << m_path << " to " << file_size << " bytes: " << ec.message());
+    if (!map_file())
+    {
+      close();
+      return false;
+    }
+    return !ec;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::push_back(const crypto::hash& h)
+  {
+    if (!reserve(m_size + 1))
+      return false;
+    m_data[m_size++] = h;
+    m_header->size = m_size;
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::resize(size_t count)
+  {
+    if (!reserve(count))
+      return false;
+    for (size_t i = m_size; i < count; i++)
+      m_data[i] = null_hash;
+    m_size = count;
+    m_header->size = m_size;
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  void mapped_scratchpad::begin_update()
+  {
+    ++m_header->update_seq;
+  }
+  //----------------------------------------------------------------------------------------------------
+  void mapped_scratchpad::end_update()
+  {
+    ++m_header->update_seq;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::flush()
+  {
+    CHECK_AND_ASSERT_MES(is_open(), false, "scratchpad file is not open");
+    return m_region.flush(0, 0, false);
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::set_clean(bool clean)
+  {
+    CHECK_AND_ASSERT_MES(is_open() && !m_read_only, false, "scratchpad file is not open for writing");
+    //entries have to reach the disk before the mark saying they are complete
+    if (clean && !flush())
+      return false;
+    m_header->clean = clean ? 1 : 0;
+    return m_region.flush(0, MAPPED_SCRATCHPAD_HEADER_SIZE, false);
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::is_clean() const
+  {
+    return is_open() && m_header->clean == 1;
+  }
+  //----------------------------------------------------------------------------------------------------
+  bool mapped_scratchpad::refresh()
+  {
+    CHECK_AND_ASSERT_MES(is_open(), false, "scratchpad file is not open");
+    uint64_t size = m_header->size;
+    if (size > m_capacity)
+    {
+      //writer has grown the file
+      bip::mapped_region().swap(m_region);
+      m_header = nullptr;
+      if (!map_file())
+      {
+        close();
+        return false;
+      }
+      size = m_header->size;
+    }
+    m_size = static_cast<size_t>(std::min<uint64_t>(size, m_capacity));
+    return true;
+  }
+  //----------------------------------------------------------------------------------------------------
+  uint64_t mapped_scratchpad::get_update_seq() const
+  {
+    return m_header->update_seq;
+  }
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "crypto/hash.h"
+
+#define MAPPED_SCRATCHPAD_SIGNATURE               0x44415048524353ULL // "SCRHPAD"
+#define MAPPED_SCRATCHPAD_VERSION                 1
+#define MAPPED_SCRATCHPAD_HEADER_SIZE             4096
+#define MAPPED_SCRATCHPAD_GROW_STEP               (16 * 1024 * 1024) //multiple of huge page size, file size always is
+
+namespace currency
+{
+  /************************************************************************/
+  /* Scratchpad kept in a memory-mapped file, so it's not held in memory  */
+  /* twice (once per process) and is updated in place by block patches    */
+  /* instead of being written out on exit.                                */
+  /*                                                                      */
+  /* File layout: 4 KB header followed by entries. File only grows, in    */
+  /* steps of MAPPED_SCRATCHPAD_GROW_STEP, so a reader's mapping is never */
+  /* cut. Writer makes an update between begin_update() and end_update(), */
+  /* update counter is odd meanwhile. Readers (local miners) attach       */
+  /* read-only and call refresh() to see new size, hashes they made are   */
+  /* valid while update counter stays as it was at refresh().             */
+  /************************************************************************/
+  class mapped_scratchpad
+  {
+  public:
+    mapped_scratchpad();
+    ~mapped_scratchpad();
+
+    //creates missing file when opened for writing
+    bool open(const std::string& path, bool read_only, bool huge_pages);
+    void close();
+    bool is_open() const { return m_header != nullptr; }
+    const std::string& get_path() const { return m_path; }
+    bool is_huge_pages() const { return m_huge_pages; }
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    const crypto::hash& operator[](size_t i) const { return m_data[i]; }
+    const crypto::hash* data() const { return m_data; }
+    const crypto::hash* begin() const { return m_data; }
+    const crypto::hash* end() const { return m_data + m_size; }
+
+    //writer
+    bool reserve(size_t count);
+    bool push_back(const crypto::hash& h);
+    void set(size_t i, const crypto::hash& h) { m_data[i] = h; }
+    bool resize(size_t count);
+    void clear() { resize(0); }
+    void begin_update();
+    void end_update();
+    bool flush();
+    //set when file is closed right after flush, otherwise content may be torn by a crash
+    bool set_clean(bool clean);
+    bool is_clean() const;
+
+    //reader
+    bool refresh();
+    uint64_t get_update_seq() const;
+
+  private:
+    struct header
+    {
+      uint64_t signature;
+      uint64_t version;
+      std::atomic<uint64_t> size;
+      std::atomic<uint64_t> update_seq;
+      uint64_t clean;
+    };
+
+    mapped_scratchpad(const mapped_scratchpad&) = delete;
+    mapped_scratchpad& operator=(const mapped_scratchpad&) = delete;
+
+    bool map_file();
+
+    std::string m_path;
+    bool m_read_only;
+    bool m_huge_pages;
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mapped_region m_region;
+    header* m_header;
+    crypto::hash* m_data;
+    size_t m_size;
+    size_t m_capacity;
+  };
+}
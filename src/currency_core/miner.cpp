@@ -51,6 +51,7 @@ namespace currency
     m_starter_nonce(0), 
     m_do_print_hashrate(false),
     m_do_mining(false),
+    m_scratchpad_update_seq(0),
     m_current_hash_rate(0),
     m_last_hr_merge_time(0),
     m_hashes(0),
@@ -91,7 +92,10 @@ namespace currency
   bool miner::update_scratchpad()
   {
     EXCLUSIVE_CRITICAL_REGION_LOCAL(m_scratchpad_access);
-    return m_bc.copy_scratchpad(m_scratchpad);
+    if (!m_bc.attach_scratchpad(m_scratchpad))
+      return false;
+    m_scratchpad_update_seq = m_scratchpad.get_update_seq();
+    return true;
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::on_block_chain_update()
@@ -288,7 +292,11 @@ namespace currency
 
     if(!m_template_no)
       request_block_template();//lets update block template
-    update_scratchpad();
+    if(!update_scratchpad())
+    {
+      LOG_ERROR("Starting miner canceled: failed to attach scratchpad");
+      return false;
+    }
 
     boost::interprocess::ipcdetail::atomic_write32(&m_stop, 0);
     boost::interprocess::ipcdetail::atomic_write32(&m_thread_index, 0);
@@ -382,9 +390,6 @@ namespace currency
     block b;
     blobdata block_blob;
 
-    //for now have a copy of scratchpad for every thread
-    //temporary solution(to avoid slow synchronization while mining), will be changed in few weeks to use one 
-    //std::vector<crypto::hash> local_scratch_pad;
     while(!m_stop)
     {
       if(m_pausers_count)//anti split workaround
@@ -414,19 +419,24 @@ namespace currency
 
       *reinterpret_cast<uint64_t*>(&block_blob[1]) = nonce;
       crypto::hash h;
+      bool scratchpad_changed = true;
       SHARED_CRITICAL_REGION_BEGIN(m_scratchpad_access);
+      if(m_scratchpad.size())
+      {
 #if defined(WIN32)
-      h = get_blob_longhash_opt(block_blob, m_scratchpad);
+        h = get_blob_longhash_opt(block_blob, m_scratchpad.data(), m_scratchpad.size());
 #else
-      get_blob_longhash(block_blob, h, height, [&](uint64_t index) -> crypto::hash&
-      {
-        return m_scratchpad[index%m_scratchpad.size()];
-      });
+        get_blob_longhash(block_blob, h, height, [&](uint64_t index) -> const crypto::hash&
+        {
+          return m_scratchpad[index%m_scratchpad.size()];
+        });
 #endif
-
+        //core patches scratchpad in place, hash made over it meanwhile is garbage until update_scratchpad()
+        scratchpad_changed = m_scratchpad.get_update_seq() != m_scratchpad_update_seq;
+      }
       CRITICAL_REGION_END();
 
-      if(check_hash(h, local_diff))
+      if(!scratchpad_changed && check_hash(h, local_diff))
       {
         //we lucky!
         b.nonce = nonce;
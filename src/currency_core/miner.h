@@ -125,7 +125,8 @@ namespace currency
     critical_section m_aliace_to_apply_in_block_lock;
     
     boost::shared_mutex m_scratchpad_access;
-    std::vector<crypto::hash> m_scratchpad;
+    mapped_scratchpad m_scratchpad;     //read-only view of core's scratchpad file
+    uint64_t m_scratchpad_update_seq;   //hashes are valid while core didn't touch scratchpad since attaching
   };
 }
 
@@ -0,0 +1,85 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <thread>
+#include <algorithm>
+#include "include_base_utils.h"
+using namespace epee;
+
+#include "output_scanner.h"
+#include "currency_format_utils.h"
+
+#define OUTPUT_SCANNER_MIN_TXS_PER_THREAD      16
+
+namespace currency
+{
+  //---------------------------------------------------------------------------
+  size_t output_scanner::add_account(const account_public_address& addr, const crypto::secret_key& view_secret_key)
+  {
+    account_scan_keys k = AUTO_VAL_INIT(k);
+    k.view_secret_key = view_secret_key;
+    k.spend_public_key = addr.m_spend_public_key;
+    m_accounts.push_back(k);
+    return m_accounts.size() - 1;
+  }
+  //---------------------------------------------------------------------------
+  size_t output_scanner::add_account(const account_keys& keys)
+  {
+    return add_account(keys.m_account_address, keys.m_view_secret_key);
+  }
+  //---------------------------------------------------------------------------
+  size_t output_scanner::get_accounts_count() const
+  {
+    return m_accounts.size();
+  }
+  //---------------------------------------------------------------------------
+  void output_scanner::clear_accounts()
+  {
+    m_accounts.clear();
+  }
+  //---------------------------------------------------------------------------
+  bool output_scanner::scan_transaction(const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<account_outs>& found) const
+  {
+    for (size_t i = 0; i != m_accounts.size(); i++)
+    {
+      account_outs ao = AUTO_VAL_INIT(ao);
+      ao.account_index = i;
+      //malformed tx public key gives no derivation, nothing in such transaction could be addressed to anyone
+      if (!crypto::generate_key_derivation(tx_pub_key, m_accounts[i].view_secret_key, ao.derivation))
+        continue;
+      if (!lookup_acc_outs(ao.derivation, m_accounts[i].spend_public_key, tx, ao.outs, ao.money))
+        return false;
+      if (ao.outs.size())
+        found.push_back(ao);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  void output_scanner::scan_range(std::vector<tx_entry>& txs, size_t begin, size_t end) const
+  {
+    for (size_t i = begin; i != end; i++)
+    {
+      txs[i].found.clear();
+      txs[i].result = scan_transaction(*txs[i].ptx, txs[i].tx_pub_key, txs[i].found);
+    }
+  }
+  //---------------------------------------------------------------------------
+  void output_scanner::scan_transactions(std::vector<tx_entry>& txs, size_t threads_count) const
+  {
+    threads_count = std::min(threads_count, txs.size() / OUTPUT_SCANNER_MIN_TXS_PER_THREAD);
+    if (threads_count <= 1)
+    {
+      scan_range(txs, 0, txs.size());
+      return;
+    }
+
+    size_t chunk = (txs.size() + threads_count - 1) / threads_count;
+    std::vector<std::thread> workers;
+    for (size_t begin = chunk; begin < txs.size(); begin += chunk)
+      workers.push_back(std::thread([this, &txs, begin, chunk](){ scan_range(txs, begin, std::min(begin + chunk, txs.size())); }));
+    scan_range(txs, 0, std::min(chunk, txs.size()));
+    for (auto& w : workers)
+      w.join();
+  }
+}
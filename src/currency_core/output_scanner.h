@@ -0,0 +1,56 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <vector>
+#include "currency_basic.h"
+#include "account.h"
+
+namespace currency
+{
+  // Finds outputs of a set of accounts in transactions.
+  // Key derivation is computed once per transaction and account, then candidate keys of all
+  // outputs are derived in one go, so a transaction costs one scalar multiplication per account
+  // whatever number of outputs it has. Batches of transactions can be spread over several threads.
+  class output_scanner
+  {
+  public:
+    struct account_outs
+    {
+      size_t account_index;
+      crypto::key_derivation derivation;
+      std::vector<size_t> outs;
+      uint64_t money;
+    };
+
+    struct tx_entry
+    {
+      const transaction* ptx;
+      crypto::public_key tx_pub_key;
+      bool result;                      //false if transaction has outputs of unknown type
+      std::vector<account_outs> found;  //only accounts that got something
+    };
+
+    size_t add_account(const account_public_address& addr, const crypto::secret_key& view_secret_key);
+    size_t add_account(const account_keys& keys);
+    size_t get_accounts_count() const;
+    void clear_accounts();
+
+    bool scan_transaction(const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<account_outs>& found) const;
+    //threads_count is an upper bound, small batches are scanned in the calling thread
+    void scan_transactions(std::vector<tx_entry>& txs, size_t threads_count) const;
+
+  private:
+    struct account_scan_keys
+    {
+      crypto::secret_key view_secret_key;
+      crypto::public_key spend_public_key;
+    };
+
+    void scan_range(std::vector<tx_entry>& txs, size_t begin, size_t end) const;
+
+    std::vector<account_scan_keys> m_accounts;
+  };
+}
@@ -15,36 +15,42 @@ namespace currency
   {}
 
 
-  bool scratchpad_wrapper::init(const std::string& config_folder)
+  bool scratchpad_wrapper::init(const std::string& config_folder, const std::string& map_file_path, bool huge_pages)
   {
     m_config_folder = config_folder;
-    LOG_PRINT_MAGENTA("Loading scratchpad cache...", LOG_LEVEL_0);
-    bool success_from_cache = false;
-    if (epee::file_io_utils::load_file_to_vector(config_folder + "/" + CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE, m_scratchpad_cache) && m_scratchpad_cache.size())
-    {
-      LOG_PRINT_MAGENTA("from " << config_folder << "/" << CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE << " have just been loaded loaded " << m_scratchpad_cache.size() << " elements", LOG_LEVEL_1);
-      size_t sz = m_rdb_scratchpad.size();
-      if (sz == m_scratchpad_cache.size() && m_scratchpad_cache[m_scratchpad_cache.size() - 1] == m_rdb_scratchpad[m_rdb_scratchpad.size() - 1])
-      {
-        success_from_cache = true;
-        LOG_PRINT_MAGENTA("Scratchpad loaded from cache file OK (" << m_scratchpad_cache.size() << " elements, " << (m_scratchpad_cache.size() * 32) / 1024 << " KB)", LOG_LEVEL_0);
-      }
-    }
+    //full copy written on exit by previous versions, not used anymore
     boost::system::error_code ec;
-    boost::filesystem::remove(config_folder + "/" + CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE, ec); 
-    LOG_PRINT_MAGENTA(config_folder << "/" << CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE << " was removed, status: " << ec, LOG_LEVEL_1);
+    if (boost::filesystem::remove(config_folder + "/" + CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE, ec))
+      LOG_PRINT_MAGENTA(config_folder << "/" << CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE << " is not used anymore and was removed", LOG_LEVEL_0);
+
+    LOG_PRINT_MAGENTA("Opening scratchpad file " << map_file_path << (huge_pages ? " (huge pages)" : "") << "...", LOG_LEVEL_0);
+    bool res = m_scratchpad_cache.open(map_file_path, false, huge_pages);
+    CHECK_AND_ASSERT_MES(res, false, "failed to open scratchpad file " << map_file_path);
 
-    if (!success_from_cache)
+    size_t sz = m_rdb_scratchpad.size();
+    bool success_from_file = m_scratchpad_cache.is_clean() && m_scratchpad_cache.size() == sz
+      && (!sz || m_scratchpad_cache[sz - 1] == m_rdb_scratchpad[sz - 1]);
+    //from now on file is updated in place, crash would leave it unusable
+    res = m_scratchpad_cache.set_clean(false);
+    CHECK_AND_ASSERT_MES(res, false, "failed to update scratchpad file " << map_file_path);
+
+    if (success_from_file)
     {
-      LOG_PRINT_MAGENTA("Loading scratchpad from db...", LOG_LEVEL_0);
-      //load scratchpad from db to cache
-      PROF_L1_START(cache_load_timer);
-      bool res = m_rdb_scratchpad.load_all_itmes_to_container(m_scratchpad_cache);
-      CHECK_AND_ASSERT_MES(res, false, "scratchpad loading failed");
-      PROF_L1_FINISH(cache_load_timer);
-      LOG_PRINT_MAGENTA("Scratchpad loaded from db OK (" << m_scratchpad_cache.size() << "elements, " << (m_scratchpad_cache.size() * 32) / 1024 << " KB)" << PROF_L1_STR_MS_STR(" in ", cache_load_timer, " ms"), LOG_LEVEL_0);
+      LOG_PRINT_MAGENTA("Scratchpad loaded from file OK (" << m_scratchpad_cache.size() << " elements, " << (m_scratchpad_cache.size() * 32) / 1024 << " KB)", LOG_LEVEL_0);
+      return true;
     }
 
+    LOG_PRINT_MAGENTA("Loading scratchpad from db...", LOG_LEVEL_0);
+    PROF_L1_START(cache_load_timer);
+    std::vector<crypto::hash> scratchpad_db;
+    res = m_rdb_scratchpad.load_all_itmes_to_container(scratchpad_db);
+    CHECK_AND_ASSERT_MES(res, false, "scratchpad loading failed");
+    res = m_scratchpad_cache.resize(0) && m_scratchpad_cache.reserve(scratchpad_db.size());
+    CHECK_AND_ASSERT_MES(res, false, "failed to allocate " << scratchpad_db.size() << " elements in scratchpad file " << map_file_path);
+    for (const auto& h : scratchpad_db)
+      m_scratchpad_cache.push_back(h);
+    PROF_L1_FINISH(cache_load_timer);
+    LOG_PRINT_MAGENTA("Scratchpad loaded from db OK (" << m_scratchpad_cache.size() << "elements, " << (m_scratchpad_cache.size() * 32) / 1024 << " KB)" << PROF_L1_STR_MS_STR(" in ", cache_load_timer, " ms"), LOG_LEVEL_0);
     return true;
   }
 
@@ -53,26 +59,33 @@ namespace currency
 #ifdef SELF_VALIDATE_SCRATCHPAD
     std::vector<crypto::hash> scratchpad_cache;
     load_scratchpad_from_db(m_rdb_scratchpad, scratchpad_cache);
-    if (scratchpad_cache != m_scratchpad_cache)
+    std::vector<crypto::hash> scratchpad_mapped(m_scratchpad_cache.begin(), m_scratchpad_cache.end());
+    if (scratchpad_cache != scratchpad_mapped)
     {
       LOG_PRINT_L0("scratchpads mismatch, memory version: "
-        << ENDL << dump_scratchpad(m_scratchpad_cache)
+        << ENDL << dump_scratchpad(scratchpad_mapped)
         << ENDL << "db version:" << ENDL << dump_scratchpad(scratchpad_cache)
         );
     }
 #endif
-    epee::file_io_utils::save_buff_to_file(m_config_folder + "/" + CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE, &m_scratchpad_cache[0], m_scratchpad_cache.size()*sizeof(m_scratchpad_cache[0]));
-    LOG_PRINT_MAGENTA(m_scratchpad_cache.size() << " elements (" << m_scratchpad_cache.size() * sizeof(m_scratchpad_cache[0]) << " bytes)" << " has just been saved to " << m_config_folder << " / " << CURRENCY_BLOCKCHAINDATA_SCRATCHPAD_CACHE, LOG_LEVEL_1);
-    return true;
+    if (!m_scratchpad_cache.is_open())
+      return true;
+    //entries are already in place, only flushed and marked complete
+    bool res = m_scratchpad_cache.set_clean(true);
+    LOG_PRINT_MAGENTA("Scratchpad file " << m_scratchpad_cache.get_path() << " with " << m_scratchpad_cache.size() << " elements " << (res ? "closed" : "failed to flush"), LOG_LEVEL_1);
+    m_scratchpad_cache.close();
+    return res;
   }
 
   void scratchpad_wrapper::clear()
   {
+    m_scratchpad_cache.begin_update();
     m_scratchpad_cache.clear();
+    m_scratchpad_cache.end_update();
     m_rdb_scratchpad.clear();
   }
 
-  const std::vector<crypto::hash>& scratchpad_wrapper::get_scratchpad()
+  const mapped_scratchpad& scratchpad_wrapper::get_scratchpad()
   {
     return m_scratchpad_cache;
   }
@@ -86,25 +99,70 @@ namespace currency
   }
   bool scratchpad_wrapper::push_block_scratchpad_data(const block& b)
   {
-    bool res = currency::push_block_scratchpad_data(b, m_scratchpad_cache);
-    res &= currency::push_block_scratchpad_data(b, m_rdb_scratchpad);
+    std::map<uint64_t, crypto::hash> patch;
+    uint64_t addendum_size = 0;
+    return push_block_scratchpad_data(b, patch, addendum_size);
+  }
+
+  bool scratchpad_wrapper::push_block_scratchpad_data(const block& b, std::map<uint64_t, crypto::hash>& patch, uint64_t& addendum_size)
+  {
+    size_t inital_sz = m_scratchpad_cache.size();
+    std::vector<crypto::hash> addendum;
+    if (!get_block_scratchpad_addendum(b, addendum))
+      return false;
+    //file grows before the update starts, so it can't be left half done
+    CHECK_AND_ASSERT_MES(m_scratchpad_cache.reserve(inital_sz + addendum.size()), false, "failed to grow scratchpad file");
+
+    m_scratchpad_cache.begin_update();
+    for (const auto& h : addendum)
+      m_scratchpad_cache.push_back(h);
+    get_scratchpad_patch(inital_sz, inital_sz, m_scratchpad_cache.size(), m_scratchpad_cache, patch);
+    addendum_size = addendum.size();
+    apply_scratchpad_patch(m_scratchpad_cache, patch);
+    m_scratchpad_cache.end_update();
+
+    //patch touches only entries below inital size, so db is updated from cache without reading it
+    for (size_t i = inital_sz; i != m_scratchpad_cache.size(); i++)
+      m_rdb_scratchpad.push_back(m_scratchpad_cache[i]);
+    for (const auto& p : patch)
+      m_rdb_scratchpad.set(p.first, m_scratchpad_cache[p.first]);
 #ifdef SELF_VALIDATE_SCRATCHPAD
     std::vector<crypto::hash> scratchpad_cache;
     load_scratchpad_from_db(m_rdb_scratchpad, scratchpad_cache);
-    if (scratchpad_cache != m_scratchpad_cache)
+    std::vector<crypto::hash> scratchpad_mapped(m_scratchpad_cache.begin(), m_scratchpad_cache.end());
+    if (scratchpad_cache != scratchpad_mapped)
     {
       LOG_PRINT_L0("scratchpads mismatch, memory version: "
-        << ENDL << dump_scratchpad(m_scratchpad_cache)
+        << ENDL << dump_scratchpad(scratchpad_mapped)
         << ENDL << "db version:" << ENDL << dump_scratchpad(scratchpad_cache)
         );
     }
 #endif
-    return res;
+    return true;
+  }
+
+  bool scratchpad_wrapper::pop_block_scratchpad_data(std::map<uint64_t, crypto::hash>& patch, uint64_t addendum_size)
+  {
+    CHECK_AND_ASSERT_MES(addendum_size <= m_scratchpad_cache.size(), false, "addendum size " << addendum_size << " is bigger than scratchpad size " << m_scratchpad_cache.size());
+    size_t new_sz = m_scratchpad_cache.size() - addendum_size;
+    CHECK_AND_ASSERT_MES(patch.empty() || patch.rbegin()->first < new_sz, false, "patch index " << patch.rbegin()->first << " is out of scratchpad size " << new_sz);
+
+    //xor patch undoes itself
+    m_scratchpad_cache.begin_update();
+    apply_scratchpad_patch(m_scratchpad_cache, patch);
+    m_scratchpad_cache.resize(new_sz);
+    m_scratchpad_cache.end_update();
+    for (const auto& p : patch)
+      m_rdb_scratchpad.set(p.first, m_scratchpad_cache[p.first]);
+    m_rdb_scratchpad.resize(m_scratchpad_cache.size());
+    return true;
   }
 
   bool scratchpad_wrapper::pop_block_scratchpad_data(const block& b)
   {
+    m_scratchpad_cache.begin_update();
     bool res = currency::pop_block_scratchpad_data(b, m_scratchpad_cache);
+    m_scratchpad_cache.end_update();
     res &= currency::pop_block_scratchpad_data(b, m_rdb_scratchpad);
     return res;
   }
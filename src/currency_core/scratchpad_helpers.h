@@ -9,6 +9,7 @@
 #include "currency_core/currency_format_utils.h"
 #include "crypto/hash.h"
 #include "common/db_bridge.h"
+#include "mapped_scratchpad.h"
 
 
 namespace currency
@@ -20,16 +21,19 @@ namespace currency
     typedef db::array_accessor_adapter_to_native<crypto::hash, false> scratchpad_container;
 
     scratchpad_wrapper(scratchpad_container& m_db_scratchpad);
-    bool init(const std::string& config_folder);
+    bool init(const std::string& config_folder, const std::string& map_file_path, bool huge_pages);
     bool deinit();
     void clear();
-    const std::vector<crypto::hash>& get_scratchpad();
+    const mapped_scratchpad& get_scratchpad();
     void set_scratchpad(const std::vector<crypto::hash>& sc);
     bool push_block_scratchpad_data(const block& b);
     bool pop_block_scratchpad_data(const block& b);
+    //also returns patch applied to existing entries and count of appended entries, enough to pop block without it
+    bool push_block_scratchpad_data(const block& b, std::map<uint64_t, crypto::hash>& patch, uint64_t& addendum_size);
+    bool pop_block_scratchpad_data(std::map<uint64_t, crypto::hash>& patch, uint64_t addendum_size);
 
   private:
-    std::vector<crypto::hash> m_scratchpad_cache;
+    mapped_scratchpad m_scratchpad_cache;
     scratchpad_container& m_rdb_scratchpad;
     std::string m_config_folder;
   };
@@ -57,6 +61,17 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------
+  //xors into dst entries of src patch that lay under limit
+  inline void merge_scratchpad_patch(std::map<uint64_t, crypto::hash>& dst, const std::map<uint64_t, crypto::hash>& src, uint64_t limit)
+  {
+    for (const auto& p : src)
+    {
+      if (p.first >= limit)
+        break;
+      dst[p.first] = crypto::xor_pod(dst[p.first], p.second);
+    }
+  }
+  //------------------------------------------------------------------
   template<class t_container>
   bool get_block_scratchpad_addendum(const block& b, t_container& res)
   {
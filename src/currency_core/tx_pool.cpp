@@ -20,12 +20,25 @@
 
 DISABLE_VS_WARNINGS(4244 4345 4503) //'boost::foreach_detail_::or_' : decorated name length exceeded, name was truncated
 
+#define TX_POOL_JOURNAL_MIN_COMPACTION_RECORDS  1000
+
 namespace currency
 {
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_blockchain(bchs)
+  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_blockchain(bchs), m_pevents(nullptr), m_revalidate_restored(false)
   {
 
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::set_event_notifier(core_event_notifier* pevents)
+  {
+    m_pevents = pevents;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::notify_pool_changed()
+  {
+    if (m_pevents)
+      m_pevents->notify(core_event_notifier::event_pool_changed);
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(const transaction &tx, const crypto::hash &id, tx_verification_context& tvc, bool kept_by_block)
@@ -139,7 +152,9 @@ namespace currency
       CHECK_AND_ASSERT_MES(ins_res.second, false, "internal error: try to insert duplicate iterator in key_image set");
     }
 
+    journal_tx_added(id, m_transactions[id]);
     tvc.m_verifivation_failed = false;
+    notify_pool_changed();
     //succeed
     return true;
   }
@@ -190,17 +205,26 @@ namespace currency
     fee = it->second.fee;
     remove_transaction_keyimages(it->second.tx);
     m_transactions.erase(it);
+    journal_tx_removed(id);
+    notify_pool_changed();
     return true;
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::on_idle()
   {
+    if (m_revalidate_restored)
+    {
+      m_revalidate_restored = false;
+      remove_restored_outdated_transactions();
+    }
     m_remove_stuck_tx_interval.do_call([this](){return remove_stuck_transactions();});
+    m_journal_sync_interval.do_call([this](){return sync_journal();});
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::remove_stuck_transactions()
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
+    size_t removed_count = 0;
     for(auto it = m_transactions.begin(); it!= m_transactions.end();)
     {
       uint64_t tx_age = time(nullptr) - it->second.receive_time;
@@ -210,10 +234,14 @@ namespace currency
       {
         LOG_PRINT_L0("Tx " << it->first << " removed from tx pool due to outdated, age: " << tx_age );
         remove_transaction_keyimages(it->second.tx);
+        journal_tx_removed(it->first);
         m_transactions.erase(it++);
+        ++removed_count;
       }else
         ++it;
     }
+    if (removed_count)
+      notify_pool_changed();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -293,6 +321,8 @@ namespace currency
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_transactions.clear();
     m_spent_key_images.clear();
+    compact_journal();
+    notify_pool_changed();
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::is_transaction_ready_to_go(tx_details& txd)
@@ -487,42 +517,164 @@ namespace currency
   bool tx_memory_pool::init(const std::string& config_folder)
   {
     m_config_folder = config_folder;
+    bool res = true;
+    //state file written on exit by previous versions
     std::string state_file_path = config_folder + "/" + CURRENCY_POOLDATA_FILENAME;
     boost::system::error_code ec;
-    if(!boost::filesystem::exists(state_file_path, ec))
-      return true;
-    bool res = tools::unserialize_obj_from_file(*this, state_file_path);
-    if (res)
+    if(boost::filesystem::exists(state_file_path, ec))
     {
-      // mem pool has just been successfully loaded from file
-      // delete pool file to avoid loading outdated data on the next load (in case a crash happen for ex.)
-      if (!boost::filesystem::remove_all(state_file_path))
+      res = tools::unserialize_obj_from_file(*this, state_file_path);
+      if (res)
       {
-        LOG_ERROR("failed to remove pool file " << state_file_path << " after a successful load");
+        // mem pool has just been successfully loaded from file, it goes to the journal below
+        if (!boost::filesystem::remove_all(state_file_path))
+        {
+          LOG_ERROR("failed to remove pool file " << state_file_path << " after a successful load");
+        }
+      }
+      else
+      {
+        LOG_ERROR("Failed to load memory pool from file " << state_file_path);
       }
     }
-    else
+
+    if (!tools::create_directories_if_necessary(m_config_folder))
     {
-      LOG_ERROR("Failed to load memory pool from file " << state_file_path);
+      LOG_PRINT_L0("Failed to create data directory: " << m_config_folder);
+      return false;
     }
+
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    std::string journal_path = m_config_folder + "/" + CURRENCY_POOLJOURNAL_FILENAME;
+    uint64_t records_replayed = 0;
+    bool r = m_journal.replay_and_open(journal_path, [this](uint8_t type, const std::string& payload)
+    {
+      return apply_journal_record(type, payload);
+    }, records_replayed);
+    if (!r)
+      LOG_ERROR("Failed to open memory pool journal " << journal_path << ", pool changes are not persisted");
+    rebuild_key_images();
+    //start over with only live transactions in journal
+    compact_journal();
+    m_revalidate_restored = m_transactions.size() != 0;
+    LOG_PRINT_L0("Memory pool loaded: " << m_transactions.size() << " transactions, " << records_replayed << " journal records replayed");
     return res;
   }
-
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
-    if (!tools::create_directories_if_necessary(m_config_folder))
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (!compact_journal())
     {
-      LOG_PRINT_L0("Failed to create data directory: " << m_config_folder);
+      LOG_PRINT_L0("Failed to store memory pool journal to " << m_config_folder);
+    }
+    m_journal.close();
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::journal_tx_added(const crypto::hash& id, const tx_details& txd)
+  {
+    if (!m_journal.is_open())
+      return; // compaction on idle starts the journal over
+    m_journal.append(TX_POOL_JOURNAL_TX_ADDED, tx_pool_journal::pack(id, txd, txd.kept_by_block));
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::journal_tx_removed(const crypto::hash& id)
+  {
+    if (!m_journal.is_open())
+      return;
+    m_journal.append(TX_POOL_JOURNAL_TX_REMOVED, tx_pool_journal::pack(id));
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::apply_journal_record(uint8_t type, const std::string& payload)
+  {
+    try
+    {
+      crypto::hash id = null_hash;
+      switch (type)
+      {
+      case TX_POOL_JOURNAL_TX_ADDED:
+      {
+        tx_details txd = AUTO_VAL_INIT(txd);
+        tx_pool_journal::unpack(payload, id, txd, txd.kept_by_block);
+        m_transactions[id] = txd;
+        return true;
+      }
+      case TX_POOL_JOURNAL_TX_REMOVED:
+        tx_pool_journal::unpack(payload, id);
+        m_transactions.erase(id);
+        return true;
+      default:
+        LOG_ERROR("unknown pool journal record type " << static_cast<uint32_t>(type));
+        return false;
+      }
+    }
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("failed to unpack pool journal record: " << e.what());
       return false;
     }
-
-    std::string state_file_path = m_config_folder + "/" + CURRENCY_POOLDATA_FILENAME;
-    bool res = tools::serialize_obj_to_file(*this, state_file_path);
-    if(!res)
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::compact_journal()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_config_folder.empty())
+      return false;
+    std::vector<tx_pool_journal::record> records;
+    records.reserve(m_transactions.size());
+    for (const auto& tx_vt : m_transactions)
+      records.push_back(tx_pool_journal::record(TX_POOL_JOURNAL_TX_ADDED, tx_pool_journal::pack(tx_vt.first, tx_vt.second, tx_vt.second.kept_by_block)));
+    return m_journal.rewrite(m_config_folder + "/" + CURRENCY_POOLJOURNAL_FILENAME, records);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::sync_journal()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_config_folder.empty())
+      return true;
+    //removals leave dead records behind, rewrite journal once they dominate
+    if (!m_journal.is_open() || m_journal.get_records_count() > TX_POOL_JOURNAL_MIN_COMPACTION_RECORDS + 2 * m_transactions.size())
+      return compact_journal();
+    return m_journal.sync();
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::rebuild_key_images()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_spent_key_images.clear();
+    for (const auto& tx_vt : m_transactions)
     {
-      LOG_PRINT_L0("Failed to serialize memory pool to file " << state_file_path);
+      for (const auto& in : tx_vt.second.tx.vin)
+      {
+        CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, txin, false);
+        m_spent_key_images[txin.k_image].insert(tx_vt.first);
+      }
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::remove_restored_outdated_transactions()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    size_t removed_count = 0;
+    for (auto it = m_transactions.begin(); it != m_transactions.end();)
+    {
+      //verification results (max_used_block_id, last_failed_id) are kept and rechecked lazily by is_transaction_ready_to_go()
+      if (m_blockchain.have_tx(it->first) || (!it->second.kept_by_block && m_blockchain.have_tx_keyimges_as_spent(it->second.tx)))
+      {
+        LOG_PRINT_L1("Restored tx " << it->first << " removed from tx pool: already in blockchain or uses spent key images");
+        remove_transaction_keyimages(it->second.tx);
+        journal_tx_removed(it->first);
+        m_transactions.erase(it++);
+        ++removed_count;
+      }
+      else
+        ++it;
     }
+    if (removed_count)
+      notify_pool_changed();
+    LOG_PRINT_L0("Restored memory pool checked against blockchain, " << removed_count << " transactions removed");
     return true;
   }
 }
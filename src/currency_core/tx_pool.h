@@ -20,6 +20,8 @@ using namespace epee;
 #include "verification_context.h"
 #include "crypto/hash.h"
 #include "common/boost_serialization_helper.h"
+#include "core_events.h"
+#include "tx_pool_journal.h"
 
 
 namespace currency
@@ -33,6 +35,7 @@ namespace currency
   {
   public:
     tx_memory_pool(blockchain_storage& bchs);
+    void set_event_notifier(core_event_notifier* pevents);
     bool add_tx(const transaction &tx, const crypto::hash &id, tx_verification_context& tvc, bool keeped_by_block);
     bool add_tx(const transaction &tx, tx_verification_context& tvc, bool keeped_by_block);
     //gets tx and remove it from pool
@@ -98,7 +101,15 @@ namespace currency
 
   private:
     bool remove_stuck_transactions();
+    void notify_pool_changed();
     bool is_transaction_ready_to_go(tx_details& txd);
+    void journal_tx_added(const crypto::hash& id, const tx_details& txd);
+    void journal_tx_removed(const crypto::hash& id);
+    bool apply_journal_record(uint8_t type, const std::string& payload);
+    bool compact_journal();
+    bool sync_journal();
+    bool rebuild_key_images();
+    bool remove_restored_outdated_transactions();
     typedef std::unordered_map<crypto::hash, tx_details > transactions_container;
     typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
 
@@ -107,11 +118,17 @@ namespace currency
     key_images_container m_spent_key_images;
     
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
+    //every admission and removal goes to journal, so pool survives a crash
+    tx_pool_journal m_journal;
+    epee::math_helper::once_a_time_seconds<10> m_journal_sync_interval;
+    //transactions loaded on start are checked against blockchain once it's loaded too
+    bool m_revalidate_restored;
 
     //transactions_container m_alternative_transactions;
 
     std::string m_config_folder;
     blockchain_storage& m_blockchain;
+    core_event_notifier* m_pevents;
     /************************************************************************/
     /*                                                                      */
     /************************************************************************/
@@ -0,0 +1,45 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include "common/journal_file.h"
+
+#define TX_POOL_JOURNAL_SIGNATURE                 0x4c4e524a4c4f4f50ULL // "POOLJRNL"
+#define TX_POOL_JOURNAL_VERSION                   1
+#define TX_POOL_JOURNAL_MAX_RECORD_SIZE           (64 * 1024 * 1024)
+
+#define TX_POOL_JOURNAL_TX_ADDED                  1  // tx id, tx_details, kept_by_block
+#define TX_POOL_JOURNAL_TX_REMOVED                2  // tx id
+
+namespace currency
+{
+  /************************************************************************/
+  /* Append-only log of memory pool changes, tagged with format version.  */
+  /* Every record is handed over to the OS right away, so it survives a   */
+  /* crash of the process, sync() makes it survive a power loss.          */
+  /************************************************************************/
+  class tx_pool_journal: public tools::journal_file
+  {
+  public:
+    tx_pool_journal() : journal_file(TX_POOL_JOURNAL_SIGNATURE, TX_POOL_JOURNAL_MAX_RECORD_SIZE, "pool journal")
+    {}
+
+    bool replay_and_open(const std::string& path, record_handler_t handler, uint64_t& records_replayed)
+    {
+      return journal_file::replay_and_open(path, TX_POOL_JOURNAL_VERSION, handler, records_replayed);
+    }
+
+    bool rewrite(const std::string& path, const std::vector<record>& records)
+    {
+      return journal_file::rewrite(path, TX_POOL_JOURNAL_VERSION, records);
+    }
+
+    bool append(uint8_t type, const std::string& payload)
+    {
+      add_record(type, payload);
+      return commit(false);
+    }
+  };
+}
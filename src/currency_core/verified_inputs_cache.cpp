@@ -0,0 +1,79 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "include_base_utils.h"
+using namespace epee;
+
+#include "verified_inputs_cache.h"
+#include "crypto/hash.h"
+
+namespace currency
+{
+  //---------------------------------------------------------------------------
+  verified_inputs_cache::verified_inputs_cache(size_t max_size) : m_max_size(max_size), m_hits(0), m_misses(0)
+  {}
+  //---------------------------------------------------------------------------
+  crypto::hash verified_inputs_cache::make_key(const crypto::hash& tx_prefix_hash, const txin_to_key& txin, const std::vector<crypto::public_key>& output_keys, const std::vector<crypto::signature>& sig)
+  {
+    std::string blob;
+    blob.reserve(sizeof(tx_prefix_hash) + sizeof(txin.k_image) + output_keys.size() * sizeof(crypto::public_key) + sig.size() * sizeof(crypto::signature));
+    string_tools::apped_pod_to_strbuff(blob, tx_prefix_hash);
+    string_tools::apped_pod_to_strbuff(blob, txin.k_image);
+    for (const auto& k : output_keys)
+      string_tools::apped_pod_to_strbuff(blob, k);
+    for (const auto& s : sig)
+      string_tools::apped_pod_to_strbuff(blob, s);
+    return crypto::cn_fast_hash(blob.data(), blob.size());
+  }
+  //---------------------------------------------------------------------------
+  bool verified_inputs_cache::has(const crypto::hash& key) const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (m_keys.count(key))
+    {
+      ++m_hits;
+      return true;
+    }
+    ++m_misses;
+    return false;
+  }
+  //---------------------------------------------------------------------------
+  void verified_inputs_cache::add(const crypto::hash& key)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (!m_max_size || !m_keys.insert(key).second)
+      return;
+    m_order.push_back(key);
+    shrink(m_max_size);
+  }
+  //---------------------------------------------------------------------------
+  void verified_inputs_cache::clear()
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_keys.clear();
+    m_order.clear();
+  }
+  //---------------------------------------------------------------------------
+  void verified_inputs_cache::set_max_size(size_t max_size)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_max_size = max_size;
+    shrink(m_max_size);
+  }
+  //---------------------------------------------------------------------------
+  size_t verified_inputs_cache::size() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_keys.size();
+  }
+  //---------------------------------------------------------------------------
+  void verified_inputs_cache::shrink(size_t max_size)
+  {
+    while (m_order.size() > max_size)
+    {
+      m_keys.erase(m_order.front());
+      m_order.pop_front();
+    }
+  }
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <unordered_set>
+#include "syncobj.h"
+#include "currency_basic.h"
+
+namespace currency
+{
+  // Remembers inputs whose ring signature was checked successfully, so a transaction verified
+  // when it came to the pool is not verified again when it comes in a block or is reconnected
+  // on chain switching. Key covers everything the signature check depends on: prefix hash,
+  // key image, resolved ring member keys and signatures. Oldest entries are evicted first.
+  class verified_inputs_cache
+  {
+  public:
+    verified_inputs_cache(size_t max_size);
+
+    static crypto::hash make_key(const crypto::hash& tx_prefix_hash, const txin_to_key& txin, const std::vector<crypto::public_key>& output_keys, const std::vector<crypto::signature>& sig);
+
+    bool has(const crypto::hash& key) const;
+    void add(const crypto::hash& key);
+    void clear();
+    void set_max_size(size_t max_size);
+    size_t size() const;
+    uint64_t get_hits_count() const { return m_hits; }
+    uint64_t get_misses_count() const { return m_misses; }
+
+  private:
+    void shrink(size_t max_size);
+
+    mutable epee::critical_section m_lock;
+    std::unordered_set<crypto::hash> m_keys;
+    std::deque<crypto::hash> m_order;           //oldest first
+    size_t m_max_size;
+    //read without m_lock by stats getters
+    mutable std::atomic<uint64_t> m_hits;
+    mutable std::atomic<uint64_t> m_misses;
+  };
+}
@@ -0,0 +1,446 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <chrono>
+#include <boost/foreach.hpp>
+#include "include_base_utils.h"
+#include "file_io_utils.h"
+#include "storages/portable_storage_template_helper.h"
+#include "metrics_registry.h"
+using namespace epee;
+
+#include "view_key_scanner.h"
+#include "blockchain_storage.h"
+#include "currency_format_utils.h"
+#include "output_scanner.h"
+#include "common/command_line.h"
+
+#define VIEW_KEY_SCANNER_STATE_FILENAME       "view_key_scanner.bin"
+#define VIEW_KEY_SCANNER_BATCH_BLOCKS         200
+#define VIEW_KEY_SCANNER_REORG_DEPTH          720
+#define VIEW_KEY_SCANNER_IDLE_WAIT_MS         1000
+
+namespace currency
+{
+  namespace
+  {
+    const command_line::arg_descriptor<bool>     arg_enable_view_key_scanner =    {"enable-view-key-scanner", "Scan blocks for outputs of accounts registered over (unrestricted) RPC"};
+    const command_line::arg_descriptor<uint64_t> arg_view_key_scanner_threads =   {"view-key-scanner-threads", "Threads scanning a batch of blocks, 0 - number of cores", 0};
+    const command_line::arg_descriptor<uint64_t> arg_view_key_scanner_accounts =  {"view-key-scanner-max-accounts", "Max accounts registered in view key scanner", 10000};
+
+    class blockchain_storage_chain : public i_view_key_scanner_chain
+    {
+    public:
+      blockchain_storage_chain(blockchain_storage& bcs) : m_bcs(bcs)
+      {}
+      virtual uint64_t get_current_blockchain_height() { return m_bcs.get_current_blockchain_height(); }
+      virtual crypto::hash get_block_id_by_height(uint64_t height) { return m_bcs.get_block_id_by_height(height); }
+      virtual bool get_blocks(uint64_t start_offset, size_t count, std::list<block>& blocks, std::list<transaction>& txs) { return m_bcs.get_blocks(start_offset, count, blocks, txs); }
+      virtual bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) { return m_bcs.get_tx_outputs_gindexs(tx_id, indexs); }
+    private:
+      blockchain_storage& m_bcs;
+    };
+  }
+  //---------------------------------------------------------------------------
+  view_key_scanner::view_key_scanner(blockchain_storage& bcs) : m_bcs_chain(new blockchain_storage_chain(bcs)),
+                                                                m_chain(*m_bcs_chain),
+                                                                m_enabled(false),
+                                                                m_threads_count(1),
+                                                                m_max_accounts(0),
+                                                                m_registrations_count(0),
+                                                                m_recent_ids_start(0),
+                                                                m_run(false),
+                                                                m_have_new_blocks(false)
+  {}
+  //---------------------------------------------------------------------------
+  view_key_scanner::view_key_scanner(i_view_key_scanner_chain& chain) : m_chain(chain),
+                                                                        m_enabled(false),
+                                                                        m_threads_count(1),
+                                                                        m_max_accounts(0),
+                                                                        m_registrations_count(0),
+                                                                        m_recent_ids_start(0),
+                                                                        m_run(false),
+                                                                        m_have_new_blocks(false)
+  {}
+  //---------------------------------------------------------------------------
+  void view_key_scanner::init_options(boost::program_options::options_description& desc)
+  {
+    command_line::add_arg(desc, arg_enable_view_key_scanner);
+    command_line::add_arg(desc, arg_view_key_scanner_threads);
+    command_line::add_arg(desc, arg_view_key_scanner_accounts);
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::init(const boost::program_options::variables_map& vm, const std::string& config_folder)
+  {
+    if (!command_line::get_arg(vm, arg_enable_view_key_scanner))
+      return true;
+
+    size_t threads_count = static_cast<size_t>(command_line::get_arg(vm, arg_view_key_scanner_threads));
+    if (!threads_count)
+      threads_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    size_t max_accounts = static_cast<size_t>(command_line::get_arg(vm, arg_view_key_scanner_accounts));
+    return init(threads_count, max_accounts, config_folder + "/" + VIEW_KEY_SCANNER_STATE_FILENAME, true);
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::init(size_t threads_count, size_t max_accounts, const std::string& state_file_path, bool start_worker)
+  {
+    m_enabled = true;
+    m_threads_count = threads_count;
+    m_max_accounts = max_accounts;
+    m_state_file_path = state_file_path;
+    if (m_state_file_path.size() && !load_state())
+      LOG_PRINT_RED_L0("Failed to load view key scanner state from " << m_state_file_path << ", starting with no accounts");
+
+    m_run = true;
+    if (start_worker)
+      m_worker_thread = std::thread([this](){ worker(); });
+    LOG_PRINT_L0("View key scanner started with " << m_accounts.size() << " accounts, " << m_threads_count << " threads");
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::deinit()
+  {
+    if (!m_enabled)
+      return true;
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_run = false;
+      m_wakeup.notify_all();
+    }
+    if (m_worker_thread.joinable())
+      m_worker_thread.join();
+    if (m_state_file_path.empty())
+      return true;
+    return store_state();
+  }
+  //---------------------------------------------------------------------------
+  void view_key_scanner::on_new_block()
+  {
+    if (!m_enabled)
+      return;
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_have_new_blocks = true;
+    m_wakeup.notify_all();
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::register_account(const account_public_address& addr, const crypto::secret_key& view_secret_key, uint64_t start_height, std::string& err)
+  {
+    crypto::public_key view_public_key = AUTO_VAL_INIT(view_public_key);
+    if (!crypto::secret_key_to_public_key(view_secret_key, view_public_key) || view_public_key != addr.m_view_public_key)
+    {
+      err = "view secret key doesn't match address";
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lk(m_lock);
+    std::string addr_str = get_account_address_as_str(addr);
+    if (m_accounts.count(addr_str))
+      return true;
+    if (m_accounts.size() >= m_max_accounts)
+    {
+      err = "too many accounts";
+      return false;
+    }
+    account_entry& ae = m_accounts[addr_str];
+    ae.addr = addr;
+    ae.view_secret_key = view_secret_key;
+    ae.start_height = start_height;
+    ae.scanned_height = start_height;
+    ae.registration = ++m_registrations_count;
+    m_have_new_blocks = true;
+    m_wakeup.notify_all();
+    LOG_PRINT_L0("View key scanner: registered " << addr_str << " from height " << start_height);
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::unregister_account(const account_public_address& addr)
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    return m_accounts.erase(get_account_address_as_str(addr)) != 0;
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::get_outputs(const account_public_address& addr, uint64_t offset, size_t count, std::list<view_key_scanner_output>& outs, uint64_t& total_outs, uint64_t& scanned_height)
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    auto it = m_accounts.find(get_account_address_as_str(addr));
+    if (it == m_accounts.end())
+      return false;
+    const account_entry& ae = it->second;
+    total_outs = ae.outs.size();
+    scanned_height = ae.scanned_height;
+    for (uint64_t i = offset; i < ae.outs.size() && outs.size() < count; i++)
+      outs.push_back(ae.outs[i]);
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  size_t view_key_scanner::get_accounts_count()
+  {
+    std::lock_guard<std::mutex> lk(m_lock);
+    return m_accounts.size();
+  }
+  //---------------------------------------------------------------------------
+  void view_key_scanner::worker()
+  {
+    while (m_run)
+    {
+      m_store_interval.do_call([this](){ return store_state(); });
+      if (do_scan_pass())
+        continue;
+
+      std::unique_lock<std::mutex> lk(m_lock);
+      if (!m_have_new_blocks && m_run)
+        m_wakeup.wait_for(lk, std::chrono::milliseconds(VIEW_KEY_SCANNER_IDLE_WAIT_MS));
+      m_have_new_blocks = false;
+    }
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::do_scan_pass()
+  {
+    check_reorg();
+    return scan_next();
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::scan_next()
+  {
+    uint64_t height = m_chain.get_current_blockchain_height();
+    uint64_t backfill_border = height > VIEW_KEY_SCANNER_BATCH_BLOCKS ? height - VIEW_KEY_SCANNER_BATCH_BLOCKS : 0;
+    uint64_t live_start = UINT64_MAX;
+    uint64_t backfill_start = UINT64_MAX;
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      for (auto& a : m_accounts)
+      {
+        uint64_t h = a.second.scanned_height;
+        if (h >= height)
+          continue;
+        if (h >= backfill_border)
+          live_start = std::min(live_start, h);
+        else
+          backfill_start = std::min(backfill_start, h);
+      }
+    }
+
+    //accounts at the top go first, so new blocks are not delayed by backfilling
+    bool r = false;
+    if (live_start != UINT64_MAX)
+      r |= scan_step(live_start, height);
+    if (backfill_start != UINT64_MAX && m_run)
+      r |= scan_step(backfill_start, std::min(backfill_start + VIEW_KEY_SCANNER_BATCH_BLOCKS, height));
+    return r;
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::scan_step(uint64_t start, uint64_t end)
+  {
+    METRICS_SCOPED_TIMER(step_timer, "view_key_scanner_step_duration_us", "");
+    //take accounts which need some of blocks [start, end)
+    output_scanner scanner;
+    std::vector<std::string> names;
+    std::vector<uint64_t> from_heights;
+    std::vector<uint64_t> registrations;
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      for (auto& a : m_accounts)
+      {
+        if (a.second.scanned_height < start || a.second.scanned_height >= end)
+          continue;
+        scanner.add_account(a.second.addr, a.second.view_secret_key);
+        names.push_back(a.first);
+        from_heights.push_back(a.second.scanned_height);
+        registrations.push_back(a.second.registration);
+      }
+    }
+    if (!names.size())
+      return false;
+
+    std::list<block> blocks;
+    std::list<transaction> txs;
+    if (!m_chain.get_blocks(start, static_cast<size_t>(end - start), blocks, txs) || blocks.size() != end - start)
+    {
+      //chain got shorter meanwhile
+      LOG_PRINT_L1("View key scanner: failed to get blocks [" << start << ", " << end << ")");
+      return false;
+    }
+
+    std::vector<output_scanner::tx_entry> entries;
+    std::vector<uint64_t> entry_heights;
+    std::vector<crypto::hash> entry_ids;
+    std::vector<crypto::hash> block_ids;
+    entries.reserve(blocks.size() + txs.size());
+    auto tx_it = txs.begin();
+    uint64_t h = start;
+    BOOST_FOREACH(const block& b, blocks)
+    {
+      block_ids.push_back(get_block_hash(b));
+      output_scanner::tx_entry e = AUTO_VAL_INIT(e);
+      e.ptx = &b.miner_tx;
+      entries.push_back(e);
+      entry_heights.push_back(h);
+      entry_ids.push_back(get_transaction_hash(b.miner_tx));
+      BOOST_FOREACH(const crypto::hash& tx_id, b.tx_hashes)
+      {
+        CHECK_AND_ASSERT_MES(tx_it != txs.end(), false, "internal error: not enough transactions for blocks [" << start << ", " << end << ")");
+        e.ptx = &*tx_it++;
+        entries.push_back(e);
+        entry_heights.push_back(h);
+        entry_ids.push_back(tx_id);
+      }
+      ++h;
+    }
+    BOOST_FOREACH(output_scanner::tx_entry& e, entries)
+      e.tx_pub_key = get_tx_pub_key_from_extra(*e.ptx);
+
+    scanner.scan_transactions(entries, m_threads_count);
+
+    std::vector<std::vector<view_key_scanner_output> > found(names.size());
+    for (size_t i = 0; i != entries.size(); i++)
+    {
+      if (!entries[i].found.size())
+        continue;
+      std::vector<uint64_t> gindexes;
+      bool r = m_chain.get_tx_outputs_gindexs(entry_ids[i], gindexes);
+      CHECK_AND_ASSERT_MES(r && gindexes.size() == entries[i].ptx->vout.size(), false, "View key scanner: failed to get global indexes for " << entry_ids[i]);
+      BOOST_FOREACH(const output_scanner::account_outs& ao, entries[i].found)
+      {
+        //account may need only the upper part of the step
+        if (entry_heights[i] < from_heights[ao.account_index])
+          continue;
+        BOOST_FOREACH(size_t o, ao.outs)
+        {
+          view_key_scanner_output vo = AUTO_VAL_INIT(vo);
+          vo.tx_id = entry_ids[i];
+          vo.height = entry_heights[i];
+          vo.out_index = o;
+          vo.global_index = gindexes[o];
+          vo.amount = entries[i].ptx->vout[o].amount;
+          found[ao.account_index].push_back(vo);
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lk(m_lock);
+    for (size_t i = 0; i != names.size(); i++)
+    {
+      auto it = m_accounts.find(names[i]);
+      //unregistered, re-registered or rolled back meanwhile
+      if (it == m_accounts.end() || it->second.registration != registrations[i] || it->second.scanned_height != from_heights[i])
+        continue;
+      it->second.outs.insert(it->second.outs.end(), found[i].begin(), found[i].end());
+      it->second.scanned_height = end;
+    }
+    for (size_t i = 0; i != block_ids.size(); i++)
+      add_recent_id(start + i, block_ids[i]);
+    LOG_PRINT_L2("View key scanner: scanned blocks [" << start << ", " << end << "), " << entries.size() << " txs for " << names.size() << " accounts");
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  void view_key_scanner::add_recent_id(uint64_t height, const crypto::hash& id)
+  {
+    uint64_t recent_end = m_recent_ids_start + m_recent_ids.size();
+    if (height >= m_recent_ids_start && height < recent_end)
+      return;
+    if (height != recent_end)
+    {
+      //not adjacent to the known top, start over from here
+      if (height < recent_end)
+        return;
+      m_recent_ids.clear();
+      m_recent_ids_start = height;
+    }
+    m_recent_ids.push_back(id);
+    while (m_recent_ids.size() > VIEW_KEY_SCANNER_REORG_DEPTH)
+    {
+      m_recent_ids.pop_front();
+      ++m_recent_ids_start;
+    }
+  }
+  //---------------------------------------------------------------------------
+  void view_key_scanner::check_reorg()
+  {
+    //blockchain is never asked under m_lock, core may hold blockchain lock while notifying us
+    std::deque<crypto::hash> ids;
+    uint64_t ids_start = 0;
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      if (m_recent_ids.empty())
+        return;
+      ids = m_recent_ids;
+      ids_start = m_recent_ids_start;
+    }
+    if (m_chain.get_block_id_by_height(ids_start + ids.size() - 1) == ids.back())
+      return;
+
+    //find the highest block that is still in main chain
+    uint64_t fork_height = ids_start;
+    for (size_t i = ids.size(); i != 0; i--)
+    {
+      if (m_chain.get_block_id_by_height(ids_start + i - 1) == ids[i - 1])
+      {
+        fork_height = ids_start + i;
+        break;
+      }
+    }
+
+    std::lock_guard<std::mutex> lk(m_lock);
+    if (fork_height == ids_start && ids_start != 0)
+    {
+      LOG_PRINT_RED_L0("View key scanner: chain switched deeper than " << VIEW_KEY_SCANNER_REORG_DEPTH << " blocks, rescanning all accounts");
+      fork_height = 0;
+    }
+    LOG_PRINT_L0("View key scanner: chain switched, rolling back to height " << fork_height);
+    rollback_to(fork_height);
+  }
+  //---------------------------------------------------------------------------
+  void view_key_scanner::rollback_to(uint64_t height)
+  {
+    for (auto& a : m_accounts)
+    {
+      account_entry& ae = a.second;
+      if (ae.scanned_height <= height)
+        continue;
+      ae.scanned_height = std::max(height, ae.start_height);
+      while (ae.outs.size() && ae.outs.back().height >= ae.scanned_height)
+        ae.outs.pop_back();
+    }
+    while (m_recent_ids.size() && m_recent_ids_start + m_recent_ids.size() > height)
+      m_recent_ids.pop_back();
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::load_state()
+  {
+    if (!file_io_utils::is_file_exist(m_state_file_path))
+      return true;
+    stored_state st = AUTO_VAL_INIT(st);
+    if (!epee::serialization::load_t_from_binary_file(st, m_state_file_path))
+      return false;
+
+    std::lock_guard<std::mutex> lk(m_lock);
+    m_accounts.clear();
+    BOOST_FOREACH(account_entry& ae, st.accounts)
+    {
+      ae.registration = ++m_registrations_count;
+      m_accounts[get_account_address_as_str(ae.addr)] = ae;
+    }
+    m_recent_ids.assign(st.recent_ids.begin(), st.recent_ids.end());
+    m_recent_ids_start = st.recent_ids_start;
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  bool view_key_scanner::store_state()
+  {
+    stored_state st = AUTO_VAL_INIT(st);
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      BOOST_FOREACH(auto& a, m_accounts)
+        st.accounts.push_back(a.second);
+      st.recent_ids.assign(m_recent_ids.begin(), m_recent_ids.end());
+      st.recent_ids_start = m_recent_ids_start;
+    }
+    std::string buff;
+    bool r = epee::serialization::store_t_to_binary(st, buff);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to serialize view key scanner state");
+    r = file_io_utils::save_string_to_file(m_state_file_path, buff);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to store view key scanner state to " << m_state_file_path);
+    return true;
+  }
+}
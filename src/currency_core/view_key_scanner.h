@@ -0,0 +1,149 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <deque>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include "currency_basic.h"
+#include "serialization/keyvalue_serialization.h"
+#include "math_helper.h"
+
+namespace currency
+{
+  class blockchain_storage;
+
+  struct view_key_scanner_output
+  {
+    crypto::hash tx_id;
+    uint64_t height;
+    uint64_t out_index;
+    uint64_t global_index;
+    uint64_t amount;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_VAL_POD_AS_BLOB_FORCE(tx_id)
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(out_index)
+      KV_SERIALIZE(global_index)
+      KV_SERIALIZE(amount)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  /************************************************************************/
+  /* Main chain as seen by view_key_scanner, blockchain_storage in daemon */
+  /************************************************************************/
+  struct i_view_key_scanner_chain
+  {
+    virtual uint64_t get_current_blockchain_height() = 0;
+    virtual crypto::hash get_block_id_by_height(uint64_t height) = 0;
+    virtual bool get_blocks(uint64_t start_offset, size_t count, std::list<block>& blocks, std::list<transaction>& txs) = 0;
+    virtual bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) = 0;
+    virtual ~i_view_key_scanner_chain(){}
+  };
+
+  /************************************************************************/
+  /* Opt-in daemon service that scans main chain blocks once for all      */
+  /* registered accounts (view secret key + address) and keeps their      */
+  /* matched outputs, so many wallets don't have to pull and scan every   */
+  /* block each. New blocks are scanned for accounts at the top first,    */
+  /* then accounts registered from an older height are backfilled in      */
+  /* batches, transactions of a batch are scanned by several threads.     */
+  /* State is kept in memory, stored to the data folder every 10 minutes  */
+  /* and on exit.                                                         */
+  /************************************************************************/
+  class view_key_scanner
+  {
+  public:
+    view_key_scanner(blockchain_storage& bcs);
+    view_key_scanner(i_view_key_scanner_chain& chain);
+    static void init_options(boost::program_options::options_description& desc);
+    bool init(const boost::program_options::variables_map& vm, const std::string& config_folder);
+    //empty state_file_path - state is not loaded and stored, without worker passes are run by caller
+    bool init(size_t threads_count, size_t max_accounts, const std::string& state_file_path, bool start_worker);
+    bool deinit();
+    //one pass of the worker: rolls back after chain switch, then scans next blocks, returns true if some were scanned
+    bool do_scan_pass();
+    bool is_enabled() const { return m_enabled; }
+    //wakes up the worker, called when main chain tip changes
+    void on_new_block();
+
+    //start_height is the first block that may have account outputs, usually its creation height
+    bool register_account(const account_public_address& addr, const crypto::secret_key& view_secret_key, uint64_t start_height, std::string& err);
+    bool unregister_account(const account_public_address& addr);
+    //returns false if account is not registered, scanned_height is the number of blocks covered by outs
+    bool get_outputs(const account_public_address& addr, uint64_t offset, size_t count, std::list<view_key_scanner_output>& outs, uint64_t& total_outs, uint64_t& scanned_height);
+    size_t get_accounts_count();
+
+  private:
+    struct account_entry
+    {
+      account_public_address addr;
+      crypto::secret_key view_secret_key;
+      uint64_t start_height;
+      uint64_t scanned_height;   //next block to scan
+      std::vector<view_key_scanner_output> outs;
+      uint64_t registration;     //not stored, tells apart re-registered accounts
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(addr)
+        KV_SERIALIZE_VAL_POD_AS_BLOB_FORCE(view_secret_key)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(scanned_height)
+        KV_SERIALIZE(outs)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct stored_state
+    {
+      std::list<account_entry> accounts;
+      uint64_t recent_ids_start;
+      std::list<crypto::hash> recent_ids;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(accounts)
+        KV_SERIALIZE(recent_ids_start)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(recent_ids)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    void worker();
+    bool scan_next();
+    bool scan_step(uint64_t start, uint64_t end);
+    void check_reorg();
+    void rollback_to(uint64_t height);
+    void add_recent_id(uint64_t height, const crypto::hash& id);
+    bool load_state();
+    bool store_state();
+
+    std::unique_ptr<i_view_key_scanner_chain> m_bcs_chain;
+    i_view_key_scanner_chain& m_chain;
+    bool m_enabled;
+    size_t m_threads_count;
+    size_t m_max_accounts;
+    std::string m_state_file_path;
+
+    std::mutex m_lock;
+    std::map<std::string, account_entry> m_accounts;   //by address string
+    uint64_t m_registrations_count;
+    //ids of the last scanned main chain blocks, to find out where chain was switched
+    std::deque<crypto::hash> m_recent_ids;
+    uint64_t m_recent_ids_start;
+
+    std::thread m_worker_thread;
+    std::atomic<bool> m_run;
+    std::condition_variable m_wakeup;
+    bool m_have_new_blocks;
+    epee::math_helper::once_a_time_seconds<60*10, false> m_store_interval;
+  };
+}
@@ -4,9 +4,11 @@
 
 #pragma once
 
+#include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 
 #include "storages/levin_abstract_invoke2.h"
+#include "bounded_work_queue.h"
 #include "warnings.h"
 #include "currency_protocol_defs.h"
 #include "currency_protocol_handler_common.h"
@@ -40,6 +42,7 @@ namespace currency
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, &currency_protocol_handler::handle_response_chain_entry)
     END_INVOKE_MAP2()
 
+    static void init_options(boost::program_options::options_description& desc);
     bool on_idle();
     bool init(const boost::program_options::variables_map& vm);
     bool deinit();
@@ -63,6 +66,8 @@ namespace currency
     int handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, currency_connection_context& context);
     int handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, currency_connection_context& context);
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, currency_connection_context& context);
+    //adds prevalidated blocks to core, returns false if connection was dropped
+    bool import_response_objects(const std::list<block_complete_entry>& blocks, currency_connection_context& context);
 
 
     //----------------- i_bc_protocol_layout ---------------------------------------
@@ -83,6 +88,8 @@ namespace currency
     std::atomic<uint64_t> m_max_height_seen;
     std::atomic<uint64_t> m_core_inital_height;
     std::atomic<bool> m_want_stop;
+    //takes blocks import off network threads while syncing
+    epee::bounded_work_queue m_import_queue;
 
     template<class t_parametr>
       bool post_notify(typename t_parametr::request& arg, currency_connection_context& context)
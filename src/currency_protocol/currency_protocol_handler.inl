@@ -5,9 +5,13 @@
 #include <boost/interprocess/detail/atomic.hpp>
 #include "currency_core/currency_format_utils.h"
 #include "profile_tools.h"
+#include "common/command_line.h"
 namespace currency
 {
-
+  namespace
+  {
+    const command_line::arg_descriptor<uint32_t> arg_blocks_import_queue_size = {"blocks-import-queue-size", "Received blocks are imported by a separate thread with this many responses waiting (0 - import on network threads)", 2};
+  }
   //-----------------------------------------------------------------------------------------------------------------------  
   template<class t_core>
     t_currency_protocol_handler<t_core>::t_currency_protocol_handler(t_core& rcore, nodetool::i_p2p_endpoint<connection_context>* p_net_layout):m_core(rcore), 
@@ -23,9 +27,18 @@ namespace currency
       m_p2p = &m_p2p_stub;
   }
   //-----------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::init_options(boost::program_options::options_description& desc)
+  {
+    command_line::add_arg(desc, arg_blocks_import_queue_size);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_currency_protocol_handler<t_core>::init(const boost::program_options::variables_map& vm)
   {
+    uint32_t import_queue_size = command_line::get_arg(vm, arg_blocks_import_queue_size);
+    if(import_queue_size)
+      m_import_queue.start(1, import_queue_size);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------  
@@ -33,7 +46,7 @@ namespace currency
   bool t_currency_protocol_handler<t_core>::deinit()
   {
     m_want_stop = true;
-
+    m_import_queue.stop();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------  
@@ -53,6 +66,18 @@ namespace currency
     CHECK_AND_ASSERT_MES_CC( context.m_callback_request_count > 0, false, "false callback fired, but context.m_callback_request_count=" << context.m_callback_request_count);
     --context.m_callback_request_count;
 
+    if(context.m_pending_import)
+    {
+      //nothing else is requested from this connection until import thread is done with its blocks
+      if(*context.m_pending_import == currency_connection_context::import_in_progress)
+        return true;
+      bool import_succeeded = *context.m_pending_import == currency_connection_context::import_succeeded;
+      context.m_pending_import.reset();
+      if(import_succeeded)
+        request_missing_objects(context, true);
+      return true;
+    }
+
     if(context.m_state == currency_connection_context::state_synchronizing)
     {
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
@@ -354,8 +379,6 @@ namespace currency
     }
     PROF_L2_FINISH(block_complete_entries_prevalidation_time);
 
-    PROF_L2_DO(syncing_conn_count_sum += get_synchronizing_connections_count(); ++syncing_conn_count_count);
-
     if(context.m_requested_objects.size())
     {
       LOG_PRINT_CCONTEXT_RED("returned not all requested objects (context.m_requested_objects.size()=" 
@@ -364,20 +387,69 @@ namespace currency
       return 1;
     }
 
+    PROF_L2_DO(LOG_PRINT_CCONTEXT_L1("NOTIFY_RESPONSE_GET_OBJECTS: " << arg.blocks.size() << " blocks were prevalidated in " << block_complete_entries_prevalidation_time / 1000 << " ms"));
+
+    if(m_import_queue.is_running())
+    {
+      //import goes to a separate thread, so network threads keep serving other peers;
+      //connection gets a callback when it's done and requests next objects from on_callback()
+      std::shared_ptr<std::atomic<int> > import_status(new std::atomic<int>(currency_connection_context::import_in_progress));
+      std::shared_ptr<std::list<block_complete_entry> > blocks(new std::list<block_complete_entry>());
+      blocks->swap(arg.blocks);
+      currency_connection_context context_copy = context;
+      context.m_pending_import = import_status;
+      ++context.m_callback_request_count;
+      bool posted = m_import_queue.try_post([this, blocks, context_copy, import_status]() mutable
+      {
+        //connection waits for the callback whatever happens here, otherwise it never asks for more objects
+        bool r = false;
+        try
+        {
+          r = import_response_objects(*blocks, context_copy);
+        }
+        catch (const std::exception& e)
+        {
+          LOG_ERROR_CC(context_copy, "exception while importing objects: " << e.what());
+        }
+        catch (...)
+        {
+          LOG_ERROR_CC(context_copy, "unknown exception while importing objects");
+        }
+        *import_status = r ? currency_connection_context::import_succeeded : currency_connection_context::import_failed;
+        m_p2p->request_callback(context_copy);
+      });
+      if(posted)
+        return 1;
+      //queue is full, import right here
+      context.m_pending_import.reset();
+      --context.m_callback_request_count;
+      blocks->swap(arg.blocks);
+    }
+
+    if(import_response_objects(arg.blocks, context))
+      request_missing_objects(context, true);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::import_response_objects(const std::list<block_complete_entry>& blocks, currency_connection_context& context)
+  {
+    PROF_L2_DO(uint64_t syncing_conn_count_sum = get_synchronizing_connections_count(); uint64_t syncing_conn_count_count = 1);
+
     PROF_L2_START(blocks_handle_time);
     {
       m_core.pause_mine();
       misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
         boost::bind(&t_core::resume_mine, &m_core));
 
-      BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
+      BOOST_FOREACH(const block_complete_entry& block_entry, blocks)
       {
-        CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
+        CHECK_STOP_FLAG_EXIT_IF_SET(false, "Blocks processing interrupted, connection dropped");
         //process transactions
         PROF_L1_START(transactions_process_time);
         BOOST_FOREACH(auto& tx_blob, block_entry.txs)
         {
-          CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
+          CHECK_STOP_FLAG_EXIT_IF_SET(false, "Blocks processing interrupted, connection dropped");
           tx_verification_context tvc = AUTO_VAL_INIT(tvc);
           m_core.handle_incoming_tx(tx_blob, tvc, true);
           if(tvc.m_verifivation_failed)
@@ -385,7 +457,7 @@ namespace currency
             LOG_ERROR_CCONTEXT("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = " 
               << string_tools::pod_to_hex(get_blob_hash(tx_blob)) << ", dropping connection");
             m_p2p->drop_connection(context);
-            return 1;
+            return false;
           }
         }
         PROF_L1_FINISH(transactions_process_time);
@@ -401,16 +473,15 @@ namespace currency
           LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
           m_p2p->drop_connection(context);
           m_p2p->add_ip_fail(context.m_remote_ip);
-          return 1;
+          return false;
         }
         if(bvc.m_marked_as_orphaned)
         {
           LOG_PRINT_CCONTEXT_L0("Block received at sync phase was marked as orphaned, dropping connection");
           m_p2p->drop_connection(context);
           m_p2p->add_ip_fail(context.m_remote_ip);
-          return 1;
+          return false;
         }
-
         PROF_L1_FINISH(block_process_time);
         PROF_L1_DO(LOG_PRINT_CCONTEXT_L2("Block process time: " << print_mcsec_as_ms(block_process_time + transactions_process_time) << "(" << print_mcsec_as_ms(transactions_process_time) << "/" << print_mcsec_as_ms(block_process_time) << ") ms"));
 
@@ -420,7 +491,7 @@ namespace currency
     PROF_L2_FINISH(blocks_handle_time);
     
     uint64_t current_height = m_core.get_current_blockchain_height();
-    LOG_PRINT_CCONTEXT_YELLOW(">>>>>>>>> sync progress: " << arg.blocks.size() << " blocks added, now have "
+    LOG_PRINT_CCONTEXT_YELLOW(">>>>>>>>> sync progress: " << blocks.size() << " blocks added, now have "
       << current_height << " of " << context.m_remote_blockchain_height
       << " ( " << std::fixed << std::setprecision(2) << current_height * 100.0 / context.m_remote_blockchain_height << "% ) and "
       << context.m_remote_blockchain_height - current_height << " blocks left"
@@ -430,16 +501,13 @@ namespace currency
 
 #if PROFILING_LEVEL >= 2
     double syncing_conn_count_av = syncing_conn_count_sum / static_cast<double>(syncing_conn_count_count);
-    size_t blocks_count = arg.blocks.size();
-    LOG_PRINT_CCONTEXT_YELLOW("NOTIFY_RESPONSE_GET_OBJECTS: " << blocks_count << " blocks were prevalidated in " << block_complete_entries_prevalidation_time / 1000
-      << " ms (" << std::fixed << std::setprecision(2) << block_complete_entries_prevalidation_time / 1000.0f / blocks_count << " ms per block av) and handled in " << blocks_handle_time / 1000
+    size_t blocks_count = blocks.size();
+    LOG_PRINT_CCONTEXT_YELLOW("NOTIFY_RESPONSE_GET_OBJECTS: " << blocks_count << " blocks handled in " << blocks_handle_time / 1000
       << " ms (" << std::fixed << std::setprecision(2) << blocks_handle_time / 1000.0f / blocks_count << " ms per block av)"
       << " syncing conns av: " << std::fixed << std::setprecision(2) << syncing_conn_count_av, LOG_LEVEL_1);
 #endif
 
-
-    request_missing_objects(context, true);
-    return 1;
+    return true;
   }
 #undef CHECK_STOP_FLAG__DROP_AND_RETURN_IF_SET
   //------------------------------------------------------------------------------------------------------------------------
@@ -65,6 +65,7 @@ int main(int argc, char* argv[])
 
   command_line::add_arg(desc_cmd_sett, command_line::arg_log_file);
   command_line::add_arg(desc_cmd_sett, command_line::arg_log_level);
+  command_line::add_arg(desc_cmd_sett, command_line::arg_log_async_queue_size);
   command_line::add_arg(desc_cmd_sett, command_line::arg_console);
   command_line::add_arg(desc_cmd_sett, command_line::arg_show_details);
   
@@ -72,6 +73,7 @@ int main(int argc, char* argv[])
   currency::core::init_options(desc_cmd_sett);
   currency::core_rpc_server::init_options(desc_cmd_sett);
   nodetool::node_server<currency::t_currency_protocol_handler<currency::core> >::init_options(desc_cmd_sett);
+  currency::t_currency_protocol_handler<currency::core>::init_options(desc_cmd_sett);
   currency::miner::init_options(desc_cmd_sett);
 
   po::options_description desc_options("Allowed options");
@@ -119,6 +121,9 @@ int main(int argc, char* argv[])
   log_dir = log_file_path.has_parent_path() ? log_file_path.parent_path().string() : log_space::log_singletone::get_default_log_folder();
 
   log_space::log_singletone::add_logger(LOGGER_FILE, log_file_path.filename().string().c_str(), log_dir.c_str());
+  uint32_t log_queue_size = command_line::get_arg(vm, command_line::arg_log_async_queue_size);
+  if (log_queue_size)
+    log_space::log_singletone::set_async_mode(true, log_queue_size);
   LOG_PRINT_L0(CURRENCY_NAME << " v" << PROJECT_VERSION_LONG);
 
   if (command_line_preprocessor(vm))
@@ -180,7 +185,7 @@ int main(int argc, char* argv[])
   }
 
   LOG_PRINT_L0("Starting core rpc server...");
-  res = rpc_server.run(2, false);
+  res = rpc_server.run(rpc_server.get_threads_count(), false);
   CHECK_AND_ASSERT_MES(res, 1, "Failed to initialize core rpc server.");
   LOG_PRINT_L0("Core rpc server started ok");
 
@@ -195,16 +200,18 @@ int main(int argc, char* argv[])
 
   //stop components
   LOG_PRINT_L0("Stopping core rpc server...");
+  ccore.get_event_notifier().interrupt(); // release long-poll requests
   rpc_server.send_stop_signal();
   rpc_server.timed_wait_server_stop(5000);
 
   //deinitialize components
+  //currency_protocol goes first: its import thread may still be adding blocks to core
+  LOG_PRINT_L0("Deinitializing currency_protocol...");
+  cprotocol.deinit();
   LOG_PRINT_L0("Deinitializing core...");
   ccore.deinit();
   LOG_PRINT_L0("Deinitializing rpc server ...");
   rpc_server.deinit();
-  LOG_PRINT_L0("Deinitializing currency_protocol...");
-  cprotocol.deinit();
   LOG_PRINT_L0("Deinitializing p2p...");
   p2psrv.deinit();
 
@@ -212,7 +219,10 @@ int main(int argc, char* argv[])
   ccore.set_currency_protocol(NULL);
   cprotocol.set_p2p_endpoint(NULL);
 
+  if (log_space::log_singletone::get_dropped_messages_count())
+    LOG_PRINT_L0("Log messages dropped: " << log_space::log_singletone::get_dropped_messages_count());
   LOG_PRINT("Node stopped.", LOG_LEVEL_0);
+  log_space::log_singletone::flush();
   return 0;
 
   CATCH_ENTRY_L0("main", 1);
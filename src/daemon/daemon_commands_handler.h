@@ -34,6 +34,7 @@ public:
     m_cmd_binder.set_handler("stop_mining", boost::bind(&daemon_cmmands_handler::stop_mining, this, _1), "Stop mining");
     m_cmd_binder.set_handler("print_pool", boost::bind(&daemon_cmmands_handler::print_pool, this, _1), "Print transaction pool (long format)");
     m_cmd_binder.set_handler("print_pool_sh", boost::bind(&daemon_cmmands_handler::print_pool_sh, this, _1), "Print transaction pool (short format)");
+    m_cmd_binder.set_handler("print_pruning", boost::bind(&daemon_cmmands_handler::print_pruning, this, _1), "Print ring signatures pruning progress");
     m_cmd_binder.set_handler("show_hr", boost::bind(&daemon_cmmands_handler::show_hr, this, _1), "Start showing hash rate");
     m_cmd_binder.set_handler("hide_hr", boost::bind(&daemon_cmmands_handler::hide_hr, this, _1), "Stop showing hash rate");
     m_cmd_binder.set_handler("make_alias", boost::bind(&daemon_cmmands_handler::make_alias, this, _1), "Puts alias reservation record into block template, if alias is free");
@@ -172,6 +173,17 @@ private:
     return true;
   }
   //--------------------------------------------------------------------------------
+  bool print_pruning(const std::vector<std::string>& args)
+  {
+    uint64_t pruned_height = 0, target_height = 0;
+    m_srv.get_payload_object().get_core().get_blockchain_storage().get_ring_signatures_pruning_progress(pruned_height, target_height);
+    if (target_height > pruned_height)
+      std::cout << "Ring signatures pruned up to height " << pruned_height << ", " << target_height - pruned_height << " blocks left (target height " << target_height << ")" << ENDL;
+    else
+      std::cout << "Ring signatures pruned up to height " << pruned_height << ", nothing left to prune" << ENDL;
+    return true;
+  }
+  //--------------------------------------------------------------------------------
   template <typename T>
   static bool print_as_json(T& obj)
   {
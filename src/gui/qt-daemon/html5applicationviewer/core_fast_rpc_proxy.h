@@ -64,6 +64,16 @@ namespace tools
       return m_rpc.on_get_all_aliases(req, res, m_err_stub, m_cntxt_stub);
     }
     //------------------------------------------------------------------------------------------------------------------------------
+    bool call_COMMAND_RPC_GET_ALIASES(const currency::COMMAND_RPC_GET_ALIASES::request& req, currency::COMMAND_RPC_GET_ALIASES::response& res)
+    {
+      return m_rpc.on_get_aliases(req, res, m_err_stub, m_cntxt_stub);
+    }
+    //------------------------------------------------------------------------------------------------------------------------------
+    bool call_COMMAND_RPC_GET_ALIAS_CHANGES(const currency::COMMAND_RPC_GET_ALIAS_CHANGES::request& req, currency::COMMAND_RPC_GET_ALIAS_CHANGES::response& res)
+    {
+      return m_rpc.on_get_alias_changes(req, res, m_err_stub, m_cntxt_stub);
+    }
+    //------------------------------------------------------------------------------------------------------------------------------
     bool call_COMMAND_RPC_GET_ALIAS_DETAILS(const currency::COMMAND_RPC_GET_ALIAS_DETAILS::request& req, currency::COMMAND_RPC_GET_ALIAS_DETAILS::response& res)
     {
       return m_rpc.on_get_alias_details(req, res, m_err_stub, m_cntxt_stub);
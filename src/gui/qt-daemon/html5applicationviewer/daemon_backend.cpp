@@ -16,7 +16,8 @@ daemon_backend::daemon_backend():m_pview(&m_view_stub),
                                  m_rpc_server(m_ccore, m_p2psrv),
                                  m_rpc_proxy(new tools::core_fast_rpc_proxy(m_rpc_server)),
                                  m_last_daemon_height(0),
-                                 m_last_wallet_synch_height(0)
+                                 m_last_wallet_synch_height(0),
+                                 m_aliases_cache_height(0)
 {
   m_wallet.reset(new tools::wallet2());
   m_wallet->callback(this);
@@ -71,6 +72,7 @@ bool daemon_backend::start(int argc, char* argv[], view::i_view* pview_handler)
   currency::core::init_options(desc_cmd_sett);
   currency::core_rpc_server::init_options(desc_cmd_sett);
   nodetool::node_server<currency::t_currency_protocol_handler<currency::core> >::init_options(desc_cmd_sett);
+  currency::t_currency_protocol_handler<currency::core>::init_options(desc_cmd_sett);
   currency::miner::init_options(desc_cmd_sett);
 
   po::options_description desc_options("Allowed options");
@@ -284,6 +286,12 @@ void daemon_backend::main_worker(const po::variables_map& vm)
 
   //deinitialize components
 
+  LOG_PRINT_L0("Deinitializing currency_protocol...");
+  dsi.text_state = "Deinitializing currency_protocol";
+  m_pview->update_daemon_status(dsi);
+  m_cprotocol.deinit(); //stops import thread before core goes down
+
+
   LOG_PRINT_L0("Deinitializing core...");
   dsi.text_state = "Deinitializing core";
   m_pview->update_daemon_status(dsi);
@@ -296,12 +304,6 @@ void daemon_backend::main_worker(const po::variables_map& vm)
   m_rpc_server.deinit();
 
 
-  LOG_PRINT_L0("Deinitializing currency_protocol...");
-  dsi.text_state = "Deinitializing currency_protocol";
-  m_pview->update_daemon_status(dsi);
-  m_cprotocol.deinit();
-
-
   LOG_PRINT_L0("Deinitializing p2p...");
   dsi.text_state = "Deinitializing p2p";
   m_pview->update_daemon_status(dsi);
@@ -582,14 +584,66 @@ bool daemon_backend::close_wallet()
 
 bool daemon_backend::get_aliases(view::alias_set& al_set)
 {
-  currency::COMMAND_RPC_GET_ALL_ALIASES::response aliases = AUTO_VAL_INIT(aliases);
-  if (m_rpc_proxy->call_COMMAND_RPC_GET_ALL_ALIASES(aliases) && aliases.status == CORE_RPC_STATUS_OK)
+  CRITICAL_REGION_LOCAL(m_aliases_lock);
+  if (!update_aliases_cache())
+    return false;
+
+  for (const auto& a : m_aliases_cache)
+    al_set.aliases.push_back(a.second);
+  return true;
+}
+
+#define ALIASES_CACHE_REORG_OVERLAP   10
+bool daemon_backend::update_aliases_cache()
+{
+  //first call loads whole alias set page by page, next calls only apply changes from blocks added since then
+  if (!m_aliases_cache_height)
   {
-    al_set.aliases = aliases.aliases;
-    return true;
+    currency::COMMAND_RPC_GET_ALIASES::request req = AUTO_VAL_INIT(req);
+    req.count = COMMAND_RPC_GET_ALIASES_MAX_COUNT;
+    uint64_t first_page_height = 0;
+    do
+    {
+      currency::COMMAND_RPC_GET_ALIASES::response rsp = AUTO_VAL_INIT(rsp);
+      if (!m_rpc_proxy->call_COMMAND_RPC_GET_ALIASES(req, rsp) || rsp.status != CORE_RPC_STATUS_OK)
+      {
+        m_aliases_cache.clear();
+        return false;
+      }
+      //pages may come from different chain states, changes since the first one are replayed below
+      if (!first_page_height)
+        first_page_height = rsp.height;
+      for (const auto& a : rsp.aliases)
+        m_aliases_cache[a.alias] = a;
+      req.start_alias = rsp.next_alias;
+    } while (req.start_alias.size());
+    m_aliases_cache_height = first_page_height;
   }
 
-  return false;
+  //overlap re-reads aliases updated in blocks that could be replaced by a short reorg
+  currency::COMMAND_RPC_GET_ALIAS_CHANGES::request req = AUTO_VAL_INIT(req);
+  req.from_height = m_aliases_cache_height > ALIASES_CACHE_REORG_OVERLAP ? m_aliases_cache_height - ALIASES_CACHE_REORG_OVERLAP : 0;
+  for (;;)
+  {
+    currency::COMMAND_RPC_GET_ALIAS_CHANGES::response rsp = AUTO_VAL_INIT(rsp);
+    if (!m_rpc_proxy->call_COMMAND_RPC_GET_ALIAS_CHANGES(req, rsp) || rsp.status != CORE_RPC_STATUS_OK)
+      return false;
+    if (rsp.height < m_aliases_cache_height)
+    {
+      //chain became shorter (long reorg or resync), registrations may have gone - reload from scratch
+      m_aliases_cache.clear();
+      m_aliases_cache_height = 0;
+      return update_aliases_cache();
+    }
+    for (const auto& a : rsp.aliases)
+      m_aliases_cache[a.alias] = a;
+    if (rsp.next_height >= rsp.height)
+    {
+      m_aliases_cache_height = rsp.height;
+      return true;
+    }
+    req.from_height = rsp.next_height;
+  }
 }
 
 bool daemon_backend::sign_text(const std::string& text, std::string& signature_hex)
@@ -64,6 +64,7 @@ private:
   bool update_wallet_info();
   bool load_recent_transfers();
   bool get_transfer_address(const std::string& adr_str, currency::account_public_address& addr);
+  bool update_aliases_cache();
 
   //----- tools::i_wallet2_callback ------
   virtual void on_new_block(uint64_t height, const currency::block& block);
@@ -78,6 +79,9 @@ private:
   std::unique_ptr<tools::wallet2> m_wallet;
   std::atomic<uint64_t> m_last_daemon_height;
   std::atomic<uint64_t> m_last_wallet_synch_height;
+  critical_section m_aliases_lock;
+  std::map<std::string, currency::alias_rpc_details> m_aliases_cache;
+  uint64_t m_aliases_cache_height;  //0 - cache is not loaded yet
   std::string m_data_dir;
 
   //daemon stuff
@@ -62,6 +62,8 @@ namespace nodetool
     node_server(t_payload_net_handler& payload_handler):m_payload_handler(payload_handler), 
                                                         m_allow_local_ip(false), 
                                                         m_hide_my_port(false), 
+                                                        m_threads_count(P2P_DEFAULT_THREADS_COUNT), 
+                                                        m_io_shards_count(0), 
                                                         m_alert_mode(0), 
                                                         m_maintainers_entry_local(AUTO_VAL_INIT(m_maintainers_entry_local)),
                                                         m_maintainers_info_local(AUTO_VAL_INIT(m_maintainers_info_local))
@@ -215,6 +217,8 @@ namespace nodetool
     bool m_allow_local_ip;
     bool m_hide_my_port;
     bool m_offline_mode;
+    size_t m_threads_count;
+    size_t m_io_shards_count;
 
     //critical_section m_connections_lock;
     //connections_indexed_container m_connections;
@@ -32,6 +32,8 @@ namespace nodetool
     const command_line::arg_descriptor<std::vector<std::string> > arg_p2p_seed_node           = {"seed-node", "Connect to a node to retrieve peer addresses, and disconnect"};
     const command_line::arg_descriptor<bool>                      arg_p2p_hide_my_port        = { "hide-my-port", "Do not announce yourself as peerlist candidate", false, true };
     const command_line::arg_descriptor<bool>                      arg_p2p_offline_mode        = { "p2p-offline-mode", "Neither connect to the network, nor accept incoming connections", false, true };
+    const command_line::arg_descriptor<uint32_t>                  arg_p2p_threads             = {"p2p-threads", "Number of p2p network worker threads", P2P_DEFAULT_THREADS_COUNT};
+    const command_line::arg_descriptor<uint32_t>                  arg_p2p_io_shards           = {"p2p-io-shards", "Split p2p connections between this number of io_service instances (0 - one shared io_service)", 0};
 }
 
   //-----------------------------------------------------------------------------------
@@ -48,6 +50,8 @@ namespace nodetool
     command_line::add_arg(desc, arg_p2p_hide_my_port);   
     command_line::add_arg(desc, arg_p2p_use_only_priority_nodes);       
     command_line::add_arg(desc, arg_p2p_offline_mode);
+    command_line::add_arg(desc, arg_p2p_threads);
+    command_line::add_arg(desc, arg_p2p_io_shards);
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -154,6 +158,8 @@ namespace nodetool
     m_external_port = command_line::get_arg(vm, arg_p2p_external_port);
     m_allow_local_ip = command_line::get_arg(vm, arg_p2p_allow_local_ip);
     m_offline_mode = command_line::get_arg(vm, arg_p2p_offline_mode);
+    m_threads_count = std::max<size_t>(command_line::get_arg(vm, arg_p2p_threads), 1);
+    m_io_shards_count = command_line::get_arg(vm, arg_p2p_io_shards);
 
     if (m_offline_mode)
     {
@@ -286,6 +292,12 @@ namespace nodetool
     m_net_server.get_config_object().m_pcommands_handler = this;
     m_net_server.get_config_object().m_invoke_timeout = P2P_DEFAULT_INVOKE_TIMEOUT;
     m_net_server.set_connection_filter(this);
+    if(m_io_shards_count > 1)
+    {
+      res = m_net_server.set_io_shards_count(m_io_shards_count);
+      CHECK_AND_ASSERT_MES(res, false, "Failed to set up " << m_io_shards_count << " io shards");
+      LOG_PRINT_L0("P2P connections are split between " << m_io_shards_count << " io shards");
+    }
 
     //try to bind
     LOG_PRINT_L0("Binding on " << m_bind_ip << ":" << m_port);
@@ -308,8 +320,8 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::run(bool sync_call)
   {
-    //here you can set worker threads count
-    int thrds_count = 10;
+    //with io shards server runs at least one thread per shard
+    size_t thrds_count = std::max(m_threads_count, m_net_server.get_io_shards_count());
 
     m_net_server.add_idle_handler(boost::bind(&node_server<t_payload_net_handler>::idle_worker, this), 1000);
     m_net_server.add_idle_handler(boost::bind(&t_payload_net_handler::on_idle, &m_payload_handler), 1000);
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 
+#include <set>
 #include <boost/foreach.hpp>
 #include "include_base_utils.h"
 #include <boost/serialization/variant.hpp>
@@ -25,16 +26,47 @@ namespace currency
     const command_line::arg_descriptor<std::string> arg_rpc_bind_ip   = {"rpc-bind-ip", "IP for RPC Server", "127.0.0.1"};
     const command_line::arg_descriptor<std::string> arg_rpc_bind_port = {"rpc-bind-port", "Port for RPC Server", std::to_string(RPC_DEFAULT_PORT)};
     const command_line::arg_descriptor<bool> arg_rpc_restricted_rpc = { "restricted-rpc", "Restrict RPC to view only commands", false};
+    const command_line::arg_descriptor<size_t> arg_rpc_threads = { "rpc-threads", "Number of RPC server threads, all but one can be held by wait_for_changes long-poll requests", 4};
+    const command_line::arg_descriptor<size_t> arg_rpc_max_batch_size = { "rpc-max-batch-size", "Max number of calls in one JSON RPC batch request", JSON_RPC_DEFAULT_MAX_BATCH_SIZE};
+    const command_line::arg_descriptor<size_t> arg_rpc_gzip_min_size = { "rpc-gzip-min-size", "Min size of RPC response body to be gzipped for clients accepting it", HTTP_GZIP_DEFAULT_MIN_SIZE};
+    const command_line::arg_descriptor<int> arg_rpc_gzip_level = { "rpc-gzip-level", "Compression level (1-9) of gzipped RPC responses, 0 disables compression", HTTP_GZIP_DEFAULT_LEVEL};
+    const command_line::arg_descriptor<size_t> arg_rpc_priority_threads = { "rpc-priority-threads", "Number of extra RPC server threads only mining and transaction submission calls can get", 2};
+    const command_line::arg_descriptor<size_t> arg_rpc_bulk_threads = { "rpc-bulk-threads", "Max number of RPC threads busy with bulk reads (blocks sync, random outputs, alias lists) at once, 0 - half of rpc-threads", 0};
+    const command_line::arg_descriptor<size_t> arg_rpc_max_requests_per_ip = { "rpc-max-requests-per-ip", "Max number of concurrent non-priority requests from one ip with restricted-rpc, 0 - unlimited", 2};
+    const command_line::arg_descriptor<uint64_t> arg_rpc_max_bytes_per_ip = { "rpc-max-bytes-per-ip", "Max request+response bytes per second for one ip with restricted-rpc, 0 - unlimited", 4 * 1024 * 1024};
+
+    void fill_alias_rpc_details(const std::list<alias_info>& aliases, std::list<alias_rpc_details>& details)
+    {
+      BOOST_FOREACH(const alias_info& a, aliases)
+      {
+        details.push_back(alias_rpc_details());
+        details.back().alias = a.m_alias;
+        details.back().details.address = get_account_address_as_str(a.m_address);
+        details.back().details.comment = a.m_text_comment;
+        if(a.m_view_key != null_skey)
+          details.back().details.tracking_key = string_tools::pod_to_hex(a.m_view_key);
+      }
+    }
   }
+
+#define RPC_LONG_POLL_MAX_TIMEOUT_MS    60000
   //-----------------------------------------------------------------------------------
   void core_rpc_server::init_options(boost::program_options::options_description& desc)
   {
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
     command_line::add_arg(desc, arg_rpc_restricted_rpc);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_max_batch_size);
+    command_line::add_arg(desc, arg_rpc_gzip_min_size);
+    command_line::add_arg(desc, arg_rpc_gzip_level);
+    command_line::add_arg(desc, arg_rpc_priority_threads);
+    command_line::add_arg(desc, arg_rpc_bulk_threads);
+    command_line::add_arg(desc, arg_rpc_max_requests_per_ip);
+    command_line::add_arg(desc, arg_rpc_max_bytes_per_ip);
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  core_rpc_server::core_rpc_server(core& cr, nodetool::node_server<currency::t_currency_protocol_handler<currency::core> >& p2p):m_core(cr), m_p2p(p2p), m_session_counter(0)
+  core_rpc_server::core_rpc_server(core& cr, nodetool::node_server<currency::t_currency_protocol_handler<currency::core> >& p2p):m_core(cr), m_p2p(p2p), m_session_counter(0), m_threads_count(0), m_long_poll_waiters(0), m_max_batch_size(JSON_RPC_DEFAULT_MAX_BATCH_SIZE), m_priority_threads_count(0)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::handle_command_line(const boost::program_options::variables_map& vm)
@@ -42,6 +74,24 @@ namespace currency
     m_bind_ip = command_line::get_arg(vm, arg_rpc_bind_ip);
     m_port = command_line::get_arg(vm, arg_rpc_bind_port);
     m_restricted = command_line::get_arg(vm, arg_rpc_restricted_rpc);
+    m_threads_count = std::max<size_t>(command_line::get_arg(vm, arg_rpc_threads), 1);
+    m_max_batch_size = command_line::get_arg(vm, arg_rpc_max_batch_size);
+    int gzip_level = command_line::get_arg(vm, arg_rpc_gzip_level);
+    CHECK_AND_ASSERT_MES(gzip_level >= 0 && gzip_level <= 9, false, "Wrong rpc-gzip-level " << gzip_level << ", expected 0-9");
+    set_gzip_options(command_line::get_arg(vm, arg_rpc_gzip_min_size), gzip_level);
+
+    m_priority_threads_count = command_line::get_arg(vm, arg_rpc_priority_threads);
+    rpc_admission_control::limits l = AUTO_VAL_INIT(l);
+    l.normal_concurrency = m_priority_threads_count ? m_threads_count : 0;
+    l.bulk_concurrency = command_line::get_arg(vm, arg_rpc_bulk_threads);
+    if (!l.bulk_concurrency)
+      l.bulk_concurrency = std::max<size_t>(m_threads_count / 2, 1);
+    if (m_restricted)
+    {
+      l.per_ip_concurrency = command_line::get_arg(vm, arg_rpc_max_requests_per_ip);
+      l.per_ip_bytes_per_second = command_line::get_arg(vm, arg_rpc_max_bytes_per_ip);
+    }
+    m_admission.set_limits(l);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -50,6 +100,10 @@ namespace currency
     m_net_server.set_threads_prefix("RPC");
     bool r = handle_command_line(vm);
     CHECK_AND_ASSERT_MES(r, false, "Failed to process command line in core_rpc_server");
+    epee::metrics::registry& metrics = epee::metrics::registry::instance();
+    metrics.set_help("p2p_synchronizing_connections", "Number of p2p connections in synchronizing state");
+    metrics.set_help("p2p_needed_objects", "Objects still needed from peers, total over all p2p connections");
+    metrics.set_help("p2p_requested_objects", "Objects requested from peers and not yet received, total over all p2p connections");
     return epee::http_server_impl_base<core_rpc_server, connection_context>::init(m_port, m_bind_ip);
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -86,22 +140,27 @@ namespace currency
       return true; 
     }
 
-    res.height = m_core.get_current_blockchain_height();
-    res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block().convert_to<uint64_t>();
-    res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
+    // snapshot maintained by blockchain_storage on each main chain change, doesn't touch blockchain lock
+    currency::blockchain_storage::chain_stats cs = m_core.get_blockchain_storage().get_chain_stats();
+    res.height = cs.height;
+    res.difficulty = cs.next_difficulty.convert_to<uint64_t>();
+    res.tx_count = cs.total_transactions - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool_transactions_count();
-    res.alt_blocks_count = m_core.get_blockchain_storage().get_alternative_blocks_count();
+    res.alt_blocks_count = cs.alt_blocks_count;
     uint64_t total_conn = m_p2p.get_connections_count();
     res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
     res.incoming_connections_count = total_conn - res.outgoing_connections_count;
     res.white_peerlist_size = m_p2p.get_peerlist_manager().get_white_peers_count();
     res.grey_peerlist_size = m_p2p.get_peerlist_manager().get_gray_peers_count();
-    res.current_blocks_median = m_core.get_blockchain_storage().get_current_comulative_blocksize_limit()/2;
-    res.current_network_hashrate_50 = m_core.get_blockchain_storage().get_current_hashrate(50);
-    res.current_network_hashrate_350 = m_core.get_blockchain_storage().get_current_hashrate(350);
-    res.scratchpad_size = m_core.get_blockchain_storage().get_scratchpad_size();
-    res.alias_count = m_core.get_blockchain_storage().get_aliases_count();
-    m_core.get_blockchain_storage().get_transactions_daily_stat(res.transactions_cnt_per_day, res.transactions_volume_per_day);
+    res.current_blocks_median = cs.current_blocks_median;
+    res.current_network_hashrate_50 = cs.hashrate_50;
+    res.current_network_hashrate_350 = cs.hashrate_350;
+    res.scratchpad_size = cs.scratchpad_size;
+    res.alias_count = cs.aliases_count;
+    res.transactions_cnt_per_day = cs.transactions_cnt_per_day;
+    res.transactions_volume_per_day = cs.transactions_volume_per_day;
+    res.pruned_rs_height = cs.pruned_rs_height;
+    res.pruning_target_height = cs.pruning_target_height;
 
     if (!res.outgoing_connections_count)
       res.daemon_network_state = COMMAND_RPC_GET_INFO::daemon_network_state_connecting;
@@ -118,6 +177,37 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_wait_for_changes(const COMMAND_RPC_WAIT_FOR_CHANGES::request& req, COMMAND_RPC_WAIT_FOR_CHANGES::response& res, connection_context& cntx)
+  {
+    const uint32_t all_events = core_event_notifier::event_all;
+    uint32_t events_mask = req.events ? req.events & all_events : all_events;
+    core_event_notifier& notifier = m_core.get_event_notifier();
+    core_event_notifier::events_state state = notifier.get_state();
+
+    if (req.since_token && !(state.get_events_since(req.since_token) & events_mask) && req.timeout)
+    {
+      // keep at least one thread for regular requests
+      if (++m_long_poll_waiters < m_threads_count)
+        state = notifier.wait_for_events(req.since_token, events_mask, std::min<uint64_t>(req.timeout, RPC_LONG_POLL_MAX_TIMEOUT_MS));
+      --m_long_poll_waiters;
+    }
+
+    // token from before daemon restart has other epoch, everything is reported as changed
+    uint32_t events = state.get_events_since(req.since_token);
+    res.token = state.token;
+    res.tip_changed = (events & core_event_notifier::event_tip_changed) != 0;
+    res.template_changed = (events & core_event_notifier::event_template_changed) != 0;
+    res.pool_changed = (events & core_event_notifier::event_pool_changed) != 0;
+    crypto::hash top_id = null_hash;
+    uint64_t top_height = 0;
+    m_core.get_blockchain_top(top_height, top_id);
+    res.height = top_height + 1; // same as in /getheight
+    res.top_block_hash = string_tools::pod_to_hex(top_id);
+    res.tx_pool_size = m_core.get_pool_transactions_count();
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res, connection_context& cntx)
   {
     m_p2p.send_stop_signal();
@@ -200,6 +290,54 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_scanner_register_account(const COMMAND_RPC_SCANNER_REGISTER_ACCOUNT::request& req, COMMAND_RPC_SCANNER_REGISTER_ACCOUNT::response& res, connection_context& cntx)
+  {
+    account_public_address addr = AUTO_VAL_INIT(addr);
+    if (!get_account_address_from_str(addr, req.address))
+    {
+      res.status = CORE_RPC_STATUS_INVALID_ARGUMENT;
+      res.error = "wrong address";
+      return true;
+    }
+    if (!m_core.get_view_key_scanner().register_account(addr, req.view_secret_key, req.start_height, res.error))
+    {
+      res.status = CORE_RPC_STATUS_FAILED;
+      return true;
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_scanner_unregister_account(const COMMAND_RPC_SCANNER_UNREGISTER_ACCOUNT::request& req, COMMAND_RPC_SCANNER_UNREGISTER_ACCOUNT::response& res, connection_context& cntx)
+  {
+    account_public_address addr = AUTO_VAL_INIT(addr);
+    if (!get_account_address_from_str(addr, req.address))
+    {
+      res.status = CORE_RPC_STATUS_INVALID_ARGUMENT;
+      return true;
+    }
+    res.status = m_core.get_view_key_scanner().unregister_account(addr) ? CORE_RPC_STATUS_OK : CORE_RPC_STATUS_NOT_FOUND;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_scanner_get_outputs(const COMMAND_RPC_SCANNER_GET_OUTPUTS::request& req, COMMAND_RPC_SCANNER_GET_OUTPUTS::response& res, connection_context& cntx)
+  {
+    account_public_address addr = AUTO_VAL_INIT(addr);
+    if (!get_account_address_from_str(addr, req.address))
+    {
+      res.status = CORE_RPC_STATUS_INVALID_ARGUMENT;
+      return true;
+    }
+    size_t count = static_cast<size_t>(std::min<uint64_t>(req.count, COMMAND_RPC_SCANNER_GET_OUTPUTS_MAX_COUNT));
+    if (!m_core.get_view_key_scanner().get_outputs(addr, req.offset, count, res.outs, res.total_outs, res.scanned_height))
+    {
+      res.status = CORE_RPC_STATUS_NOT_FOUND;
+      return true;
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_set_maintainers_info(const COMMAND_RPC_SET_MAINTAINERS_INFO::request& req, COMMAND_RPC_SET_MAINTAINERS_INFO::response& res, connection_context& cntx)
   {
     if(!m_p2p.handle_maintainers_entry(req))
@@ -584,25 +722,9 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  uint64_t core_rpc_server::get_block_reward(const block& blk)
-  {
-    uint64_t reward = 0;
-    uint64_t royalty = 0;
-    uint64_t donation = 0;
-    uint64_t h = get_block_height(blk);
-    BOOST_FOREACH(const tx_out& out, blk.miner_tx.vout)
-    {
-      reward += out.amount;
-    }
-  
-  if(h && !(h%CURRENCY_DONATIONS_INTERVAL) /*&& h > 21600*/)
+  bool core_rpc_server::get_block_reward(const block& blk, uint64_t& reward)
   {
-    bool r = m_core.get_blockchain_storage().lookfor_donation(blk.miner_tx, donation, royalty);
-    CHECK_AND_ASSERT_MES(r, false, "Failed to lookfor_donation");
-    reward -= donation + royalty;
-  }
-
-    return reward;
+    return m_core.get_blockchain_storage().get_block_miner_reward(blk, reward);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::fill_block_header_responce(const block& blk, bool orphan_status, block_header_responce& responce)
@@ -617,8 +739,7 @@ namespace currency
     responce.depth = m_core.get_current_blockchain_height() - responce.height - 1;
     responce.hash = string_tools::pod_to_hex(get_block_hash(blk));
     responce.difficulty = m_core.get_blockchain_storage().block_difficulty(responce.height).convert_to<uint64_t>();
-    responce.reward = get_block_reward(blk);
-    return true;
+    return get_block_reward(blk, responce.reward);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res, epee::json_rpc::error& error_resp, connection_context& cntx)
@@ -716,6 +837,54 @@ namespace currency
     return true;
   }
   
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response& res, epee::json_rpc::error& error_resp, connection_context& cntx)
+  {
+    if(!check_core_ready())
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
+      error_resp.message = "Core is busy.";
+      return false;
+    }
+    if(!req.count || req.count > COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_MAX_COUNT)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "Wrong count, expected 1-" + std::to_string(COMMAND_RPC_GET_BLOCK_HEADERS_RANGE_MAX_COUNT);
+      return false;
+    }
+    if(m_core.get_current_blockchain_height() <= req.start_height)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_TOO_BIG_HEIGHT;
+      error_resp.message = std::string("To big height: ") + std::to_string(req.start_height) + ", current blockchain height = " +  std::to_string(m_core.get_current_blockchain_height());
+      return false;
+    }
+
+    std::list<blockchain_storage::block_header_index_entry> headers;
+    if(!m_core.get_blockchain_storage().get_block_headers_range(req.start_height, req.count, headers, res.height))
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Internal error: can't get block headers from height " + std::to_string(req.start_height) + '.';
+      return false;
+    }
+
+    uint64_t h = req.start_height;
+    for(const auto& bhie : headers)
+    {
+      block_header_short_entry entry = AUTO_VAL_INIT(entry);
+      entry.height = h++;
+      entry.hash = string_tools::pod_to_hex(bhie.id);
+      entry.timestamp = bhie.timestamp;
+      entry.block_size = bhie.header_blob_size + bhie.block_cumulative_size;
+      entry.difficulty = bhie.difficulty.convert_to<difficulty_type>();
+      entry.cumulative_difficulty = bhie.cumulative_difficulty.str();
+      entry.tx_count = bhie.tx_count;
+      entry.reward = bhie.reward;
+      res.headers.push_back(entry);
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
 bool core_rpc_server::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res, epee::json_rpc::error& error_resp, connection_context& cntx) {
     if(!check_core_ready())
     {
@@ -735,36 +904,25 @@ bool core_rpc_server::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST:
     last_height = 0;
   } 
 
-  for (uint64_t i = req.height; i >= last_height; i--) 
-  {
-    crypto::hash block_hash = m_core.get_block_id_by_height(static_cast<uint32_t>(i));
-    block blk;
-    if (!m_core.get_block_by_hash(block_hash, blk)) {
-      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
-      error_resp.message = "Internal error: can't get block by height. Height = " + std::to_string(i) + '.';
-      return false;
-    }
-    std::vector<size_t> blocks_sizes;
-    m_core.get_backward_blocks_sizes(i, blocks_sizes, 1);
-    
-    size_t tx_cumulative_block_size = misc_utils::median(blocks_sizes);
-    //m_core.getBlockSize(block_hash, tx_cumulative_block_size);
-    
-    size_t blokBlobSize = get_object_blobsize(blk);
-    size_t minerTxBlobSize = get_object_blobsize(blk.miner_tx);
+  std::list<blockchain_storage::block_header_index_entry> headers;
+  uint64_t height = 0;
+  if (!m_core.get_blockchain_storage().get_block_headers_range(last_height, req.height - last_height + 1, headers, height)) {
+    error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+    error_resp.message = "Internal error: can't get block headers from height " + std::to_string(last_height) + '.';
+    return false;
+  }
 
+  uint64_t i = last_height + headers.size() - 1;
+  for (auto it = headers.rbegin(); it != headers.rend(); ++it, --i)
+  {
     f_block_short_response block_short;
-    block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
-    block_short.timestamp = blk.timestamp;
+    block_short.timestamp = it->timestamp;
     block_short.height = i;
-    block_short.hash = string_tools::pod_to_hex(block_hash);
-    block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
-    block_short.tx_count = blk.tx_hashes.size() + 1;
-    block_short.difficulty = m_core.get_blockchain_storage().block_difficulty(i).convert_to<uint64_t>();
+    block_short.hash = string_tools::pod_to_hex(it->id);
+    block_short.cumul_size = it->header_blob_size + it->block_cumulative_size;
+    block_short.tx_count = it->tx_count;
+    block_short.difficulty = it->difficulty.convert_to<uint64_t>();
     res.blocks.push_back(block_short);
-
-    if (i == 0)
-      break;
   }
 
   res.status = CORE_RPC_STATUS_OK;
@@ -795,7 +953,11 @@ bool core_rpc_server::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::req
 
   block_header_responce block_header;
   res.block.height = boost::get<txin_gen>(blk.miner_tx.vin.front()).height;
-  fill_block_header_responce(blk, false, block_header);
+  if (!fill_block_header_responce(blk, false, block_header)) {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Internal error: can't produce valid response.";
+      return false;
+  }
 
   res.block.major_version = block_header.major_version;
   res.block.minor_version = block_header.minor_version;
@@ -1072,15 +1234,55 @@ bool core_rpc_server::f_getMixin(const transaction& transaction, uint64_t& mixin
 
     std::list<currency::alias_info> aliases;
     m_core.get_blockchain_storage().get_all_aliases(aliases);
-    for(auto a: aliases)
+    fill_alias_rpc_details(aliases, res.aliases);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_aliases(const COMMAND_RPC_GET_ALIASES::request& req, COMMAND_RPC_GET_ALIASES::response& res, epee::json_rpc::error& error_resp, connection_context& cntx)
+  {
+    if(!check_core_ready())
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
+      error_resp.message = "Core is busy.";
+      return false;
+    }
+    if(!req.count || req.count > COMMAND_RPC_GET_ALIASES_MAX_COUNT)
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_WRONG_PARAM;
+      error_resp.message = "Wrong count, expected 1-" + std::to_string(COMMAND_RPC_GET_ALIASES_MAX_COUNT);
+      return false;
+    }
+
+    std::list<currency::alias_info> aliases;
+    if(!m_core.get_blockchain_storage().get_aliases(req.start_alias, req.prefix, static_cast<size_t>(req.count), aliases, res.next_alias, res.height))
     {
-      res.aliases.push_back(alias_rpc_details());
-      res.aliases.back().alias = a.m_alias;
-      res.aliases.back().details.address =  currency::get_account_address_as_str(a.m_address);
-      res.aliases.back().details.comment = a.m_text_comment;
-      if(a.m_view_key != currency::null_skey)
-        res.aliases.back().details.tracking_key = string_tools::pod_to_hex(a.m_view_key);
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Internal error: can't get aliases";
+      return false;
     }
+    fill_alias_rpc_details(aliases, res.aliases);
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_alias_changes(const COMMAND_RPC_GET_ALIAS_CHANGES::request& req, COMMAND_RPC_GET_ALIAS_CHANGES::response& res, epee::json_rpc::error& error_resp, connection_context& cntx)
+  {
+    if(!check_core_ready())
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_CORE_BUSY;
+      error_resp.message = "Core is busy.";
+      return false;
+    }
+
+    std::list<currency::alias_info> aliases;
+    if(!m_core.get_blockchain_storage().get_aliases_changes(req.from_height, req.max_blocks ? req.max_blocks : COMMAND_RPC_GET_ALIAS_CHANGES_MAX_BLOCKS, aliases, res.next_height, res.height))
+    {
+      error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
+      error_resp.message = "Internal error: can't get alias changes";
+      return false;
+    }
+    fill_alias_rpc_details(aliases, res.aliases);
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -1191,6 +1393,55 @@ bool core_rpc_server::f_getMixin(const transaction& transaction, uint64_t& mixin
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    LOG_PRINT_L2("HTTP [" << epee::string_tools::get_ip_string_from_int32(m_conn_context.m_remote_ip) << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+
+    //json rpc calls are admitted by json_rpc_admission when their methods are known
+    epee::misc_utils::auto_scope_leave_caller ticket;
+    if (query_info.m_URI != "/json_rpc" && !m_admission.admit(rpc_admission_control::get_uri_work_class(query_info.m_URI), m_conn_context.m_remote_ip, ticket))
+    {
+      response.m_response_code = 503;
+      response.m_response_comment = "Service Unavailable";
+      return true;
+    }
+
+    if (!handle_http_request_map(query_info, response, m_conn_context))
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+    }
+    m_admission.charge_bytes(m_conn_context.m_remote_ip, query_info.m_body.size() + response.m_body.size());
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::json_rpc_admission(const std::vector<std::string>& methods, connection_context& cntx, epee::misc_utils::auto_scope_leave_caller& ticket)
+  {
+    return m_admission.admit(rpc_admission_control::get_methods_work_class(methods), cntx.m_remote_ip, ticket);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  epee::misc_utils::auto_scope_leave_caller core_rpc_server::json_rpc_batch_guard(const std::vector<std::string>& methods)
+  {
+    //batch made of chain queries only is served under blockchain lock, so all its answers
+    //come from the same chain state; anything else (mining, long-poll, relay) runs unlocked
+    static const std::set<std::string> chain_queries = {"getblockcount", "on_getblockhash", "getlastblockheader",
+      "getblockheaderbyhash", "getblockheaderbyheight", "getblock", "get_alias_details", "get_all_alias_details", "get_aliases", "get_alias_changes",
+      "get_alias_by_address", "get_block_headers_range", "f_blocks_list_json", "f_block_json", "f_transaction_json", "f_pool_json"};
+    BOOST_FOREACH(const std::string& m, methods)
+    {
+      if(!chain_queries.count(m))
+        return epee::misc_utils::auto_scope_leave_caller();
+    }
+    //pool goes first, same order as blockchain_storage::add_new_block, since f_pool_json reads the pool
+    tx_memory_pool& pool = m_core.get_tx_pool();
+    epee::critical_section& blockchain_lock = m_core.get_blockchain_storage().get_blockchain_lock();
+    pool.lock();
+    blockchain_lock.lock();
+    return epee::misc_utils::create_scope_leave_handler([&pool, &blockchain_lock](){ blockchain_lock.unlock(); pool.unlock(); });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   void core_rpc_server::set_session_blob(const std::string& session_id, const currency::block& blob)
   {
     CRITICAL_REGION_LOCAL(m_session_jobs_lock);
@@ -1389,6 +1640,36 @@ bool core_rpc_server::f_getMixin(const transaction& transaction, uint64_t& mixin
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& cntx)
+  {
+    //gauges are sampled on scrape, timers and counters are fed from the code as it goes
+    //object queue depths are summed over all connections, not reported per connection
+    uint64_t needed_objects = 0;
+    uint64_t requested_objects = 0;
+    uint64_t synchronizing_connections = 0;
+    nodetool::i_p2p_endpoint<currency_connection_context>& p2p_endpoint = m_p2p;
+    p2p_endpoint.for_each_connection([&](currency_connection_context& context, nodetool::peerid_type peer_id)->bool{
+      needed_objects += context.m_needed_objects.size();
+      requested_objects += context.m_requested_objects.size();
+      if(context.m_state == currency_connection_context::state_synchronizing)
+        ++synchronizing_connections;
+      return true;
+    });
+    METRICS_GAUGE_SET("p2p_connections", "", m_p2p.get_connections_count());
+    METRICS_GAUGE_SET("p2p_outgoing_connections", "", m_p2p.get_outgoing_connections_count());
+    METRICS_GAUGE_SET("p2p_synchronizing_connections", "", synchronizing_connections);
+    METRICS_GAUGE_SET("p2p_needed_objects", "", needed_objects);
+    METRICS_GAUGE_SET("p2p_requested_objects", "", requested_objects);
+    METRICS_GAUGE_SET("blockchain_height", "", m_core.get_current_blockchain_height());
+    METRICS_GAUGE_SET("mempool_transactions", "", m_core.get_pool_transactions_count());
+    METRICS_GAUGE_SET("rpc_long_poll_waiters", "", m_long_poll_waiters.load());
+
+    response_info.m_body = epee::metrics::registry::instance().render_text();
+    response_info.m_mime_tipe = "text/plain; version=0.0.4";
+    response_info.m_header_info.m_content_type = " text/plain; version=0.0.4";
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_addendums(const COMMAND_RPC_GET_ADDENDUMS::request& req, COMMAND_RPC_GET_ADDENDUMS::response& res, epee::json_rpc::error& error_resp, connection_context& cntx)
   {
     if (!check_core_ready())
@@ -13,6 +13,7 @@
 #include "p2p/net_node.h"
 #include "currency_protocol/currency_protocol_handler.h"
 #include "mining_protocol_defs.h"
+#include "rpc_admission_control.h"
 
 namespace currency
 {
@@ -28,6 +29,7 @@ namespace currency
 
     static void init_options(boost::program_options::options_description& desc);
     bool init(const boost::program_options::variables_map& vm);
+    size_t get_threads_count() const { return m_threads_count + m_priority_threads_count; }
 
     bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, connection_context& cntx);
     bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, connection_context& cntx);
@@ -43,6 +45,9 @@ namespace currency
     bool on_get_tx_pool(const COMMAND_RPC_GET_TX_POOL::request& req, COMMAND_RPC_GET_TX_POOL::response& res, connection_context& cntx);
     bool on_check_keyimages(const COMMAND_RPC_CHECK_KEYIMAGES::request& req, COMMAND_RPC_CHECK_KEYIMAGES::response& res, connection_context& cntx);
     bool on_relay_txs_to_net(const currency::COMMAND_RPC_RELAY_TXS::request& rqt, currency::COMMAND_RPC_RELAY_TXS::response& rsp, connection_context& cntx);
+    bool on_scanner_register_account(const COMMAND_RPC_SCANNER_REGISTER_ACCOUNT::request& req, COMMAND_RPC_SCANNER_REGISTER_ACCOUNT::response& res, connection_context& cntx);
+    bool on_scanner_unregister_account(const COMMAND_RPC_SCANNER_UNREGISTER_ACCOUNT::request& req, COMMAND_RPC_SCANNER_UNREGISTER_ACCOUNT::response& res, connection_context& cntx);
+    bool on_scanner_get_outputs(const COMMAND_RPC_SCANNER_GET_OUTPUTS::request& req, COMMAND_RPC_SCANNER_GET_OUTPUTS::response& res, connection_context& cntx);
     
 
     //json_rpc
@@ -54,6 +59,7 @@ namespace currency
     bool on_get_last_block_header(const COMMAND_RPC_GET_LAST_BLOCK_HEADER::request& req, COMMAND_RPC_GET_LAST_BLOCK_HEADER::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool on_get_block_header_by_hash(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool on_get_block_header_by_height(const COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::request& req, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
+    bool on_get_block_headers_range(const COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::request& req, COMMAND_RPC_GET_BLOCK_HEADERS_RANGE::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST::request& req, F_COMMAND_RPC_GET_BLOCKS_LIST::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::request& req, F_COMMAND_RPC_GET_BLOCK_DETAILS::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool f_getMixin(const transaction& transaction, uint64_t& mixin);
@@ -61,10 +67,13 @@ namespace currency
     bool f_on_transaction_json(const F_COMMAND_RPC_GET_TRANSACTION_DETAILS::request& req, F_COMMAND_RPC_GET_TRANSACTION_DETAILS::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool f_on_pool_json(const F_COMMAND_RPC_GET_POOL::request& req, F_COMMAND_RPC_GET_POOL::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool on_get_all_aliases(const COMMAND_RPC_GET_ALL_ALIASES::request& req, COMMAND_RPC_GET_ALL_ALIASES::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
+    bool on_get_aliases(const COMMAND_RPC_GET_ALIASES::request& req, COMMAND_RPC_GET_ALIASES::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
+    bool on_get_alias_changes(const COMMAND_RPC_GET_ALIAS_CHANGES::request& req, COMMAND_RPC_GET_ALIAS_CHANGES::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool on_alias_by_address(const COMMAND_RPC_GET_ALIASES_BY_ADDRESS::request& req, COMMAND_RPC_GET_ALIASES_BY_ADDRESS::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool on_get_addendums(const COMMAND_RPC_GET_ADDENDUMS::request& req, COMMAND_RPC_GET_ADDENDUMS::response& res, epee::json_rpc::error& error_resp, connection_context& cntx);
     bool on_reset_transaction_pool(const COMMAND_RPC_RESET_TX_POOL::request& req, COMMAND_RPC_RESET_TX_POOL::response& res, connection_context& cntx);
     bool on_validate_signed_text(const COMMAND_RPC_VALIDATE_SIGNED_TEXT::request& req, COMMAND_RPC_VALIDATE_SIGNED_TEXT::response& res, connection_context& cntx);
+    bool on_wait_for_changes(const COMMAND_RPC_WAIT_FOR_CHANGES::request& req, COMMAND_RPC_WAIT_FOR_CHANGES::response& res, connection_context& cntx);
 
     
     //mining rpc
@@ -74,12 +83,14 @@ namespace currency
     bool on_submit(const mining::COMMAND_RPC_SUBMITSHARE::request& req, mining::COMMAND_RPC_SUBMITSHARE::response& res, connection_context& cntx);
     bool on_store_scratchpad(const mining::COMMAND_RPC_STORE_SCRATCHPAD::request& req, mining::COMMAND_RPC_STORE_SCRATCHPAD::response& res, connection_context& cntx);
     bool on_getfullscratchpad2(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& cntx);
+    bool on_get_metrics(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response_info, connection_context& cntx);
 
     
 
   private:
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //admission control in front of uri map, see rpc_admission_control
+    virtual bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
@@ -89,6 +100,9 @@ namespace currency
       MAP_URI_AUTO_BIN2("/set_maintainers_info.bin", on_set_maintainers_info, COMMAND_RPC_SET_MAINTAINERS_INFO)
       MAP_URI_AUTO_BIN2("/get_tx_pool.bin", on_get_tx_pool, COMMAND_RPC_GET_TX_POOL)
       MAP_URI_AUTO_BIN2("/check_keyimages.bin", on_check_keyimages, COMMAND_RPC_CHECK_KEYIMAGES)
+      MAP_URI_AUTO_BIN2_IF("/scanner_register_account.bin", on_scanner_register_account, COMMAND_RPC_SCANNER_REGISTER_ACCOUNT, !m_restricted && m_core.get_view_key_scanner().is_enabled())
+      MAP_URI_AUTO_BIN2_IF("/scanner_unregister_account.bin", on_scanner_unregister_account, COMMAND_RPC_SCANNER_UNREGISTER_ACCOUNT, !m_restricted && m_core.get_view_key_scanner().is_enabled())
+      MAP_URI_AUTO_BIN2_IF("/scanner_get_outputs.bin", on_scanner_get_outputs, COMMAND_RPC_SCANNER_GET_OUTPUTS, !m_restricted && m_core.get_view_key_scanner().is_enabled())
       MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
       MAP_URI_AUTO_JON2_IF("/start_mining", on_start_mining, COMMAND_RPC_START_MINING, !m_restricted)
@@ -96,7 +110,8 @@ namespace currency
       MAP_URI_AUTO_JON2("/getinfo", on_get_info, COMMAND_RPC_GET_INFO)
       MAP_URI_AUTO_JON2_IF("/stop_daemon", on_stop_daemon, COMMAND_RPC_STOP_DAEMON, !m_restricted)
       MAP_URI2("/getfullscratchpad2", on_getfullscratchpad2)
-      BEGIN_JSON_RPC_MAP("/json_rpc")
+      MAP_URI2("/metrics", on_get_metrics)
+      BEGIN_JSON_RPC_MAP_ADMISSION("/json_rpc", m_max_batch_size, json_rpc_batch_guard, json_rpc_admission)
         MAP_JON_RPC("getblockcount",             on_getblockcount,              COMMAND_RPC_GETBLOCKCOUNT)
         MAP_JON_RPC_WE("on_getblockhash",        on_getblockhash,               COMMAND_RPC_GETBLOCKHASH)
         MAP_JON_RPC_WE("getblocktemplate",       on_getblocktemplate,           COMMAND_RPC_GETBLOCKTEMPLATE)
@@ -104,8 +119,11 @@ namespace currency
         MAP_JON_RPC_WE("getlastblockheader",     on_get_last_block_header,      COMMAND_RPC_GET_LAST_BLOCK_HEADER)
         MAP_JON_RPC_WE("getblockheaderbyhash",   on_get_block_header_by_hash,   COMMAND_RPC_GET_BLOCK_HEADER_BY_HASH)
         MAP_JON_RPC_WE("getblockheaderbyheight", on_get_block_header_by_height, COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT)
+        MAP_JON_RPC_WE("get_block_headers_range", on_get_block_headers_range,   COMMAND_RPC_GET_BLOCK_HEADERS_RANGE)
         MAP_JON_RPC_WE("get_alias_details",      on_get_alias_details,          COMMAND_RPC_GET_ALIAS_DETAILS)
         MAP_JON_RPC_WE("get_all_alias_details",  on_get_all_aliases,            COMMAND_RPC_GET_ALL_ALIASES)
+        MAP_JON_RPC_WE("get_aliases",            on_get_aliases,                COMMAND_RPC_GET_ALIASES)
+        MAP_JON_RPC_WE("get_alias_changes",      on_get_alias_changes,          COMMAND_RPC_GET_ALIAS_CHANGES)
         MAP_JON_RPC_WE("get_alias_by_address",   on_alias_by_address,           COMMAND_RPC_GET_ALIASES_BY_ADDRESS)
         MAP_JON_RPC_WE("get_addendums",          on_get_addendums,              COMMAND_RPC_GET_ADDENDUMS)
         MAP_JON_RPC_WE("f_blocks_list_json",     f_on_blocks_list_json,         F_COMMAND_RPC_GET_BLOCKS_LIST)
@@ -116,6 +134,7 @@ namespace currency
         MAP_JON_RPC_WE("getblock",               on_getblock,                   COMMAND_RPC_GETBLOCK)
         MAP_JON_RPC("relay_txs",              on_relay_txs_to_net,           COMMAND_RPC_RELAY_TXS)
         MAP_JON_RPC("validate_signed_text",      on_validate_signed_text,       COMMAND_RPC_VALIDATE_SIGNED_TEXT)
+        MAP_JON_RPC("wait_for_changes",          on_wait_for_changes,           COMMAND_RPC_WAIT_FOR_CHANGES)
         //remote miner rpc
         MAP_JON_RPC_N(on_login,            mining::COMMAND_RPC_LOGIN)
         MAP_JON_RPC_N(on_getjob,           mining::COMMAND_RPC_GETJOB)
@@ -133,9 +152,11 @@ namespace currency
     bool get_addendum_for_hi(const mining::height_info& hi, std::list<mining::addendum>& res);
     bool get_job(const std::string& job_id, mining::job_details& job, epee::json_rpc::error& err, connection_context& cntx);
     bool get_current_hi(mining::height_info& hi);
+    epee::misc_utils::auto_scope_leave_caller json_rpc_batch_guard(const std::vector<std::string>& methods);
+    bool json_rpc_admission(const std::vector<std::string>& methods, connection_context& cntx, epee::misc_utils::auto_scope_leave_caller& ticket);
 
     //utils
-    uint64_t get_block_reward(const block& blk);
+    bool get_block_reward(const block& blk, uint64_t& reward);
     bool fill_block_header_responce(const block& blk, bool orphan_status, block_header_responce& responce);
     void set_session_blob(const std::string& session_id, const currency::block& blob);
     bool get_session_blob(const std::string& session_id, currency::block& blob);
@@ -149,5 +170,12 @@ namespace currency
     epee::critical_section m_session_jobs_lock;
     std::map<std::string, currency::block> m_session_jobs; //session id -> blob
     std::atomic<size_t> m_session_counter;
+    //long-poll
+    size_t m_threads_count;
+    std::atomic<size_t> m_long_poll_waiters;
+    size_t m_max_batch_size;
+    //admission control
+    size_t m_priority_threads_count;
+    rpc_admission_control m_admission;
   };
 }
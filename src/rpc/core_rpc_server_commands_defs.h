@@ -6,6 +6,7 @@
 #include "currency_protocol/currency_protocol_defs.h"
 #include "currency_core/currency_basic.h"
 #include "currency_core/difficulty.h"
+#include "currency_core/view_key_scanner.h"
 #include "crypto/hash.h"
 #include "p2p/p2p_protocol_defs.h"
 #include "rpc/mining_protocol_defs.h"
@@ -331,6 +332,8 @@ struct EMPTY_STRUCT {
       uint64_t max_net_seen_height;
       uint64_t transactions_cnt_per_day;
       uint64_t transactions_volume_per_day;
+      uint64_t pruned_rs_height;
+      uint64_t pruning_target_height;
       nodetool::maintainers_info_external mi;
 
       BEGIN_KV_SERIALIZE_MAP()
@@ -354,6 +357,8 @@ struct EMPTY_STRUCT {
         KV_SERIALIZE(max_net_seen_height)
         KV_SERIALIZE(transactions_cnt_per_day)
         KV_SERIALIZE(transactions_volume_per_day)
+        KV_SERIALIZE(pruned_rs_height)
+        KV_SERIALIZE(pruning_target_height)
         KV_SERIALIZE(mi)
       END_KV_SERIALIZE_MAP()
     };
@@ -606,6 +611,56 @@ struct EMPTY_STRUCT {
 
   };
 
+  struct block_header_short_entry
+  {
+    uint64_t height;
+    std::string hash;
+    uint64_t timestamp;
+    uint64_t block_size;            //block blob size without coinbase + cumulative size of block
+    difficulty_type difficulty;
+    std::string cumulative_difficulty;
+    uint64_t tx_count;              //including coinbase
+    uint64_t reward;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(hash)
+      KV_SERIALIZE(timestamp)
+      KV_SERIALIZE(block_size)
+      KV_SERIALIZE(difficulty)
+      KV_SERIALIZE(cumulative_difficulty)
+      KV_SERIALIZE(tx_count)
+      KV_SERIALIZE(reward)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct COMMAND_RPC_GET_BLOCK_HEADERS_RANGE
+  {
+    struct request
+    {
+      uint64_t start_height;
+      uint64_t count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(count)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::list<block_header_short_entry> headers; //ascending by height, may be shorter than count at the top of the chain
+      uint64_t height;                             //blockchain height the range was read at
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(headers)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_GET_ALIAS_DETAILS
   {
     struct request
@@ -650,6 +705,68 @@ struct EMPTY_STRUCT {
   };
 
 
+  struct COMMAND_RPC_GET_ALIASES
+  {
+    struct request
+    {
+      std::string start_alias;  //first alias of the page, empty - from the beginning
+      std::string prefix;       //only aliases starting with this prefix
+      uint64_t count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(start_alias)
+        KV_SERIALIZE(prefix)
+        KV_SERIALIZE(count)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::list<alias_rpc_details> aliases;
+      std::string next_alias;   //start_alias for the next page, empty if this page is the last one
+      uint64_t height;          //blockchain height the page is consistent with
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(aliases)
+        KV_SERIALIZE(next_alias)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+
+  struct COMMAND_RPC_GET_ALIAS_CHANGES
+  {
+    struct request
+    {
+      uint64_t from_height;
+      uint64_t max_blocks;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(from_height)
+        KV_SERIALIZE(max_blocks)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::list<alias_rpc_details> aliases; //actual state of aliases registered or updated in [from_height, next_height)
+      uint64_t next_height;
+      uint64_t height;
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(aliases)
+        KV_SERIALIZE(next_height)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+
   struct COMMAND_RPC_GET_ALIASES_BY_ADDRESS
   {
 
@@ -1043,5 +1160,124 @@ struct F_COMMAND_RPC_GET_BLOCKCHAIN_SETTINGS {
     };
   };
 
-}
+  // long-poll: returns when something of interest changed after since_token or on timeout
+  struct COMMAND_RPC_WAIT_FOR_CHANGES
+  {
+    struct request
+    {
+      uint64_t since_token;  // token from previous response, 0 - return current state immediately (all reported as changed)
+      uint32_t events;       // mask of core_event_notifier::event_type, 0 - any event
+      uint64_t timeout;      // milliseconds, limited by daemon
 
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(since_token)
+        KV_SERIALIZE(events)
+        KV_SERIALIZE(timeout)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t token;
+      bool tip_changed;
+      bool template_changed;
+      bool pool_changed;
+      uint64_t height;
+      std::string top_block_hash;
+      uint64_t tx_pool_size;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(token)
+        KV_SERIALIZE(tip_changed)
+        KV_SERIALIZE(template_changed)
+        KV_SERIALIZE(pool_changed)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(top_block_hash)
+        KV_SERIALIZE(tx_pool_size)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  // view key scanner, available on unrestricted rpc of daemon run with --enable-view-key-scanner
+  struct COMMAND_RPC_SCANNER_REGISTER_ACCOUNT
+  {
+    struct request
+    {
+      std::string address;
+      crypto::secret_key view_secret_key;
+      uint64_t start_height;  // first block that may have account outputs
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(address)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(view_secret_key)
+        KV_SERIALIZE(start_height)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      std::string error;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(error)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_SCANNER_UNREGISTER_ACCOUNT
+  {
+    struct request
+    {
+      std::string address;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(address)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct COMMAND_RPC_SCANNER_GET_OUTPUTS
+  {
+    struct request
+    {
+      std::string address;
+      uint64_t offset;  // outputs are in chain order, new ones are appended
+      uint64_t count;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(address)
+        KV_SERIALIZE(offset)
+        KV_SERIALIZE(count)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t scanned_height;  // blocks below it are scanned for the account
+      uint64_t total_outs;
+      std::list<view_key_scanner_output> outs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(scanned_height)
+        KV_SERIALIZE(total_outs)
+        KV_SERIALIZE(outs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+}
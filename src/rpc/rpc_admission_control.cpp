@@ -0,0 +1,173 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <set>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include "include_base_utils.h"
+using namespace epee;
+
+#include "rpc_admission_control.h"
+
+#define RPC_ADMISSION_BYTES_BURST_SECONDS       5
+#define RPC_ADMISSION_IPS_SWEEP_THRESHOLD       10000
+
+namespace currency
+{
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_admission_control::rpc_admission_control()
+  {
+    m_limits = AUTO_VAL_INIT(m_limits);
+    for (size_t i = 0; i != work_classes_count; i++)
+    {
+      m_inflight[i] = 0;
+      m_inflight_gauges[i] = &epee::metrics::registry::instance().get_gauge("rpc_inflight_requests", std::string("class=\"") + get_work_class_name(static_cast<work_class>(i)) + "\"");
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_admission_control::set_limits(const limits& l)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_limits = l;
+    m_ips.clear();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool rpc_admission_control::admit(work_class wc, uint32_t ip, epee::misc_utils::auto_scope_leave_caller& ticket)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (wc != work_class_priority)
+    {
+      if (m_limits.normal_concurrency && m_inflight[work_class_normal] + m_inflight[work_class_bulk] >= m_limits.normal_concurrency)
+      {
+        on_refused(wc, "threads");
+        return false;
+      }
+      if (wc == work_class_bulk && m_limits.bulk_concurrency && m_inflight[work_class_bulk] >= m_limits.bulk_concurrency)
+      {
+        on_refused(wc, "bulk_threads");
+        return false;
+      }
+      if (m_limits.per_ip_concurrency || m_limits.per_ip_bytes_per_second)
+      {
+        auto it = m_ips.find(ip);
+        if (it == m_ips.end())
+        {
+          ip_state s = AUTO_VAL_INIT(s);
+          s.bytes_allowance = static_cast<double>(m_limits.per_ip_bytes_per_second * RPC_ADMISSION_BYTES_BURST_SECONDS);
+          s.last_refill_ms = misc_utils::get_tick_count();
+          it = m_ips.insert(std::make_pair(ip, s)).first;
+        }
+        ip_state& s = it->second;
+        refill(s, misc_utils::get_tick_count());
+        if (m_limits.per_ip_concurrency && s.inflight >= m_limits.per_ip_concurrency)
+        {
+          on_refused(wc, "ip_concurrency");
+          return false;
+        }
+        if (m_limits.per_ip_bytes_per_second && s.bytes_allowance <= 0)
+        {
+          on_refused(wc, "ip_bytes");
+          return false;
+        }
+        ++s.inflight;
+      }
+    }
+
+    m_inflight_gauges[wc]->set(++m_inflight[wc]);
+    ticket = misc_utils::create_scope_leave_handler([this, wc, ip](){ release(wc, ip); });
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_admission_control::release(work_class wc, uint32_t ip)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    m_inflight_gauges[wc]->set(--m_inflight[wc]);
+    if (wc == work_class_priority)
+      return;
+
+    auto it = m_ips.find(ip);
+    if (it != m_ips.end() && it->second.inflight)
+      --it->second.inflight;
+
+    if (m_ips.size() < RPC_ADMISSION_IPS_SWEEP_THRESHOLD)
+      return;
+    //forget idle clients with full allowance, they'd start from the same state anyway
+    uint64_t now = misc_utils::get_tick_count();
+    double full_allowance = static_cast<double>(m_limits.per_ip_bytes_per_second * RPC_ADMISSION_BYTES_BURST_SECONDS);
+    misc_utils::erase_if(m_ips, [&](std::pair<const uint32_t, ip_state>& s){
+      refill(s.second, now);
+      return !s.second.inflight && s.second.bytes_allowance >= full_allowance;
+    });
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_admission_control::charge_bytes(uint32_t ip, uint64_t bytes)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (!m_limits.per_ip_bytes_per_second)
+      return;
+    auto it = m_ips.find(ip);
+    if (it == m_ips.end())
+      return;
+    //allowance may go below zero, client is refused until it's refilled back
+    it->second.bytes_allowance -= static_cast<double>(bytes);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_admission_control::refill(ip_state& s, uint64_t now_ms)
+  {
+    if (now_ms <= s.last_refill_ms)
+      return;
+    double full_allowance = static_cast<double>(m_limits.per_ip_bytes_per_second * RPC_ADMISSION_BYTES_BURST_SECONDS);
+    s.bytes_allowance = std::min(full_allowance, s.bytes_allowance + static_cast<double>(m_limits.per_ip_bytes_per_second) * (now_ms - s.last_refill_ms) / 1000);
+    s.last_refill_ms = now_ms;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void rpc_admission_control::on_refused(work_class wc, const char* reason)
+  {
+    epee::metrics::registry::instance().get_counter("rpc_refused_requests_total", std::string("class=\"") + get_work_class_name(wc) + "\",reason=\"" + reason + "\"").add(1);
+    LOG_PRINT_L1("RPC request of class " << get_work_class_name(wc) << " refused: " << reason);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_admission_control::work_class rpc_admission_control::get_uri_work_class(const std::string& uri)
+  {
+    static const std::set<std::string> priority_uris = {"/sendrawtransaction"};
+    static const std::set<std::string> bulk_uris = {"/getblocks.bin", "/getrandom_outs.bin", "/get_tx_pool.bin", "/check_keyimages.bin",
+      "/gettransactions", "/getfullscratchpad2"};
+    if (priority_uris.count(uri))
+      return work_class_priority;
+    if (bulk_uris.count(uri))
+      return work_class_bulk;
+    return work_class_normal;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_admission_control::work_class rpc_admission_control::get_method_work_class(const std::string& method)
+  {
+    static const std::set<std::string> priority_methods = {"getblocktemplate", "submitblock", "relay_txs", "login", "getjob", "submit"};
+    static const std::set<std::string> bulk_methods = {"get_all_alias_details", "get_aliases", "get_alias_changes", "get_block_headers_range",
+      "f_blocks_list_json", "f_pool_json", "getfullscratchpad"};
+    if (priority_methods.count(method))
+      return work_class_priority;
+    if (bulk_methods.count(method))
+      return work_class_bulk;
+    return work_class_normal;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  rpc_admission_control::work_class rpc_admission_control::get_methods_work_class(const std::vector<std::string>& methods)
+  {
+    work_class wc = work_class_priority;
+    BOOST_FOREACH(const std::string& m, methods)
+      wc = std::max(wc, get_method_work_class(m));
+    return wc;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  const char* rpc_admission_control::get_work_class_name(work_class wc)
+  {
+    switch (wc)
+    {
+    case work_class_priority: return "priority";
+    case work_class_normal:   return "normal";
+    case work_class_bulk:     return "bulk";
+    default:                  return "unknown";
+    }
+  }
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "misc_language.h"
+#include "syncobj.h"
+#include "metrics_registry.h"
+
+namespace currency
+{
+  // Admission control for RPC requests.
+  // Requests are split into work classes: priority (mining and submission, never limited here,
+  // server runs extra threads only they can get), normal, and bulk (expensive reads, limited to
+  // a part of normal threads). Non-priority requests can also be limited per client ip by number
+  // of concurrent requests and by request+response bytes per second.
+  // There is no waiting queue: request over the limits is refused right away and doesn't hold a thread.
+  class rpc_admission_control
+  {
+  public:
+    enum work_class
+    {
+      work_class_priority = 0,
+      work_class_normal,
+      work_class_bulk,
+      work_classes_count
+    };
+
+    struct limits
+    {
+      size_t normal_concurrency;       //normal + bulk requests at once, 0 - unlimited
+      size_t bulk_concurrency;         //bulk requests at once, 0 - unlimited
+      size_t per_ip_concurrency;       //non-priority requests at once from one ip, 0 - unlimited
+      uint64_t per_ip_bytes_per_second;//non-priority request+response bytes from one ip, 0 - unlimited
+    };
+
+    rpc_admission_control();
+    void set_limits(const limits& l);
+
+    //on success ticket holds the slot until it's released
+    bool admit(work_class wc, uint32_t ip, epee::misc_utils::auto_scope_leave_caller& ticket);
+    //bytes of any request count, but only non-priority ones are refused when allowance is over
+    void charge_bytes(uint32_t ip, uint64_t bytes);
+
+    static work_class get_uri_work_class(const std::string& uri);
+    static work_class get_method_work_class(const std::string& method);
+    //batch goes as its most expensive call
+    static work_class get_methods_work_class(const std::vector<std::string>& methods);
+    static const char* get_work_class_name(work_class wc);
+
+  private:
+    struct ip_state
+    {
+      size_t inflight;
+      double bytes_allowance;
+      uint64_t last_refill_ms;
+    };
+
+    void release(work_class wc, uint32_t ip);
+    void refill(ip_state& s, uint64_t now_ms);
+    void on_refused(work_class wc, const char* reason);
+
+    epee::critical_section m_lock;
+    limits m_limits;
+    size_t m_inflight[work_classes_count];
+    epee::metrics::gauge* m_inflight_gauges[work_classes_count];
+    std::unordered_map<uint32_t, ip_state> m_ips;
+  };
+}
@@ -1200,14 +1200,18 @@ bool simple_wallet::check_tx_key_helper(const crypto::hash &txid, const currency
 
   uint64_t received = 0;
   try {
+    std::vector<crypto::public_key> pubkeys(tx.vout.size());
+    if (pubkeys.size() && !crypto::derive_public_keys(derivation, 0, address.m_spend_public_key, &pubkeys[0], pubkeys.size()))
+    {
+      fail_msg_writer() << "failed to derive output keys";
+      return true;
+    }
     for (size_t n = 0; n < tx.vout.size(); ++n)
     {
       if (typeid(txout_to_key) != tx.vout[n].target.type())
         continue;
       const txout_to_key tx_out_to_key = boost::get<txout_to_key>(tx.vout[n].target);
-      crypto::public_key pubkey;
-      derive_public_key(derivation, n, address.m_spend_public_key, pubkey);
-      if (pubkey == tx_out_to_key.key)
+      if (pubkeys[n] == tx_out_to_key.key)
       {
           uint64_t amount = 0;
         if (tx.version == 1)
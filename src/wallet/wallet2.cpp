@@ -5,6 +5,7 @@
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <thread>
 
 #include <boost/utility/value_init.hpp>
 #include "include_base_utils.h"
@@ -16,6 +17,7 @@ using namespace epee;
 #include "misc_language.h"
 #include "currency_core/currency_basic_impl.h"
 #include "common/boost_serialization_helper.h"
+#include "common/util.h"
 #include "profile_tools.h"
 #include "crypto/crypto.h"
 #include "serialization/binary_utils.h"
@@ -56,20 +58,19 @@ std::shared_ptr<i_core_proxy> wallet2::get_core_proxy()
   return m_core_proxy;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b)
+void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b, const currency::output_scanner::tx_entry& scanned)
 {
   std::string recipient, recipient_alias;
   process_unconfirmed(tx, recipient, recipient_alias);
-  std::vector<size_t> outs;
-  uint64_t tx_money_got_in_outs = 0;
-  crypto::public_key tx_pub_key = null_pkey;
-  bool r = parse_and_validate_tx_extra(tx, tx_pub_key);
-  CHECK_AND_THROW_WALLET_EX(!r, error::tx_extra_parse_error, tx);
+  CHECK_AND_THROW_WALLET_EX(!scanned.result, error::acc_outs_lookup_error, tx, scanned.tx_pub_key, m_account.get_keys());
 
-  r = lookup_acc_outs(m_account.get_keys(), tx, tx_pub_key, outs, tx_money_got_in_outs);
-  CHECK_AND_THROW_WALLET_EX(!r, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
+  //scanner holds only this wallet's account
+  static const std::vector<size_t> no_outs;
+  const std::vector<size_t>& outs = scanned.found.size() ? scanned.found.front().outs : no_outs;
+  uint64_t tx_money_got_in_outs = scanned.found.size() ? scanned.found.front().money : 0;
 
   money_transfer2_details mtd;
+  crypto::hash tx_id = get_transaction_hash(tx);
 
   if(!outs.empty() && tx_money_got_in_outs)
   {
@@ -77,7 +78,7 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
     //usually we have only one transfer for user in transaction
     currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
     currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response res = AUTO_VAL_INIT(res);
-    req.txid = get_transaction_hash(tx);
+    req.txid = tx_id;
     bool r = m_core_proxy->call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(req, res);
     CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
     CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
@@ -86,6 +87,7 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
       "transactions outputs size=" + std::to_string(tx.vout.size()) +
       " not match with COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES response size=" + std::to_string(res.o_indexes.size()));
 
+    m_journal.add(WALLET_JOURNAL_TRANSFER_TX, tx_id, tx);
     for(size_t o : outs)
     {
       CHECK_AND_THROW_WALLET_EX(tx.vout.size() <= o, error::wallet_internal_error, "wrong out in transaction: internal index=" +
@@ -99,14 +101,17 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
       td.m_internal_output_index = o;
       td.m_global_output_index = res.o_indexes[o];
       td.m_tx = tx;
+      td.m_tx_id = tx_id;
       td.m_spent = false;
       currency::keypair in_ephemeral;
-      currency::generate_key_image_helper(m_account.get_keys(), tx_pub_key, o, in_ephemeral, td.m_key_image);
+      currency::generate_key_image_helper(m_account.get_keys(), scanned.found.front().derivation, o, in_ephemeral, td.m_key_image);
       CHECK_AND_THROW_WALLET_EX(in_ephemeral.pub != boost::get<currency::txout_to_key>(tx.vout[o].target).key,
         error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
 
       m_key_images[td.m_key_image] = m_transfers.size()-1;
-      LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << get_transaction_hash(tx));
+      add_transfer_to_indexes(m_transfers.size()-1);
+      m_journal.add(WALLET_JOURNAL_TRANSFER_ADDED, td);
+      LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << tx_id);
       if (0 != m_callback)
         m_callback->on_money_received(height, td.m_tx, td.m_internal_output_index);
     }
@@ -122,10 +127,10 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
     auto it = m_key_images.find(boost::get<currency::txin_to_key>(in).k_image);
     if(it != m_key_images.end())
     {
-      LOG_PRINT_L0("Spent money: " << print_money(boost::get<currency::txin_to_key>(in).amount) << ", with tx: " << get_transaction_hash(tx));
+      LOG_PRINT_L0("Spent money: " << print_money(boost::get<currency::txin_to_key>(in).amount) << ", with tx: " << tx_id);
       tx_money_spent_in_ins += boost::get<currency::txin_to_key>(in).amount;
       transfer_details& td = m_transfers[it->second];
-      td.m_spent = true;
+      set_transfer_spent(it->second, true);
       
       mtd.spent_indices.push_back(i);
 
@@ -142,11 +147,13 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
       if (0 < received && payment_id.size() != 0)
       {
         payment_details payment;
-        payment.m_tx_hash      = currency::get_transaction_hash(tx);
+        payment.m_tx_hash      = tx_id;
         payment.m_amount       = received;
         payment.m_block_height = height;
         payment.m_unlock_time  = tx.unlock_time;
         m_payments.emplace(payment_id, payment);
+        m_payment_ids_by_height.emplace(height, payment_id);
+        m_journal.add(WALLET_JOURNAL_PAYMENT_ADDED, payment_id, payment);
         LOG_PRINT_L2("Payment found: " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
       }
     }
@@ -193,6 +200,8 @@ void wallet2::handle_money_received2(const currency::block& b, const currency::t
   wallet_rpc::wallet_transfer_info& wti = m_transfer_history.back();
   prepare_wti(wti, get_block_height(b), b.timestamp, tx, amount, td);
   wti.is_income = true;
+  add_history_entry_to_indexes(m_transfer_history.size() - 1);
+  m_journal.add(WALLET_JOURNAL_HISTORY_ADDED, wti);
 
   if (m_callback)
     m_callback->on_transfer2(wti);
@@ -206,6 +215,8 @@ void wallet2::handle_money_spent2(const currency::block& b, const currency::tran
   wti.is_income = false;
   wti.destinations = recipient;
   wti.destination_alias = recipient_alias;
+  add_history_entry_to_indexes(m_transfer_history.size() - 1);
+  m_journal.add(WALLET_JOURNAL_HISTORY_ADDED, wti);
 
   if (m_callback)
     m_callback->on_transfer2(wti);
@@ -218,31 +229,26 @@ void wallet2::process_unconfirmed(const currency::transaction& tx, std::string&
   {
     recipient = unconf_it->second.m_recipient;
     recipient_alias = unconf_it->second.m_recipient_alias;
+    m_journal.add(WALLET_JOURNAL_UNCONFIRMED_REMOVED, unconf_it->first);
     m_unconfirmed_txs.erase(unconf_it);
   }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const currency::block& b, currency::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height)
+void wallet2::process_new_blockchain_entry(const currency::block& b, const std::vector<currency::transaction>& txs, const currency::output_scanner::tx_entry* scanned, const crypto::hash& bl_id, uint64_t height)
 {
   //handle transactions from new block
   CHECK_AND_THROW_WALLET_EX(height != m_blockchain.size(), error::wallet_internal_error,
     "current_index=" + std::to_string(height) + ", m_blockchain.size()=" + std::to_string(m_blockchain.size()));
 
-  //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
-  if(b.timestamp + 60*60*24 > m_account.get_createtime())
+  if(scanned)
   {
     TIME_MEASURE_START(miner_tx_handle_time);
-    process_new_transaction(b.miner_tx, height, b);
+    process_new_transaction(b.miner_tx, height, b, scanned[0]);
     TIME_MEASURE_FINISH(miner_tx_handle_time);
 
     TIME_MEASURE_START(txs_handle_time);
-    BOOST_FOREACH(auto& txblob, bche.txs)
-    {
-      currency::transaction tx;
-      bool r = parse_and_validate_tx_from_blob(txblob, tx);
-      CHECK_AND_THROW_WALLET_EX(!r, error::tx_parse_error, txblob);
-      process_new_transaction(tx, height, b);
-    }
+    for (size_t i = 0; i != txs.size(); i++)
+      process_new_transaction(txs[i], height, b, scanned[i + 1]);
     TIME_MEASURE_FINISH(txs_handle_time);
     LOG_PRINT_L2("Processed block: " << bl_id << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
   }else
@@ -251,6 +257,7 @@ void wallet2::process_new_blockchain_entry(const currency::block& b, currency::b
   }
   m_blockchain.push_back(bl_id);
   ++m_local_bc_height;
+  m_journal.add(WALLET_JOURNAL_BLOCK_ADDED, bl_id);
 
   if (0 != m_callback)
     m_callback->on_new_block(height, b);
@@ -297,39 +304,94 @@ void wallet2::pull_blocks(size_t& blocks_added)
     "wrong daemon response: m_start_height=" + std::to_string(res.start_height) +
     " not less than local blockchain size=" + std::to_string(m_blockchain.size()));
 
+  //parse all blocks first, so transactions of new blocks are scanned for our outputs in one batch
+  std::vector<pulled_block> blocks(res.blocks.size());
+  size_t scan_entries_count = 0;
   size_t current_index = res.start_height;
+  size_t i = 0;
   BOOST_FOREACH(auto& bl_entry, res.blocks)
   {
-    currency::block bl;
-    r = currency::parse_and_validate_block_from_blob(bl_entry.block, bl);
+    pulled_block& pb = blocks[i++];
+    r = currency::parse_and_validate_block_from_blob(bl_entry.block, pb.b);
     CHECK_AND_THROW_WALLET_EX(!r, error::block_parse_error, bl_entry.block);
+    pb.id = get_block_hash(pb.b);
+    pb.known = current_index < m_blockchain.size() && pb.id == m_blockchain[current_index];
+    pb.first_scan_entry = SIZE_MAX;
+    ++current_index;
+
+    //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
+    if (pb.known || pb.b.timestamp + 60*60*24 <= m_account.get_createtime())
+      continue;
 
-    crypto::hash bl_id = get_block_hash(bl);
+    pb.txs.resize(bl_entry.txs.size());
+    size_t j = 0;
+    BOOST_FOREACH(auto& txblob, bl_entry.txs)
+    {
+      r = parse_and_validate_tx_from_blob(txblob, pb.txs[j++]);
+      CHECK_AND_THROW_WALLET_EX(!r, error::tx_parse_error, txblob);
+    }
+    pb.first_scan_entry = scan_entries_count;
+    scan_entries_count += 1 + pb.txs.size();
+  }
+
+  std::vector<currency::output_scanner::tx_entry> scan_entries;
+  scan_entries.reserve(scan_entries_count);
+  BOOST_FOREACH(const pulled_block& pb, blocks)
+  {
+    if (pb.first_scan_entry == SIZE_MAX)
+      continue;
+    add_scan_entry(pb.b.miner_tx, scan_entries);
+    BOOST_FOREACH(const currency::transaction& tx, pb.txs)
+      add_scan_entry(tx, scan_entries);
+  }
+  currency::output_scanner scanner;
+  scanner.add_account(m_account.get_keys());
+  TIME_MEASURE_START(scan_time);
+  scanner.scan_transactions(scan_entries, std::thread::hardware_concurrency());
+  TIME_MEASURE_FINISH(scan_time);
+  LOG_PRINT_L2("Scanned " << scan_entries.size() << " transactions of " << blocks.size() << " blocks in " << scan_time << "ms");
+
+  current_index = res.start_height;
+  BOOST_FOREACH(const pulled_block& pb, blocks)
+  {
+    const currency::output_scanner::tx_entry* scanned = pb.first_scan_entry == SIZE_MAX ? nullptr : &scan_entries[pb.first_scan_entry];
     if(current_index >= m_blockchain.size())
     {
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      CHECK_AND_THROW_WALLET_EX(pb.known, error::wallet_internal_error, "block " + string_tools::pod_to_hex(pb.id) + " unexpectedly needs processing");
+      process_new_blockchain_entry(pb.b, pb.txs, scanned, pb.id, current_index);
       ++blocks_added;
     }
-    else if(bl_id != m_blockchain[current_index])
+    else if(pb.id != m_blockchain[current_index])
     {
       //split detected here !!!
       CHECK_AND_THROW_WALLET_EX(current_index == res.start_height, error::wallet_internal_error,
-        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(bl_id) + 
+        "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(pb.id) + 
         " (height " + std::to_string(res.start_height) + "), local block id at this height: " +
         string_tools::pod_to_hex(m_blockchain[current_index]));
 
       detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(pb.b, pb.txs, scanned, pb.id, current_index);
     }
     else
     {
-      LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(bl_id));
+      LOG_PRINT_L2("Block is already in blockchain: " << string_tools::pod_to_hex(pb.id));
     }
 
     ++current_index;
   }
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::add_scan_entry(const currency::transaction& tx, std::vector<currency::output_scanner::tx_entry>& scan_entries)
+{
+  scan_entries.push_back(currency::output_scanner::tx_entry());
+  currency::output_scanner::tx_entry& e = scan_entries.back();
+  e.ptx = &tx;
+  e.tx_pub_key = null_pkey;
+  e.result = false;
+  bool r = parse_and_validate_tx_extra(tx, e.tx_pub_key);
+  CHECK_AND_THROW_WALLET_EX(!r, error::tx_extra_parse_error, tx);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::refresh()
 {
   size_t blocks_fetched = 0;
@@ -446,7 +508,7 @@ void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
   blocks_fetched = 0;
   size_t added_blocks = 0;
   size_t try_count = 0;
-  crypto::hash last_tx_hash_id = m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash;
+  crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_tx_id : null_hash;
 
   while(m_run.load(std::memory_order_relaxed))
   {
@@ -472,7 +534,7 @@ void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
       }
     }
   }
-  if(last_tx_hash_id != (m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash))
+  if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_tx_id : null_hash))
     received_money = true;
 
   LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << ", balance: " << print_money(balance()) << ", unlocked: " << print_money(unlocked_balance()));
@@ -499,15 +561,19 @@ void wallet2::detach_blockchain(uint64_t height)
 {
   LOG_PRINT_L0("Detaching blockchain on height " << height);
   size_t transfers_detached = 0;
+  m_journal.add(WALLET_JOURNAL_DETACH, height);
 
-  auto it = std::find_if(m_transfers.begin(), m_transfers.end(), [&](const transfer_details& td){return td.m_block_height >= height;});
+  // transfers are ordered by height, so are history entries and payments indexes
+  auto it = std::lower_bound(m_transfers.begin(), m_transfers.end(), height, [](const transfer_details& td, uint64_t h){return td.m_block_height < h;});
   size_t i_start = it - m_transfers.begin();
 
-  for(size_t i = i_start; i!= m_transfers.size();i++)
+  for(size_t i = m_transfers.size(); i != i_start; )
   {
+    --i;
     auto it_ki = m_key_images.find(m_transfers[i].m_key_image);
     CHECK_AND_THROW_WALLET_EX(it_ki == m_key_images.end(), error::wallet_internal_error, "key image not found");
     m_key_images.erase(it_ki);
+    remove_transfer_from_indexes(i);
     ++transfers_detached;
   }
   m_transfers.erase(it, m_transfers.end());
@@ -516,13 +582,27 @@ void wallet2::detach_blockchain(uint64_t height)
   m_blockchain.erase(m_blockchain.begin()+height, m_blockchain.end());
   m_local_bc_height -= blocks_detached;
 
-  for (auto it = m_payments.begin(); it != m_payments.end(); )
+  auto pid_it = m_payment_ids_by_height.lower_bound(height);
+  for (auto it = pid_it; it != m_payment_ids_by_height.end(); ++it)
   {
-    if(height <= it->second.m_block_height)
-      it = m_payments.erase(it);
-    else
-      ++it;
+    auto range = m_payments.equal_range(it->second);
+    for (auto p_it = range.first; p_it != range.second; )
+    {
+      if (height <= p_it->second.m_block_height)
+        p_it = m_payments.erase(p_it);
+      else
+        ++p_it;
+    }
   }
+  m_payment_ids_by_height.erase(pid_it, m_payment_ids_by_height.end());
+
+  // history entries of detached blocks would otherwise be reported twice once the new chain is processed
+  auto history_it = std::lower_bound(m_transfer_history.begin(), m_transfer_history.end(), height, [](const wallet_rpc::wallet_transfer_info& wti, uint64_t h){ return wti.height < h; });
+  size_t history_start = history_it - m_transfer_history.begin();
+  m_transfer_history.erase(history_it, m_transfer_history.end());
+  m_history_in.erase(std::lower_bound(m_history_in.begin(), m_history_in.end(), history_start), m_history_in.end());
+  m_history_out.erase(std::lower_bound(m_history_out.begin(), m_history_out.end(), history_start), m_history_out.end());
+  update_lock_indexes();
 
   LOG_PRINT_L0("Detached blockchain on height " << height << ", transfers detached " << transfers_detached << ", blocks detached " << blocks_detached);
 }
@@ -536,10 +616,12 @@ bool wallet2::clear()
 {
   m_blockchain.clear();
   m_transfers.clear();
+  m_journal.close(); // state is not derived from the wallet file anymore, next store() writes a full snapshot
   currency::block b;
   currency::generate_genesis_block(b);
   m_blockchain.push_back(get_block_hash(b));
   m_local_bc_height = 1;
+  rebuild_indexes();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -707,7 +789,7 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
     m_account_public_address = m_account.get_keys().m_account_address;
     return;
   }
-  bool r = tools::unserialize_obj_from_file(*this, m_wallet_file);
+  bool r = tools::unserialize_obj_from_mapped_file(*this, m_wallet_file);
 
   bool need_to_resync = false;
   if (!r || m_blockchain.empty() ||
@@ -717,6 +799,28 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
   {
     need_to_resync = true;
   }
+  else
+  {
+    rebuild_indexes();
+    m_snapshot_size = boost::filesystem::file_size(m_wallet_file, e);
+    std::unordered_map<crypto::hash, currency::transaction> journal_txs;
+    uint64_t records_replayed = 0;
+    r = m_journal.replay_and_open(m_wallet_file + WALLET_JOURNAL_FILE_EXTENSION, m_snapshot_generation, [&](uint8_t type, const std::string& payload)
+    {
+      try
+      {
+        return apply_journal_record(type, payload, journal_txs);
+      }
+      catch (const std::exception& ex)
+      {
+        LOG_ERROR("Failed to apply wallet journal record: " << ex.what());
+        return false;
+      }
+    }, records_replayed);
+    if (!r)
+      LOG_PRINT_RED_L0("Failed to open wallet journal, full wallet file will be written on next save");
+    LOG_PRINT_L1("Wallet journal replayed: " << records_replayed << " records");
+  }
 
   if (need_to_resync)
   {
@@ -730,18 +834,137 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
 //----------------------------------------------------------------------------------------------------
 void wallet2::store()
 {
-  bool r = tools::serialize_obj_to_file(*this, m_wallet_file);
-  CHECK_AND_THROW_WALLET_EX(!r, error::file_save_error, m_wallet_file);
+  // usually only changes made since the last store() are appended to the journal,
+  // whole wallet is rewritten once the journal grows comparable to the wallet file
+  if (m_journal.is_open() && m_journal.size() < std::max<uint64_t>(WALLET_JOURNAL_MIN_COMPACTION_SIZE, m_snapshot_size / 2))
+  {
+    if (m_journal.commit())
+      return;
+    LOG_PRINT_RED_L0("Failed to commit wallet journal, writing full wallet file");
+  }
+  store_snapshot();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::store_snapshot()
+{
+  TIME_MEASURE_START(store_time);
+  ++m_snapshot_generation;
+  std::string tmp_file = m_wallet_file + ".tmp";
+  bool r = tools::serialize_obj_to_file(*this, tmp_file);
+  r = r && wallet_journal::sync_file(tmp_file);
+  CHECK_AND_THROW_WALLET_EX(!r, error::file_save_error, tmp_file);
+  std::error_code ec = tools::replace_file(tmp_file, m_wallet_file);
+  CHECK_AND_THROW_WALLET_EX(ec, error::file_save_error, m_wallet_file);
+
+  // the new snapshot supersedes the old journal: if we crash before the reset below,
+  // the journal's generation doesn't match and it is ignored on load
+  boost::system::error_code e;
+  m_snapshot_size = boost::filesystem::file_size(m_wallet_file, e);
+  r = m_journal.reset(m_wallet_file + WALLET_JOURNAL_FILE_EXTENSION, m_snapshot_generation);
+  if (!r)
+    LOG_PRINT_RED_L0("Failed to reset wallet journal, full wallet file will be written on next save");
+  TIME_MEASURE_FINISH(store_time);
+  LOG_PRINT_L1("Wallet file stored: " << m_snapshot_size << " bytes, generation " << m_snapshot_generation << ", " << store_time << "ms");
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::apply_journal_record(uint8_t type, const std::string& payload, std::unordered_map<crypto::hash, currency::transaction>& txs)
+{
+  switch (type)
+  {
+  case WALLET_JOURNAL_BLOCK_ADDED:
+  {
+    crypto::hash bl_id = null_hash;
+    wallet_journal::unpack(payload, bl_id);
+    m_blockchain.push_back(bl_id);
+    return true;
+  }
+  case WALLET_JOURNAL_TRANSFER_TX:
+  {
+    crypto::hash tx_id = null_hash;
+    currency::transaction tx;
+    wallet_journal::unpack(payload, tx_id, tx);
+    txs[tx_id] = tx;
+    return true;
+  }
+  case WALLET_JOURNAL_TRANSFER_ADDED:
+  {
+    transfer_details td = boost::value_initialized<transfer_details>();
+    wallet_journal::unpack(payload, td);
+    auto it = txs.find(td.m_tx_id);
+    CHECK_AND_ASSERT_MES(it != txs.end(), false, "transaction " << td.m_tx_id << " not found in wallet journal");
+    td.m_tx = it->second;
+    m_transfers.push_back(td);
+    m_key_images[td.m_key_image] = m_transfers.size() - 1;
+    add_transfer_to_indexes(m_transfers.size() - 1);
+    return true;
+  }
+  case WALLET_JOURNAL_TRANSFER_SPENT:
+  {
+    uint64_t index = 0;
+    bool spent = false;
+    wallet_journal::unpack(payload, index, spent);
+    CHECK_AND_ASSERT_MES(index < m_transfers.size(), false, "wrong transfer index " << index << " in wallet journal, transfers count " << m_transfers.size());
+    set_transfer_spent(index, spent);
+    return true;
+  }
+  case WALLET_JOURNAL_PAYMENT_ADDED:
+  {
+    payment_id_t payment_id;
+    payment_details payment = AUTO_VAL_INIT(payment);
+    wallet_journal::unpack(payload, payment_id, payment);
+    m_payments.emplace(payment_id, payment);
+    m_payment_ids_by_height.emplace(payment.m_block_height, payment_id);
+    return true;
+  }
+  case WALLET_JOURNAL_HISTORY_ADDED:
+  {
+    m_transfer_history.push_back(wallet_rpc::wallet_transfer_info());
+    wallet_journal::unpack(payload, m_transfer_history.back());
+    add_history_entry_to_indexes(m_transfer_history.size() - 1);
+    return true;
+  }
+  case WALLET_JOURNAL_DETACH:
+  {
+    uint64_t height = 0;
+    wallet_journal::unpack(payload, height);
+    CHECK_AND_ASSERT_MES(height <= m_blockchain.size(), false, "wrong detach height " << height << " in wallet journal, blockchain size " << m_blockchain.size());
+    m_local_bc_height = m_blockchain.size();
+    detach_blockchain(height);
+    return true;
+  }
+  case WALLET_JOURNAL_UNCONFIRMED_ADDED:
+  {
+    crypto::hash tx_id = null_hash;
+    unconfirmed_transfer_details utd = AUTO_VAL_INIT(utd);
+    wallet_journal::unpack(payload, tx_id, utd);
+    m_unconfirmed_txs[tx_id] = utd;
+    return true;
+  }
+  case WALLET_JOURNAL_UNCONFIRMED_REMOVED:
+  {
+    crypto::hash tx_id = null_hash;
+    wallet_journal::unpack(payload, tx_id);
+    m_unconfirmed_txs.erase(tx_id);
+    return true;
+  }
+  case WALLET_JOURNAL_TX_KEY_ADDED:
+  {
+    crypto::hash tx_id = null_hash;
+    crypto::secret_key tx_key = AUTO_VAL_INIT(tx_key);
+    wallet_journal::unpack(payload, tx_id, tx_key);
+    m_tx_keys.insert(std::make_pair(tx_id, tx_key));
+    return true;
+  }
+  default:
+    LOG_ERROR("unknown wallet journal record type " << static_cast<uint32_t>(type));
+    return false;
+  }
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::unlocked_balance()
 {
-  uint64_t amount = 0;
-  BOOST_FOREACH(transfer_details& td, m_transfers)
-    if(!td.m_spent && is_transfer_unlocked(td))
-      amount += td.amount();
-
-  return amount;
+  update_lock_indexes();
+  return m_unlocked_amount;
 }
 //----------------------------------------------------------------------------------------------------
 int64_t wallet2::unconfirmed_balance()
@@ -753,11 +976,7 @@ int64_t wallet2::unconfirmed_balance()
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance()
 {
-  uint64_t amount = 0;
-  BOOST_FOREACH(auto& td, m_transfers)
-    if(!td.m_spent)
-      amount += td.amount();
-
+  uint64_t amount = m_unspent_amount;
 
   BOOST_FOREACH(auto& utx, m_unconfirmed_txs)
     amount+= utx.second.m_change;
@@ -772,38 +991,25 @@ void wallet2::get_transfers(wallet2::transfer_container& incoming_transfers) con
 //----------------------------------------------------------------------------------------------------
 bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const 
 {
-  uint64_t tr_count = m_transfer_history.size();
-  if (!tr_count)
-    return true;
-  uint64_t i = tr_count;
-
-  do
+  // newest first, height range is located with binary search over direction index
+  auto fill = [&](const std::vector<size_t>& index, std::list<wallet_rpc::wallet_transfer_info>& target)
   {
-    --i;
-    const wallet_rpc::wallet_transfer_info& thi = m_transfer_history[i];
-
-    // handle filter_by_height
+    auto first = index.begin();
+    auto last = index.end();
     if (req.filter_by_height)
     {
-      if (!thi.height) // unconfirmed
-        continue;
-
-      if (thi.height < req.min_height)
-      {
-        //no need to scan more
-        break;
-      }
-      if (thi.height > req.max_height)
-      {
-        continue;
-      }
+      // zero height means unconfirmed, never matches height filter
+      first = std::lower_bound(index.begin(), index.end(), std::max<uint64_t>(req.min_height, 1), [&](size_t i, uint64_t h){ return m_transfer_history[i].height < h; });
+      last = std::upper_bound(first, index.end(), req.max_height, [&](uint64_t h, size_t i){ return h < m_transfer_history[i].height; });
     }
-    
-    if (thi.is_income && req.in)
-      res.in.push_back(thi);
-    if (!thi.is_income && req.out)
-      res.out.push_back(thi);   
-  } while (i != 0);
+    for (auto it = last; it != first; )
+      target.push_back(m_transfer_history[*--it]);
+  };
+
+  if (req.in)
+    fill(m_history_in, res.in);
+  if (req.out)
+    fill(m_history_out, res.out);
 
   if (req.pool)
   {
@@ -915,13 +1121,13 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
     {
       //unlock funds if transaction rejected
       for (auto& s : create_tx_param.sources)
-        m_transfers[s.transfer_index].m_spent = false;
+        set_transfer_spent(s.transfer_index, false);
     }
     else
     {
       //unlock funds if transaction rejected
       for (auto& s : create_tx_param.sources)
-        m_transfers[s.transfer_index].m_spent = true;
+        set_transfer_spent(s.transfer_index, true);
     }
     CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "sendrawtransaction");
     CHECK_AND_THROW_WALLET_EX(daemon_send_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "sendrawtransaction");
@@ -931,7 +1137,7 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
   {
     //unlock funds if transaction rejected
     for (auto& s : create_tx_param.sources)
-      m_transfers[s.transfer_index].m_spent = true;
+      set_transfer_spent(s.transfer_index, true);
   }
 
   std::string recipient;
@@ -945,6 +1151,7 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
 
   crypto::hash txid = get_transaction_hash(tx);
   m_tx_keys.insert(std::make_pair(txid, create_tx_result.txkey.sec));
+  m_journal.add(WALLET_JOURNAL_TX_KEY_ADDED, txid, create_tx_result.txkey.sec);
 
   LOG_PRINT_L2("transaction " << get_transaction_hash(tx) << " generated ok and sent to daemon, key_images: [" << key_images << "]");
 
@@ -991,6 +1198,158 @@ void wallet2::get_unconfirmed_transfers(std::vector<wallet_rpc::wallet_transfer_
   }
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_indexes()
+{
+  m_transfers_lock_state.clear();
+  m_transfers_by_unlock_height.clear();
+  m_transfers_waiting_for_time.clear();
+  m_lock_index_chain_size = 0;
+  m_unspent_amount = 0;
+  m_unlocked_amount = 0;
+  for (size_t i = 0; i != m_transfers.size(); i++)
+    add_transfer_to_indexes(i);
+
+  // history of wallets stored by older versions may have entries of orphaned blocks out of order
+  auto height_less = [](const wallet_rpc::wallet_transfer_info& a, const wallet_rpc::wallet_transfer_info& b){ return a.height < b.height; };
+  if (!std::is_sorted(m_transfer_history.begin(), m_transfer_history.end(), height_less))
+    std::stable_sort(m_transfer_history.begin(), m_transfer_history.end(), height_less);
+  m_history_in.clear();
+  m_history_out.clear();
+  for (size_t i = 0; i != m_transfer_history.size(); i++)
+    add_history_entry_to_indexes(i);
+
+  m_payment_ids_by_height.clear();
+  for (auto& p : m_payments)
+    m_payment_ids_by_height.emplace(p.second.m_block_height, p.first);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_history_entry_to_indexes(size_t history_index)
+{
+  if (m_transfer_history[history_index].is_income)
+    m_history_in.push_back(history_index);
+  else
+    m_history_out.push_back(history_index);
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::get_transfer_unlock_chain_size(const transfer_details& td) const
+{
+  // the smallest m_blockchain.size() making is_transfer_unlocked() true, ignoring timestamp unlock_time
+  uint64_t unlock_size = td.m_block_height + DEFAULT_TX_SPENDABLE_AGE;
+  uint64_t unlock_time = td.m_tx.unlock_time;
+  if (unlock_time < CURRENCY_MAX_BLOCK_NUMBER && unlock_time + 1 > CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS)
+    unlock_size = std::max<uint64_t>(unlock_size, unlock_time + 1 - CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  return unlock_size;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_transfer_to_indexes(size_t transfer_index)
+{
+  CHECK_AND_THROW_WALLET_EX(transfer_index != m_transfers_lock_state.size(), error::wallet_internal_error, "transfers indexes are out of sync");
+  const transfer_details& td = m_transfers[transfer_index];
+  m_transfers_lock_state.push_back(TRANSFER_LOCKED);
+  if (!td.m_spent)
+    m_unspent_amount += td.amount();
+  uint64_t unlock_size = get_transfer_unlock_chain_size(td);
+  m_transfers_by_unlock_height.emplace(unlock_size, transfer_index);
+  if (unlock_size <= m_lock_index_chain_size)
+    on_transfer_height_unlocked(transfer_index);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::remove_transfer_from_indexes(size_t transfer_index)
+{
+  CHECK_AND_THROW_WALLET_EX(transfer_index + 1 != m_transfers_lock_state.size(), error::wallet_internal_error, "only the last transfer can be removed from indexes");
+  const transfer_details& td = m_transfers[transfer_index];
+  on_transfer_height_locked(transfer_index);
+  if (!td.m_spent)
+    m_unspent_amount -= td.amount();
+  auto range = m_transfers_by_unlock_height.equal_range(get_transfer_unlock_chain_size(td));
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second == transfer_index)
+    {
+      m_transfers_by_unlock_height.erase(it);
+      break;
+    }
+  }
+  m_transfers_lock_state.pop_back();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::set_transfer_spent(size_t transfer_index, bool spent)
+{
+  transfer_details& td = m_transfers[transfer_index];
+  if (td.m_spent != spent)
+  {
+    td.m_spent = spent;
+    if (spent)
+    {
+      m_unspent_amount -= td.amount();
+      if (m_transfers_lock_state[transfer_index] == TRANSFER_UNLOCKED)
+        m_unlocked_amount -= td.amount();
+    }
+    else
+    {
+      m_unspent_amount += td.amount();
+      if (m_transfers_lock_state[transfer_index] == TRANSFER_UNLOCKED)
+        m_unlocked_amount += td.amount();
+    }
+  }
+  m_journal.add(WALLET_JOURNAL_TRANSFER_SPENT, static_cast<uint64_t>(transfer_index), spent);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::on_transfer_height_unlocked(size_t transfer_index)
+{
+  const transfer_details& td = m_transfers[transfer_index];
+  if (td.m_tx.unlock_time >= CURRENCY_MAX_BLOCK_NUMBER && !is_tx_spendtime_unlocked(td.m_tx.unlock_time))
+  {
+    m_transfers_lock_state[transfer_index] = TRANSFER_WAITING_FOR_TIME;
+    m_transfers_waiting_for_time.insert(transfer_index);
+    return;
+  }
+  m_transfers_lock_state[transfer_index] = TRANSFER_UNLOCKED;
+  if (!td.m_spent)
+    m_unlocked_amount += td.amount();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::on_transfer_height_locked(size_t transfer_index)
+{
+  const transfer_details& td = m_transfers[transfer_index];
+  if (m_transfers_lock_state[transfer_index] == TRANSFER_UNLOCKED && !td.m_spent)
+    m_unlocked_amount -= td.amount();
+  else if (m_transfers_lock_state[transfer_index] == TRANSFER_WAITING_FOR_TIME)
+    m_transfers_waiting_for_time.erase(transfer_index);
+  m_transfers_lock_state[transfer_index] = TRANSFER_LOCKED;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_lock_indexes()
+{
+  // only transfers whose unlock height lies between the previous and the current chain size change their state
+  uint64_t chain_size = m_blockchain.size();
+  if (chain_size > m_lock_index_chain_size)
+  {
+    for (auto it = m_transfers_by_unlock_height.upper_bound(m_lock_index_chain_size); it != m_transfers_by_unlock_height.end() && it->first <= chain_size; ++it)
+      on_transfer_height_unlocked(it->second);
+  }
+  else if (chain_size < m_lock_index_chain_size)
+  {
+    for (auto it = m_transfers_by_unlock_height.upper_bound(chain_size); it != m_transfers_by_unlock_height.end() && it->first <= m_lock_index_chain_size; ++it)
+      on_transfer_height_locked(it->second);
+  }
+  m_lock_index_chain_size = chain_size;
+
+  for (auto it = m_transfers_waiting_for_time.begin(); it != m_transfers_waiting_for_time.end(); )
+  {
+    const transfer_details& td = m_transfers[*it];
+    if (!is_tx_spendtime_unlocked(td.m_tx.unlock_time))
+    {
+      ++it;
+      continue;
+    }
+    m_transfers_lock_state[*it] = TRANSFER_UNLOCKED;
+    if (!td.m_spent)
+      m_unlocked_amount += td.amount();
+    it = m_transfers_waiting_for_time.erase(it);
+  }
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(const transfer_details& td) const
 {
   if(!is_tx_spendtime_unlocked(td.m_tx.unlock_time))
@@ -1157,6 +1516,7 @@ void wallet2::add_sent_unconfirmed_tx(const currency::transaction& tx, uint64_t
   utd.m_tx = tx;
   utd.m_recipient = recipient;
   utd.m_recipient_alias = get_alias_for_address(recipient);
+  m_journal.add(WALLET_JOURNAL_UNCONFIRMED_ADDED, currency::get_transaction_hash(tx), utd);
 
   if (m_callback)
   {
@@ -1221,7 +1581,7 @@ std::string wallet2::get_transfers_str() const
         std::setw(7) << (td.m_spent ? "spent" : "") << "  " <<
         std::setw(7) << td.m_global_output_index << "  " <<
         std::setw(7) << td.m_block_height << "  " <<
-        get_transaction_hash(td.m_tx) << "  " <<
+        td.m_tx_id << "  " <<
         std::setw(4) << td.m_internal_output_index << "  " <<
         td.m_key_image << ENDL;
     }
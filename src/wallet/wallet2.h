@@ -5,6 +5,8 @@
 #pragma once
 
 #include <memory>
+#include <map>
+#include <set>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/vector.hpp>
 #include <atomic>
@@ -15,6 +17,7 @@
 #include "currency_core/currency_basic_impl.h"
 #include "wallet_rpc_server_commans_defs.h"
 #include "currency_core/currency_format_utils.h"
+#include "currency_core/output_scanner.h"
 #include "common/unordered_containers_boost_serialization.h"
 #include "storages/portable_storage_template_helper.h"
 #include "crypto/chacha8.h"
@@ -22,6 +25,7 @@
 #include "core_rpc_proxy.h"
 #include "core_default_rpc_proxy.h"
 #include "wallet_errors.h"
+#include "wallet_journal.h"
 
 #define DEFAULT_TX_SPENDABLE_AGE                               10
 
@@ -62,14 +66,17 @@ namespace tools
 
   class wallet2
   {
-    wallet2(const wallet2&) : m_run(true), m_is_view_only(false), m_callback(0), m_unconfirmed_balance(0) {};
+    wallet2(const wallet2&) : m_run(true), m_is_view_only(false), m_callback(0), m_unconfirmed_balance(0), m_snapshot_generation(0), m_snapshot_size(0),
+      m_lock_index_chain_size(0), m_unspent_amount(0), m_unlocked_amount(0) {};
   public:
-    wallet2() : m_run(true), m_callback(0), m_is_view_only(false), m_core_proxy(new default_http_core_proxy()), m_unconfirmed_balance(0)
+    wallet2() : m_run(true), m_callback(0), m_is_view_only(false), m_core_proxy(new default_http_core_proxy()), m_unconfirmed_balance(0), m_snapshot_generation(0), m_snapshot_size(0),
+      m_lock_index_chain_size(0), m_unspent_amount(0), m_unlocked_amount(0)
     {};
     struct transfer_details
     {
       uint64_t m_block_height;
       currency::transaction m_tx;
+      crypto::hash m_tx_id;     //on disk transfers refer to m_tx by this id, each transaction is stored once
       size_t m_internal_output_index;
       uint64_t m_global_output_index;
       bool m_spent;
@@ -188,20 +195,50 @@ namespace tools
       if (ver < 9)
           return;
       a & m_tx_keys;
-
+      if (ver < 11)
+        return;
+      a & m_snapshot_generation;
+      serialize_transfers_txs(a);
     }
     static uint64_t select_indices_for_transfer(std::list<size_t>& ind, std::map<uint64_t, std::list<size_t> >& found_free_amounts, uint64_t needed_money);
   private:
+    //unit tests check derived indexes through it, see tests/unit_tests
+    friend struct wallet2_test_accessor;
+
+    struct pulled_block
+    {
+      currency::block b;
+      crypto::hash id;
+      std::vector<currency::transaction> txs;
+      bool known;               //already in local blockchain
+      size_t first_scan_entry;  //SIZE_MAX if block is not scanned
+    };
+
+    template <class t_archive>
+    void serialize_transfers_txs(t_archive &a);
+    void store_snapshot();
+    bool apply_journal_record(uint8_t type, const std::string& payload, std::unordered_map<crypto::hash, currency::transaction>& txs);
+    void rebuild_indexes();
+    void add_transfer_to_indexes(size_t transfer_index);
+    void remove_transfer_from_indexes(size_t transfer_index);
+    void add_history_entry_to_indexes(size_t history_index);
+    void set_transfer_spent(size_t transfer_index, bool spent);
+    void update_lock_indexes();
+    void on_transfer_height_unlocked(size_t transfer_index);
+    void on_transfer_height_locked(size_t transfer_index);
+    uint64_t get_transfer_unlock_chain_size(const transfer_details& td) const;
 
     void load_keys(const std::string& keys_file_name, const std::string& password);
-    void process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b);
-    void process_new_blockchain_entry(const currency::block& b, currency::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height);
+    void process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b, const currency::output_scanner::tx_entry& scanned);
+    //scanned points to scan results of miner tx followed by txs, null if block is skipped by wallet creation time
+    void process_new_blockchain_entry(const currency::block& b, const std::vector<currency::transaction>& txs, const currency::output_scanner::tx_entry* scanned, const crypto::hash& bl_id, uint64_t height);
     void detach_blockchain(uint64_t height);
     void get_short_chain_history(std::list<crypto::hash>& ids);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time) const;
     bool is_transfer_unlocked(const transfer_details& td) const;
     bool clear();
     void pull_blocks(size_t& blocks_added);
+    void add_scan_entry(const currency::transaction& tx, std::vector<currency::output_scanner::tx_entry>& scan_entries);
     uint64_t select_transfers(uint64_t needed_money, size_t fake_outputs_count, uint64_t dust, std::list<transfer_container::iterator>& selected_transfers);
     bool prepare_file_names(const std::string& file_path);
     void process_unconfirmed(const currency::transaction& tx, std::string& recipient, std::string& recipient_alias);
@@ -236,11 +273,33 @@ namespace tools
     std::shared_ptr<i_core_proxy> m_core_proxy;
     i_wallet2_callback* m_callback;
     std::unordered_map<crypto::hash, crypto::secret_key> m_tx_keys;
+
+    wallet_journal m_journal;
+    uint64_t m_snapshot_generation;
+    uint64_t m_snapshot_size;
+
+    // derived indexes, never stored: rebuilt on load, then maintained incrementally
+    enum transfer_lock_state
+    {
+      TRANSFER_LOCKED = 0,
+      TRANSFER_WAITING_FOR_TIME,  // spendable age reached, unlock_time (a timestamp) is not
+      TRANSFER_UNLOCKED
+    };
+    std::vector<uint8_t> m_transfers_lock_state;                  // parallel to m_transfers
+    std::multimap<uint64_t, size_t> m_transfers_by_unlock_height; // chain size when transfer becomes spendable -> transfer index
+    std::set<size_t> m_transfers_waiting_for_time;
+    uint64_t m_lock_index_chain_size;                             // chain size m_transfers_lock_state is actual for
+    uint64_t m_unspent_amount;
+    uint64_t m_unlocked_amount;
+    std::vector<size_t> m_history_in;                             // m_transfer_history indices of incoming transfers, by height
+    std::vector<size_t> m_history_out;                            // m_transfer_history indices of outgoing transfers, by height
+    std::multimap<uint64_t, currency::payment_id_t> m_payment_ids_by_height;
   };
 }
 
 
-BOOST_CLASS_VERSION(tools::wallet2, 10)
+BOOST_CLASS_VERSION(tools::wallet2, 11)
+BOOST_CLASS_VERSION(tools::wallet2::transfer_details, 1)
 BOOST_CLASS_VERSION(tools::wallet2::unconfirmed_transfer_details, 3)
 BOOST_CLASS_VERSION(tools::wallet_rpc::wallet_transfer_info, 3)
 
@@ -255,7 +314,17 @@ namespace boost
       a & x.m_block_height;
       a & x.m_global_output_index;
       a & x.m_internal_output_index;
-      a & x.m_tx;
+      if (ver < 1)
+      {
+        a & x.m_tx;
+        if (Archive::is_loading::value)
+          x.m_tx_id = currency::get_transaction_hash(x.m_tx);
+      }
+      else
+      {
+        //transaction itself is stored by wallet2::serialize_transfers_txs
+        a & x.m_tx_id;
+      }
       a & x.m_spent;
       a & x.m_key_image;
     }
@@ -385,6 +454,49 @@ namespace tools
     //----------------------------------------------------------------------------------------------------
   }
   //----------------------------------------------------------------------------------------------------
+  template <class t_archive>
+  void wallet2::serialize_transfers_txs(t_archive &a)
+  {
+    //transactions with wallet's outputs, each one stored once no matter how many outputs it has
+    uint64_t txs_count = 0;
+    if (t_archive::is_saving::value)
+    {
+      std::unordered_set<crypto::hash> stored;
+      for (auto& td : m_transfers)
+      {
+        if (!stored.insert(td.m_tx_id).second)
+          continue;
+        ++txs_count;
+      }
+      a & txs_count;
+      stored.clear();
+      for (auto& td : m_transfers)
+      {
+        if (!stored.insert(td.m_tx_id).second)
+          continue;
+        a & td.m_tx_id;
+        a & td.m_tx;
+      }
+    }
+    else
+    {
+      a & txs_count;
+      std::unordered_map<crypto::hash, currency::transaction> txs;
+      for (uint64_t i = 0; i != txs_count; i++)
+      {
+        crypto::hash tx_id = currency::null_hash;
+        a & tx_id;
+        a & txs[tx_id];
+      }
+      for (auto& td : m_transfers)
+      {
+        auto it = txs.find(td.m_tx_id);
+        CHECK_AND_THROW_WALLET_EX(it == txs.end(), error::wallet_internal_error, "transaction " + epee::string_tools::pod_to_hex(td.m_tx_id) + " not found in wallet file");
+        td.m_tx = it->second;
+      }
+    }
+  }
+  //----------------------------------------------------------------------------------------------------
   template<typename T>
   void wallet2::transfer(const std::vector<currency::tx_destination_entry>& dsts, size_t fake_outputs_count,
     uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, T destination_split_strategy, const tx_dust_policy& dust_policy)
@@ -532,7 +644,7 @@ namespace tools
     {
       //mark outputs as spent 
       BOOST_FOREACH(transfer_container::iterator it, selected_transfers)
-        it->m_spent = true;
+        set_transfer_spent(it - m_transfers.begin(), true);
       //do offline sig
       blobdata bl = t_serializable_object_to_blob(create_tx_param);
       crypto::do_chacha_crypt(bl, m_account.get_keys().m_view_secret_key);
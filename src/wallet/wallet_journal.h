@@ -0,0 +1,60 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include "include_base_utils.h"
+#include "common/journal_file.h"
+
+#define WALLET_JOURNAL_FILE_EXTENSION             ".journal"
+#define WALLET_JOURNAL_SIGNATURE                  0x4c4e524a544c4c57ULL // "WLLTJRNL"
+#define WALLET_JOURNAL_MIN_COMPACTION_SIZE        (4 * 1024 * 1024)     // journal is never compacted while smaller than this
+#define WALLET_JOURNAL_MAX_RECORD_SIZE            (64 * 1024 * 1024)
+
+namespace tools
+{
+  enum wallet_journal_record_type
+  {
+    WALLET_JOURNAL_BLOCK_ADDED = 1,        // block id
+    WALLET_JOURNAL_TRANSFER_TX,            // tx id, transaction (written once per tx, referenced by transfers)
+    WALLET_JOURNAL_TRANSFER_ADDED,         // transfer_details
+    WALLET_JOURNAL_TRANSFER_SPENT,         // transfer index, spent flag
+    WALLET_JOURNAL_PAYMENT_ADDED,          // payment id, payment_details
+    WALLET_JOURNAL_HISTORY_ADDED,          // wallet_transfer_info
+    WALLET_JOURNAL_DETACH,                 // height
+    WALLET_JOURNAL_UNCONFIRMED_ADDED,      // tx id, unconfirmed_transfer_details
+    WALLET_JOURNAL_UNCONFIRMED_REMOVED,    // tx id
+    WALLET_JOURNAL_TX_KEY_ADDED            // tx id, tx secret key
+  };
+
+  /************************************************************************/
+  /* Append-only log of wallet changes made since the last snapshot,      */
+  /* tagged with snapshot generation. Records reach the disk only on      */
+  /* commit(), which ends with fsync.                                     */
+  /************************************************************************/
+  class wallet_journal: public journal_file
+  {
+  public:
+    wallet_journal() : journal_file(WALLET_JOURNAL_SIGNATURE, WALLET_JOURNAL_MAX_RECORD_SIZE, "wallet journal")
+    {}
+
+    bool reset(const std::string& path, uint64_t snapshot_generation)
+    {
+      return rewrite(path, snapshot_generation, std::vector<record>());
+    }
+
+    bool commit()
+    {
+      return journal_file::commit(true);
+    }
+
+    template<class... t_args>
+    void add(uint8_t type, const t_args&... args)
+    {
+      if (!is_open())
+        return; // nothing to journal to, next store() writes a full snapshot anyway
+      add_record(type, pack(args...));
+    }
+  };
+}
@@ -18,14 +18,16 @@ namespace tools
   //-----------------------------------------------------------------------------------
   const command_line::arg_descriptor<std::string> wallet_rpc_server::arg_rpc_bind_port = {"rpc-bind-port", "Starts wallet as rpc server for wallet operations, sets bind port for server", "", true};
   const command_line::arg_descriptor<std::string> wallet_rpc_server::arg_rpc_bind_ip = {"rpc-bind-ip", "Specify ip to bind rpc server", "127.0.0.1"};
+  const command_line::arg_descriptor<size_t> wallet_rpc_server::arg_rpc_max_batch_size = {"rpc-max-batch-size", "Max number of calls in one JSON RPC batch request", JSON_RPC_DEFAULT_MAX_BATCH_SIZE};
 
   void wallet_rpc_server::init_options(boost::program_options::options_description& desc)
   {
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
+    command_line::add_arg(desc, arg_rpc_max_batch_size);
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  wallet_rpc_server::wallet_rpc_server(wallet2& w):m_wallet(w)
+  wallet_rpc_server::wallet_rpc_server(wallet2& w):m_wallet(w), m_max_batch_size(JSON_RPC_DEFAULT_MAX_BATCH_SIZE)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::run()
@@ -46,6 +48,7 @@ namespace tools
   {
     m_bind_ip = command_line::get_arg(vm, arg_rpc_bind_ip);
     m_port = command_line::get_arg(vm, arg_rpc_bind_port);
+    m_max_batch_size = command_line::get_arg(vm, arg_rpc_max_batch_size);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -395,26 +398,25 @@ namespace tools
       return false;
     }
 
-    //prepare inputs
-    std::vector<currency::tx_source_entry> sources;
-    size_t i = 0;
+    //prepare inputs from outputs that go to telepod's address
+    std::vector<size_t> outs;
     uint64_t amount = 0;
-    for (auto& o : get_ind_rsp.o_indexes)
+    if (!currency::lookup_acc_outs(acc.get_keys(), tx, tx_pub_key, outs, amount))
     {
-      //check if input is for telepod's address
-      if (currency::is_out_to_acc(acc.get_keys(), boost::get<currency::txout_to_key>(tx.vout[i].target), tx_pub_key, i))
-      {
-        //income output 
-        amount += tx.vout[i].amount;
-        sources.resize(sources.size() + 1);
-        currency::tx_source_entry& tse = sources.back();
-        tse.amount = tx.vout[i].amount;
-        tse.outputs.push_back(currency::tx_source_entry::output_entry(o, boost::get<currency::txout_to_key>(tx.vout[i].target).key));
-        tse.real_out_tx_key = tx_pub_key;
-        tse.real_output = 0;
-        tse.real_output_in_tx_index = i;
-      }
-      ++i;
+      LOG_ERROR("Failed to currency::lookup_acc_outs(...)");
+      status = "BAD";
+      return false;
+    }
+    std::vector<currency::tx_source_entry> sources;
+    for (size_t i : outs)
+    {
+      sources.resize(sources.size() + 1);
+      currency::tx_source_entry& tse = sources.back();
+      tse.amount = tx.vout[i].amount;
+      tse.outputs.push_back(currency::tx_source_entry::output_entry(get_ind_rsp.o_indexes[i], boost::get<currency::txout_to_key>(tx.vout[i].target).key));
+      tse.real_out_tx_key = tx_pub_key;
+      tse.real_output = 0;
+      tse.real_output_in_tx_index = i;
     }
 
 
@@ -24,6 +24,7 @@ namespace tools
 
     const static command_line::arg_descriptor<std::string> arg_rpc_bind_port;
     const static command_line::arg_descriptor<std::string> arg_rpc_bind_ip;
+    const static command_line::arg_descriptor<size_t> arg_rpc_max_batch_size;
 
 
     static void init_options(boost::program_options::options_description& desc);
@@ -34,7 +35,8 @@ namespace tools
     CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
 
     BEGIN_URI_MAP2()
-      BEGIN_JSON_RPC_MAP("/json_rpc")
+      //single RPC thread, so calls of a batch already see one wallet state
+      BEGIN_JSON_RPC_MAP_BATCH("/json_rpc", m_max_batch_size, epee::json_rpc::no_batch_guard)
         MAP_JON_RPC_WE("getbalance",   on_getbalance,   wallet_rpc::COMMAND_RPC_GET_BALANCE)
         MAP_JON_RPC_WE("getaddress",   on_getaddress,   wallet_rpc::COMMAND_RPC_GET_ADDRESS)
         MAP_JON_RPC_WE("transfer",     on_transfer,     wallet_rpc::COMMAND_RPC_TRANSFER)
@@ -74,5 +76,6 @@ namespace tools
       wallet2& m_wallet;
       std::string m_port;
       std::string m_bind_ip;
+      size_t m_max_batch_size;
   };
 }
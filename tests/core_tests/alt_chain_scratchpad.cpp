@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+#include "alt_chain_scratchpad.h"
+#include "blockchain_storage_test_accessor.h"
+
+using namespace epee;
+using namespace currency;
+
+
+gen_alt_chain_scratchpad::gen_alt_chain_scratchpad()
+{
+  REGISTER_CALLBACK_METHOD(gen_alt_chain_scratchpad, check_alt_blocks_longhash);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_alt_chain_scratchpad::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 )-(2 )-(3 )-(4 )-(5 )-(6 )-(7 )-(8 )-(9 )   <- main, then alt, then main again
+              |         |         \-(6c)
+              |         \-(4b)-(5b)-(6b)-(7b)-(8b)         <- main after (7b)
+              \-(2a)-(3a)-(4a)
+                  \-(3aa)
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0r, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_4, blk_3, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2a, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3a, blk_2a, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_4b, blk_3, miner_account);
+  DO_CALLBACK(events, "check_alt_blocks_longhash");
+
+  //main chain grows under cached main line patches
+  MAKE_NEXT_BLOCK(events, blk_5, blk_4, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_6, blk_5, miner_account);
+  DO_CALLBACK(events, "check_alt_blocks_longhash");
+
+  //alt chains grow on cached states, fork inside alt chain and new connection height
+  MAKE_NEXT_BLOCK(events, blk_4a, blk_3a, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3aa, blk_2a, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_5b, blk_4b, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_6c, blk_5, miner_account);
+  DO_CALLBACK(events, "check_alt_blocks_longhash");
+
+  //switch pops (4 )-(6 ), they become alt chain with (6c) on top of (5 )
+  MAKE_NEXT_BLOCK(events, blk_6b, blk_5b, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_7b, blk_6b, miner_account);
+  DO_CALLBACK(events, "check_alt_blocks_longhash");
+  MAKE_NEXT_BLOCK(events, blk_8b, blk_7b, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_7, blk_6, miner_account);
+  DO_CALLBACK(events, "check_alt_blocks_longhash");
+
+  //switch back pops (4b)-(8b)
+  MAKE_NEXT_BLOCK(events, blk_8, blk_7, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_9, blk_8, miner_account);
+  DO_CALLBACK(events, "check_alt_blocks_longhash");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_alt_chain_scratchpad::check_alt_blocks_longhash(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  size_t alt_blocks_count = 0;
+  for (size_t i = 0; i != ev_index; i++)
+  {
+    if (events[i].type() != typeid(block))
+      continue;
+    const block& b = boost::get<block>(events[i]);
+    crypto::hash id = get_block_hash(b);
+    uint64_t height = get_block_height(b);
+    if (height < bcs.get_current_blockchain_height() && bcs.get_block_id_by_height(height) == id)
+      continue;
+
+    //scratchpad of the chain under alt block, built the way miner does
+    std::vector<block> chain;
+    map_hash2tx_t mtx;
+    bool r = find_block_chain(events, chain, mtx, b.prev_id);
+    CHECK_TEST_CONDITION(r);
+    CHECK_EQ(height, chain.size());
+    std::vector<crypto::hash> scratchpad;
+    for (const block& cb : chain)
+    {
+      r = push_block_scratchpad_data(cb, scratchpad);
+      CHECK_TEST_CONDITION(r);
+    }
+    crypto::hash expected_pow = get_block_longhash(b, height, [&](uint64_t index) -> crypto::hash&
+    {
+      return scratchpad[index%scratchpad.size()];
+    });
+
+    crypto::hash pow = null_hash;
+    r = blockchain_storage_test_accessor::get_alternative_block_longhash(bcs, id, pow);
+    CHECK_TEST_CONDITION(r);
+    CHECK_EQ(expected_pow, pow);
+    ++alt_blocks_count;
+  }
+  CHECK_EQ(bcs.get_alternative_blocks_count(), alt_blocks_count);
+  return true;
+}
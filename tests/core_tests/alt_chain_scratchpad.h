@@ -0,0 +1,21 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Alternative chains at several connection heights while main chain    */
+/* grows and switches, PoW of every alt block is compared to the one    */
+/* calculated over scratchpad rebuilt from scratch                      */
+/************************************************************************/
+class gen_alt_chain_scratchpad : public test_chain_unit_base
+{
+public:
+  gen_alt_chain_scratchpad();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_alt_blocks_longhash(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
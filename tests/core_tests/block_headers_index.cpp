@@ -0,0 +1,183 @@
+// Copyright (c) 2012-2013 The Cryptonote developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+#include "block_headers_index.h"
+#include "blockchain_storage_test_accessor.h"
+
+using namespace epee;
+using namespace currency;
+
+
+gen_block_headers_index::gen_block_headers_index()
+{
+  REGISTER_CALLBACK_METHOD(gen_block_headers_index, check_headers_index);
+  REGISTER_CALLBACK_METHOD(gen_block_headers_index, check_headers_range_clipping);
+  REGISTER_CALLBACK_METHOD(gen_block_headers_index, rebuild_headers_index);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_block_headers_index::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 )-(2 )-(3 )                   <- main chain until (4a)
+               \-(2a)-(3a)-(4a)-(5 )         <- becomes main chain, (2 ) and (3 ) are popped
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  MAKE_TX(events, tx_0, miner_account, alice_account, MK_COINS(5), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_0);
+  MAKE_TX_LIST_START(events, txs_blk_2, miner_account, alice_account, MK_COINS(1), blk_1);
+  MAKE_TX_LIST(events, txs_blk_2, miner_account, alice_account, MK_COINS(2), blk_1);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_2, blk_1, miner_account, txs_blk_2);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  DO_CALLBACK(events, "check_headers_index");
+
+  //switch pops (2 ) and (3 )
+  MAKE_NEXT_BLOCK(events, blk_2a, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3a, blk_2a, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_4a, blk_3a, miner_account);
+  DO_CALLBACK(events, "check_headers_index");
+  DO_CALLBACK(events, "check_headers_range_clipping");
+
+  DO_CALLBACK(events, "rebuild_headers_index");
+  DO_CALLBACK(events, "check_headers_index");
+  MAKE_NEXT_BLOCK(events, blk_5, blk_4a, miner_account);
+  DO_CALLBACK(events, "check_headers_index");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_block_headers_index::check_headers_index(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  std::list<blockchain_storage::block_header_index_entry> headers;
+  uint64_t height = 0;
+  bool r = bcs.get_block_headers_range(0, std::numeric_limits<uint64_t>::max(), headers, height);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(bcs.get_current_blockchain_height(), height);
+  CHECK_EQ(height, headers.size());
+  CHECK_EQ(bcs.get_top_block_id(), headers.back().id);
+
+  //every entry is compared to the values rpc used to compute from full blocks
+  uint64_t h = 0;
+  for (const auto& bhie : headers)
+  {
+    blockchain_storage::block_extended_info bei = AUTO_VAL_INIT(bei);
+    r = bcs.get_block_extended_info_by_height(h, bei);
+    CHECK_TEST_CONDITION(r);
+    CHECK_EQ(get_block_hash(bei.bl), bhie.id);
+    CHECK_EQ(bei.bl.timestamp, bhie.timestamp);
+
+    std::vector<size_t> sizes;
+    r = bcs.get_backward_blocks_sizes(h, sizes, 1);
+    CHECK_TEST_CONDITION(r);
+    CHECK_EQ(1, sizes.size());
+    CHECK_EQ(sizes.back(), bhie.block_cumulative_size);
+    CHECK_EQ(get_object_blobsize(bei.bl) - get_object_blobsize(bei.bl.miner_tx), bhie.header_blob_size);
+
+    CHECK_EQ(bcs.block_difficulty(h), bhie.difficulty);
+    CHECK_EQ(bei.cumulative_difficulty, bhie.cumulative_difficulty);
+    CHECK_EQ(bei.bl.tx_hashes.size() + 1, bhie.tx_count);
+
+    uint64_t reward = get_outs_money_amount(bei.bl.miner_tx);
+    if (h && !(h % CURRENCY_DONATIONS_INTERVAL))
+    {
+      uint64_t donation = 0;
+      uint64_t royalty = 0;
+      r = bcs.lookfor_donation(bei.bl.miner_tx, donation, royalty);
+      CHECK_TEST_CONDITION(r);
+      reward -= donation + royalty;
+    }
+    CHECK_EQ(reward, bhie.reward);
+    uint64_t miner_reward = 0;
+    r = bcs.get_block_miner_reward(bei.bl, miner_reward);
+    CHECK_TEST_CONDITION(r);
+    CHECK_EQ(miner_reward, bhie.reward);
+    ++h;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_block_headers_index::check_headers_range_clipping(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  const uint64_t top_height = bcs.get_current_blockchain_height();
+
+  std::list<blockchain_storage::block_header_index_entry> headers;
+  uint64_t height = 0;
+  bool r = bcs.get_block_headers_range(top_height - 2, 10, headers, height);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(top_height, height);
+  CHECK_EQ(2, headers.size());
+  CHECK_EQ(bcs.get_block_id_by_height(top_height - 2), headers.front().id);
+  CHECK_EQ(bcs.get_top_block_id(), headers.back().id);
+
+  //count that would overflow start + count
+  headers.clear();
+  r = bcs.get_block_headers_range(1, std::numeric_limits<uint64_t>::max(), headers, height);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(top_height - 1, headers.size());
+
+  headers.clear();
+  r = bcs.get_block_headers_range(top_height - 1, 0, headers, height);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(0, headers.size());
+
+  r = bcs.get_block_headers_range(top_height, 1, headers, height);
+  CHECK_TEST_CONDITION(!r);
+  CHECK_EQ(top_height, height);
+  CHECK_EQ(0, headers.size());
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_block_headers_index::rebuild_headers_index(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  const uint64_t top_height = bcs.get_current_blockchain_height();
+  bool r = blockchain_storage_test_accessor::clear_block_headers_index(bcs);
+  CHECK_TEST_CONDITION(r);
+
+  std::list<blockchain_storage::block_header_index_entry> headers;
+  uint64_t height = 0;
+  r = bcs.get_block_headers_range(0, 1, headers, height);
+  CHECK_TEST_CONDITION(!r);
+  CHECK_EQ(0, height);
+
+  //reopen storage the same way the core does, init() finds index out of sync with blocks
+  boost::program_options::options_description desc("Allowed options");
+  currency::core::init_options(desc);
+  command_line::add_arg(desc, command_line::arg_data_dir);
+  boost::program_options::variables_map vm;
+  r = command_line::handle_error_helper(desc, [&]()
+  {
+    boost::program_options::store(boost::program_options::basic_parsed_options<char>(&desc), vm);
+    boost::program_options::notify(vm);
+    return true;
+  });
+  CHECK_TEST_CONDITION(r);
+
+  r = bcs.deinit();
+  CHECK_TEST_CONDITION(r);
+  r = bcs.init(vm, c.get_config_folder());
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(top_height, bcs.get_current_blockchain_height());
+
+  r = bcs.get_block_headers_range(0, 1, headers, height);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(top_height, height);
+
+  return true;
+}
@@ -0,0 +1,21 @@
+// Copyright (c) 2012-2013 The Cryptonote developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/*                                                                      */
+/************************************************************************/
+class gen_block_headers_index : public test_chain_unit_base
+{
+public:
+  gen_block_headers_index();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_headers_index(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_headers_range_clipping(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool rebuild_headers_index(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
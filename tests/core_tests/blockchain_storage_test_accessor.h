@@ -0,0 +1,120 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "currency_core/blockchain_storage.h"
+
+namespace currency
+{
+  /************************************************************************/
+  /* Access to blockchain_storage internals, core tests only              */
+  /************************************************************************/
+  struct blockchain_storage_test_accessor
+  {
+    //emulate storage written by older version, init() rebuilds the index
+    static bool clear_block_headers_index(blockchain_storage& bcs)
+    {
+      CRITICAL_REGION_LOCAL(bcs.m_blockchain_lock);
+      bcs.m_db.begin_transaction();
+      bcs.m_db_block_headers.clear();
+      bcs.m_db.commit_transaction();
+      return true;
+    }
+
+    //erase undo record or make its id mismatch, pop_block_from_blockchain() goes legacy way
+    static bool damage_block_undo_record(blockchain_storage& bcs, uint64_t height, bool erase)
+    {
+      CRITICAL_REGION_LOCAL(bcs.m_blockchain_lock);
+      auto undo_ptr = bcs.m_db_block_undo.get(height);
+      CHECK_AND_ASSERT_MES(undo_ptr, false, "undo record not found for height " << height);
+      blockchain_storage::block_undo_entry undo = *undo_ptr;
+      undo.id = null_hash;
+      bcs.m_db.begin_transaction();
+      if (erase)
+        bcs.m_db_block_undo.erase(height);
+      else
+        bcs.m_db_block_undo.set(height, undo);
+      bcs.m_db.commit_transaction();
+      return true;
+    }
+
+    //PoW of alternative block as it is calculated against current alternative and main scratchpad state
+    static bool get_alternative_block_longhash(blockchain_storage& bcs, const crypto::hash& id, crypto::hash& proof_of_work)
+    {
+      CRITICAL_REGION_LOCAL(bcs.m_blockchain_lock);
+      auto alt_it = bcs.m_alternative_chains.find(id);
+      CHECK_AND_ASSERT_MES(alt_it != bcs.m_alternative_chains.end(), false, "alternative block " << id << " not found");
+      std::list<blockchain_storage::blocks_ext_by_hash::iterator> alt_chain;
+      for (auto it = bcs.m_alternative_chains.find(alt_it->second.bl.prev_id); it != bcs.m_alternative_chains.end(); it = bcs.m_alternative_chains.find(it->second.bl.prev_id))
+        alt_chain.push_front(it);
+
+      blockchain_storage::block_extended_info bei = alt_it->second;
+      bool r = bcs.get_alt_block_longhash(alt_chain, bei, proof_of_work);
+      CHECK_AND_ASSERT_MES(r, false, "Failed to get_alt_block_longhash for alternative block " << id);
+      CHECK_AND_ASSERT_MES(bei.scratch_offset == alt_it->second.scratch_offset, false, "scratch offset " << bei.scratch_offset << " of alternative block " << id << " differs from stored " << alt_it->second.scratch_offset);
+      return true;
+    }
+
+    //pops blocks from main chain top, the way chain switching disconnects them
+    static bool pop_blocks(blockchain_storage& bcs, size_t count)
+    {
+      CRITICAL_REGION_LOCAL(bcs.m_blockchain_lock);
+      CHECK_AND_ASSERT_MES(count < bcs.m_db_blocks.size(), false, "can't pop " << count << " blocks from chain of " << bcs.m_db_blocks.size());
+      bcs.m_db.begin_transaction();
+      for (size_t i = 0; i != count; i++)
+      {
+        if (!bcs.pop_block_from_blockchain())
+        {
+          bcs.m_db.abort_transaction();
+          LOG_ERROR("failed to pop block " << i << " of " << count);
+          return false;
+        }
+      }
+      bcs.m_db.commit_transaction();
+      return bcs.update_chain_stats();
+    }
+
+    //difficulty for next block calculated straight from blocks db, the way it was done before chain stats window
+    static wide_difficulty_type get_next_difficulty_from_db(blockchain_storage& bcs)
+    {
+      CRITICAL_REGION_LOCAL(bcs.m_blockchain_lock);
+      std::vector<uint64_t> timestamps;
+      std::vector<wide_difficulty_type> commulative_difficulties;
+      size_t offset = bcs.m_db_blocks.size() - std::min(bcs.m_db_blocks.size(), static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
+      if (!offset)
+        ++offset;//skip genesis block
+      for (; offset < bcs.m_db_blocks.size(); offset++)
+      {
+        timestamps.push_back(bcs.m_db_blocks[offset]->bl.timestamp);
+        commulative_difficulties.push_back(bcs.m_db_blocks[offset]->cumulative_difficulty);
+      }
+      return next_difficulty(timestamps, commulative_difficulties);
+    }
+
+    //chain stats window is contiguous, ends on top block, covers difficulty and daily windows and matches blocks db
+    static bool check_chain_stats_window(blockchain_storage& bcs)
+    {
+      CRITICAL_REGION_LOCAL(bcs.m_blockchain_lock);
+      const uint64_t sz = bcs.m_db_blocks.size();
+      //genesis is never in window
+      if (sz == 1)
+        return bcs.m_chain_stats_window.empty();
+      CHECK_AND_ASSERT_MES(bcs.m_chain_stats_window.size(), false, "chain stats window is empty");
+      CHECK_AND_ASSERT_MES(bcs.m_chain_stats_window.back().height + 1 == sz, false, "chain stats window ends on " << bcs.m_chain_stats_window.back().height << ", chain size " << sz);
+      CHECK_AND_ASSERT_MES(bcs.m_chain_stats_window.front().height <= std::max<uint64_t>(1, sz - std::min<uint64_t>(sz, DIFFICULTY_BLOCKS_COUNT)), false, "chain stats window starts on " << bcs.m_chain_stats_window.front().height << " after difficulty window");
+      CHECK_AND_ASSERT_MES(bcs.m_chain_stats_window.front().height <= std::max<uint64_t>(1, sz - std::min<uint64_t>(sz, CURRENCY_BLOCK_PER_DAY)), false, "chain stats window starts on " << bcs.m_chain_stats_window.front().height << " after daily window");
+      uint64_t h = bcs.m_chain_stats_window.front().height;
+      for (const auto& e : bcs.m_chain_stats_window)
+      {
+        CHECK_AND_ASSERT_MES(e.height == h, false, "chain stats window has a gap on " << h);
+        blockchain_storage::chain_stats_entry db_e = AUTO_VAL_INIT(db_e);
+        CHECK_AND_ASSERT_MES(bcs.fill_chain_stats_entry(h, db_e), false, "failed to read block on height " << h);
+        CHECK_AND_ASSERT_MES(e.id == db_e.id && e.timestamp == db_e.timestamp && e.cumulative_difficulty == db_e.cumulative_difficulty &&
+          e.tx_count == db_e.tx_count && e.tx_volume == db_e.tx_volume, false, "chain stats entry on height " << h << " differs from blocks db");
+        ++h;
+      }
+      return true;
+    }
+  };
+}
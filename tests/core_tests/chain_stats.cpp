@@ -0,0 +1,105 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+#include "chain_stats.h"
+#include "blockchain_storage_test_accessor.h"
+
+using namespace epee;
+using namespace currency;
+
+
+gen_chain_stats::gen_chain_stats()
+{
+  REGISTER_CALLBACK_METHOD(gen_chain_stats, check_chain_stats);
+  REGISTER_CALLBACK_METHOD(gen_chain_stats, pop_blocks_and_check);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 tx)-..-(2 )-(3 tx)-..-(4 )-(5 tx)-(6 )   <- hashrate windows and then daily window slide, txs of (1 ) go out of it
+                                               \-(6a)-(7a tx)  <- main after (7a), then top blocks popped
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+  GENERATE_ACCOUNT(alice_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  DO_CALLBACK(events, "check_chain_stats");
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  MAKE_TX_LIST_START(events, txs_1, miner_account, alice_account, MK_COINS(1), blk_0r);
+  MAKE_TX_LIST(events, txs_1, miner_account, alice_account, MK_COINS(2), blk_0r);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_1, blk_0r, miner_account, txs_1);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  //past short and long hashrate windows
+  REWIND_BLOCKS_N(events, blk_2, blk_1, miner_account, 350);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  MAKE_TX_LIST_START(events, txs_3, miner_account, alice_account, MK_COINS(3), blk_2);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_3, blk_2, miner_account, txs_3);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  //past daily and difficulty windows
+  REWIND_BLOCKS_N(events, blk_4, blk_3, miner_account, DIFFICULTY_BLOCKS_COUNT - 350);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  MAKE_TX_LIST_START(events, txs_5, miner_account, alice_account, MK_COINS(4), blk_4);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_5, blk_4, miner_account, txs_5);
+  MAKE_NEXT_BLOCK(events, blk_6, blk_5, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  //alternative chain is kept aside, then main chain switches to it
+  MAKE_NEXT_BLOCK(events, blk_6a, blk_5, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+  MAKE_TX_LIST_START(events, txs_7a, miner_account, alice_account, MK_COINS(5), blk_6a);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_7a, blk_6a, miner_account, txs_7a);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  DO_CALLBACK(events, "pop_blocks_and_check");
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats::check_chain_stats(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  blockchain_storage::chain_stats cs = bcs.get_chain_stats();
+
+  CHECK_TEST_CONDITION(blockchain_storage_test_accessor::check_chain_stats_window(bcs));
+  CHECK_EQ(cs.height, bcs.get_current_blockchain_height());
+  CHECK_EQ(cs.total_transactions, bcs.get_total_transactions());
+  CHECK_EQ(cs.alt_blocks_count, bcs.get_alternative_blocks_count());
+  CHECK_EQ(cs.current_blocks_median, bcs.get_current_comulative_blocksize_limit() / 2);
+  CHECK_TEST_CONDITION(cs.next_difficulty == blockchain_storage_test_accessor::get_next_difficulty_from_db(bcs));
+  CHECK_TEST_CONDITION(bcs.get_difficulty_for_next_block() == blockchain_storage_test_accessor::get_next_difficulty_from_db(bcs));
+  CHECK_EQ(cs.hashrate_50, bcs.get_current_hashrate(50));
+  CHECK_EQ(cs.hashrate_350, bcs.get_current_hashrate(350));
+
+  uint64_t daily_cnt = 0, daily_volume = 0;
+  CHECK_TEST_CONDITION(bcs.get_transactions_daily_stat(daily_cnt, daily_volume));
+  CHECK_EQ(cs.transactions_cnt_per_day, daily_cnt);
+  CHECK_EQ(cs.transactions_volume_per_day, daily_volume);
+  return true;
+}
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats::pop_blocks_and_check(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  //top block with transaction goes first, then blocks down past the switch point
+  for (size_t count : {1, 3})
+  {
+    uint64_t height = bcs.get_current_blockchain_height();
+    CHECK_TEST_CONDITION(blockchain_storage_test_accessor::pop_blocks(bcs, count));
+    CHECK_EQ(bcs.get_current_blockchain_height(), height - count);
+    if (!check_chain_stats(c, ev_index, events))
+      return false;
+  }
+  return true;
+}
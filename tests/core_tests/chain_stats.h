@@ -0,0 +1,21 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Chain stats kept in sliding window are compared to figures           */
+/* calculated over blocks db after push, chain switch and pop of blocks */
+/************************************************************************/
+class gen_chain_stats : public test_chain_unit_base
+{
+public:
+  gen_chain_stats();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_chain_stats(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool pop_blocks_and_check(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -0,0 +1,309 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+#include "chain_switch_undo.h"
+#include "blockchain_storage_test_accessor.h"
+
+using namespace epee;
+using namespace currency;
+
+#define UNDO_DAMAGED_RECORDS_COUNT 4
+
+gen_chain_switch_undo::gen_chain_switch_undo() : m_damage_undo_records(false),
+                                                 m_top_before_switch(null_hash),
+                                                 m_invalid_block_index(0)
+{
+  REGISTER_CALLBACK_METHOD(gen_chain_switch_undo, check_chain_state);
+  REGISTER_CALLBACK_METHOD(gen_chain_switch_undo, damage_undo_records);
+  REGISTER_CALLBACK_METHOD(gen_chain_switch_undo, remember_top_block);
+  REGISTER_CALLBACK_METHOD(gen_chain_switch_undo, check_switch_rolled_back);
+  REGISTER_CALLBACK_METHOD(gen_chain_switch_undo, mark_invalid_block);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 )-(2 )-(2r)-(3 )-(4 )-(5 )------------(6 )-(7 )-(8 )   <- main, alt, main again, (7 ) popped and reconnected
+                          \-(3a)-(4a)-(5a)-(6a)         \-(7x)-(8x)   <- (8x) double spends (7x), switch is rolled back
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  MAKE_ACCOUNT(events, bob_account);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  MAKE_TX(events, tx_0, miner_account, alice_account, MK_COINS(10), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_0);
+
+  currency::alias_info ai = AUTO_VAL_INIT(ai);
+  ai.m_alias = "alice";
+  ai.m_text_comment = "alice@alice.com";
+  ai.m_address = alice_account.get_keys().m_account_address;
+  MAKE_NEXT_BLOCK_ALIAS(events, blk_2, blk_1, miner_account, ai);
+  REWIND_BLOCKS(events, blk_2r, blk_2, miner_account);
+
+  //main chain: spends by miner and alice, alias update, one more transaction
+  MAKE_TX_LIST_START(events, txs_3, miner_account, bob_account, MK_COINS(3), blk_2r);
+  MAKE_TX_LIST(events, txs_3, alice_account, bob_account, MK_COINS(2), blk_2r);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_3, blk_2r, miner_account, txs_3);
+
+  currency::alias_info ai_upd = AUTO_VAL_INIT(ai_upd);
+  ai_upd.m_alias = "alice";
+  ai_upd.m_text_comment = "alice moved to bob";
+  ai_upd.m_address = bob_account.get_keys().m_account_address;
+  bool r = sign_update_alias(ai_upd, alice_account.get_keys().m_account_address.m_spend_public_key, alice_account.get_keys().m_spend_secret_key);
+  CHECK_AND_ASSERT_MES(r, false, "failed to sign update_alias");
+  MAKE_NEXT_BLOCK_ALIAS(events, blk_4, blk_3, miner_account, ai_upd);
+  MAKE_TX(events, tx_5, miner_account, alice_account, MK_COINS(4), blk_4);
+  MAKE_NEXT_BLOCK_TX1(events, blk_5, blk_4, miner_account, tx_5);
+  DO_CALLBACK(events, "check_chain_state");
+
+  //alternative chain shares miner's transaction, registers another alias and has its own transaction, switch pops 3 blocks
+  MAKE_TX(events, tx_alt, miner_account, alice_account, MK_COINS(6), blk_5);
+  MAKE_NEXT_BLOCK_TX1(events, blk_3a, blk_2r, miner_account, txs_3.front());
+  ai = AUTO_VAL_INIT(ai);
+  ai.m_alias = "bob";
+  ai.m_text_comment = "bob@bob.com";
+  ai.m_address = bob_account.get_keys().m_account_address;
+  MAKE_NEXT_BLOCK_ALIAS(events, blk_4a, blk_3a, miner_account, ai);
+  MAKE_NEXT_BLOCK_TX1(events, blk_5a, blk_4a, miner_account, tx_alt);
+  DO_CALLBACK(events, "damage_undo_records");
+  MAKE_NEXT_BLOCK(events, blk_6a, blk_5a, miner_account);
+  DO_CALLBACK(events, "check_chain_state");
+
+  //back to main chain, switch pops 4 blocks
+  MAKE_NEXT_BLOCK(events, blk_6, blk_5, miner_account);
+  DO_CALLBACK(events, "damage_undo_records");
+  MAKE_NEXT_BLOCK(events, blk_7, blk_6, miner_account);
+  DO_CALLBACK(events, "check_chain_state");
+
+  //failed switch: (7 ) is popped, (7x) connected and popped, (7 ) reconnected
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_keeped_by_block, true);
+  MAKE_TX(events, tx_x, bob_account, alice_account, MK_COINS(1), blk_7);
+  events.pop_back();
+  MAKE_TX(events, tx_y, bob_account, alice_account, MK_COINS(1), blk_7);
+  events.pop_back();
+  events.push_back(tx_x);
+  MAKE_NEXT_BLOCK_TX1(events, blk_7x, blk_6, miner_account, tx_x);
+  events.push_back(tx_y);
+  DO_CALLBACK(events, "damage_undo_records");
+  DO_CALLBACK(events, "remember_top_block");
+  DO_CALLBACK(events, "mark_invalid_block");
+  MAKE_NEXT_BLOCK_TX1(events, blk_8x, blk_7x, miner_account, tx_y);
+  DO_CALLBACK(events, "check_switch_rolled_back");
+  SET_EVENT_VISITOR_SETT(events, event_visitor_settings::set_txs_keeped_by_block, false);
+
+  //reconnected chain goes on, transaction of rolled back block gets confirmed
+  MAKE_NEXT_BLOCK_TX1(events, blk_8, blk_7, miner_account, tx_x);
+  DO_CALLBACK(events, "check_chain_state");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::check_block_verification_context(const currency::block_verification_context& bvc, size_t event_idx, const currency::block& /*block*/)
+{
+  if (m_invalid_block_index == event_idx)
+    return bvc.m_verifivation_failed;
+  else
+    return !bvc.m_verifivation_failed;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::check_chain_state(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  //last block sent to core is expected to be on top
+  for (size_t i = ev_index; i != 0; i--)
+  {
+    if (events[i - 1].type() == typeid(block))
+      return check_state_for_head(c, ev_index, events, get_block_hash(boost::get<block>(events[i - 1])));
+  }
+  return false;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::damage_undo_records(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  if (!m_damage_undo_records)
+    return true;
+
+  //missing and mismatched records both make the block popped the legacy way
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  uint64_t height = bcs.get_current_blockchain_height();
+  for (uint64_t h = height - UNDO_DAMAGED_RECORDS_COUNT; h != height; h++)
+  {
+    bool r = blockchain_storage_test_accessor::damage_block_undo_record(bcs, h, h % 2 != 0);
+    CHECK_TEST_CONDITION(r);
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::remember_top_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  m_top_before_switch = c.get_blockchain_storage().get_top_block_id();
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::check_switch_rolled_back(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  return check_state_for_head(c, ev_index, events, m_top_before_switch);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::mark_invalid_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  m_invalid_block_index = ev_index + 1;
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_switch_undo::check_state_for_head(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events, const crypto::hash& head)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  std::vector<block> chain;
+  map_hash2tx_t mtx;
+  bool r = find_block_chain(events, chain, mtx, head);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(head, bcs.get_top_block_id());
+  CHECK_EQ(chain.size(), bcs.get_current_blockchain_height());
+
+  //expected containers state, built from chain blocks in the order they were connected
+  std::map<uint64_t, std::vector<crypto::public_key> > outs;
+  std::map<std::string, alias_info> aliases;
+  std::unordered_set<crypto::hash> chain_txs;
+  std::unordered_set<crypto::key_image> chain_key_images;
+  std::vector<crypto::hash> scratchpad;
+  for (const block& b : chain)
+  {
+    std::list<const transaction*> txs(1, &b.miner_tx);
+    for (const crypto::hash& tx_id : b.tx_hashes)
+    {
+      auto it = mtx.find(tx_id);
+      CHECK_TEST_CONDITION(it != mtx.end());
+      txs.push_back(it->second);
+      chain_txs.insert(tx_id);
+    }
+    for (const transaction* ptx : txs)
+    {
+      std::vector<uint64_t> gindexes;
+      r = bcs.get_tx_outputs_gindexs(get_transaction_hash(*ptx), gindexes);
+      CHECK_TEST_CONDITION(r);
+      CHECK_EQ(ptx->vout.size(), gindexes.size());
+      for (size_t i = 0; i != ptx->vout.size(); i++)
+      {
+        std::vector<crypto::public_key>& amount_outs = outs[ptx->vout[i].amount];
+        CHECK_EQ(amount_outs.size(), gindexes[i]);
+        amount_outs.push_back(boost::get<txout_to_key>(ptx->vout[i].target).key);
+      }
+      for (const txin_v& in : ptx->vin)
+      {
+        if (in.type() == typeid(txin_to_key))
+          chain_key_images.insert(boost::get<txin_to_key>(in).k_image);
+      }
+    }
+
+    tx_extra_info ei = AUTO_VAL_INIT(ei);
+    r = parse_and_validate_tx_extra(b.miner_tx, ei);
+    CHECK_TEST_CONDITION(r);
+    if (ei.m_alias.m_alias.size())
+      aliases[ei.m_alias.m_alias] = ei.m_alias;
+    r = push_block_scratchpad_data(b, scratchpad);
+    CHECK_TEST_CONDITION(r);
+  }
+
+  //everything sent to core so far, including blocks and transactions that are not in chain
+  std::list<const transaction*> event_txs;
+  std::set<uint64_t> amounts;
+  std::set<std::string> alias_names;
+  for (size_t i = 0; i != ev_index; i++)
+  {
+    if (events[i].type() == typeid(block))
+    {
+      const block& b = boost::get<block>(events[i]);
+      for (const auto& o : b.miner_tx.vout)
+        amounts.insert(o.amount);
+      tx_extra_info ei = AUTO_VAL_INIT(ei);
+      if (parse_and_validate_tx_extra(b.miner_tx, ei) && ei.m_alias.m_alias.size())
+        alias_names.insert(ei.m_alias.m_alias);
+    }
+    else if (events[i].type() == typeid(transaction))
+    {
+      const transaction& tx = boost::get<transaction>(events[i]);
+      event_txs.push_back(&tx);
+      for (const auto& o : tx.vout)
+        amounts.insert(o.amount);
+    }
+  }
+
+  //per-amount outputs
+  for (uint64_t amount : amounts)
+  {
+    std::list<crypto::public_key> pkeys;
+    r = bcs.get_outs(amount, pkeys);
+    CHECK_TEST_CONDITION(r);
+    const std::vector<crypto::public_key>& expected = outs[amount];
+    CHECK_EQ(expected.size(), pkeys.size());
+    CHECK_TEST_CONDITION(std::equal(expected.begin(), expected.end(), pkeys.begin()));
+  }
+
+  //spent key images and pool, transactions out of chain are expected to be returned to pool
+  std::unordered_set<crypto::hash> expected_pool;
+  for (const transaction* ptx : event_txs)
+  {
+    crypto::hash tx_id = get_transaction_hash(*ptx);
+    if (!chain_txs.count(tx_id))
+    {
+      std::vector<uint64_t> gindexes;
+      CHECK_TEST_CONDITION(!bcs.get_tx_outputs_gindexs(tx_id, gindexes));
+      expected_pool.insert(tx_id);
+    }
+    for (const txin_v& in : ptx->vin)
+    {
+      const crypto::key_image& ki = boost::get<txin_to_key>(in).k_image;
+      bool spent_in_chain = chain_key_images.count(ki) != 0;
+      CHECK_EQ(spent_in_chain, bcs.have_tx_keyimg_as_spent(ki));
+    }
+  }
+  std::list<transaction> pool_txs;
+  r = c.get_pool_transactions(pool_txs);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(expected_pool.size(), pool_txs.size());
+  for (const transaction& tx : pool_txs)
+    CHECK_TEST_CONDITION(expected_pool.count(get_transaction_hash(tx)));
+
+  //aliases, updates are expected to be rolled back to previous values
+  for (const std::string& name : alias_names)
+  {
+    alias_info_base ai = AUTO_VAL_INIT(ai);
+    r = bcs.get_alias_info(name, ai);
+    auto it = aliases.find(name);
+    bool registered_in_chain = it != aliases.end();
+    CHECK_EQ(registered_in_chain, r);
+    if (!r)
+      continue;
+    CHECK_EQ(it->second.m_address.m_spend_public_key, ai.m_address.m_spend_public_key);
+    CHECK_EQ(it->second.m_address.m_view_public_key, ai.m_address.m_view_public_key);
+    CHECK_EQ(it->second.m_text_comment, ai.m_text_comment);
+  }
+  std::list<alias_info> all_aliases;
+  r = bcs.get_all_aliases(all_aliases);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(aliases.size(), all_aliases.size());
+
+  //scratchpad rebuilt from scratch
+  std::vector<crypto::hash> bcs_scratchpad;
+  r = bcs.copy_scratchpad(bcs_scratchpad);
+  CHECK_TEST_CONDITION(r);
+  CHECK_EQ(scratchpad.size(), bcs_scratchpad.size());
+  CHECK_TEST_CONDITION(scratchpad == bcs_scratchpad);
+
+  return true;
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Chain switches back and forth over several blocks, state of          */
+/* containers is compared to the one expected from blocks in events     */
+/************************************************************************/
+class gen_chain_switch_undo : public test_chain_unit_base
+{
+public:
+  gen_chain_switch_undo();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+  bool check_block_verification_context(const currency::block_verification_context& bvc, size_t event_idx, const currency::block& block);
+
+  bool check_chain_state(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool damage_undo_records(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool remember_top_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_switch_rolled_back(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool mark_invalid_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+protected:
+  bool check_state_for_head(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events, const crypto::hash& head);
+
+  //blocks are popped without undo records, by legacy purge
+  bool m_damage_undo_records;
+
+private:
+  crypto::hash m_top_before_switch;
+  size_t m_invalid_block_index;
+};
+
+class gen_chain_switch_undo_legacy : public gen_chain_switch_undo
+{
+public:
+  gen_chain_switch_undo_legacy()
+  {
+    m_damage_undo_records = true;
+  }
+};
@@ -80,12 +80,19 @@ int main(int argc, char* argv[])
 //     GENERATE_AND_PLAY(mix_attr_tests);
 
     GENERATE_AND_PLAY(prun_ring_signatures);
+    GENERATE_AND_PLAY(gen_prune_ring_signatures_steps);
     GENERATE_AND_PLAY(get_random_outs_test);
     GENERATE_AND_PLAY(mix_attr_tests);
     GENERATE_AND_PLAY(gen_simple_chain_001);
     GENERATE_AND_PLAY(gen_simple_chain_split_1);
     GENERATE_AND_PLAY(one_block);
     GENERATE_AND_PLAY(gen_chain_switch_1);
+    GENERATE_AND_PLAY(gen_block_headers_index);
+    GENERATE_AND_PLAY(gen_chain_switch_undo);
+    GENERATE_AND_PLAY(gen_chain_switch_undo_legacy);
+    GENERATE_AND_PLAY(gen_alt_chain_scratchpad);
+    GENERATE_AND_PLAY(gen_rpc_batch_lock_order);
+    GENERATE_AND_PLAY(gen_chain_stats);
     GENERATE_AND_PLAY(gen_ring_signature_1);
     GENERATE_AND_PLAY(gen_ring_signature_2);
     //GENERATE_AND_PLAY(gen_ring_signature_big); // Takes up to XXX hours (if CURRENCY_MINED_MONEY_UNLOCK_WINDOW == 10)
@@ -17,6 +17,11 @@
 #include "mixin_attr.h"
 #include "get_random_outs.h"
 #include "pruning_ring_signatures.h"
+#include "block_headers_index.h"
+#include "chain_switch_undo.h"
+#include "alt_chain_scratchpad.h"
+#include "rpc_batch_lock.h"
+#include "chain_stats.h"
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
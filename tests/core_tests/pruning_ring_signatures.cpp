@@ -117,4 +117,129 @@ bool prun_ring_signatures::check_blockchain(currency::core& c, size_t ev_index,
   CHECK_EQ(c.get_current_blockchain_height(), currency::get_block_height(b) + 1);
 
   return true;
-}
\ No newline at end of file
+}
+//-----------------------------------------------------------------------------------------------------
+#define PRUNE_STEPS_TX_BLOCKS           12
+#define PRUNE_STEPS_TARGET_HEIGHT       (CURRENCY_MINED_MONEY_UNLOCK_WINDOW + 8)
+#define PRUNE_STEPS_BLOCKS_PER_STEP     4
+
+namespace
+{
+  //reopen storage the way daemon starts: init() with given options, then checkpoints
+  bool reopen_blockchain_storage(currency::core& c, uint64_t blocks_per_step, const currency::checkpoints& cp)
+  {
+    boost::program_options::options_description desc("Allowed options");
+    currency::core::init_options(desc);
+    command_line::add_arg(desc, command_line::arg_data_dir);
+    boost::program_options::variables_map vm;
+    std::string blocks_per_step_arg = "--prune-rs-blocks-per-step=" + std::to_string(blocks_per_step);
+    const char* argv[] = {"coretests", blocks_per_step_arg.c_str()};
+    bool r = command_line::handle_error_helper(desc, [&]()
+    {
+      boost::program_options::store(command_line::parse_command_line(2, argv, desc), vm);
+      boost::program_options::notify(vm);
+      return true;
+    });
+    CHECK_AND_ASSERT_MES(r, false, "failed to parse options");
+
+    blockchain_storage& bcs = c.get_blockchain_storage();
+    CHECK_AND_ASSERT_MES(bcs.deinit(), false, "failed to deinit blockchain storage");
+    CHECK_AND_ASSERT_MES(bcs.init(vm, c.get_config_folder()), false, "failed to init blockchain storage");
+    currency::checkpoints cp_copy = cp;
+    return bcs.set_checkpoints(std::move(cp_copy));
+  }
+
+  //transactions in blocks up to pruned height have no signatures, the ones above keep them
+  bool check_signatures_pruned_up_to(blockchain_storage& bcs, uint64_t pruned_height)
+  {
+    for (uint64_t h = 1; h < bcs.get_current_blockchain_height(); h++)
+    {
+      block b = AUTO_VAL_INIT(b);
+      CHECK_AND_ASSERT_MES(bcs.get_block_by_height(h, b), false, "failed to get block on height " << h);
+      for (const auto& tx_id : b.tx_hashes)
+      {
+        std::shared_ptr<transaction> tx = bcs.get_tx(tx_id);
+        CHECK_AND_ASSERT_MES(tx, false, "failed to get tx " << tx_id);
+        CHECK_AND_ASSERT_MES(tx->signatures.empty() == (h <= pruned_height), false, "tx " << tx_id << " on height " << h << " has "
+          << tx->signatures.size() << " signatures, pruned height " << pruned_height);
+      }
+    }
+    return true;
+  }
+}
+
+gen_prune_ring_signatures_steps::gen_prune_ring_signatures_steps()
+{
+  REGISTER_CALLBACK_METHOD(gen_prune_ring_signatures_steps, check_pruning_steps);
+}
+
+bool gen_prune_ring_signatures_steps::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+  GENERATE_ACCOUNT(alice_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+
+  //one transaction in each block around the target height
+  currency::block blk_prev = blk_0r;
+  for (size_t i = 0; i != PRUNE_STEPS_TX_BLOCKS; i++)
+  {
+    MAKE_TX_LIST_START(events, txs, miner_account, alice_account, MK_COINS(1), blk_prev);
+    MAKE_NEXT_BLOCK_TX_LIST(events, blk, blk_prev, miner_account, txs);
+    blk_prev = blk;
+  }
+  REWIND_BLOCKS_N(events, blk_1, blk_prev, miner_account, 3);
+
+  DO_CALLBACK(events, "check_pruning_steps");
+  return true;
+}
+
+bool gen_prune_ring_signatures_steps::check_pruning_steps(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  const uint64_t top_height = bcs.get_current_blockchain_height() - 1;
+  CHECK_TEST_CONDITION(top_height > PRUNE_STEPS_TARGET_HEIGHT);
+  currency::checkpoints cp;
+  cp.add_checkpoint(PRUNE_STEPS_TARGET_HEIGHT, epee::string_tools::pod_to_hex(bcs.get_block_id_by_height(PRUNE_STEPS_TARGET_HEIGHT)));
+
+  CHECK_TEST_CONDITION(reopen_blockchain_storage(c, PRUNE_STEPS_BLOCKS_PER_STEP, cp));
+  uint64_t pruned_height = 0, target_height = 0;
+  bcs.get_ring_signatures_pruning_progress(pruned_height, target_height);
+  CHECK_EQ(pruned_height, 0);
+  CHECK_EQ(target_height, PRUNE_STEPS_TARGET_HEIGHT);
+  CHECK_TEST_CONDITION(check_signatures_pruned_up_to(bcs, 0));
+
+  //each call prunes one step, storage is reopened in the middle
+  uint64_t expected_pruned_height = 0;
+  for (size_t step = 0; expected_pruned_height != PRUNE_STEPS_TARGET_HEIGHT; step++)
+  {
+    CHECK_TEST_CONDITION(bcs.prune_ring_signatures_if_need());
+    expected_pruned_height = std::min<uint64_t>(PRUNE_STEPS_TARGET_HEIGHT, expected_pruned_height + PRUNE_STEPS_BLOCKS_PER_STEP);
+    bcs.get_ring_signatures_pruning_progress(pruned_height, target_height);
+    CHECK_EQ(pruned_height, expected_pruned_height);
+    CHECK_EQ(target_height, PRUNE_STEPS_TARGET_HEIGHT);
+    CHECK_EQ(bcs.get_chain_stats().pruned_rs_height, expected_pruned_height);
+    CHECK_TEST_CONDITION(check_signatures_pruned_up_to(bcs, expected_pruned_height));
+
+    if (step == 2)
+    {
+      CHECK_TEST_CONDITION(reopen_blockchain_storage(c, PRUNE_STEPS_BLOCKS_PER_STEP, cp));
+      bcs.get_ring_signatures_pruning_progress(pruned_height, target_height);
+      CHECK_EQ(pruned_height, expected_pruned_height);
+      CHECK_EQ(bcs.get_chain_stats().pruned_rs_height, expected_pruned_height);
+      CHECK_TEST_CONDITION(check_signatures_pruned_up_to(bcs, expected_pruned_height));
+    }
+  }
+
+  //nothing goes past the target, neither on more calls nor after reopen with bigger step
+  CHECK_TEST_CONDITION(bcs.prune_ring_signatures_if_need());
+  CHECK_TEST_CONDITION(reopen_blockchain_storage(c, 100, cp));
+  CHECK_TEST_CONDITION(bcs.prune_ring_signatures_if_need());
+  bcs.get_ring_signatures_pruning_progress(pruned_height, target_height);
+  CHECK_EQ(pruned_height, PRUNE_STEPS_TARGET_HEIGHT);
+  CHECK_EQ(target_height, PRUNE_STEPS_TARGET_HEIGHT);
+  CHECK_TEST_CONDITION(check_signatures_pruned_up_to(bcs, PRUNE_STEPS_TARGET_HEIGHT));
+  return true;
+}
@@ -23,3 +23,17 @@ private:
   currency::account_base m_alice_account;
 };
 
+
+/************************************************************************/
+/* Background pruning goes in steps of --prune-rs-blocks-per-step,      */
+/* keeps its progress across reopen and stops on top checkpoint         */
+/************************************************************************/
+class gen_prune_ring_signatures_steps: public test_chain_unit_base
+{
+public:
+  gen_prune_ring_signatures_steps();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_pruning_steps(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+#include "rpc_batch_lock.h"
+#include "rpc/core_rpc_server.h"
+
+using namespace epee;
+using namespace currency;
+
+
+gen_rpc_batch_lock_order::gen_rpc_batch_lock_order()
+{
+  REGISTER_CALLBACK_METHOD(gen_rpc_batch_lock_order, start_batch_queries);
+  REGISTER_CALLBACK_METHOD(gen_rpc_batch_lock_order, stop_batch_queries);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_rpc_batch_lock_order::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  DO_CALLBACK(events, "start_batch_queries");
+
+  //every tx goes through the pool and is taken out of it by block import
+  MAKE_TX(events, tx_0, miner_account, alice_account, MK_COINS(1), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_0);
+  MAKE_TX(events, tx_1, miner_account, alice_account, MK_COINS(1), blk_1);
+  MAKE_NEXT_BLOCK_TX1(events, blk_2, blk_1, miner_account, tx_1);
+  MAKE_TX(events, tx_2, miner_account, alice_account, MK_COINS(1), blk_2);
+  MAKE_NEXT_BLOCK_TX1(events, blk_3, blk_2, miner_account, tx_2);
+  MAKE_TX(events, tx_3, miner_account, alice_account, MK_COINS(1), blk_3);
+  MAKE_NEXT_BLOCK_TX1(events, blk_4, blk_3, miner_account, tx_3);
+  MAKE_NEXT_BLOCK(events, blk_5, blk_4, miner_account);
+  DO_CALLBACK(events, "stop_batch_queries");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_rpc_batch_lock_order::start_batch_queries(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  m_state.reset(new batch_queries_state());
+  m_state->stop = false;
+  m_state->batches_served = 0;
+  m_state->batches_failed = 0;
+
+  std::shared_ptr<batch_queries_state> state = m_state;
+  m_state->worker = std::thread([&c, state]()
+  {
+    t_currency_protocol_handler<core> cprotocol(c, NULL);
+    nodetool::node_server<t_currency_protocol_handler<core> > p2psrv(cprotocol);
+    core_rpc_server rpc_server(c, p2psrv);
+    net_utils::http::i_http_server_handler<core_rpc_server::connection_context>& handler = rpc_server;
+
+    net_utils::http::http_request_info query_info;
+    query_info.m_URI = "/json_rpc";
+    query_info.m_body = "[{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"getblockcount\"},"
+      "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"f_pool_json\",\"params\":{}}]";
+    core_rpc_server::connection_context cntx = AUTO_VAL_INIT(cntx);
+    //keep querying until stopped and at least once after that, so the last block is covered too
+    do
+    {
+      net_utils::http::http_response_info response;
+      handler.handle_http_request(query_info, response, cntx);
+      if (response.m_response_code == 200 && response.m_body.find("\"error\"") == std::string::npos)
+        ++state->batches_served;
+      else
+        ++state->batches_failed;
+    } while (!state->stop);
+  });
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_rpc_batch_lock_order::stop_batch_queries(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  CHECK_TEST_CONDITION(m_state);
+  m_state->stop = true;
+  m_state->worker.join();
+  CHECK_NOT_EQ(0, m_state->batches_served);
+  CHECK_EQ(0, m_state->batches_failed);
+  m_state.reset();
+  return true;
+}
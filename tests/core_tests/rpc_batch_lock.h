@@ -0,0 +1,34 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <atomic>
+#include <thread>
+#include "chaingen.h"
+
+/************************************************************************/
+/* JSON-RPC batch of chain queries touching the pool is served over and */
+/* over while blocks with transactions are imported, batch guard has to */
+/* take locks in the same order as block import or the test hangs       */
+/************************************************************************/
+class gen_rpc_batch_lock_order : public test_chain_unit_base
+{
+public:
+  gen_rpc_batch_lock_order();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool start_batch_queries(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool stop_batch_queries(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+private:
+  struct batch_queries_state
+  {
+    std::atomic<bool> stop;
+    std::atomic<size_t> batches_served;
+    std::atomic<size_t> batches_failed;
+    std::thread worker;
+  };
+  std::shared_ptr<batch_queries_state> m_state;
+};
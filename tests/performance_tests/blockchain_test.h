@@ -0,0 +1,246 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <list>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "currency_core/account.h"
+#include "currency_core/blockchain_storage.h"
+#include "currency_core/currency_format_utils.h"
+#include "currency_core/miner.h"
+#include "currency_core/tx_pool.h"
+
+/************************************************************************/
+/* Blockchain with its memory pool living in a temporary folder, able   */
+/* to mine blocks with minimal difficulty and to spend coinbase outputs */
+/************************************************************************/
+class bench_blockchain
+{
+public:
+  bench_blockchain()
+    : m_pool(m_bcs)
+    , m_bcs(m_pool)
+    , m_initialized(false)
+  {}
+
+  ~bench_blockchain()
+  {
+    if (m_initialized)
+      m_bcs.deinit();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(m_folder, ec);
+  }
+
+  bool init()
+  {
+    namespace po = boost::program_options;
+    po::options_description desc;
+    currency::blockchain_storage::init_options(desc);
+    po::variables_map vm;
+    po::store(po::command_line_parser(std::vector<std::string>()).options(desc).run(), vm);
+    po::notify(vm);
+
+    m_folder = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    m_initialized = m_bcs.init(vm, m_folder);
+    return m_initialized;
+  }
+
+  bool mine_block(const currency::account_base& miner_acc, currency::block& b)
+  {
+    using namespace currency;
+
+    wide_difficulty_type diffic = 0;
+    uint64_t height = 0;
+    if (!m_bcs.create_block_template(b, miner_acc.get_keys().m_account_address, diffic, height, blobdata(), false, alias_info()))
+      return false;
+
+    // regular timestamps keep difficulty at its minimum, so nonce search is instant
+    block top = AUTO_VAL_INIT(top);
+    m_bcs.get_top_block(top);
+    b.timestamp = top.timestamp + DIFFICULTY_TARGET;
+
+    std::vector<crypto::hash> scratchpad;
+    m_bcs.copy_scratchpad(scratchpad);
+    if (!miner::find_nonce_for_given_block(b, diffic, height, [&](uint64_t index) -> crypto::hash
+    {
+      return scratchpad[index%scratchpad.size()];
+    }))
+      return false;
+
+    block_verification_context bvc = AUTO_VAL_INIT(bvc);
+    return m_bcs.add_new_block(b, bvc) && bvc.m_added_to_main_chain;
+  }
+
+  // transactions moving every coinbase output of given block owned by acc back to acc, one output per transaction
+  bool construct_spending_txs(const currency::account_base& acc, const currency::block& b, std::list<currency::transaction>& txs)
+  {
+    using namespace currency;
+
+    const transaction& coinbase = b.miner_tx;
+    crypto::public_key coinbase_pub_key = get_tx_pub_key_from_extra(coinbase);
+    std::vector<size_t> outs;
+    uint64_t money = 0;
+    if (!lookup_acc_outs(acc.get_keys(), coinbase, coinbase_pub_key, outs, money))
+      return false;
+    std::vector<uint64_t> gindexes;
+    if (!m_bcs.get_tx_outputs_gindexs(get_transaction_hash(coinbase), gindexes) || gindexes.size() != coinbase.vout.size())
+      return false;
+
+    for (size_t out_index : outs)
+    {
+      if (coinbase.vout[out_index].amount <= DEFAULT_FEE)
+        continue;
+      tx_source_entry se = AUTO_VAL_INIT(se);
+      se.amount = coinbase.vout[out_index].amount;
+      se.outputs.push_back(make_output_entry(gindexes[out_index], boost::get<txout_to_key>(coinbase.vout[out_index].target).key));
+      se.real_output = 0;
+      se.real_out_tx_key = coinbase_pub_key;
+      se.real_output_in_tx_index = out_index;
+
+      std::vector<tx_source_entry> sources(1, se);
+      std::vector<tx_destination_entry> destinations(1, tx_destination_entry(se.amount - DEFAULT_FEE, acc.get_keys().m_account_address));
+      keypair tx_key = AUTO_VAL_INIT(tx_key);
+      txs.push_back(transaction());
+      if (!construct_tx(acc.get_keys(), sources, destinations, txs.back(), tx_key, 0))
+        return false;
+    }
+    return true;
+  }
+
+  currency::blockchain_storage& get_storage() { return m_bcs; }
+  currency::tx_memory_pool& get_pool() { return m_pool; }
+
+private:
+  currency::tx_memory_pool m_pool;
+  currency::blockchain_storage m_bcs;
+  std::string m_folder;
+  bool m_initialized;
+};
+
+// a_pool_size spendable transactions in pool, one block template per call
+template<size_t a_pool_size>
+class test_fill_block_template
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    using namespace currency;
+
+    if (!m_chain.init())
+      return false;
+    m_miner.generate();
+
+    std::vector<block> blocks(a_pool_size + CURRENCY_MINED_MONEY_UNLOCK_WINDOW);
+    for (auto& b : blocks)
+    {
+      if (!m_chain.mine_block(m_miner, b))
+        return false;
+    }
+
+    std::list<transaction> txs;
+    for (size_t i = 0; i != blocks.size() && txs.size() < a_pool_size; i++)
+    {
+      if (!m_chain.construct_spending_txs(m_miner, blocks[i], txs))
+        return false;
+    }
+    for (const auto& tx : txs)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!m_chain.get_pool().add_tx(tx, tvc, false) || !tvc.m_added_to_pool)
+        return false;
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    currency::block b = AUTO_VAL_INIT(b);
+    size_t total_size = 0;
+    uint64_t fee = 0;
+    return m_chain.get_pool().fill_block_template(b, CURRENCY_BLOCK_GRANTED_FULL_REWARD_ZONE, 0, 0, total_size, fee) && !b.tx_hashes.empty();
+  }
+
+private:
+  bench_blockchain m_chain;
+  currency::account_base m_miner;
+};
+
+// replay of a_blocks_count blocks (coinbase spends included once unlocked) into empty blockchain, one block per call
+template<size_t a_blocks_count>
+class test_add_new_block_replay
+{
+public:
+  static const size_t loop_count = a_blocks_count;
+
+  test_add_new_block_replay() : m_next_block(0) {}
+
+  bool init()
+  {
+    using namespace currency;
+
+    {
+      bench_blockchain source;
+      if (!source.init())
+        return false;
+      m_miner.generate();
+
+      for (size_t i = 0; i != a_blocks_count; i++)
+      {
+        if (i >= CURRENCY_MINED_MONEY_UNLOCK_WINDOW)
+        {
+          std::list<transaction> txs;
+          if (!source.construct_spending_txs(m_miner, m_blocks[i - CURRENCY_MINED_MONEY_UNLOCK_WINDOW].first, txs))
+            return false;
+          for (const auto& tx : txs)
+          {
+            tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+            if (!source.get_pool().add_tx(tx, tvc, false) || !tvc.m_added_to_pool)
+              return false;
+          }
+        }
+
+        m_blocks.push_back(std::make_pair(block(), std::list<transaction>()));
+        if (!source.mine_block(m_miner, m_blocks.back().first))
+          return false;
+        for (const auto& tx_id : m_blocks.back().first.tx_hashes)
+        {
+          std::shared_ptr<transaction> tx_ptr = source.get_storage().get_tx(tx_id);
+          if (!tx_ptr)
+            return false;
+          m_blocks.back().second.push_back(*tx_ptr);
+        }
+      }
+    }
+
+    return m_target.init();
+  }
+
+  bool test()
+  {
+    using namespace currency;
+
+    // same path as core::handle_incoming_block: transactions go to the pool first
+    const auto& entry = m_blocks[m_next_block++];
+    for (const auto& tx : entry.second)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!m_target.get_pool().add_tx(tx, tvc, true))
+        return false;
+    }
+    block_verification_context bvc = AUTO_VAL_INIT(bvc);
+    return m_target.get_storage().add_new_block(entry.first, bvc) && bvc.m_added_to_main_chain;
+  }
+
+private:
+  bench_blockchain m_target;
+  currency::account_base m_miner;
+  std::vector<std::pair<currency::block, std::list<currency::transaction> > > m_blocks;
+  size_t m_next_block;
+};
@@ -36,7 +36,8 @@ public:
     std::vector<tx_destination_entry> destinations;
     destinations.push_back(tx_destination_entry(this->m_source_amount, m_alice.get_keys().m_account_address));
 
-    if (!construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, m_tx, 0))
+    keypair tx_key = AUTO_VAL_INIT(tx_key);
+    if (!construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, m_tx, tx_key, 0))
       return false;
 
     get_transaction_prefix_hash(m_tx, m_tx_prefix_hash);
@@ -42,11 +42,12 @@ public:
 
   bool test()
   {
-    return currency::construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, m_destinations, m_tx, 0);
+    return currency::construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, m_destinations, m_tx, m_tx_key, 0);
   }
 
 private:
   currency::account_base m_alice;
   std::vector<currency::tx_destination_entry> m_destinations;
   currency::transaction m_tx;
+  currency::keypair m_tx_key;
 };
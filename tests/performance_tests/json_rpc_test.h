@@ -0,0 +1,156 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+
+#include "crypto/crypto.h"
+#include "net/http_server_handlers_map2.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/json_stream.h"
+#include "string_tools.h"
+
+namespace json_rpc_test
+{
+  inline std::string random_hex(size_t size)
+  {
+    std::string buff(size, '\0');
+    for (auto& c : buff)
+      c = crypto::rand<char>();
+    return epee::string_tools::buff_to_hex_nodelimer(buff);
+  }
+}
+
+struct json_rpc_payload_getblockheaderbyheight
+{
+  typedef currency::COMMAND_RPC_GET_BLOCK_HEADER_BY_HEIGHT command;
+  static const char* method() { return "getblockheaderbyheight"; }
+
+  static void fill(command::request& req, command::response& resp)
+  {
+    req.height = 123456;
+    resp.status = CORE_RPC_STATUS_OK;
+    resp.block_header.major_version = 1;
+    resp.block_header.minor_version = 0;
+    resp.block_header.timestamp = 1400000000;
+    resp.block_header.prev_hash = json_rpc_test::random_hex(32);
+    resp.block_header.nonce = 1234567890123ULL;
+    resp.block_header.orphan_status = false;
+    resp.block_header.height = req.height;
+    resp.block_header.depth = 100;
+    resp.block_header.hash = json_rpc_test::random_hex(32);
+    resp.block_header.difficulty = 123456789;
+    resp.block_header.reward = 17592186044415ULL;
+  }
+};
+
+struct json_rpc_payload_getblocktemplate
+{
+  typedef currency::COMMAND_RPC_GETBLOCKTEMPLATE command;
+  static const char* method() { return "getblocktemplate"; }
+
+  static void fill(command::request& req, command::response& resp)
+  {
+    req.reserve_size = 8;
+    req.wallet_address = "1" + json_rpc_test::random_hex(47);
+    req.alias_details.alias = "some-alias";
+    req.alias_details.details.address = req.wallet_address;
+    req.alias_details.details.comment = "comment";
+    req.dev_bounties_vote = epee::serialization::storage_entry(true);
+    resp.difficulty = 123456789;
+    resp.height = 123456;
+    resp.reserved_offset = 130;
+    resp.blocktemplate_blob = json_rpc_test::random_hex(400);
+    resp.status = CORE_RPC_STATUS_OK;
+  }
+};
+
+struct json_rpc_payload_f_block_json
+{
+  typedef currency::F_COMMAND_RPC_GET_BLOCK_DETAILS command;
+  static const char* method() { return "f_block_json"; }
+
+  static void fill(command::request& req, command::response& resp)
+  {
+    req.hash = json_rpc_test::random_hex(32);
+    json_rpc_payload_getblockheaderbyheight::command::request header_req;
+    json_rpc_payload_getblockheaderbyheight::command::response header_resp;
+    json_rpc_payload_getblockheaderbyheight::fill(header_req, header_resp);
+    currency::f_block_details_response& b = resp.block;
+    b.major_version = header_resp.block_header.major_version;
+    b.timestamp = header_resp.block_header.timestamp;
+    b.prev_hash = header_resp.block_header.prev_hash;
+    b.nonce = header_resp.block_header.nonce;
+    b.height = header_resp.block_header.height;
+    b.hash = req.hash;
+    b.difficulty = header_resp.block_header.difficulty;
+    b.reward = header_resp.block_header.reward;
+    b.blockSize = 30000;
+    b.sizeMedian = 20000;
+    b.penalty = 0.125;
+    for (size_t i = 0; i != 100; i++)
+    {
+      currency::f_transaction_short_response tx = AUTO_VAL_INIT(tx);
+      tx.hash = json_rpc_test::random_hex(32);
+      tx.fee = 1000000;
+      tx.amount_out = 123456789000ULL + i;
+      tx.size = 300 + i;
+      b.transactions.push_back(tx);
+    }
+    resp.status = CORE_RPC_STATUS_OK;
+  }
+};
+
+// one JSON RPC call: request body bound to request structure, result serialized to response body,
+// through portable_storage tree (a_stream == false) or directly (a_stream == true)
+template<class t_payload, bool a_stream>
+class test_json_rpc
+{
+public:
+  static const size_t loop_count = 10000;
+
+  typedef typename t_payload::command command;
+  typedef epee::json_rpc::request<typename command::request> request_type;
+  typedef epee::json_rpc::response<typename command::response, epee::json_rpc::dummy_error> response_type;
+
+  bool init()
+  {
+    request_type req = AUTO_VAL_INIT(req);
+    req.jsonrpc = "2.0";
+    req.id = epee::serialization::storage_entry(std::string("0"));
+    req.method = t_payload::method();
+    m_response = AUTO_VAL_INIT(m_response);
+    m_response.jsonrpc = "2.0";
+    m_response.id = req.id;
+    t_payload::fill(req.params, m_response.result);
+    epee::serialization::store_t_to_json(req, m_request_body);
+    return true;
+  }
+
+  bool test()
+  {
+    std::string response_body;
+    request_type req = AUTO_VAL_INIT(req);
+    if (a_stream)
+    {
+      epee::serialization::json_stream_reader reader;
+      if (!reader.load_from_json(m_request_body) || !req.load(reader))
+        return false;
+      epee::serialization::store_t_to_json_stream(m_response, response_body);
+    }
+    else
+    {
+      epee::serialization::portable_storage ps;
+      if (!ps.load_from_json(m_request_body) || !req.load(ps))
+        return false;
+      epee::serialization::store_t_to_json(m_response, response_body);
+    }
+    return req.method == t_payload::method() && !response_body.empty();
+  }
+
+private:
+  std::string m_request_body;
+  response_type m_response;
+};
@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "crypto/crypto.h"
+#include "common/db_bridge.h"
+#include "common/db_lmdb_adapter.h"
+
+#define LMDB_TEST_VALUE_SIZE      128
+#define LMDB_TEST_RECORDS_COUNT   100000
+
+// temporary database with one table of uint64 keys
+class lmdb_test_base
+{
+public:
+  lmdb_test_base()
+    : m_adapter(std::make_shared<db::lmdb_adapter>())
+    , m_tid(0)
+    , m_records_count(0)
+  {}
+
+  ~lmdb_test_base()
+  {
+    m_adapter->close();
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(m_folder, ec);
+  }
+
+  bool init()
+  {
+    m_folder = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    boost::filesystem::create_directories(m_folder);
+    if (!m_adapter->open(m_folder))
+      return false;
+    if (!m_adapter->open_table("perf", m_tid))
+      return false;
+    m_value.clear();
+    for (size_t i = 0; i != LMDB_TEST_VALUE_SIZE / sizeof(crypto::hash); i++)
+    {
+      crypto::hash h = crypto::rand<crypto::hash>();
+      m_value.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    return true;
+  }
+
+protected:
+  bool put_records(size_t count)
+  {
+    if (!m_adapter->begin_transaction())
+      return false;
+    for (size_t i = 0; i != count; i++, m_records_count++)
+    {
+      uint64_t key = m_records_count;
+      if (!m_adapter->set(m_tid, reinterpret_cast<const char*>(&key), sizeof(key), m_value.data(), m_value.size()))
+      {
+        m_adapter->abort_transaction();
+        return false;
+      }
+    }
+    return m_adapter->commit_transaction();
+  }
+
+  std::shared_ptr<db::lmdb_adapter> m_adapter;
+  db::table_id m_tid;
+  std::string m_folder;
+  std::string m_value;
+  uint64_t m_records_count;
+};
+
+// one write transaction of a_batch_size records
+template<size_t a_batch_size>
+class test_lmdb_set : public lmdb_test_base
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool test()
+  {
+    return put_records(a_batch_size);
+  }
+};
+
+// one read transaction of a_batch_size random lookups
+template<size_t a_batch_size>
+class test_lmdb_get : public lmdb_test_base
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    return lmdb_test_base::init() && put_records(LMDB_TEST_RECORDS_COUNT);
+  }
+
+  bool test()
+  {
+    if (!m_adapter->begin_transaction(db::tx_read_only))
+      return false;
+    std::string buff;
+    for (size_t i = 0; i != a_batch_size; i++)
+    {
+      uint64_t key = crypto::rand<uint64_t>() % m_records_count;
+      if (!m_adapter->get(m_tid, reinterpret_cast<const char*>(&key), sizeof(key), buff) || buff.size() != LMDB_TEST_VALUE_SIZE)
+      {
+        m_adapter->abort_transaction();
+        return false;
+      }
+    }
+    return m_adapter->commit_transaction();
+  }
+};
+
+// full table scan
+class test_lmdb_iterate : public lmdb_test_base, public db::i_db_visitor
+{
+public:
+  static const size_t loop_count = 10;
+
+  bool init()
+  {
+    return lmdb_test_base::init() && put_records(LMDB_TEST_RECORDS_COUNT);
+  }
+
+  bool test()
+  {
+    m_visited = 0;
+    return m_adapter->visit_table(m_tid, this) && m_visited == m_records_count;
+  }
+
+  virtual bool on_visit_db_item(size_t i, const void* key_data, size_t key_size, const void* value_data, size_t value_size) override
+  {
+    m_visited += value_size == LMDB_TEST_VALUE_SIZE ? 1 : 0;
+    return true;
+  }
+
+private:
+  uint64_t m_visited;
+};
@@ -2,6 +2,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "common/command_line.h"
 #include "performance_tests.h"
 #include "performance_utils.h"
 
@@ -15,9 +16,57 @@
 #include "generate_key_image_helper.h"
 #include "is_out_to_acc.h"
 #include "keccak_test.h"
+#include "serialization_test.h"
+#include "lmdb_test.h"
+#include "blockchain_test.h"
+#include "json_rpc_test.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_filter          = {"filter", "Run only tests whose name contains given substring", ""};
+  const command_line::arg_descriptor<std::string> arg_json_output     = {"json-output", "Append results to given file, one JSON object per test", ""};
+  const command_line::arg_descriptor<bool>        arg_keccak_scan     = {"keccak-scan", "Compare scalar and optimized wild keccak over growing scratchpad (takes hours)"};
+}
 
 int main(int argc, char** argv)
 {
+  po::options_description desc_options("Allowed options");
+  command_line::add_arg(desc_options, command_line::arg_help);
+  command_line::add_arg(desc_options, arg_filter);
+  command_line::add_arg(desc_options, arg_json_output);
+  command_line::add_arg(desc_options, arg_keccak_scan);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  performance_tests_config& config = get_performance_tests_config();
+  config.filter = command_line::get_arg(vm, arg_filter);
+  std::string json_output = command_line::get_arg(vm, arg_json_output);
+  if (!json_output.empty())
+  {
+    config.json_output.open(json_output, std::ios_base::app);
+    if (!config.json_output.is_open())
+    {
+      std::cout << "Failed to open " << json_output << std::endl;
+      return 1;
+    }
+  }
+
   set_process_affinity(1);
   set_thread_high_priority();
 
@@ -42,8 +91,9 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_wild_keccak, 100000000);
   TEST_PERFORMANCE1(test_wild_keccak2, 100000000);
 
-  measure_keccak_over_scratchpad();
-  /*
+  if (command_line::get_arg(vm, arg_keccak_scan))
+    measure_keccak_over_scratchpad();
+
   TEST_PERFORMANCE2(test_construct_tx, 1, 1);
   TEST_PERFORMANCE2(test_construct_tx, 1, 2);
   TEST_PERFORMANCE2(test_construct_tx, 1, 10);
@@ -76,8 +126,36 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE0(test_generate_key_image);
   TEST_PERFORMANCE0(test_derive_public_key);
   TEST_PERFORMANCE0(test_derive_secret_key);
-  */
+
+  TEST_PERFORMANCE1(test_tx_serialization, 1);
+  TEST_PERFORMANCE1(test_tx_serialization, 10);
+  TEST_PERFORMANCE1(test_tx_deserialization, 1);
+  TEST_PERFORMANCE1(test_tx_deserialization, 10);
+  TEST_PERFORMANCE1(test_block_serialization, 0);
+  TEST_PERFORMANCE1(test_block_serialization, 100);
+  TEST_PERFORMANCE1(test_block_deserialization, 0);
+  TEST_PERFORMANCE1(test_block_deserialization, 100);
+
+  TEST_PERFORMANCE2(test_json_rpc, json_rpc_payload_getblockheaderbyheight, false);
+  TEST_PERFORMANCE2(test_json_rpc, json_rpc_payload_getblockheaderbyheight, true);
+  TEST_PERFORMANCE2(test_json_rpc, json_rpc_payload_getblocktemplate, false);
+  TEST_PERFORMANCE2(test_json_rpc, json_rpc_payload_getblocktemplate, true);
+  TEST_PERFORMANCE2(test_json_rpc, json_rpc_payload_f_block_json, false);
+  TEST_PERFORMANCE2(test_json_rpc, json_rpc_payload_f_block_json, true);
+
+  TEST_PERFORMANCE1(test_lmdb_set, 1);
+  TEST_PERFORMANCE1(test_lmdb_set, 1000);
+  TEST_PERFORMANCE1(test_lmdb_get, 1000);
+  TEST_PERFORMANCE0(test_lmdb_iterate);
+
+  TEST_PERFORMANCE1(test_fill_block_template, 10);
+  TEST_PERFORMANCE1(test_fill_block_template, 100);
+  TEST_PERFORMANCE1(test_fill_block_template, 1000);
+
+  TEST_PERFORMANCE1(test_add_new_block_replay, 100);
+  TEST_PERFORMANCE1(test_add_new_block_replay, 1000);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
-  return 0;
+  return config.failed_count ? 1 : 0;
 }
@@ -5,6 +5,8 @@
 #pragma once
 
 #include <iostream>
+#include <fstream>
+#include <string>
 #include <stdint.h>
 
 #include <boost/chrono.hpp>
@@ -30,6 +32,12 @@ public:
     return static_cast<int>(boost::chrono::duration_cast<boost::chrono::milliseconds>(elapsed).count());
   }
 
+  uint64_t elapsed_us()
+  {
+    clock::duration elapsed = clock::now() - m_start;
+    return static_cast<uint64_t>(boost::chrono::duration_cast<boost::chrono::microseconds>(elapsed).count());
+  }
+
 private:
   clock::time_point m_base;
   clock::time_point m_start;
@@ -42,6 +50,7 @@ class test_runner
 public:
   test_runner()
     : m_elapsed(0)
+    , m_elapsed_us(0)
   {
   }
 
@@ -62,12 +71,19 @@ public:
       if (!test.test())
         return false;
     }
-    m_elapsed = timer.elapsed_ms();
+    m_elapsed_us = timer.elapsed_us();
+    m_elapsed = static_cast<int>(m_elapsed_us / 1000);
 
     return true;
   }
 
   int elapsed_time() const { return m_elapsed; }
+  uint64_t elapsed_time_us() const { return m_elapsed_us; }
+
+  uint64_t time_per_call_ns() const
+  {
+    return m_elapsed_us * 1000 / T::loop_count;
+  }
 
   int time_per_call() const
   {
@@ -93,22 +109,57 @@ private:
 private:
   volatile uint64_t m_warm_up;  ///<! This field is intended for preclude compiler optimizations
   int m_elapsed;
+  uint64_t m_elapsed_us;
+};
+
+/**
+ * Run-wide settings: tests filter and machine-readable results sink (one JSON object per line)
+ */
+struct performance_tests_config
+{
+  std::string filter;
+  std::ofstream json_output;
+  size_t failed_count;
+
+  performance_tests_config() : failed_count(0) {}
 };
 
+inline performance_tests_config& get_performance_tests_config()
+{
+  static performance_tests_config config;
+  return config;
+}
+
+inline void write_json_result(const char* test_name, bool ok, size_t loop_count, uint64_t elapsed_us, uint64_t ns_per_call)
+{
+  std::ofstream& out = get_performance_tests_config().json_output;
+  if (!out.is_open())
+    return;
+  out << "{\"test\": \"" << test_name << "\", \"status\": \"" << (ok ? "ok" : "failed") << "\", \"loop_count\": " << loop_count
+      << ", \"elapsed_us\": " << elapsed_us << ", \"ns_per_call\": " << ns_per_call << "}" << std::endl;
+}
+
 template <typename T>
 void run_test(const char* test_name)
 {
+  performance_tests_config& config = get_performance_tests_config();
+  if (!config.filter.empty() && std::string(test_name).find(config.filter) == std::string::npos)
+    return;
+
   test_runner<T> runner;
   if (runner.run())
   {
     std::cout << test_name << " - OK:\n";
     std::cout << "  loop count:    " << T::loop_count << '\n';
     std::cout << "  elapsed:       " << runner.elapsed_time() << " ms\n";
-    std::cout << "  time per call: " << runner.time_per_call() << " ms/call\n" << std::endl;
+    std::cout << "  time per call: " << runner.time_per_call_ns() / 1000 << " us/call\n" << std::endl;
+    write_json_result(test_name, true, T::loop_count, runner.elapsed_time_us(), runner.time_per_call_ns());
   }
   else
   {
     std::cout << test_name << " - FAILED" << std::endl;
+    write_json_result(test_name, false, T::loop_count, 0, 0);
+    ++config.failed_count;
   }
 }
 
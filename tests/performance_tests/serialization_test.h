@@ -0,0 +1,130 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <vector>
+
+#include "currency_core/account.h"
+#include "currency_core/currency_basic.h"
+#include "currency_core/currency_format_utils.h"
+#include "crypto/crypto.h"
+
+#include "multi_tx_test_base.h"
+
+// transaction with one input of given ring size
+template<size_t a_ring_size>
+class tx_serialization_test_base : protected multi_tx_test_base<a_ring_size>
+{
+public:
+  typedef multi_tx_test_base<a_ring_size> base_class;
+
+  bool init()
+  {
+    using namespace currency;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount, m_alice.get_keys().m_account_address));
+
+    keypair tx_key = AUTO_VAL_INIT(tx_key);
+    if (!construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, destinations, m_tx, tx_key, 0))
+      return false;
+
+    m_tx_blob = tx_to_blob(m_tx);
+    return true;
+  }
+
+protected:
+  currency::account_base m_alice;
+  currency::transaction m_tx;
+  currency::blobdata m_tx_blob;
+};
+
+template<size_t a_ring_size>
+class test_tx_serialization : public tx_serialization_test_base<a_ring_size>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool test()
+  {
+    currency::blobdata blob;
+    return currency::tx_to_blob(this->m_tx, blob) && blob.size() == this->m_tx_blob.size();
+  }
+};
+
+template<size_t a_ring_size>
+class test_tx_deserialization : public tx_serialization_test_base<a_ring_size>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool test()
+  {
+    currency::transaction tx;
+    crypto::hash tx_hash, tx_prefix_hash;
+    return currency::parse_and_validate_tx_from_blob(this->m_tx_blob, tx, tx_hash, tx_prefix_hash);
+  }
+};
+
+// block with coinbase and given number of transaction hashes
+template<size_t a_tx_count>
+class block_serialization_test_base
+{
+public:
+  bool init()
+  {
+    using namespace currency;
+
+    m_miner.generate();
+    m_block = AUTO_VAL_INIT(m_block);
+    m_block.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+    m_block.minor_version = CURRENT_BLOCK_MINOR_VERSION;
+    m_block.timestamp = time(nullptr);
+    m_block.prev_id = crypto::rand<crypto::hash>();
+    if (!construct_miner_tx(1, 0, 0, 0, 0, m_miner.get_keys().m_account_address, m_block.miner_tx))
+      return false;
+    for (size_t i = 0; i != a_tx_count; i++)
+      m_block.tx_hashes.push_back(crypto::rand<crypto::hash>());
+
+    m_block_blob = block_to_blob(m_block);
+    return true;
+  }
+
+protected:
+  currency::account_base m_miner;
+  currency::block m_block;
+  currency::blobdata m_block_blob;
+};
+
+template<size_t a_tx_count>
+class test_block_serialization : public block_serialization_test_base<a_tx_count>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool test()
+  {
+    currency::blobdata blob;
+    return currency::block_to_blob(this->m_block, blob) && blob.size() == this->m_block_blob.size();
+  }
+};
+
+template<size_t a_tx_count>
+class test_block_deserialization : public block_serialization_test_base<a_tx_count>
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool test()
+  {
+    currency::block b;
+    return currency::parse_and_validate_block_from_blob(this->m_block_blob, b);
+  }
+};
@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <thread>
+
+#include "include_base_utils.h"
+#include "currency_core/core_events.h"
+
+using currency::core_event_notifier;
+
+TEST(core_events, tokens)
+{
+  core_event_notifier n;
+  core_event_notifier::events_state st = n.get_state();
+  const uint64_t start = st.token;
+  ASSERT_NE(0, start);
+  ASSERT_EQ(0, st.get_events_since(start));
+  ASSERT_EQ(core_event_notifier::event_all, st.get_events_since(0));
+
+  n.notify(core_event_notifier::event_pool_changed);
+  uint64_t after_pool = n.get_state().token;
+  n.notify(core_event_notifier::event_tip_changed | core_event_notifier::event_template_changed);
+  st = n.get_state();
+  ASSERT_EQ(start + 2, st.token);
+  ASSERT_EQ(core_event_notifier::event_all, st.get_events_since(start));
+  ASSERT_EQ(core_event_notifier::event_tip_changed | core_event_notifier::event_template_changed, st.get_events_since(after_pool));
+  ASSERT_EQ(0, st.get_events_since(st.token));
+}
+
+TEST(core_events, wait_returns_immediately_for_seen_events)
+{
+  core_event_notifier n;
+  const uint64_t start_token = n.get_state().token;
+  n.notify(core_event_notifier::event_pool_changed);
+  auto start = std::chrono::steady_clock::now();
+  core_event_notifier::events_state st = n.wait_for_events(start_token, core_event_notifier::event_all, 10000);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  ASSERT_EQ(core_event_notifier::event_pool_changed, st.get_events_since(start_token));
+}
+
+TEST(core_events, wait_filters_by_mask_and_times_out)
+{
+  core_event_notifier n;
+  const uint64_t start_token = n.get_state().token;
+  n.notify(core_event_notifier::event_pool_changed);
+  core_event_notifier::events_state st = n.wait_for_events(start_token, core_event_notifier::event_tip_changed, 50);
+  ASSERT_EQ(0, st.get_events_since(start_token) & core_event_notifier::event_tip_changed);
+}
+
+TEST(core_events, wait_is_woken_by_notify)
+{
+  core_event_notifier n;
+  const uint64_t start_token = n.get_state().token;
+  std::thread t([&n]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    n.notify(core_event_notifier::event_pool_changed);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    n.notify(core_event_notifier::event_tip_changed);
+  });
+  auto start = std::chrono::steady_clock::now();
+  core_event_notifier::events_state st = n.wait_for_events(start_token, core_event_notifier::event_tip_changed, 10000);
+  t.join();
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  ASSERT_EQ(start_token + 2, st.token);
+  ASSERT_NE(0, st.get_events_since(start_token) & core_event_notifier::event_tip_changed);
+}
+
+TEST(core_events, interrupt)
+{
+  core_event_notifier n;
+  const uint64_t start_token = n.get_state().token;
+  std::thread t([&n]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    n.interrupt();
+  });
+  auto start = std::chrono::steady_clock::now();
+  core_event_notifier::events_state st = n.wait_for_events(start_token, core_event_notifier::event_all, 10000);
+  t.join();
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  ASSERT_EQ(start_token, st.token);
+  // further waits don't block
+  st = n.wait_for_events(start_token, core_event_notifier::event_all, 10000);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+TEST(core_events, restart_changes_epoch)
+{
+  // client saw a few events before restart, restarted daemon has had more of them since
+  core_event_notifier before_restart(1);
+  before_restart.notify(core_event_notifier::event_pool_changed);
+  const uint64_t old_token = before_restart.get_state().token;
+
+  core_event_notifier after_restart(2);
+  ASSERT_EQ(core_event_notifier::event_all, after_restart.get_state().get_events_since(old_token));
+  for (size_t i = 0; i != 5; i++)
+    after_restart.notify(core_event_notifier::event_pool_changed);
+  core_event_notifier::events_state st = after_restart.get_state();
+  ASSERT_EQ(core_event_notifier::event_all, st.get_events_since(old_token));
+  ASSERT_EQ(core_event_notifier::event_pool_changed, st.get_events_since(st.token - 1));
+
+  // waiting with old token returns at once
+  auto start = std::chrono::steady_clock::now();
+  st = after_restart.wait_for_events(old_token, core_event_notifier::event_tip_changed, 10000);
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  ASSERT_EQ(core_event_notifier::event_all, st.get_events_since(old_token));
+}
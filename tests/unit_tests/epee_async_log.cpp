@@ -0,0 +1,204 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+#include "gtest/gtest.h"
+
+#include "misc_log_ex.h"
+
+namespace
+{
+  struct capture_stream: public epee::log_space::ibase_log_stream
+  {
+    capture_stream(std::string& out, std::mutex& lock, size_t& calls): m_out(out), m_lock(lock), m_calls(calls)
+    {}
+    virtual bool out_buffer(const char* buffer, int buffer_len, int log_level, int color, const char* plog_name = NULL)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_out.append(buffer, buffer_len);
+      ++m_calls;
+      return true;
+    }
+
+    std::string& m_out;
+    std::mutex& m_lock;
+    size_t& m_calls;
+  };
+}
+
+TEST(epee_async_log, bounded_queue)
+{
+  epee::log_space::mpsc_bounded_queue<std::string> q(3);
+  //size is rounded up to power of two
+  for (size_t i = 0; i != 4; i++)
+  {
+    std::string s = std::to_string(i);
+    ASSERT_TRUE(q.try_push(s));
+  }
+  std::string extra = "x";
+  ASSERT_FALSE(q.try_push(extra));
+  ASSERT_EQ("x", extra);
+  ASSERT_EQ(4, q.get_pushed_count());
+
+  std::string s;
+  ASSERT_TRUE(q.try_pop(s));
+  ASSERT_EQ("0", s);
+  ASSERT_TRUE(q.try_push(extra));
+  for (const char* expected : {"1", "2", "3", "x"})
+  {
+    ASSERT_FALSE(q.empty());
+    ASSERT_TRUE(q.try_pop(s));
+    ASSERT_EQ(expected, s);
+  }
+  ASSERT_TRUE(q.empty());
+  ASSERT_FALSE(q.try_pop(s));
+}
+
+TEST(epee_async_log, all_messages_written_in_order)
+{
+  std::string out;
+  std::mutex lock;
+  size_t calls = 0;
+  {
+    epee::log_space::logger l;
+    l.add_logger(new capture_stream(out, lock, calls));
+    ASSERT_TRUE(l.set_async_mode(true, 1 << 16));
+
+    const size_t threads_count = 4, per_thread = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t != threads_count; t++)
+      threads.push_back(std::thread([&l, t, per_thread]()
+      {
+        for (size_t i = 0; i != per_thread; i++)
+          l.do_log_message(std::to_string(t) + ":" + std::to_string(i) + "\n", LOG_LEVEL_1, epee::log_space::console_color_default);
+      }));
+    for (auto& th : threads)
+      th.join();
+
+    ASSERT_TRUE(l.flush());
+    ASSERT_EQ(0, l.get_dropped_messages_count());
+
+    std::lock_guard<std::mutex> lk(lock);
+    std::vector<size_t> next(threads_count, 0);
+    size_t lines = 0;
+    std::istringstream ss(out);
+    std::string line;
+    while (std::getline(ss, line))
+    {
+      size_t colon = line.find(':');
+      ASSERT_NE(std::string::npos, colon);
+      size_t t = std::stoul(line.substr(0, colon));
+      ASSERT_LT(t, threads_count);
+      ASSERT_EQ(next[t], std::stoul(line.substr(colon + 1)));
+      ++next[t];
+      ++lines;
+    }
+    ASSERT_EQ(threads_count * per_thread, lines);
+    //batching merges messages, streams are called less often than once per message
+    ASSERT_LT(calls, lines);
+  }
+}
+
+TEST(epee_async_log, errors_reach_journal_and_streams_before_return)
+{
+  std::string out;
+  std::mutex lock;
+  size_t calls = 0;
+  epee::log_space::logger l;
+  l.add_logger(new capture_stream(out, lock, calls));
+  ASSERT_TRUE(l.set_async_mode(true, 16));
+  l.do_log_message("fatal\n", LOG_LEVEL_0, epee::log_space::console_color_red, true);
+  {
+    std::lock_guard<std::mutex> lk(lock);
+    ASSERT_NE(std::string::npos, out.find("fatal\n"));
+  }
+  std::list<std::string> journal;
+  l.take_away_journal(journal);
+  ASSERT_EQ(1, journal.size());
+  ASSERT_EQ("fatal\n", journal.front());
+
+  //back to synchronous mode
+  ASSERT_TRUE(l.set_async_mode(false));
+  l.do_log_message("sync\n", LOG_LEVEL_1, epee::log_space::console_color_default);
+  std::lock_guard<std::mutex> lk(lock);
+  ASSERT_EQ(out.size() - 5, out.rfind("sync\n"));
+}
+
+TEST(epee_async_log, no_messages_lost_when_switching_modes)
+{
+  std::string out;
+  std::mutex lock;
+  size_t calls = 0;
+  const size_t threads_count = 4, per_thread = 20000;
+  {
+    epee::log_space::logger l;
+    l.add_logger(new capture_stream(out, lock, calls));
+    std::atomic<size_t> finished(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t != threads_count; t++)
+      threads.push_back(std::thread([&l, &finished, per_thread]()
+      {
+        for (size_t i = 0; i != per_thread; i++)
+          l.do_log_message("m\n", LOG_LEVEL_0, epee::log_space::console_color_default);
+        ++finished;
+      }));
+    //producers are caught in every phase of switching
+    while (finished != threads_count)
+    {
+      ASSERT_TRUE(l.set_async_mode(true, 64));
+      ASSERT_TRUE(l.set_async_mode(false));
+    }
+    for (auto& th : threads)
+      th.join();
+    ASSERT_EQ(0, l.get_dropped_messages_count());
+  }
+  std::lock_guard<std::mutex> lk(lock);
+  ASSERT_EQ(threads_count * per_thread, static_cast<size_t>(std::count(out.begin(), out.end(), '\n')));
+}
+
+TEST(epee_async_log, queue_size_changes_on_reenable)
+{
+  std::string out;
+  std::mutex lock;
+  size_t calls = 0;
+  epee::log_space::logger l;
+  l.add_logger(new capture_stream(out, lock, calls));
+  ASSERT_EQ(0, l.get_async_queue_size());
+  ASSERT_TRUE(l.set_async_mode(true, 16));
+  ASSERT_EQ(16, l.get_async_queue_size());
+  //running queue is not resized
+  ASSERT_TRUE(l.set_async_mode(true, 16));
+  ASSERT_TRUE(l.set_async_mode(true));
+  ASSERT_FALSE(l.set_async_mode(true, 1024));
+  ASSERT_EQ(16, l.get_async_queue_size());
+  for (size_t i = 0; i != 10; i++)
+    l.do_log_message("a\n", LOG_LEVEL_0, epee::log_space::console_color_default);
+  ASSERT_TRUE(l.flush());
+
+  ASSERT_TRUE(l.set_async_mode(false));
+  ASSERT_TRUE(l.set_async_mode(true, 1000));
+  ASSERT_EQ(1024, l.get_async_queue_size());
+  //flush waits for messages of the new queue, not the old one's count
+  for (size_t i = 0; i != 5; i++)
+    l.do_log_message("b\n", LOG_LEVEL_0, epee::log_space::console_color_default);
+  ASSERT_TRUE(l.flush());
+  {
+    std::lock_guard<std::mutex> lk(lock);
+    ASSERT_EQ(5, static_cast<size_t>(std::count(out.begin(), out.end(), 'b')));
+  }
+
+  //size is kept when not given
+  ASSERT_TRUE(l.set_async_mode(false));
+  ASSERT_TRUE(l.set_async_mode(true));
+  ASSERT_EQ(1024, l.get_async_queue_size());
+  ASSERT_TRUE(l.set_async_mode(false));
+  std::lock_guard<std::mutex> lk(lock);
+  ASSERT_EQ(10, static_cast<size_t>(std::count(out.begin(), out.end(), 'a')));
+}
@@ -0,0 +1,27 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "bounded_work_queue.h"
+
+TEST(bounded_work_queue, worker_survives_throwing_jobs)
+{
+  epee::bounded_work_queue q;
+  ASSERT_TRUE(q.start(1, 10));
+  std::atomic<int> done(0);
+  ASSERT_TRUE(q.try_post([](){ throw std::runtime_error("job failed"); }));
+  ASSERT_TRUE(q.try_post([](){ throw 1; }));
+  ASSERT_TRUE(q.try_post([&done](){ ++done; }));
+  for (size_t i = 0; i != 500 && q.get_jobs_count(); i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  ASSERT_EQ(0, q.get_jobs_count());
+  ASSERT_EQ(1, done);
+  q.stop();
+}
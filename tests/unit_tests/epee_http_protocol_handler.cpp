@@ -0,0 +1,289 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "net/http_protocol_handler.h"
+#include "net/net_utils_base.h"
+#ifdef HTTP_ENABLE_GZIP
+#include "gzip_encoding.h"
+#endif
+
+namespace
+{
+  typedef epee::net_utils::connection_context_base test_http_connection_context;
+  typedef epee::net_utils::http::http_custom_handler<test_http_connection_context> test_http_protocol_handler;
+
+  struct test_http_request_handler : public epee::net_utils::http::i_http_server_handler<test_http_connection_context>
+  {
+    virtual bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, test_http_connection_context& context)
+    {
+      m_requests.push_back(query_info);
+      response.m_body = query_info.m_URI;
+      if(query_info.m_URI == "/big")
+        response.m_body.append(200000, 'a');
+      return true;
+    }
+
+    std::vector<epee::net_utils::http::http_request_info> m_requests;
+  };
+
+  class test_http_connection : public epee::net_utils::i_service_endpoint
+  {
+  public:
+    test_http_connection()
+      : m_protocol_handler(this, m_config, m_context)
+    {
+      m_config.m_phandler = &m_request_handler;
+    }
+
+    // feeds data split into pieces of given size, returns false as soon as handler wants connection to be closed
+    bool recv(const std::string& data, size_t piece_size = std::string::npos)
+    {
+      for (size_t offset = 0; offset < data.size(); offset += piece_size)
+      {
+        size_t cb = std::min(piece_size, data.size() - offset);
+        if (!m_protocol_handler.handle_recv(data.data() + offset, cb))
+          return false;
+      }
+      return true;
+    }
+
+    size_t responses_count() const
+    {
+      size_t count = 0;
+      for (size_t pos = m_sent.find("HTTP/1.1 "); pos != std::string::npos; pos = m_sent.find("HTTP/1.1 ", pos + 1))
+        ++count;
+      return count;
+    }
+
+    // Implement epee::net_utils::i_service_endpoint interface
+    virtual bool do_send(const void* ptr, size_t cb) { m_sent.append(static_cast<const char*>(ptr), cb); return true; }
+    virtual bool close() { return true; }
+    virtual bool call_run_once_service_io() { return true; }
+    virtual bool request_callback() { return true; }
+    virtual boost::asio::io_service& get_io_service() { return m_io_service; }
+    virtual bool add_ref() { return true; }
+    virtual bool release() { return true; }
+
+    test_http_request_handler m_request_handler;
+    std::string m_sent;
+
+  private:
+    boost::asio::io_service m_io_service;
+    test_http_protocol_handler::config_type m_config;
+    test_http_connection_context m_context;
+    test_http_protocol_handler m_protocol_handler;
+  };
+
+  const std::string post_request =
+    "POST /json_rpc?a=1&b=2#frag HTTP/1.1\r\n"
+    "Host: localhost\r\n"
+    "content-type:application/json\r\n"
+    "X-Custom:  value \r\n"
+    "Content-Length: 11\r\n"
+    "\r\n"
+    "{\"id\":\"0\"}\n";
+}
+
+TEST(http_protocol_handler, parses_request_line_headers_and_body)
+{
+  test_http_connection conn;
+  ASSERT_TRUE(conn.recv(post_request));
+  ASSERT_EQ(1, conn.m_request_handler.m_requests.size());
+
+  const epee::net_utils::http::http_request_info& req = conn.m_request_handler.m_requests[0];
+  ASSERT_EQ(epee::net_utils::http::http_method_post, req.m_http_method);
+  ASSERT_EQ("POST", req.m_http_method_str);
+  ASSERT_EQ(1, req.m_http_ver_hi);
+  ASSERT_EQ(1, req.m_http_ver_lo);
+  ASSERT_EQ("/json_rpc?a=1&b=2#frag", req.m_URI);
+  ASSERT_EQ("/json_rpc", req.m_uri_content.m_path);
+  ASSERT_EQ("a=1&b=2", req.m_uri_content.m_query);
+  ASSERT_EQ("frag", req.m_uri_content.m_fragment);
+  ASSERT_EQ(2, req.m_uri_content.m_query_params.size());
+  ASSERT_EQ("localhost", req.m_header_info.m_host);
+  ASSERT_EQ("application/json", req.m_header_info.m_content_type);
+  ASSERT_EQ(1, req.m_header_info.m_etc_fields.size());
+  ASSERT_EQ("X-Custom", req.m_header_info.m_etc_fields.front().first);
+  ASSERT_EQ("value", req.m_header_info.m_etc_fields.front().second);
+  ASSERT_EQ("{\"id\":\"0\"}\n", req.m_body);
+  ASSERT_EQ(1, conn.responses_count());
+}
+
+TEST(http_protocol_handler, handles_request_split_into_single_bytes)
+{
+  test_http_connection conn;
+  ASSERT_TRUE(conn.recv(post_request + post_request, 1));
+  ASSERT_EQ(2, conn.m_request_handler.m_requests.size());
+  ASSERT_EQ("{\"id\":\"0\"}\n", conn.m_request_handler.m_requests[1].m_body);
+  ASSERT_EQ(2, conn.responses_count());
+}
+
+TEST(http_protocol_handler, handles_pipelined_requests_in_one_packet)
+{
+  test_http_connection conn;
+  ASSERT_TRUE(conn.recv("GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n" + post_request + "GET /c HTTP/1.1\r\n\r\n"));
+  ASSERT_EQ(4, conn.m_request_handler.m_requests.size());
+  ASSERT_EQ("/a", conn.m_request_handler.m_requests[0].m_URI);
+  ASSERT_EQ("/b", conn.m_request_handler.m_requests[1].m_URI);
+  ASSERT_EQ("/c", conn.m_request_handler.m_requests[3].m_URI);
+  ASSERT_EQ(4, conn.responses_count());
+  ASSERT_LT(conn.m_sent.find("\r\n\r\n/a"), conn.m_sent.find("\r\n\r\n/b"));
+}
+
+TEST(http_protocol_handler, handles_chunked_body)
+{
+  const std::string request =
+    "POST /json_rpc HTTP/1.1\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n"
+    "5;ext=1\r\nhello\r\n"
+    "B\r\n, chunked!!\r\n"
+    "0\r\n"
+    "X-Trailer: 1\r\n"
+    "\r\n";
+
+  for (size_t piece_size : {size_t(1), size_t(3), size_t(7), request.size()})
+  {
+    test_http_connection conn;
+    ASSERT_TRUE(conn.recv(request + "GET /next HTTP/1.1\r\n\r\n", piece_size));
+    ASSERT_EQ(2, conn.m_request_handler.m_requests.size());
+    ASSERT_EQ("hello, chunked!!", conn.m_request_handler.m_requests[0].m_body);
+    ASSERT_EQ("/next", conn.m_request_handler.m_requests[1].m_URI);
+  }
+}
+
+TEST(http_protocol_handler, closes_connection_when_requested)
+{
+  test_http_connection conn;
+  ASSERT_FALSE(conn.recv("GET /a HTTP/1.1\r\nConnection: close\r\n\r\nGET /b HTTP/1.1\r\n\r\n"));
+  ASSERT_EQ(1, conn.m_request_handler.m_requests.size());
+  ASSERT_NE(std::string::npos, conn.m_sent.find("Connection: close\r\n"));
+
+  test_http_connection conn_1_0;
+  ASSERT_FALSE(conn_1_0.recv("GET /a HTTP/1.0\r\n\r\n"));
+
+  test_http_connection conn_1_0_keep_alive;
+  ASSERT_TRUE(conn_1_0_keep_alive.recv("GET /a HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\nGET /b HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"));
+  ASSERT_EQ(2, conn_1_0_keep_alive.m_request_handler.m_requests.size());
+  ASSERT_NE(std::string::npos, conn_1_0_keep_alive.m_sent.find("Connection: keep-alive\r\n"));
+}
+
+TEST(http_protocol_handler, rejects_malformed_requests)
+{
+  test_http_connection bad_line;
+  ASSERT_FALSE(bad_line.recv("GET /a\r\n\r\n"));
+  test_http_connection bad_method;
+  ASSERT_FALSE(bad_method.recv("FOO /a HTTP/1.1\r\n\r\n"));
+  test_http_connection bad_header;
+  ASSERT_FALSE(bad_header.recv("GET /a HTTP/1.1\r\nno colon here\r\n\r\n"));
+  test_http_connection bad_length;
+  ASSERT_FALSE(bad_length.recv("POST /a HTTP/1.1\r\nContent-Length: 1x\r\n\r\n"));
+  test_http_connection bad_chunk;
+  ASSERT_FALSE(bad_chunk.recv("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"));
+  test_http_connection long_uri;
+  ASSERT_FALSE(long_uri.recv("GET /" + std::string(HTTP_MAX_URI_LEN, 'a')));
+
+  ASSERT_TRUE(bad_line.m_request_handler.m_requests.empty());
+  ASSERT_TRUE(long_uri.m_request_handler.m_requests.empty());
+}
+
+TEST(http_protocol_handler, rejects_too_big_body)
+{
+  std::stringstream hex_max;
+  hex_max << std::hex << HTTP_MAX_BODY_LEN;
+  std::stringstream hex_rest;
+  hex_rest << std::hex << HTTP_MAX_BODY_LEN - 4;
+
+  test_http_connection big_length;
+  ASSERT_FALSE(big_length.recv("POST /a HTTP/1.1\r\nContent-Length: " + std::to_string(HTTP_MAX_BODY_LEN + 1) + "\r\n\r\n"));
+  test_http_connection big_chunk;
+  ASSERT_FALSE(big_chunk.recv("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n" + hex_max.str() + "1\r\n"));
+  //chunks are small enough one by one, their total is not
+  test_http_connection big_total;
+  ASSERT_FALSE(big_total.recv("POST /a HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n" + hex_rest.str() + "\r\n"));
+
+  ASSERT_TRUE(big_length.m_request_handler.m_requests.empty());
+  ASSERT_TRUE(big_chunk.m_request_handler.m_requests.empty());
+  ASSERT_TRUE(big_total.m_request_handler.m_requests.empty());
+
+  //body of exactly max size is still accepted
+  test_http_connection max_length;
+  ASSERT_TRUE(max_length.recv("POST /a HTTP/1.1\r\nContent-Length: " + std::to_string(HTTP_MAX_BODY_LEN) + "\r\n\r\n"));
+}
+
+TEST(http_protocol_handler, parses_accept_encoding)
+{
+  using epee::net_utils::http::is_gzip_accepted;
+  ASSERT_TRUE(is_gzip_accepted("gzip"));
+  ASSERT_TRUE(is_gzip_accepted("deflate, GZIP;q=0.5"));
+  ASSERT_TRUE(is_gzip_accepted("br, *"));
+  ASSERT_TRUE(is_gzip_accepted("gzip; q=1.0"));
+  ASSERT_FALSE(is_gzip_accepted(""));
+  ASSERT_FALSE(is_gzip_accepted("deflate, br"));
+  ASSERT_FALSE(is_gzip_accepted("x-gzip2"));
+  ASSERT_FALSE(is_gzip_accepted("gzip;q=0"));
+  ASSERT_FALSE(is_gzip_accepted("*;q=1, gzip;q=0"));
+  ASSERT_FALSE(is_gzip_accepted("gzip;q=0.000, *"));
+  ASSERT_FALSE(is_gzip_accepted("*;q=0"));
+  ASSERT_TRUE(is_gzip_accepted("*;q=0, gzip"));
+  ASSERT_TRUE(is_gzip_accepted("gzip;level=1;q=0.1"));
+  ASSERT_FALSE(is_gzip_accepted("gzip;level=1; Q=0"));
+  ASSERT_FALSE(is_gzip_accepted("gzip; q=0.000, deflate"));
+}
+
+#ifdef HTTP_ENABLE_GZIP
+namespace
+{
+  struct test_gzip_target : public epee::net_utils::i_target_handler
+  {
+    virtual bool handle_target_data(std::string& piece_of_transfer)
+    {
+      m_body += piece_of_transfer;
+      piece_of_transfer.clear();
+      return true;
+    }
+    std::string m_body;
+  };
+}
+
+TEST(http_protocol_handler, gzips_large_responses_for_accepting_clients)
+{
+  test_http_connection plain;
+  ASSERT_TRUE(plain.recv("GET /big HTTP/1.1\r\n\r\n"));
+  ASSERT_EQ(std::string::npos, plain.m_sent.find("Content-Encoding"));
+  //same uri is gzipped for other clients
+  ASSERT_NE(std::string::npos, plain.m_sent.find("\r\nVary: Accept-Encoding\r\n"));
+
+  test_http_connection small;
+  ASSERT_TRUE(small.recv("GET /small HTTP/1.1\r\nAccept-Encoding: gzip\r\n\r\n"));
+  ASSERT_EQ(std::string::npos, small.m_sent.find("Content-Encoding"));
+  ASSERT_EQ(std::string::npos, small.m_sent.find("Vary"));
+
+  test_http_connection conn;
+  ASSERT_TRUE(conn.recv("GET /big HTTP/1.1\r\nAccept-Encoding: deflate, gzip\r\n\r\n"));
+  ASSERT_NE(std::string::npos, conn.m_sent.find("Content-Encoding: gzip\r\n"));
+  ASSERT_NE(std::string::npos, conn.m_sent.find("\r\nVary: Accept-Encoding\r\n"));
+  size_t body_pos = conn.m_sent.find("\r\n\r\n");
+  ASSERT_NE(std::string::npos, body_pos);
+  std::string packed = conn.m_sent.substr(body_pos + 4);
+  ASSERT_LT(packed.size(), 2000);
+
+  //decoded by the same handler as used in http_simple_client, fed in pieces
+  test_gzip_target target;
+  epee::net_utils::content_encoding_gzip decoder(&target);
+  for(size_t offset = 0; offset < packed.size(); offset += 100)
+  {
+    std::string piece = packed.substr(offset, 100);
+    ASSERT_TRUE(decoder.update_in(piece));
+  }
+  ASSERT_EQ("/big" + std::string(200000, 'a'), target.m_body);
+}
+#endif
@@ -0,0 +1,127 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "net/http_server_handlers_map2.h"
+#include "net/net_utils_base.h"
+
+namespace
+{
+  struct COMMAND_ECHO
+  {
+    struct request
+    {
+      std::string text;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(text)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string text;
+      bool under_guard;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(text)
+        KV_SERIALIZE(under_guard)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  class test_json_rpc_handler
+  {
+  public:
+    typedef epee::net_utils::connection_context_base connection_context;
+
+    test_json_rpc_handler() : m_guard_count(0), m_under_guard(false)
+    {}
+
+    std::string call(const std::string& body)
+    {
+      epee::net_utils::http::http_request_info query_info;
+      epee::net_utils::http::http_response_info response_info;
+      connection_context context;
+      query_info.m_URI = "/json_rpc";
+      query_info.m_body = body;
+      EXPECT_TRUE(handle_http_request_map(query_info, response_info, context));
+      return response_info.m_body;
+    }
+
+    bool on_echo(const COMMAND_ECHO::request& req, COMMAND_ECHO::response& res, connection_context& cntx)
+    {
+      res.text = req.text;
+      res.under_guard = m_under_guard;
+      return true;
+    }
+
+    bool on_fail(const COMMAND_ECHO::request& req, COMMAND_ECHO::response& res, epee::json_rpc::error& er, connection_context& cntx)
+    {
+      er.code = -1;
+      er.message = "failed: " + req.text;
+      return false;
+    }
+
+    epee::misc_utils::auto_scope_leave_caller batch_guard(const std::vector<std::string>& methods)
+    {
+      ++m_guard_count;
+      m_under_guard = true;
+      return epee::misc_utils::create_scope_leave_handler([this](){ m_under_guard = false; });
+    }
+
+    BEGIN_URI_MAP2()
+      BEGIN_JSON_RPC_MAP_BATCH("/json_rpc", 3, batch_guard)
+        MAP_JON_RPC("echo",    on_echo, COMMAND_ECHO)
+        MAP_JON_RPC_WE("fail", on_fail, COMMAND_ECHO)
+      END_JSON_RPC_MAP()
+    END_URI_MAP2()
+
+    size_t m_guard_count;
+    bool m_under_guard;
+  };
+}
+
+TEST(json_rpc_map, single_call_is_answered_with_object)
+{
+  test_json_rpc_handler h;
+  ASSERT_EQ("{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"text\":\"a\",\"under_guard\":false}}",
+    h.call("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"echo\",\"params\":{\"text\":\"a\"}}"));
+  ASSERT_EQ(0, h.m_guard_count);
+  ASSERT_NE(std::string::npos, h.call("{\"id\":2,\"method\":\"nope\"}").find("-32601"));
+  ASSERT_NE(std::string::npos, h.call("{\"id\":2,\"method\":\"echo\"").find("-32700"));
+}
+
+TEST(json_rpc_map, batch_calls_are_answered_in_order_with_per_call_errors)
+{
+  test_json_rpc_handler h;
+  const std::string rsp = h.call("["
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"echo\",\"params\":{\"text\":\"a\"}},"
+    "{\"jsonrpc\":\"2.0\",\"id\":\"x\",\"method\":\"fail\",\"params\":{\"text\":\"b\"}},"
+    "5"
+    "]");
+  ASSERT_EQ("["
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"text\":\"a\",\"under_guard\":true}},"
+    "{\"jsonrpc\":\"2.0\",\"id\":\"x\",\"error\":{\"code\":-1,\"message\":\"failed: b\"}},"
+    "{\"jsonrpc\":\"2.0\",\"id\":\"\",\"error\":{\"code\":-32600,\"message\":\"Invalid Request\"}}"
+    "]", rsp);
+  ASSERT_EQ(1, h.m_guard_count);
+  ASSERT_FALSE(h.m_under_guard);
+}
+
+TEST(json_rpc_map, empty_and_oversized_batches_are_rejected)
+{
+  test_json_rpc_handler h;
+  const std::string call = "{\"id\":1,\"method\":\"echo\",\"params\":{\"text\":\"a\"}}";
+  ASSERT_NE(std::string::npos, h.call("[]").find("-32600"));
+  ASSERT_EQ('{', h.call("[" + call + "," + call + "," + call + "," + call + "]")[0]);
+  ASSERT_EQ(0, h.m_guard_count);
+  ASSERT_EQ('[', h.call("[" + call + "," + call + "," + call + "]")[0]);
+  ASSERT_EQ(1, h.m_guard_count);
+}
@@ -0,0 +1,226 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
+#include "storages/json_stream.h"
+#include "net/http_server_handlers_map2.h"
+
+namespace
+{
+  struct test_pod
+  {
+    uint64_t a;
+    uint32_t b;
+  };
+
+  struct test_item
+  {
+    std::string name;
+    uint64_t amount;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(amount)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct test_nested
+  {
+    int32_t value;
+    std::list<std::string> tags;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(value)
+      KV_SERIALIZE(tags)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct test_struct
+  {
+    uint64_t u64;
+    int64_t i64;
+    uint8_t u8;
+    int8_t i8;
+    double d;
+    bool flag;
+    std::string text;
+    test_pod pod;
+    std::vector<uint64_t> numbers;
+    std::vector<test_item> items;
+    std::vector<test_item> empty_items;
+    test_nested nested;
+    epee::serialization::storage_entry meta;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(u64)
+      KV_SERIALIZE(i64)
+      KV_SERIALIZE(u8)
+      KV_SERIALIZE(i8)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(text)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(pod)
+      KV_SERIALIZE(numbers)
+      KV_SERIALIZE(items)
+      KV_SERIALIZE(empty_items)
+      KV_SERIALIZE(nested)
+      KV_SERIALIZE(meta)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  test_struct make_test_struct()
+  {
+    test_struct s = AUTO_VAL_INIT(s);
+    s.u64 = 18446744073709551615ULL;
+    s.i64 = -9223372036854775807LL - 1;
+    s.u8 = 255;
+    s.i8 = -128;
+    s.d = 0.25;
+    s.flag = true;
+    s.text = "quote\" backslash\\ slash/ \r\n\t\b\f\v end";
+    s.pod.a = 0x2f5c22;    // bytes of '"', '\\' and '/' inside the blob
+    s.pod.b = 0x0a0d;
+    s.numbers.push_back(0);
+    s.numbers.push_back(1);
+    s.numbers.push_back(12345678901234ULL);
+    test_item item = AUTO_VAL_INIT(item);
+    item.name = "first";
+    item.amount = 1;
+    s.items.push_back(item);
+    item.name = "second";
+    item.amount = 2;
+    s.items.push_back(item);
+    s.nested.value = -7;
+    s.nested.tags.push_back("a");
+    s.nested.tags.push_back("b");
+    s.meta = epee::serialization::storage_entry(true);
+    return s;
+  }
+
+  void check_equal(const test_struct& expected, const test_struct& actual)
+  {
+    ASSERT_EQ(expected.u64, actual.u64);
+    ASSERT_EQ(expected.i64, actual.i64);
+    ASSERT_EQ(expected.u8, actual.u8);
+    ASSERT_EQ(expected.i8, actual.i8);
+    ASSERT_EQ(expected.d, actual.d);
+    ASSERT_EQ(expected.flag, actual.flag);
+    ASSERT_EQ(expected.text, actual.text);
+    ASSERT_EQ(expected.pod.a, actual.pod.a);
+    ASSERT_EQ(expected.pod.b, actual.pod.b);
+    ASSERT_EQ(expected.numbers, actual.numbers);
+    ASSERT_EQ(expected.items.size(), actual.items.size());
+    for (size_t i = 0; i != expected.items.size(); i++)
+    {
+      ASSERT_EQ(expected.items[i].name, actual.items[i].name);
+      ASSERT_EQ(expected.items[i].amount, actual.items[i].amount);
+    }
+    ASSERT_TRUE(actual.empty_items.empty());
+    ASSERT_EQ(expected.nested.value, actual.nested.value);
+    ASSERT_EQ(expected.nested.tags, actual.nested.tags);
+    ASSERT_EQ(typeid(bool), actual.meta.type());
+  }
+}
+
+TEST(json_stream, stream_writer_output_is_loaded_by_both_readers)
+{
+  test_struct s = make_test_struct();
+  std::string json;
+  ASSERT_TRUE(epee::serialization::store_t_to_json_stream(s, json));
+
+  test_struct loaded_stream;
+  ASSERT_TRUE(epee::serialization::load_t_from_json_stream(loaded_stream, json));
+  check_equal(s, loaded_stream);
+
+  test_struct loaded_ps;
+  ASSERT_TRUE(epee::serialization::load_t_from_json(loaded_ps, json));
+  check_equal(s, loaded_ps);
+}
+
+TEST(json_stream, portable_storage_output_is_loaded_by_stream_reader)
+{
+  test_struct s = make_test_struct();
+  std::string json;
+  ASSERT_TRUE(epee::serialization::store_t_to_json(s, json));
+
+  test_struct loaded;
+  ASSERT_TRUE(epee::serialization::load_t_from_json_stream(loaded, json));
+  check_equal(s, loaded);
+}
+
+TEST(json_stream, reader_handles_any_key_order_nulls_and_unknown_fields)
+{
+  const std::string json =
+    "{ \"items\" : [ {\"amount\": 5, \"name\": \"x\"} ], \"unknown\": {\"deep\": [[1, 2], {}]},"
+    "  \"text\": null, \"u8\": 7, \"nested\": {\"tags\": [], \"value\": -1}, \"meta\": {\"k\": [1, 2]} }";
+  test_struct s = AUTO_VAL_INIT(s);
+  s.text = "untouched";
+  ASSERT_TRUE(epee::serialization::load_t_from_json_stream(s, json));
+  ASSERT_EQ(7, s.u8);
+  ASSERT_EQ("untouched", s.text);
+  ASSERT_EQ(1, s.items.size());
+  ASSERT_EQ("x", s.items[0].name);
+  ASSERT_EQ(5, s.items[0].amount);
+  ASSERT_EQ(-1, s.nested.value);
+  ASSERT_TRUE(s.nested.tags.empty());
+  ASSERT_EQ(typeid(epee::serialization::section), s.meta.type());
+}
+
+TEST(json_stream, reader_rejects_wrong_types_and_ranges)
+{
+  test_struct s = AUTO_VAL_INIT(s);
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u8\": 256}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u64\": -1}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u64\": 18446744073709551616}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u64\": \"1\"}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u64\": 1.5}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"flag\": 1}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"text\": 1}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"text\": \"unterminated}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"a\" 1}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"a\": 1,}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"a\": tru}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, std::string(200, '[') + std::string(200, ']')));
+}
+
+TEST(json_stream, reader_rejects_trailing_data)
+{
+  test_struct s = AUTO_VAL_INIT(s);
+  ASSERT_TRUE(epee::serialization::load_t_from_json_stream(s, " {\"u8\": 1} \r\n\t"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u8\": 1} garbage"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "{\"u8\": 1}{}"));
+  ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, "[] 1"));
+}
+
+TEST(json_stream, integer_fields_take_only_integer_numbers)
+{
+  //same narrowing as portable storage, which keeps such numbers as double
+  for (const char* json : {"{\"u64\": 1.0}", "{\"u64\": 1.5e3}", "{\"i64\": -2.0}"})
+  {
+    test_struct s = AUTO_VAL_INIT(s);
+    ASSERT_FALSE(epee::serialization::load_t_from_json_stream(s, json)) << json;
+    test_struct ps = AUTO_VAL_INIT(ps);
+    ASSERT_FALSE(epee::serialization::load_t_from_json(ps, json)) << json;
+  }
+  test_struct s = AUTO_VAL_INIT(s);
+  ASSERT_TRUE(epee::serialization::load_t_from_json_stream(s, "{\"d\": 1.5e3, \"u64\": 10}"));
+  ASSERT_EQ(1500.0, s.d);
+  ASSERT_EQ(10, s.u64);
+}
+
+TEST(json_stream, method_hash_is_same_at_compile_and_run_time)
+{
+  static_assert(epee::json_rpc::method_hash("getblocktemplate") != epee::json_rpc::method_hash("getblockcount"), "method hash collision");
+  const uint64_t compile_time_hash = epee::json_rpc::method_hash("getblockheaderbyheight");
+  ASSERT_EQ(compile_time_hash, epee::json_rpc::method_hash(std::string("getblockheaderbyheight")));
+  ASSERT_EQ(epee::json_rpc::method_hash(""), epee::json_rpc::method_hash(std::string()));
+}
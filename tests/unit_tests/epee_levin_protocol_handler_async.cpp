@@ -488,6 +488,70 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_chunke
   ASSERT_EQ(1, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_body_bigger_than_prealloc)
+{
+  m_in_data.clear();
+  for (size_t i = 0; i != 3 * LEVIN_MAX_BODY_PREALLOC + 7; ++i)
+    m_in_data.push_back(static_cast<char>(i % 251));
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  //body arrives in pieces, buffer grows past the preallocated part
+  const size_t piece_size = 10000;
+  for (size_t offset = 0; offset < m_buf.size(); offset += piece_size)
+  {
+    ASSERT_EQ(0, m_commands_handler.invoke_counter());
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + offset, std::min(piece_size, m_buf.size() - offset)));
+  }
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, big_body_takes_bounded_reallocations)
+{
+  m_in_data.clear();
+  for (size_t i = 0; i != 8 * 1024 * 1024; ++i)
+    m_in_data.push_back(static_cast<char>(i % 251));
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  const std::string& body_buf = m_conn->m_protocol_handler.m_cache_in_buffer;
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), sizeof(m_req_head)));
+  ASSERT_LE(body_buf.capacity(), LEVIN_MAX_BODY_PREALLOC);
+
+  //body comes in socket-read sized pieces, buffer is reallocated only when it doubles
+  const size_t piece_size = 65536;
+  size_t reallocations = 0;
+  size_t capacity = body_buf.capacity();
+  for (size_t offset = sizeof(m_req_head); offset < m_buf.size(); offset += piece_size)
+  {
+    ASSERT_EQ(0, m_commands_handler.invoke_counter());
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + offset, std::min(piece_size, m_buf.size() - offset)));
+    if (m_commands_handler.invoke_counter())
+      break;
+    if (body_buf.capacity() != capacity)
+    {
+      ++reallocations;
+      capacity = body_buf.capacity();
+    }
+    ASSERT_LE(body_buf.capacity(), 2 * body_buf.size() + LEVIN_MAX_BODY_PREALLOC);
+  }
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+  //64 KB -> 8 MB
+  ASSERT_LE(reallocations, 8);
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, forged_body_size_is_not_reserved)
+{
+  m_req_head.m_cb = max_packet_size;
+  prepare_buf();
+
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(0, m_commands_handler.invoke_counter());
+  ASSERT_LE(m_conn->m_protocol_handler.m_cache_in_buffer.capacity(), LEVIN_MAX_BODY_PREALLOC);
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_requests_at_once)
 {
   prepare_buf();
@@ -497,6 +561,22 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_re
   ASSERT_EQ(2, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_requests_split_at_any_point)
+{
+  prepare_buf();
+  m_buf.append(m_buf);
+
+  size_t expected_invoke_count = 0;
+  for (size_t split = 1; split < m_buf.size(); ++split)
+  {
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), split));
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + split, m_buf.size() - split));
+    expected_invoke_count += 2;
+    ASSERT_EQ(expected_invoke_count, m_commands_handler.invoke_counter());
+    ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+  }
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpected_response)
 {
   m_req_head.m_flags = LEVIN_PACKET_RESPONSE;
@@ -0,0 +1,82 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "metrics_registry.h"
+
+namespace
+{
+  void observe_test_value(uint64_t v)
+  {
+    METRICS_HISTOGRAM_OBSERVE("ut_static_histogram_us", "", v);
+  }
+}
+
+TEST(metrics_registry, same_name_and_labels_give_same_metric)
+{
+  epee::metrics::registry& r = epee::metrics::registry::instance();
+  epee::metrics::counter& c1 = r.get_counter("ut_counter_total", "kind=\"a\"");
+  epee::metrics::counter& c2 = r.get_counter("ut_counter_total", "kind=\"a\"");
+  epee::metrics::counter& c3 = r.get_counter("ut_counter_total", "kind=\"b\"");
+  ASSERT_EQ(&c1, &c2);
+  ASSERT_NE(&c1, &c3);
+
+  c1.add(2);
+  c2.add(3);
+  ASSERT_EQ(5, c1.get());
+  ASSERT_EQ(0, c3.get());
+}
+
+TEST(metrics_registry, histogram_buckets)
+{
+  epee::metrics::histogram& h = epee::metrics::registry::instance().get_histogram("ut_histogram_us", "");
+  h.observe(0);
+  h.observe(10);
+  h.observe(11);
+  h.observe(20000000);
+
+  ASSERT_EQ(2, h.get_bucket(0));
+  ASSERT_EQ(1, h.get_bucket(1));
+  ASSERT_EQ(1, h.get_bucket(epee::metrics::histogram::buckets_count));
+  ASSERT_EQ(4, h.get_count());
+  ASSERT_EQ(20000021, h.get_sum());
+}
+
+TEST(metrics_registry, concurrent_updates)
+{
+  const size_t threads_count = 4;
+  const size_t observations_per_thread = 10000;
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i != threads_count; i++)
+    threads.push_back(std::thread([&]() {
+      for (size_t j = 0; j != observations_per_thread; j++)
+        observe_test_value(j);
+    }));
+  for (auto& t : threads)
+    t.join();
+
+  ASSERT_EQ(threads_count * observations_per_thread, epee::metrics::registry::instance().get_histogram("ut_static_histogram_us", "").get_count());
+}
+
+TEST(metrics_registry, render_text)
+{
+  epee::metrics::registry& r = epee::metrics::registry::instance();
+  r.get_gauge("ut_gauge", "").set(-7);
+  r.set_help("ut_gauge", "Test gauge");
+  r.get_histogram("ut_render_us", "method=\"getinfo\"").observe(100);
+
+  std::string text = r.render_text();
+  ASSERT_NE(std::string::npos, text.find("# HELP ut_gauge Test gauge\n# TYPE ut_gauge gauge\nut_gauge -7\n"));
+  ASSERT_NE(std::string::npos, text.find("# TYPE ut_render_us histogram\n"));
+  ASSERT_NE(std::string::npos, text.find("ut_render_us_bucket{method=\"getinfo\",le=\"50\"} 0\n"));
+  ASSERT_NE(std::string::npos, text.find("ut_render_us_bucket{method=\"getinfo\",le=\"100\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("ut_render_us_bucket{method=\"getinfo\",le=\"+Inf\"} 1\n"));
+  ASSERT_NE(std::string::npos, text.find("ut_render_us_sum{method=\"getinfo\"} 100\n"));
+  ASSERT_NE(std::string::npos, text.find("ut_render_us_count{method=\"getinfo\"} 1\n"));
+}
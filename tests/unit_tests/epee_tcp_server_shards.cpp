@@ -0,0 +1,105 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "net/abstract_tcp_server2.h"
+
+namespace
+{
+  const std::string test_server_host("127.0.0.1");
+  const char test_message[] = "ping";
+  const size_t test_connections_count = 200;
+
+  struct shards_test_config
+  {
+    shards_test_config(): connections_count(0), bytes_received(0)
+    {}
+    void on_send_stop_signal()
+    {}
+    std::atomic<size_t> connections_count;
+    std::atomic<size_t> bytes_received;
+  };
+
+  //outgoing connections send one message, incoming ones count what they get
+  struct shards_test_protocol_handler
+  {
+    typedef epee::net_utils::connection_context_base connection_context;
+    typedef shards_test_config config_type;
+
+    shards_test_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context):
+      m_psnd_hndlr(psnd_hndlr), m_config(config), m_context(conn_context)
+    {}
+
+    void after_init_connection()
+    {
+      if (m_context.m_is_income)
+        ++m_config.connections_count;
+      else
+        m_psnd_hndlr->do_send(test_message, sizeof(test_message));
+    }
+    void handle_qued_callback()
+    {}
+    bool release_protocol()
+    {
+      return true;
+    }
+    bool handle_recv(const void* /*data*/, size_t size)
+    {
+      m_config.bytes_received += size;
+      return true;
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+    config_type& m_config;
+    connection_context& m_context;
+  };
+
+  typedef epee::net_utils::boosted_tcp_server<shards_test_protocol_handler> shards_test_server;
+
+  bool wait_for(const std::function<bool()>& cond)
+  {
+    for (size_t i = 0; i != 1000 && !cond(); i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return cond();
+  }
+}
+
+TEST(boosted_tcp_server, sharded_server_handles_many_connections)
+{
+  shards_test_server srv;
+  ASSERT_TRUE(srv.set_io_shards_count(4));
+  ASSERT_EQ(4, srv.get_io_shards_count());
+  ASSERT_TRUE(srv.init_server(0, test_server_host));
+  ASSERT_FALSE(srv.set_io_shards_count(2));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  shards_test_server clt;
+  ASSERT_TRUE(clt.set_io_shards_count(2));
+  ASSERT_TRUE(clt.init_server(0, test_server_host));
+  ASSERT_TRUE(clt.run_server(2, false));
+
+  std::string port = std::to_string(srv.get_binded_port());
+  for (size_t i = 0; i != test_connections_count; i++)
+  {
+    epee::net_utils::connection_context_base cntx;
+    ASSERT_TRUE(clt.connect(test_server_host, port, 5000, cntx));
+  }
+
+  shards_test_config& cfg = srv.get_config_object();
+  EXPECT_TRUE(wait_for([&](){ return cfg.connections_count == test_connections_count; }));
+  EXPECT_TRUE(wait_for([&](){ return cfg.bytes_received == test_connections_count * sizeof(test_message); }));
+  EXPECT_EQ(test_connections_count, cfg.connections_count);
+  EXPECT_EQ(test_connections_count * sizeof(test_message), cfg.bytes_received);
+
+  clt.send_stop_signal();
+  ASSERT_TRUE(clt.timed_wait_server_stop(5000));
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5000));
+}
@@ -781,4 +781,72 @@ namespace lmdb_test
     db_array.commit_transaction();
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // enumerate_from_test
+  //////////////////////////////////////////////////////////////////////////////
+  TEST(lmdb, enumerate_from_test)
+  {
+    const std::string table_name("names");
+
+    std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+    db::db_bridge_base dbb(lmdb_ptr);
+    db::key_value_accessor_base<std::string, uint64_t, false> names(dbb);
+
+    ASSERT_TRUE(dbb.open("enumerate_from_test"));
+
+    // clear table
+    db::table_id tid;
+    ASSERT_TRUE(lmdb_ptr->open_table(table_name, tid));
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_TRUE(dbb.clear(tid));
+    dbb.commit_transaction();
+
+    ASSERT_TRUE(names.init(table_name));
+    ASSERT_TRUE(dbb.begin_transaction());
+    for (const char* n : {"bob", "alice", "bobby", "carol", "bo", "boris"})
+      names.set(n, strlen(n));
+    dbb.commit_transaction();
+
+    std::vector<std::string> keys;
+    auto collect = [&](uint64_t i, const std::string& k, const uint64_t& v)
+    {
+      if (i != keys.size() || v != k.size())
+        return false;
+      keys.push_back(k);
+      return true;
+    };
+
+    // empty start key - whole table, in key order, without active transaction
+    names.enumerate_items_from(std::string(), collect);
+    ASSERT_EQ(std::vector<std::string>({"alice", "bo", "bob", "bobby", "boris", "carol"}), keys);
+
+    // starts from the first key not less than the given one
+    keys.clear();
+    names.enumerate_items_from(std::string("boa"), collect);
+    ASSERT_EQ(std::vector<std::string>({"bob", "bobby", "boris", "carol"}), keys);
+
+    // stops as soon as callback returns false
+    keys.clear();
+    names.enumerate_items_from(std::string("bob"), [&](uint64_t i, const std::string& k, const uint64_t& v)
+    {
+      if (k.compare(0, 3, "bob") != 0)
+        return false;
+      keys.push_back(k);
+      return true;
+    });
+    ASSERT_EQ(std::vector<std::string>({"bob", "bobby"}), keys);
+
+    keys.clear();
+    names.enumerate_items_from(std::string("zzz"), collect);
+    ASSERT_TRUE(keys.empty());
+
+    // inside of caller's read-only transaction
+    ASSERT_TRUE(dbb.begin_transaction(true));
+    names.enumerate_items_from(std::string("c"), collect);
+    dbb.commit_transaction();
+    ASSERT_EQ(std::vector<std::string>({"carol"}), keys);
+
+    ASSERT_TRUE(dbb.close());
+  }
+
 }
@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+#include "gtest/gtest.h"
+
+#include "misc_language.h"
+#include "currency_core/mapped_scratchpad.h"
+
+namespace
+{
+  crypto::hash make_hash(size_t i)
+  {
+    crypto::hash h = AUTO_VAL_INIT(h);
+    *reinterpret_cast<uint64_t*>(&h) = i + 1;
+    return h;
+  }
+
+  class mapped_scratchpad_test : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("scratchpad-%%%%-%%%%.map")).string();
+    }
+    virtual void TearDown()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove(m_path, ec);
+    }
+
+    std::string m_path;
+  };
+}
+
+TEST_F(mapped_scratchpad_test, grows_and_survives_reopen_when_clean)
+{
+  const size_t count = MAPPED_SCRATCHPAD_GROW_STEP / sizeof(crypto::hash) + 10;
+  {
+    currency::mapped_scratchpad scr;
+    ASSERT_TRUE(scr.open(m_path, false, false));
+    ASSERT_EQ(0, scr.size());
+    ASSERT_FALSE(scr.is_clean());
+    for (size_t i = 0; i != count; i++)
+      ASSERT_TRUE(scr.push_back(make_hash(i)));
+    ASSERT_EQ(count, scr.size());
+    ASSERT_LE(count, scr.capacity());
+    ASSERT_EQ(0, boost::filesystem::file_size(m_path) % MAPPED_SCRATCHPAD_GROW_STEP);
+    ASSERT_TRUE(scr.set_clean(true));
+  }
+
+  currency::mapped_scratchpad scr;
+  ASSERT_TRUE(scr.open(m_path, false, false));
+  ASSERT_TRUE(scr.is_clean());
+  ASSERT_EQ(count, scr.size());
+  for (size_t i = 0; i != count; i++)
+    ASSERT_EQ(make_hash(i), scr[i]);
+
+  ASSERT_TRUE(scr.resize(5));
+  ASSERT_EQ(5, scr.size());
+  scr.clear();
+  ASSERT_EQ(0, scr.size());
+}
+
+TEST_F(mapped_scratchpad_test, reader_follows_writer)
+{
+  currency::mapped_scratchpad writer;
+  ASSERT_TRUE(writer.open(m_path, false, false));
+  ASSERT_TRUE(writer.push_back(make_hash(0)));
+
+  currency::mapped_scratchpad reader;
+  ASSERT_TRUE(reader.open(m_path, true, false));
+  ASSERT_EQ(1, reader.size());
+  ASSERT_EQ(make_hash(0), reader[0]);
+  uint64_t seq = reader.get_update_seq();
+
+  writer.begin_update();
+  writer.set(0, make_hash(7));
+  ASSERT_NE(seq, reader.get_update_seq());
+  const size_t count = MAPPED_SCRATCHPAD_GROW_STEP / sizeof(crypto::hash) + 10;
+  for (size_t i = 1; i != count; i++)
+    ASSERT_TRUE(writer.push_back(make_hash(i)));
+  writer.end_update();
+  ASSERT_EQ(0, writer.get_update_seq() % 2);
+
+  //reader still sees old size until refresh
+  ASSERT_EQ(1, reader.size());
+  ASSERT_TRUE(reader.refresh());
+  ASSERT_EQ(count, reader.size());
+  ASSERT_EQ(make_hash(7), reader[0]);
+  ASSERT_EQ(make_hash(count - 1), reader[count - 1]);
+  ASSERT_EQ(writer.get_update_seq(), reader.get_update_seq());
+}
+
+TEST_F(mapped_scratchpad_test, reader_rejects_alien_file)
+{
+  {
+    std::ofstream f(m_path, std::ios_base::binary);
+    f << std::string(MAPPED_SCRATCHPAD_HEADER_SIZE * 2, 'x');
+  }
+  currency::mapped_scratchpad reader;
+  ASSERT_FALSE(reader.open(m_path, true, false));
+  ASSERT_FALSE(reader.is_open());
+
+  currency::mapped_scratchpad writer;
+  ASSERT_TRUE(writer.open(m_path, false, false));
+  ASSERT_EQ(0, writer.size());
+  ASSERT_FALSE(writer.is_clean());
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "currency_core/currency_format_utils.h"
+#include "currency_core/output_scanner.h"
+
+namespace
+{
+  //outputs go to accounts in turn, output i gets amount i + 1
+  currency::transaction make_tx_to_accounts(const std::vector<currency::account_base>& accs, size_t outs_count)
+  {
+    currency::transaction tx = AUTO_VAL_INIT(tx);
+    currency::keypair txkey = currency::keypair::generate();
+    currency::add_tx_pub_key_to_extra(tx, txkey.pub);
+    for (size_t i = 0; i != outs_count; i++)
+    {
+      const currency::account_public_address& addr = accs[i % accs.size()].get_keys().m_account_address;
+      crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+      crypto::generate_key_derivation(addr.m_view_public_key, txkey.sec, derivation);
+      currency::txout_to_key tk = AUTO_VAL_INIT(tk);
+      crypto::derive_public_key(derivation, i, addr.m_spend_public_key, tk.key);
+      currency::tx_out out = AUTO_VAL_INIT(out);
+      out.amount = i + 1;
+      out.target = tk;
+      tx.vout.push_back(out);
+    }
+    return tx;
+  }
+}
+
+TEST(output_scanner, derive_public_keys_matches_single_derivation)
+{
+  currency::account_base acc;
+  acc.generate();
+  currency::keypair txkey = currency::keypair::generate();
+  crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+  ASSERT_TRUE(crypto::generate_key_derivation(acc.get_keys().m_account_address.m_view_public_key, txkey.sec, derivation));
+
+  std::vector<crypto::public_key> keys(10);
+  ASSERT_TRUE(crypto::derive_public_keys(derivation, 3, acc.get_keys().m_account_address.m_spend_public_key, &keys[0], keys.size()));
+  for (size_t i = 0; i != keys.size(); i++)
+  {
+    crypto::public_key pk = AUTO_VAL_INIT(pk);
+    ASSERT_TRUE(crypto::derive_public_key(derivation, i + 3, acc.get_keys().m_account_address.m_spend_public_key, pk));
+    ASSERT_EQ(pk, keys[i]);
+  }
+}
+
+TEST(output_scanner, lookup_acc_outs_on_miner_tx)
+{
+  currency::account_base acc, other;
+  acc.generate();
+  other.generate();
+  currency::transaction tx = AUTO_VAL_INIT(tx);
+  ASSERT_TRUE(currency::construct_miner_tx(0, 0, 10000000000000, 1000, DEFAULT_FEE, acc.get_keys().m_account_address, tx, currency::blobdata(), 11));
+  ASSERT_LT(1, tx.vout.size());
+
+  std::vector<size_t> outs;
+  uint64_t money = 0;
+  ASSERT_TRUE(currency::lookup_acc_outs(acc.get_keys(), tx, outs, money));
+  ASSERT_EQ(tx.vout.size(), outs.size());
+  uint64_t total = 0;
+  for (size_t i = 0; i != tx.vout.size(); i++)
+  {
+    ASSERT_TRUE(currency::is_out_to_acc(acc.get_keys(), boost::get<currency::txout_to_key>(tx.vout[i].target), currency::get_tx_pub_key_from_extra(tx), i));
+    total += tx.vout[i].amount;
+  }
+  ASSERT_EQ(total, money);
+
+  outs.clear();
+  ASSERT_TRUE(currency::lookup_acc_outs(other.get_keys(), tx, outs, money));
+  ASSERT_TRUE(outs.empty());
+  ASSERT_EQ(0, money);
+}
+
+TEST(output_scanner, many_accounts_one_pass)
+{
+  std::vector<currency::account_base> accs(3);
+  for (auto& a : accs)
+    a.generate();
+  currency::account_base stranger;
+  stranger.generate();
+
+  currency::output_scanner scanner;
+  ASSERT_EQ(0, scanner.add_account(accs[0].get_keys()));
+  ASSERT_EQ(1, scanner.add_account(stranger.get_keys()));
+  ASSERT_EQ(2, scanner.add_account(accs[2].get_keys().m_account_address, accs[2].get_keys().m_view_secret_key));
+
+  currency::transaction tx = make_tx_to_accounts(accs, 7);
+  std::vector<currency::output_scanner::account_outs> found;
+  ASSERT_TRUE(scanner.scan_transaction(tx, currency::get_tx_pub_key_from_extra(tx), found));
+  ASSERT_EQ(2, found.size());
+  ASSERT_EQ(0, found[0].account_index);
+  ASSERT_EQ(std::vector<size_t>({0, 3, 6}), found[0].outs);
+  ASSERT_EQ(1 + 4 + 7, found[0].money);
+  ASSERT_EQ(2, found[1].account_index);
+  ASSERT_EQ(std::vector<size_t>({2, 5}), found[1].outs);
+  ASSERT_EQ(3 + 6, found[1].money);
+
+  //stored derivation gives the same key image as the helper computing it from scratch
+  currency::keypair eph1, eph2;
+  crypto::key_image ki1, ki2;
+  ASSERT_TRUE(currency::generate_key_image_helper(accs[0].get_keys(), found[0].derivation, 3, eph1, ki1));
+  ASSERT_TRUE(currency::generate_key_image_helper(accs[0].get_keys(), currency::get_tx_pub_key_from_extra(tx), 3, eph2, ki2));
+  ASSERT_EQ(ki2, ki1);
+  ASSERT_EQ(boost::get<currency::txout_to_key>(tx.vout[3].target).key, eph1.pub);
+}
+
+TEST(output_scanner, batch_in_threads_matches_serial)
+{
+  std::vector<currency::account_base> accs(2);
+  for (auto& a : accs)
+    a.generate();
+  currency::output_scanner scanner;
+  scanner.add_account(accs[1].get_keys());
+
+  std::vector<currency::transaction> txs;
+  for (size_t i = 0; i != 100; i++)
+    txs.push_back(make_tx_to_accounts(accs, 1 + i % 5));
+  //unknown output type fails only its own transaction
+  txs[42].vout.push_back(currency::tx_out());
+  txs[42].vout.back().target = currency::txout_to_script();
+
+  std::vector<currency::output_scanner::tx_entry> entries(txs.size());
+  for (size_t i = 0; i != txs.size(); i++)
+  {
+    entries[i].ptx = &txs[i];
+    entries[i].tx_pub_key = currency::get_tx_pub_key_from_extra(txs[i]);
+  }
+  std::vector<currency::output_scanner::tx_entry> serial = entries;
+  scanner.scan_transactions(serial, 1);
+  scanner.scan_transactions(entries, 4);
+
+  for (size_t i = 0; i != txs.size(); i++)
+  {
+    ASSERT_EQ(i != 42, entries[i].result);
+    ASSERT_EQ(serial[i].result, entries[i].result);
+    if (i == 42)
+      continue;
+    size_t outs_count = 1 + i % 5;
+    ASSERT_EQ(outs_count > 1 ? 1 : 0, entries[i].found.size());
+    ASSERT_EQ(serial[i].found.size(), entries[i].found.size());
+    if (entries[i].found.size())
+    {
+      ASSERT_EQ(outs_count / 2, entries[i].found[0].outs.size());
+      ASSERT_EQ(serial[i].found[0].outs, entries[i].found[0].outs);
+    }
+  }
+}
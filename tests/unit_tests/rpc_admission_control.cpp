@@ -0,0 +1,82 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "rpc/rpc_admission_control.h"
+
+using currency::rpc_admission_control;
+
+namespace
+{
+  rpc_admission_control::limits make_limits(size_t normal, size_t bulk, size_t per_ip, uint64_t bytes_per_second)
+  {
+    rpc_admission_control::limits l = AUTO_VAL_INIT(l);
+    l.normal_concurrency = normal;
+    l.bulk_concurrency = bulk;
+    l.per_ip_concurrency = per_ip;
+    l.per_ip_bytes_per_second = bytes_per_second;
+    return l;
+  }
+}
+
+TEST(rpc_admission_control, work_classes)
+{
+  ASSERT_EQ(rpc_admission_control::work_class_priority, rpc_admission_control::get_method_work_class("submitblock"));
+  ASSERT_EQ(rpc_admission_control::work_class_priority, rpc_admission_control::get_method_work_class("getblocktemplate"));
+  ASSERT_EQ(rpc_admission_control::work_class_bulk, rpc_admission_control::get_method_work_class("get_all_alias_details"));
+  ASSERT_EQ(rpc_admission_control::work_class_normal, rpc_admission_control::get_method_work_class("getlastblockheader"));
+  ASSERT_EQ(rpc_admission_control::work_class_bulk, rpc_admission_control::get_uri_work_class("/getblocks.bin"));
+  ASSERT_EQ(rpc_admission_control::work_class_priority, rpc_admission_control::get_uri_work_class("/sendrawtransaction"));
+  ASSERT_EQ(rpc_admission_control::work_class_normal, rpc_admission_control::get_uri_work_class("/getinfo"));
+
+  std::vector<std::string> batch = {"submitblock", "getlastblockheader"};
+  ASSERT_EQ(rpc_admission_control::work_class_normal, rpc_admission_control::get_methods_work_class(batch));
+  batch.push_back("f_blocks_list_json");
+  ASSERT_EQ(rpc_admission_control::work_class_bulk, rpc_admission_control::get_methods_work_class(batch));
+}
+
+TEST(rpc_admission_control, bulk_requests_dont_take_priority_slots)
+{
+  rpc_admission_control ac;
+  ac.set_limits(make_limits(3, 2, 0, 0));
+
+  epee::misc_utils::auto_scope_leave_caller b1, b2, b3, n1, n2, p1, p2;
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_bulk, 1, b1));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_bulk, 2, b2));
+  ASSERT_FALSE(ac.admit(rpc_admission_control::work_class_bulk, 3, b3));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_normal, 3, n1));
+  ASSERT_FALSE(ac.admit(rpc_admission_control::work_class_normal, 4, n2));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_priority, 5, p1));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_priority, 5, p2));
+
+  b1.reset();
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_bulk, 3, b3));
+}
+
+TEST(rpc_admission_control, per_ip_limits)
+{
+  rpc_admission_control ac;
+  ac.set_limits(make_limits(0, 0, 2, 1000));
+
+  epee::misc_utils::auto_scope_leave_caller t1, t2, t3, t4;
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_normal, 1, t1));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_normal, 1, t2));
+  ASSERT_FALSE(ac.admit(rpc_admission_control::work_class_normal, 1, t3));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_normal, 2, t3));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_priority, 1, t4));
+  t1.reset();
+  t2.reset();
+  t4.reset();
+
+  //burst allowance is 5 seconds of traffic, going over it refuses ip until refilled
+  ac.charge_bytes(1, 100000);
+  ASSERT_FALSE(ac.admit(rpc_admission_control::work_class_bulk, 1, t1));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_priority, 1, t1));
+  ASSERT_TRUE(ac.admit(rpc_admission_control::work_class_normal, 2, t2));
+}
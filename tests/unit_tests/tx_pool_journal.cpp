@@ -0,0 +1,121 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/serialization/string.hpp>
+
+#include "currency_core/tx_pool_journal.h"
+
+namespace
+{
+  struct replayed_record
+  {
+    uint8_t type;
+    uint64_t a;
+    std::string b;
+  };
+
+  bool replay(currency::tx_pool_journal& j, const std::string& path, std::vector<replayed_record>& records)
+  {
+    records.clear();
+    uint64_t count = 0;
+    bool r = j.replay_and_open(path, [&](uint8_t type, const std::string& payload)
+    {
+      replayed_record rec = { type, 0, "" };
+      currency::tx_pool_journal::unpack(payload, rec.a, rec.b);
+      records.push_back(rec);
+      return true;
+    }, count);
+    return r && count == records.size() && count == j.get_records_count();
+  }
+
+  class tx_pool_journal_test : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    }
+    virtual void TearDown()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove(m_path, ec);
+      boost::filesystem::remove(m_path + ".tmp", ec);
+    }
+
+    std::string m_path;
+  };
+}
+
+TEST_F(tx_pool_journal_test, appended_records_survive_without_close)
+{
+  currency::tx_pool_journal j;
+  std::vector<replayed_record> records;
+  ASSERT_TRUE(replay(j, m_path, records));
+  ASSERT_TRUE(records.empty());
+  ASSERT_TRUE(j.append(1, currency::tx_pool_journal::pack(uint64_t(10), std::string("ten"))));
+  ASSERT_TRUE(j.append(2, currency::tx_pool_journal::pack(uint64_t(20), std::string("twenty"))));
+
+  // records are visible to another reader while the journal is still open, as after a crash
+  currency::tx_pool_journal j2;
+  ASSERT_TRUE(replay(j2, m_path, records));
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ(1, records[0].type);
+  ASSERT_EQ(10, records[0].a);
+  ASSERT_EQ("ten", records[0].b);
+  ASSERT_EQ(2, records[1].type);
+  ASSERT_EQ("twenty", records[1].b);
+}
+
+TEST_F(tx_pool_journal_test, torn_tail_is_discarded)
+{
+  currency::tx_pool_journal j;
+  std::vector<replayed_record> records;
+  ASSERT_TRUE(replay(j, m_path, records));
+  ASSERT_TRUE(j.append(1, currency::tx_pool_journal::pack(uint64_t(1), std::string("first"))));
+  uint64_t good_size = j.size();
+  ASSERT_TRUE(j.append(1, currency::tx_pool_journal::pack(uint64_t(2), std::string("second"))));
+  j.close();
+
+  boost::filesystem::resize_file(m_path, good_size + 5);
+
+  ASSERT_TRUE(replay(j, m_path, records));
+  ASSERT_EQ(1, records.size());
+  ASSERT_EQ("first", records[0].b);
+  ASSERT_EQ(good_size, j.size());
+  ASSERT_EQ(good_size, boost::filesystem::file_size(m_path));
+
+  // appending continues right after the last good record
+  ASSERT_TRUE(j.append(1, currency::tx_pool_journal::pack(uint64_t(3), std::string("third"))));
+  j.close();
+  ASSERT_TRUE(replay(j, m_path, records));
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ("third", records[1].b);
+}
+
+TEST_F(tx_pool_journal_test, rewrite_replaces_records)
+{
+  currency::tx_pool_journal j;
+  std::vector<replayed_record> records;
+  ASSERT_TRUE(replay(j, m_path, records));
+  for (uint64_t i = 0; i != 10; i++)
+    ASSERT_TRUE(j.append(1, currency::tx_pool_journal::pack(i, std::string("old"))));
+
+  std::vector<currency::tx_pool_journal::record> live;
+  live.push_back(currency::tx_pool_journal::record(1, currency::tx_pool_journal::pack(uint64_t(7), std::string("live"))));
+  ASSERT_TRUE(j.rewrite(m_path, live));
+  ASSERT_EQ(1, j.get_records_count());
+  ASSERT_TRUE(j.append(2, currency::tx_pool_journal::pack(uint64_t(8), std::string("after"))));
+  ASSERT_FALSE(boost::filesystem::exists(m_path + ".tmp"));
+  j.close();
+
+  ASSERT_TRUE(replay(j, m_path, records));
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ(7, records[0].a);
+  ASSERT_EQ("live", records[0].b);
+  ASSERT_EQ(2, records[1].type);
+  ASSERT_EQ("after", records[1].b);
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "currency_core/verified_inputs_cache.h"
+
+using currency::verified_inputs_cache;
+
+namespace
+{
+  crypto::hash make_hash(uint64_t n)
+  {
+    crypto::hash h = AUTO_VAL_INIT(h);
+    *reinterpret_cast<uint64_t*>(&h) = n;
+    return h;
+  }
+}
+
+TEST(verified_inputs_cache, key_depends_on_everything_signature_checks)
+{
+  crypto::hash prefix_hash = make_hash(1);
+  currency::txin_to_key txin = AUTO_VAL_INIT(txin);
+  std::vector<crypto::public_key> keys(3);
+  std::vector<crypto::signature> sigs(3);
+  crypto::hash key = verified_inputs_cache::make_key(prefix_hash, txin, keys, sigs);
+  ASSERT_EQ(key, verified_inputs_cache::make_key(prefix_hash, txin, keys, sigs));
+
+  ASSERT_NE(key, verified_inputs_cache::make_key(make_hash(2), txin, keys, sigs));
+
+  currency::txin_to_key txin2 = txin;
+  reinterpret_cast<unsigned char*>(&txin2.k_image)[0] = 1;
+  ASSERT_NE(key, verified_inputs_cache::make_key(prefix_hash, txin2, keys, sigs));
+
+  std::vector<crypto::public_key> keys2 = keys;
+  reinterpret_cast<unsigned char*>(&keys2[2])[31] = 1;
+  ASSERT_NE(key, verified_inputs_cache::make_key(prefix_hash, txin, keys2, sigs));
+
+  std::vector<crypto::signature> sigs2 = sigs;
+  reinterpret_cast<unsigned char*>(&sigs2[1])[0] = 1;
+  ASSERT_NE(key, verified_inputs_cache::make_key(prefix_hash, txin, keys, sigs2));
+}
+
+TEST(verified_inputs_cache, oldest_entries_evicted)
+{
+  verified_inputs_cache cache(3);
+  for (uint64_t i = 0; i != 5; i++)
+    cache.add(make_hash(i));
+  ASSERT_EQ(3, cache.size());
+  ASSERT_FALSE(cache.has(make_hash(0)));
+  ASSERT_FALSE(cache.has(make_hash(1)));
+  ASSERT_TRUE(cache.has(make_hash(2)));
+  ASSERT_TRUE(cache.has(make_hash(4)));
+  ASSERT_EQ(2, cache.get_hits_count());
+  ASSERT_EQ(2, cache.get_misses_count());
+
+  //adding existing key doesn't make it younger or take a slot
+  cache.add(make_hash(2));
+  cache.add(make_hash(5));
+  ASSERT_FALSE(cache.has(make_hash(2)));
+  ASSERT_TRUE(cache.has(make_hash(3)));
+
+  cache.set_max_size(1);
+  ASSERT_EQ(1, cache.size());
+  ASSERT_TRUE(cache.has(make_hash(5)));
+
+  cache.set_max_size(0);
+  cache.add(make_hash(6));
+  ASSERT_EQ(0, cache.size());
+}
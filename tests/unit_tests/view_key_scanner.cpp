@@ -0,0 +1,417 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "currency_core/currency_format_utils.h"
+#include "currency_core/view_key_scanner.h"
+
+namespace
+{
+  //main chain kept in memory, blocks are not checked
+  class test_chain : public currency::i_view_key_scanner_chain
+  {
+  public:
+    test_chain() : m_next_gindex(0)
+    {
+      m_nobody.generate();
+    }
+
+    virtual uint64_t get_current_blockchain_height()
+    {
+      return m_blocks.size();
+    }
+    virtual crypto::hash get_block_id_by_height(uint64_t height)
+    {
+      return height < m_blocks.size() ? currency::get_block_hash(m_blocks[height]) : currency::null_hash;
+    }
+    virtual bool get_blocks(uint64_t start_offset, size_t count, std::list<currency::block>& blocks, std::list<currency::transaction>& txs)
+    {
+      m_requests.push_back(start_offset);
+      if (m_on_get_blocks)
+      {
+        std::function<void()> cb;
+        cb.swap(m_on_get_blocks);
+        cb();
+      }
+      if (start_offset >= m_blocks.size())
+        return false;
+      for (uint64_t i = start_offset; i < start_offset + count && i < m_blocks.size(); i++)
+      {
+        blocks.push_back(m_blocks[i]);
+        for (const auto& tx_id : m_blocks[i].tx_hashes)
+          txs.push_back(m_txs[tx_id]);
+      }
+      return true;
+    }
+    virtual bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs)
+    {
+      auto it = m_gindexes.find(tx_id);
+      if (it == m_gindexes.end())
+        return false;
+      indexs = it->second;
+      return true;
+    }
+
+    //coinbase has one output per coinbase_to entry (or one to nobody), tx_to adds a transaction with one output per entry
+    void push_block(const std::vector<currency::account_base>& coinbase_to, const std::vector<currency::account_base>& tx_to = std::vector<currency::account_base>())
+    {
+      uint64_t height = m_blocks.size();
+      currency::block b = AUTO_VAL_INIT(b);
+      b.prev_id = height ? currency::get_block_hash(m_blocks.back()) : currency::null_hash;
+      b.timestamp = height;
+      currency::txin_gen in = AUTO_VAL_INIT(in);
+      in.height = height;
+      b.miner_tx = make_tx(coinbase_to.size() ? coinbase_to : std::vector<currency::account_base>(1, m_nobody), height);
+      b.miner_tx.vin.push_back(in);
+      add_gindexes(b.miner_tx);
+      if (tx_to.size())
+      {
+        currency::transaction tx = make_tx(tx_to, height);
+        crypto::hash tx_id = currency::get_transaction_hash(tx);
+        m_txs[tx_id] = tx;
+        add_gindexes(tx);
+        b.tx_hashes.push_back(tx_id);
+      }
+      m_blocks.push_back(b);
+    }
+    void push_blocks(size_t count, const std::vector<currency::account_base>& coinbase_to = std::vector<currency::account_base>())
+    {
+      for (size_t i = 0; i != count; i++)
+        push_block(coinbase_to);
+    }
+    //drops blocks from height, transactions are kept like in pool
+    void pop_to(uint64_t height)
+    {
+      m_blocks.resize(height);
+    }
+
+    std::vector<currency::block> m_blocks;
+    std::unordered_map<crypto::hash, currency::transaction> m_txs;
+    std::unordered_map<crypto::hash, std::vector<uint64_t> > m_gindexes;
+    std::vector<uint64_t> m_requests;
+    std::function<void()> m_on_get_blocks;
+
+  private:
+    //output i gets amount height * 100 + i + 1
+    currency::transaction make_tx(const std::vector<currency::account_base>& to, uint64_t height)
+    {
+      currency::transaction tx = AUTO_VAL_INIT(tx);
+      currency::keypair txkey = currency::keypair::generate();
+      currency::add_tx_pub_key_to_extra(tx, txkey.pub);
+      for (size_t i = 0; i != to.size(); i++)
+      {
+        const currency::account_public_address& addr = to[i].get_keys().m_account_address;
+        crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+        crypto::generate_key_derivation(addr.m_view_public_key, txkey.sec, derivation);
+        currency::txout_to_key tk = AUTO_VAL_INIT(tk);
+        crypto::derive_public_key(derivation, i, addr.m_spend_public_key, tk.key);
+        currency::tx_out out = AUTO_VAL_INIT(out);
+        out.amount = height * 100 + i + 1;
+        out.target = tk;
+        tx.vout.push_back(out);
+      }
+      return tx;
+    }
+    void add_gindexes(const currency::transaction& tx)
+    {
+      std::vector<uint64_t>& gi = m_gindexes[currency::get_transaction_hash(tx)];
+      for (size_t i = 0; i != tx.vout.size(); i++)
+        gi.push_back(m_next_gindex++);
+    }
+
+    currency::account_base m_nobody;
+    uint64_t m_next_gindex;
+  };
+
+  class view_key_scanner_test : public ::testing::Test
+  {
+  protected:
+    view_key_scanner_test() : m_scanner(m_chain)
+    {
+      m_alice.generate();
+      m_bob.generate();
+    }
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(m_scanner.init(2, 10, "", false));
+    }
+    virtual void TearDown()
+    {
+      m_scanner.deinit();
+    }
+
+    bool register_account(const currency::account_base& acc, uint64_t start_height)
+    {
+      std::string err;
+      return m_scanner.register_account(acc.get_keys().m_account_address, acc.get_keys().m_view_secret_key, start_height, err);
+    }
+    void scan_all()
+    {
+      while (m_scanner.do_scan_pass());
+    }
+    std::vector<currency::view_key_scanner_output> get_outputs(const currency::account_base& acc, uint64_t& scanned_height)
+    {
+      std::list<currency::view_key_scanner_output> outs;
+      uint64_t total = 0;
+      scanned_height = 0;
+      EXPECT_TRUE(m_scanner.get_outputs(acc.get_keys().m_account_address, 0, 1000, outs, total, scanned_height));
+      EXPECT_EQ(total, outs.size());
+      return std::vector<currency::view_key_scanner_output>(outs.begin(), outs.end());
+    }
+    std::vector<uint64_t> get_heights(const currency::account_base& acc)
+    {
+      uint64_t scanned_height = 0;
+      std::vector<uint64_t> heights;
+      for (const auto& o : get_outputs(acc, scanned_height))
+        heights.push_back(o.height);
+      return heights;
+    }
+    crypto::hash coinbase_id(uint64_t height)
+    {
+      return currency::get_transaction_hash(m_chain.m_blocks[height].miner_tx);
+    }
+
+    test_chain m_chain;
+    currency::view_key_scanner m_scanner;
+    currency::account_base m_alice;
+    currency::account_base m_bob;
+  };
+}
+
+TEST_F(view_key_scanner_test, register_scan_reorg_rescan)
+{
+  std::vector<currency::account_base> alice(1, m_alice);
+  m_chain.push_block(std::vector<currency::account_base>());
+  m_chain.push_block(alice);
+  m_chain.push_block(std::vector<currency::account_base>(), std::vector<currency::account_base>(2, m_alice));
+  m_chain.push_block(alice);
+  m_chain.push_block(std::vector<currency::account_base>());
+  ASSERT_TRUE(register_account(m_alice, 0));
+  scan_all();
+
+  uint64_t scanned_height = 0;
+  std::vector<currency::view_key_scanner_output> outs = get_outputs(m_alice, scanned_height);
+  ASSERT_EQ(5, scanned_height);
+  ASSERT_EQ(std::vector<uint64_t>({1, 2, 2, 3}), get_heights(m_alice));
+  crypto::hash tx_id = m_chain.m_blocks[2].tx_hashes.front();
+  ASSERT_EQ(tx_id, outs[2].tx_id);
+  ASSERT_EQ(1, outs[2].out_index);
+  ASSERT_EQ(m_chain.m_gindexes[tx_id][1], outs[2].global_index);
+  ASSERT_EQ(2 * 100 + 2, outs[2].amount);
+  ASSERT_EQ(coinbase_id(3), outs[3].tx_id);
+
+  //blocks 3 and 4 replaced by three others
+  m_chain.pop_to(3);
+  m_chain.push_block(std::vector<currency::account_base>());
+  m_chain.push_block(alice);
+  m_chain.push_block(alice);
+  m_chain.m_requests.clear();
+  scan_all();
+
+  outs = get_outputs(m_alice, scanned_height);
+  ASSERT_EQ(6, scanned_height);
+  ASSERT_EQ(std::vector<uint64_t>({1, 2, 2, 4, 5}), get_heights(m_alice));
+  ASSERT_EQ(coinbase_id(4), outs[3].tx_id);
+  ASSERT_EQ(coinbase_id(5), outs[4].tx_id);
+  ASSERT_EQ(std::vector<uint64_t>({3}), m_chain.m_requests);
+
+  //nothing changed - nothing is asked
+  m_chain.m_requests.clear();
+  ASSERT_FALSE(m_scanner.do_scan_pass());
+  ASSERT_TRUE(m_chain.m_requests.empty());
+}
+
+TEST_F(view_key_scanner_test, get_outputs_paging)
+{
+  m_chain.push_blocks(7, std::vector<currency::account_base>(1, m_alice));
+  ASSERT_TRUE(register_account(m_alice, 0));
+  scan_all();
+
+  std::list<currency::view_key_scanner_output> outs;
+  uint64_t total = 0;
+  uint64_t scanned_height = 0;
+  ASSERT_TRUE(m_scanner.get_outputs(m_alice.get_keys().m_account_address, 0, 3, outs, total, scanned_height));
+  ASSERT_EQ(7, total);
+  ASSERT_EQ(7, scanned_height);
+  ASSERT_EQ(3, outs.size());
+  ASSERT_EQ(0, outs.front().height);
+  ASSERT_EQ(2, outs.back().height);
+
+  outs.clear();
+  ASSERT_TRUE(m_scanner.get_outputs(m_alice.get_keys().m_account_address, 5, 3, outs, total, scanned_height));
+  ASSERT_EQ(7, total);
+  ASSERT_EQ(2, outs.size());
+  ASSERT_EQ(5, outs.front().height);
+  ASSERT_EQ(6, outs.back().height);
+
+  outs.clear();
+  ASSERT_TRUE(m_scanner.get_outputs(m_alice.get_keys().m_account_address, 7, 3, outs, total, scanned_height));
+  ASSERT_EQ(7, total);
+  ASSERT_TRUE(outs.empty());
+
+  ASSERT_FALSE(m_scanner.get_outputs(m_bob.get_keys().m_account_address, 0, 3, outs, total, scanned_height));
+  ASSERT_TRUE(m_scanner.unregister_account(m_alice.get_keys().m_account_address));
+  ASSERT_FALSE(m_scanner.get_outputs(m_alice.get_keys().m_account_address, 0, 3, outs, total, scanned_height));
+}
+
+TEST_F(view_key_scanner_test, account_gets_outputs_only_from_its_height)
+{
+  std::vector<currency::account_base> both;
+  both.push_back(m_alice);
+  both.push_back(m_bob);
+  m_chain.push_blocks(6, both);
+  ASSERT_TRUE(register_account(m_alice, 0));
+  ASSERT_TRUE(register_account(m_bob, 3));
+  scan_all();
+
+  //both accounts are taken by the same step
+  ASSERT_EQ(std::vector<uint64_t>({0}), m_chain.m_requests);
+  ASSERT_EQ(std::vector<uint64_t>({0, 1, 2, 3, 4, 5}), get_heights(m_alice));
+  ASSERT_EQ(std::vector<uint64_t>({3, 4, 5}), get_heights(m_bob));
+}
+
+TEST_F(view_key_scanner_test, rollback_trims_outs_and_keeps_start_height)
+{
+  std::vector<currency::account_base> alice(1, m_alice);
+  m_chain.push_blocks(7, alice);
+  ASSERT_TRUE(register_account(m_alice, 3));
+  ASSERT_TRUE(register_account(m_bob, 0));
+  scan_all();
+  ASSERT_EQ(std::vector<uint64_t>({3, 4, 5, 6}), get_heights(m_alice));
+
+  //switch below start height of alice, bob goes back to the fork
+  m_chain.pop_to(1);
+  m_chain.push_blocks(7, alice);
+  m_chain.m_requests.clear();
+  scan_all();
+
+  uint64_t scanned_height = 0;
+  std::vector<currency::view_key_scanner_output> outs = get_outputs(m_alice, scanned_height);
+  ASSERT_EQ(8, scanned_height);
+  ASSERT_EQ(std::vector<uint64_t>({3, 4, 5, 6, 7}), get_heights(m_alice));
+  for (const auto& o : outs)
+    ASSERT_EQ(coinbase_id(o.height), o.tx_id);
+  ASSERT_EQ(std::vector<uint64_t>({1}), m_chain.m_requests);
+  ASSERT_TRUE(get_outputs(m_bob, scanned_height).empty());
+  ASSERT_EQ(8, scanned_height);
+}
+
+TEST_F(view_key_scanner_test, recent_ids_window_restarts_on_gap)
+{
+  m_chain.push_blocks(155);
+  m_chain.push_block(std::vector<currency::account_base>(1, m_alice));
+  m_chain.push_blocks(344);
+  ASSERT_TRUE(register_account(m_alice, 0));
+  //alice is backfilled, so known ids are [0, 200)
+  ASSERT_TRUE(m_scanner.do_scan_pass());
+  ASSERT_EQ(std::vector<uint64_t>({0}), m_chain.m_requests);
+  //bob at the top goes first and starts ids over from 400
+  ASSERT_TRUE(register_account(m_bob, 400));
+  scan_all();
+  ASSERT_EQ(std::vector<uint64_t>({0, 400, 200, 400}), m_chain.m_requests);
+
+  //ids don't get shifted by the gap, no false switch is seen
+  m_chain.m_requests.clear();
+  ASSERT_FALSE(m_scanner.do_scan_pass());
+  ASSERT_TRUE(m_chain.m_requests.empty());
+
+  //switch inside known ids rolls back to the fork only
+  m_chain.pop_to(450);
+  m_chain.push_blocks(10);
+  m_chain.push_block(std::vector<currency::account_base>(1, m_alice));
+  m_chain.push_blocks(39);
+  scan_all();
+  ASSERT_EQ(std::vector<uint64_t>({450}), m_chain.m_requests);
+  ASSERT_EQ(std::vector<uint64_t>({155, 460}), get_heights(m_alice));
+
+  //switch under known ids
+  m_chain.pop_to(150);
+  m_chain.push_blocks(10);
+  m_chain.push_block(std::vector<currency::account_base>(1, m_alice));
+  m_chain.push_blocks(350);
+  m_chain.m_requests.clear();
+  scan_all();
+  ASSERT_NE(m_chain.m_requests.end(), std::find(m_chain.m_requests.begin(), m_chain.m_requests.end(), 0));
+  ASSERT_EQ(std::vector<uint64_t>({160}), get_heights(m_alice));
+  uint64_t scanned_height = 0;
+  ASSERT_TRUE(get_outputs(m_bob, scanned_height).empty());
+  ASSERT_EQ(511, scanned_height);
+}
+
+TEST_F(view_key_scanner_test, switch_deeper_than_known_ids_rescans_from_zero)
+{
+  std::vector<currency::account_base> alice(1, m_alice);
+  m_chain.push_blocks(50);
+  m_chain.push_block(alice);
+  m_chain.push_blocks(749);
+  ASSERT_TRUE(register_account(m_alice, 0));
+  scan_all();
+  ASSERT_EQ(std::vector<uint64_t>({50}), get_heights(m_alice));
+
+  //fork is below the 720 known ids
+  m_chain.pop_to(40);
+  m_chain.push_blocks(20);
+  m_chain.push_block(alice);
+  m_chain.push_blocks(740);
+  m_chain.m_requests.clear();
+  scan_all();
+  ASSERT_EQ(0, m_chain.m_requests.front());
+  uint64_t scanned_height = 0;
+  std::vector<currency::view_key_scanner_output> outs = get_outputs(m_alice, scanned_height);
+  ASSERT_EQ(801, scanned_height);
+  ASSERT_EQ(1, outs.size());
+  ASSERT_EQ(60, outs[0].height);
+  ASSERT_EQ(coinbase_id(60), outs[0].tx_id);
+}
+
+TEST_F(view_key_scanner_test, step_results_dropped_for_reregistered_account)
+{
+  m_chain.push_blocks(6, std::vector<currency::account_base>(1, m_alice));
+  ASSERT_TRUE(register_account(m_alice, 0));
+  m_chain.m_on_get_blocks = [&]()
+  {
+    ASSERT_TRUE(m_scanner.unregister_account(m_alice.get_keys().m_account_address));
+    ASSERT_TRUE(register_account(m_alice, 2));
+  };
+  ASSERT_TRUE(m_scanner.do_scan_pass());
+
+  uint64_t scanned_height = 0;
+  ASSERT_TRUE(get_outputs(m_alice, scanned_height).empty());
+  ASSERT_EQ(2, scanned_height);
+  scan_all();
+  ASSERT_EQ(std::vector<uint64_t>({2, 3, 4, 5}), get_heights(m_alice));
+}
+
+TEST_F(view_key_scanner_test, step_results_dropped_for_rolled_back_account)
+{
+  std::vector<currency::account_base> alice(1, m_alice);
+  m_chain.push_blocks(5, alice);
+  ASSERT_TRUE(register_account(m_alice, 0));
+  scan_all();
+  m_chain.push_blocks(3, alice);
+
+  //while blocks [5, 8) are scanned chain switches at 3 and another pass catches up
+  m_chain.m_on_get_blocks = [&]()
+  {
+    m_chain.pop_to(3);
+    m_chain.push_blocks(5, alice);
+    m_scanner.do_scan_pass();
+  };
+  m_chain.m_requests.clear();
+  ASSERT_TRUE(m_scanner.do_scan_pass());
+  ASSERT_EQ(std::vector<uint64_t>({5, 3}), m_chain.m_requests);
+
+  uint64_t scanned_height = 0;
+  std::vector<currency::view_key_scanner_output> outs = get_outputs(m_alice, scanned_height);
+  ASSERT_EQ(8, scanned_height);
+  ASSERT_EQ(std::vector<uint64_t>({0, 1, 2, 3, 4, 5, 6, 7}), get_heights(m_alice));
+  for (const auto& o : outs)
+    ASSERT_EQ(coinbase_id(o.height), o.tx_id);
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "wallet/wallet2.h"
+
+namespace tools
+{
+  /************************************************************************/
+  /* Access to wallet2 internals, unit tests only                         */
+  /************************************************************************/
+  struct wallet2_test_accessor
+  {
+    //wallet with genesis block only, no daemon needed
+    static void reset(wallet2& w)
+    {
+      w.clear();
+    }
+
+    static void add_block(wallet2& w)
+    {
+      uint64_t n = w.m_blockchain.size();
+      w.m_blockchain.push_back(crypto::cn_fast_hash(&n, sizeof(n)));
+      ++w.m_local_bc_height;
+    }
+
+    static uint64_t get_chain_size(wallet2& w)
+    {
+      return w.m_blockchain.size();
+    }
+
+    //transfer of one output received in the block on top of the chain, as process_new_transaction() adds it
+    static size_t add_transfer(wallet2& w, uint64_t amount, uint64_t unlock_time)
+    {
+      wallet2::transfer_details td = AUTO_VAL_INIT(td);
+      td.m_block_height = w.m_blockchain.size() - 1;
+      td.m_tx.unlock_time = unlock_time;
+      currency::tx_out out = AUTO_VAL_INIT(out);
+      out.amount = amount;
+      td.m_tx.vout.push_back(out);
+      td.m_internal_output_index = 0;
+      td.m_spent = false;
+      uint64_t n = w.m_transfers.size();
+      crypto::hash h = crypto::cn_fast_hash(&n, sizeof(n));
+      memcpy(&td.m_key_image, &h, sizeof(td.m_key_image));
+      w.m_transfers.push_back(td);
+      w.m_key_images[td.m_key_image] = w.m_transfers.size() - 1;
+      w.add_transfer_to_indexes(w.m_transfers.size() - 1);
+      return w.m_transfers.size() - 1;
+    }
+
+    static size_t get_transfers_count(wallet2& w)
+    {
+      return w.m_transfers.size();
+    }
+
+    static void set_transfer_spent(wallet2& w, size_t transfer_index, bool spent)
+    {
+      w.set_transfer_spent(transfer_index, spent);
+    }
+
+    //emulates time passing for a transfer locked by timestamp, its unlock height stays the same
+    static void set_transfer_unlock_time(wallet2& w, size_t transfer_index, uint64_t unlock_time)
+    {
+      w.m_transfers[transfer_index].m_tx.unlock_time = unlock_time;
+    }
+
+    static void add_history_entry(wallet2& w, bool is_income)
+    {
+      wallet_rpc::wallet_transfer_info wti = AUTO_VAL_INIT(wti);
+      wti.height = w.m_blockchain.size() - 1;
+      wti.is_income = is_income;
+      w.m_transfer_history.push_back(wti);
+      w.add_history_entry_to_indexes(w.m_transfer_history.size() - 1);
+    }
+
+    static void detach_blockchain(wallet2& w, uint64_t height)
+    {
+      w.detach_blockchain(height);
+    }
+
+    //checks history indexes against m_transfer_history, all entries are below given height
+    static bool check_history(wallet2& w, uint64_t height)
+    {
+      size_t in_count = 0;
+      for (size_t i = 0; i != w.m_transfer_history.size(); i++)
+      {
+        if (w.m_transfer_history[i].height >= height)
+          return false;
+        if (w.m_transfer_history[i].is_income)
+          ++in_count;
+      }
+      if (in_count != w.m_history_in.size() || w.m_transfer_history.size() - in_count != w.m_history_out.size())
+        return false;
+      for (size_t i : w.m_history_in)
+        if (i >= w.m_transfer_history.size() || !w.m_transfer_history[i].is_income)
+          return false;
+      for (size_t i : w.m_history_out)
+        if (i >= w.m_transfer_history.size() || w.m_transfer_history[i].is_income)
+          return false;
+      return true;
+    }
+
+    static size_t get_history_size(wallet2& w)
+    {
+      return w.m_transfer_history.size();
+    }
+
+    //balances the way they were calculated before the indexes, by a full scan of transfers
+    static void recompute_balances(wallet2& w, uint64_t& unspent, uint64_t& unlocked)
+    {
+      unspent = 0;
+      unlocked = 0;
+      for (const auto& td : w.m_transfers)
+      {
+        if (td.m_spent)
+          continue;
+        unspent += td.amount();
+        if (w.is_transfer_unlocked(td))
+          unlocked += td.amount();
+      }
+    }
+  };
+}
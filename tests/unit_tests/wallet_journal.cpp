@@ -0,0 +1,118 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <boost/filesystem.hpp>
+
+#include "wallet/wallet_journal.h"
+
+namespace
+{
+  struct replayed_record
+  {
+    uint8_t type;
+    uint64_t a;
+    std::string b;
+  };
+
+  bool replay(tools::wallet_journal& j, const std::string& path, uint64_t generation, std::vector<replayed_record>& records)
+  {
+    records.clear();
+    uint64_t count = 0;
+    bool r = j.replay_and_open(path, generation, [&](uint8_t type, const std::string& payload)
+    {
+      replayed_record rec = { type, 0, "" };
+      tools::wallet_journal::unpack(payload, rec.a, rec.b);
+      records.push_back(rec);
+      return true;
+    }, count);
+    return r && count == records.size();
+  }
+
+  class wallet_journal_test : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      m_path = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+    }
+    virtual void TearDown()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove(m_path, ec);
+    }
+
+    std::string m_path;
+  };
+}
+
+TEST_F(wallet_journal_test, records_survive_reopen)
+{
+  tools::wallet_journal j;
+  ASSERT_TRUE(j.reset(m_path, 7));
+  j.add(1, uint64_t(10), std::string("ten"));
+  j.add(2, uint64_t(20), std::string("twenty"));
+  ASSERT_TRUE(j.commit());
+  j.add(3, uint64_t(30), std::string("never committed"));
+  j.close();
+
+  std::vector<replayed_record> records;
+  ASSERT_TRUE(replay(j, m_path, 7, records));
+  ASSERT_EQ(2, records.size());
+  ASSERT_EQ(1, records[0].type);
+  ASSERT_EQ(10, records[0].a);
+  ASSERT_EQ("ten", records[0].b);
+  ASSERT_EQ(2, records[1].type);
+  ASSERT_EQ(20, records[1].a);
+  ASSERT_EQ("twenty", records[1].b);
+
+  // appending continues after replayed records
+  j.add(4, uint64_t(40), std::string("forty"));
+  ASSERT_TRUE(j.commit());
+  j.close();
+  ASSERT_TRUE(replay(j, m_path, 7, records));
+  ASSERT_EQ(3, records.size());
+  ASSERT_EQ(40, records[2].a);
+}
+
+TEST_F(wallet_journal_test, torn_tail_is_discarded)
+{
+  tools::wallet_journal j;
+  ASSERT_TRUE(j.reset(m_path, 1));
+  j.add(1, uint64_t(1), std::string("first"));
+  ASSERT_TRUE(j.commit());
+  uint64_t good_size = j.size();
+  j.add(1, uint64_t(2), std::string("second"));
+  ASSERT_TRUE(j.commit());
+  j.close();
+
+  // simulate crash in the middle of the second record
+  boost::filesystem::resize_file(m_path, good_size + 5);
+
+  std::vector<replayed_record> records;
+  ASSERT_TRUE(replay(j, m_path, 1, records));
+  ASSERT_EQ(1, records.size());
+  ASSERT_EQ("first", records[0].b);
+  ASSERT_EQ(good_size, j.size());
+  ASSERT_EQ(good_size, boost::filesystem::file_size(m_path));
+}
+
+TEST_F(wallet_journal_test, other_generation_is_ignored)
+{
+  tools::wallet_journal j;
+  ASSERT_TRUE(j.reset(m_path, 1));
+  j.add(1, uint64_t(1), std::string("stale"));
+  ASSERT_TRUE(j.commit());
+  j.close();
+
+  std::vector<replayed_record> records;
+  ASSERT_TRUE(replay(j, m_path, 2, records));
+  ASSERT_TRUE(records.empty());
+  j.close();
+
+  // journal has been started over for the new generation
+  ASSERT_TRUE(replay(j, m_path, 1, records));
+  ASSERT_TRUE(records.empty());
+}
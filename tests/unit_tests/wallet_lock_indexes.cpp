@@ -0,0 +1,179 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+
+#include "wallet2_test_accessor.h"
+
+using tools::wallet2_test_accessor;
+
+namespace
+{
+  class wallet_lock_indexes_test : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp()
+    {
+      wallet2_test_accessor::reset(m_wallet);
+    }
+
+    //balances from indexes are the same as full scan gives
+    void check_balances(const char* what)
+    {
+      uint64_t unspent = 0, unlocked = 0;
+      wallet2_test_accessor::recompute_balances(m_wallet, unspent, unlocked);
+      ASSERT_EQ(unspent, m_wallet.balance()) << what << ", chain size " << wallet2_test_accessor::get_chain_size(m_wallet);
+      ASSERT_EQ(unlocked, m_wallet.unlocked_balance()) << what << ", chain size " << wallet2_test_accessor::get_chain_size(m_wallet);
+    }
+
+    void add_blocks(size_t count)
+    {
+      for (size_t i = 0; i != count; i++)
+      {
+        wallet2_test_accessor::add_block(m_wallet);
+        check_balances("add block");
+      }
+    }
+
+    static uint64_t now()
+    {
+      return static_cast<uint64_t>(time(NULL));
+    }
+
+    tools::wallet2 m_wallet;
+  };
+}
+
+TEST_F(wallet_lock_indexes_test, height_unlocks)
+{
+  add_blocks(3);
+  wallet2_test_accessor::add_transfer(m_wallet, 1000, 0);
+  wallet2_test_accessor::add_transfer(m_wallet, 2000, 0);
+  check_balances("add transfers");
+  ASSERT_EQ(3000, m_wallet.balance());
+  ASSERT_EQ(0, m_wallet.unlocked_balance());
+
+  //unlock_time as block height, beyond spendable age
+  add_blocks(2);
+  const uint64_t unlock_height = wallet2_test_accessor::get_chain_size(m_wallet) + DEFAULT_TX_SPENDABLE_AGE + 5;
+  wallet2_test_accessor::add_transfer(m_wallet, 4000, unlock_height);
+  check_balances("add locked transfer");
+
+  add_blocks(DEFAULT_TX_SPENDABLE_AGE);
+  ASSERT_EQ(3000, m_wallet.unlocked_balance());
+  while (wallet2_test_accessor::get_chain_size(m_wallet) < unlock_height)
+  {
+    ASSERT_EQ(3000, m_wallet.unlocked_balance());
+    add_blocks(1);
+  }
+  ASSERT_EQ(7000, m_wallet.unlocked_balance());
+  ASSERT_EQ(7000, m_wallet.balance());
+}
+
+TEST_F(wallet_lock_indexes_test, timestamp_unlocks)
+{
+  add_blocks(2);
+  //long past timestamp unlocks with spendable age, far future one waits for time once age is reached
+  wallet2_test_accessor::add_transfer(m_wallet, 100, CURRENCY_MAX_BLOCK_NUMBER + 1);
+  size_t waiting = wallet2_test_accessor::add_transfer(m_wallet, 200, now() + 100 * CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS + 3600);
+  check_balances("add transfers");
+
+  add_blocks(DEFAULT_TX_SPENDABLE_AGE + 2);
+  ASSERT_EQ(300, m_wallet.balance());
+  ASSERT_EQ(100, m_wallet.unlocked_balance());
+
+  //spending and unspending a transfer waiting for time
+  wallet2_test_accessor::set_transfer_spent(m_wallet, waiting, true);
+  check_balances("spend waiting transfer");
+  wallet2_test_accessor::set_transfer_spent(m_wallet, waiting, false);
+  check_balances("unspend waiting transfer");
+
+  //the time comes
+  wallet2_test_accessor::set_transfer_unlock_time(m_wallet, waiting, now() - 1);
+  check_balances("time passed");
+  ASSERT_EQ(300, m_wallet.unlocked_balance());
+
+  //transfer that reaches spendable age before its time
+  size_t recent = wallet2_test_accessor::add_transfer(m_wallet, 400, now() + 100 * CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS + 3600);
+  add_blocks(DEFAULT_TX_SPENDABLE_AGE);
+  ASSERT_EQ(300, m_wallet.unlocked_balance());
+  wallet2_test_accessor::set_transfer_unlock_time(m_wallet, recent, now() - 1);
+  check_balances("recent transfer time passed");
+  ASSERT_EQ(700, m_wallet.unlocked_balance());
+}
+
+TEST_F(wallet_lock_indexes_test, spend_and_unspend)
+{
+  add_blocks(2);
+  std::vector<size_t> transfers;
+  for (size_t i = 0; i != 20; i++)
+  {
+    uint64_t unlock_time = i % 3 == 0 ? wallet2_test_accessor::get_chain_size(m_wallet) + DEFAULT_TX_SPENDABLE_AGE + i : 0;
+    transfers.push_back(wallet2_test_accessor::add_transfer(m_wallet, 10 * (i + 1), unlock_time));
+    add_blocks(1);
+  }
+  //spend states change while transfers are locked, unlocked and in between
+  for (size_t round = 0; round != 3 * DEFAULT_TX_SPENDABLE_AGE; round++)
+  {
+    for (size_t i = round % 4; i < transfers.size(); i += 3)
+    {
+      wallet2_test_accessor::set_transfer_spent(m_wallet, transfers[i], (i + round) % 2 == 0);
+      check_balances("spend state changed");
+    }
+    add_blocks(1);
+  }
+  for (size_t t : transfers)
+    wallet2_test_accessor::set_transfer_spent(m_wallet, t, true);
+  check_balances("all spent");
+  ASSERT_EQ(0, m_wallet.balance());
+  ASSERT_EQ(0, m_wallet.unlocked_balance());
+}
+
+TEST_F(wallet_lock_indexes_test, detach_blockchain)
+{
+  add_blocks(2);
+  for (size_t i = 0; i != 30; i++)
+  {
+    uint64_t unlock_time = 0;
+    if (i % 4 == 1)
+      unlock_time = wallet2_test_accessor::get_chain_size(m_wallet) + DEFAULT_TX_SPENDABLE_AGE + 7;
+    else if (i % 4 == 2)
+      unlock_time = now() + 100 * CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS + 3600;
+    size_t t = wallet2_test_accessor::add_transfer(m_wallet, 1000 + i, unlock_time);
+    if (i % 5 == 0)
+      wallet2_test_accessor::set_transfer_spent(m_wallet, t, true);
+    wallet2_test_accessor::add_history_entry(m_wallet, i % 3 != 0);
+    add_blocks(1);
+  }
+  const uint64_t top = wallet2_test_accessor::get_chain_size(m_wallet);
+  ASSERT_TRUE(wallet2_test_accessor::check_history(m_wallet, top));
+  ASSERT_EQ(30, wallet2_test_accessor::get_history_size(m_wallet));
+
+  //some unlocked transfers go back to locked, waiting ones are dropped
+  const uint64_t detach_height = top - 12;
+  wallet2_test_accessor::detach_blockchain(m_wallet, detach_height);
+  ASSERT_EQ(detach_height, wallet2_test_accessor::get_chain_size(m_wallet));
+  check_balances("detach");
+  ASSERT_TRUE(wallet2_test_accessor::check_history(m_wallet, detach_height));
+  ASSERT_EQ(detach_height - 2, wallet2_test_accessor::get_history_size(m_wallet));
+  ASSERT_EQ(detach_height - 2, wallet2_test_accessor::get_transfers_count(m_wallet));
+
+  //other chain grows past the old top
+  for (size_t i = 0; i != 20; i++)
+  {
+    wallet2_test_accessor::add_transfer(m_wallet, 5000 + i, i % 2 ? 0 : wallet2_test_accessor::get_chain_size(m_wallet) + DEFAULT_TX_SPENDABLE_AGE + 3);
+    wallet2_test_accessor::add_history_entry(m_wallet, true);
+    add_blocks(1);
+  }
+  ASSERT_TRUE(wallet2_test_accessor::check_history(m_wallet, wallet2_test_accessor::get_chain_size(m_wallet)));
+
+  //detach everything but genesis
+  wallet2_test_accessor::detach_blockchain(m_wallet, 1);
+  check_balances("detach all");
+  ASSERT_EQ(0, m_wallet.balance());
+  ASSERT_EQ(0, wallet2_test_accessor::get_history_size(m_wallet));
+  ASSERT_TRUE(wallet2_test_accessor::check_history(m_wallet, 1));
+}